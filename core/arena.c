@@ -0,0 +1,173 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2017 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ *******************************************************************************/
+
+/*
+ * The arena hands out memory from blocks of LWM2M_ARENA_BLOCK_SIZE bytes by
+ * bumping an offset. Nothing is freed individually: data_free() skips arena
+ * memory and the whole arena is rewound when the outermost arena_leave() is
+ * reached, i.e. when lwm2m_handle_packet() or lwm2m_step() returns.
+ * Requests bigger than a block get a block of their own. Only one standard
+ * block is kept across resets.
+ *
+ * A buffer of the caller (e.g. a CoAP payload) can be borrowed so that data
+ * trees point into it instead of copying values. It is reported by
+ * arena_contains() like arena memory and must stay valid until the arena is
+ * rewound.
+ */
+
+#include "internals.h"
+
+#define ARENA_ALIGN(S) (((S) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+#define ARENA_HEADER_SIZE ARENA_ALIGN(sizeof(lwm2m_arena_block_t))
+
+static uint8_t * prv_blockData(lwm2m_arena_block_t * blockP)
+{
+    return (uint8_t *)blockP + ARENA_HEADER_SIZE;
+}
+
+void * arena_alloc(lwm2m_arena_t * arenaP,
+                   size_t size)
+{
+    lwm2m_arena_block_t * blockP;
+    void * memP;
+
+    size = ARENA_ALIGN(size);
+    if (size == 0) return NULL;
+
+    blockP = arenaP->blockList;
+    if (blockP == NULL || blockP->size - blockP->used < size)
+    {
+        size_t blockSize;
+
+        blockSize = (size > LWM2M_ARENA_BLOCK_SIZE) ? size : LWM2M_ARENA_BLOCK_SIZE;
+        blockP = (lwm2m_arena_block_t *)lwm2m_malloc(ARENA_HEADER_SIZE + blockSize);
+        if (blockP == NULL) return NULL;
+        blockP->size = blockSize;
+        blockP->used = 0;
+        blockP->next = arenaP->blockList;
+        arenaP->blockList = blockP;
+    }
+
+    memP = prv_blockData(blockP) + blockP->used;
+    blockP->used += size;
+
+    return memP;
+}
+
+bool arena_contains(lwm2m_arena_t * arenaP,
+                    void * memP)
+{
+    lwm2m_arena_block_t * blockP;
+    lwm2m_arena_view_t * viewP;
+
+    if (arenaP == NULL) return false;
+
+    for (blockP = arenaP->blockList ; blockP != NULL ; blockP = blockP->next)
+    {
+        if ((uint8_t *)memP >= prv_blockData(blockP)
+         && (uint8_t *)memP < prv_blockData(blockP) + blockP->size)
+        {
+            return true;
+        }
+    }
+
+    for (viewP = arenaP->viewList ; viewP != NULL ; viewP = viewP->next)
+    {
+        if ((uint8_t *)memP >= viewP->buffer
+         && (uint8_t *)memP < viewP->buffer + viewP->length)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool arena_borrow(lwm2m_arena_t * arenaP,
+                  uint8_t * buffer,
+                  size_t length)
+{
+    lwm2m_arena_view_t * viewP;
+
+    if (arena_contains(arenaP, buffer)
+     && (length == 0 || arena_contains(arenaP, buffer + length - 1)))
+    {
+        return true;
+    }
+
+    viewP = (lwm2m_arena_view_t *)arena_alloc(arenaP, sizeof(lwm2m_arena_view_t));
+    if (viewP == NULL) return false;
+    viewP->buffer = buffer;
+    viewP->length = length;
+    viewP->next = arenaP->viewList;
+    arenaP->viewList = viewP;
+
+    return true;
+}
+
+void arena_enter(lwm2m_arena_t * arenaP)
+{
+    arenaP->depth++;
+}
+
+void arena_leave(lwm2m_arena_t * arenaP)
+{
+    arenaP->depth--;
+    if (arenaP->depth == 0)
+    {
+        arena_reset(arenaP);
+    }
+}
+
+void arena_reset(lwm2m_arena_t * arenaP)
+{
+    lwm2m_arena_block_t * keptP = NULL;
+
+    LOG("Entering");
+    arenaP->viewList = NULL;
+    while (arenaP->blockList != NULL)
+    {
+        lwm2m_arena_block_t * blockP = arenaP->blockList;
+
+        arenaP->blockList = blockP->next;
+        if (keptP == NULL && blockP->size == LWM2M_ARENA_BLOCK_SIZE)
+        {
+            keptP = blockP;
+        }
+        else
+        {
+            lwm2m_free(blockP);
+        }
+    }
+
+    if (keptP != NULL)
+    {
+        keptP->used = 0;
+        keptP->next = NULL;
+        arenaP->blockList = keptP;
+    }
+}
+
+void arena_free(lwm2m_arena_t * arenaP)
+{
+    arenaP->viewList = NULL;
+    while (arenaP->blockList != NULL)
+    {
+        lwm2m_arena_block_t * blockP = arenaP->blockList;
+
+        arenaP->blockList = blockP->next;
+        lwm2m_free(blockP);
+    }
+    arenaP->depth = 0;
+}
@@ -46,81 +46,179 @@
 #include <string.h>
 #include <stdio.h>
 
-// the maximum payload transferred by block1 we accumulate per server
-#define MAX_BLOCK1_SIZE 4096
+/*
+ * Blocks are appended to a buffer sized from the Size1 option when the server sends it,
+ * or growing geometrically otherwise, so that each byte is copied once in most cases.
+ * Transfers are identified by their URI path. Up to LWM2M_BLOCK1_MAX_TRANSFERS are kept
+ * per server, the oldest one being dropped to make room for a new one.
+ * A complete payload is kept until another transfer starts so that the retransmission of
+ * the last block can be answered.
+ *
+ * Streamed transfers (see coap_block1_stream()) use the same entries without a buffer,
+ * block1bufferLength then being the length already handed over to the object.
+ */
+
+#define BLOCK1_MIN_BUFFER_SIZE 256
+
+static lwm2m_block1_data_t * prv_findBlock1Data(lwm2m_block1_data_t * block1Data,
+                                                const char * uri)
+{
+    while (block1Data != NULL && strcmp(block1Data->uri, uri) != 0)
+    {
+        block1Data = block1Data->next;
+    }
+
+    return block1Data;
+}
+
+static void prv_freeBlock1Data(lwm2m_block1_data_t * block1Data)
+{
+    if (block1Data->uri != NULL) lwm2m_free(block1Data->uri);
+    if (block1Data->block1buffer != NULL) lwm2m_free(block1Data->block1buffer);
+    lwm2m_free(block1Data);
+}
+
+// removes block1Data from the list and frees it
+static void prv_dropBlock1Data(lwm2m_block1_data_t ** pBlock1Data,
+                               lwm2m_block1_data_t * block1Data)
+{
+    while (*pBlock1Data != block1Data)
+    {
+        pBlock1Data = &(*pBlock1Data)->next;
+    }
+    *pBlock1Data = block1Data->next;
+    prv_freeBlock1Data(block1Data);
+}
+
+// drops completed transfers and the oldest ones beyond LWM2M_BLOCK1_MAX_TRANSFERS - 1
+static void prv_makeRoom(lwm2m_block1_data_t ** pBlock1Data)
+{
+    int count = 0;
+
+    while (*pBlock1Data != NULL)
+    {
+        lwm2m_block1_data_t * block1Data = *pBlock1Data;
+
+        if (block1Data->complete || count >= LWM2M_BLOCK1_MAX_TRANSFERS - 1)
+        {
+            *pBlock1Data = block1Data->next;
+            prv_freeBlock1Data(block1Data);
+        }
+        else
+        {
+            count++;
+            pBlock1Data = &block1Data->next;
+        }
+    }
+}
+
+static bool prv_reserve(lwm2m_block1_data_t * block1Data,
+                        size_t length,
+                        size_t maxSize)
+{
+    uint8_t * buffer;
+    size_t size;
+
+    if (length <= block1Data->block1bufferSize) return true;
+
+    size = block1Data->block1bufferSize * 2;
+    if (size < BLOCK1_MIN_BUFFER_SIZE) size = BLOCK1_MIN_BUFFER_SIZE;
+    if (size < length) size = length;
+    if (size > maxSize) size = maxSize;
+
+    buffer = (uint8_t *)lwm2m_malloc(size);
+    if (buffer == NULL) return false;
+    if (block1Data->block1buffer != NULL)
+    {
+        memcpy(buffer, block1Data->block1buffer, block1Data->block1bufferLength);
+        lwm2m_free(block1Data->block1buffer);
+    }
+    block1Data->block1buffer = buffer;
+    block1Data->block1bufferSize = size;
+
+    return true;
+}
 
 uint8_t coap_block1_handler(lwm2m_block1_data_t ** pBlock1Data,
+                            const char * uri,
                             uint16_t mid,
                             uint8_t * buffer,
                             size_t length,
                             uint16_t blockSize,
                             uint32_t blockNum,
                             bool blockMore,
+                            uint32_t totalSize,
+                            size_t maxSize,
                             uint8_t ** outputBuffer,
                             size_t * outputLength)
 {
-    lwm2m_block1_data_t * block1Data = *pBlock1Data;;
+    lwm2m_block1_data_t * block1Data;
 
-    // manage new block1 transfer
-    if (blockNum == 0)
-    {
-       // we already have block1 data for this server, clear it
-       if (block1Data != NULL)
-       {
-           lwm2m_free(block1Data->block1buffer);
-       }
-       else
-       {
-           block1Data = lwm2m_malloc(sizeof(lwm2m_block1_data_t));
-           *pBlock1Data = block1Data;
-           if (NULL == block1Data) return COAP_500_INTERNAL_SERVER_ERROR;
-       }
-
-       block1Data->block1buffer = lwm2m_malloc(length);
-       block1Data->block1bufferSize = length;
-
-       // write new block in buffer
-       memcpy(block1Data->block1buffer, buffer, length);
-       block1Data->lastmid = mid;
-    }
-    // manage already started block1 transfer
-    else
+    if (uri == NULL) uri = "";
+
+    block1Data = prv_findBlock1Data(*pBlock1Data, uri);
+
+    // If this is a retransmission, we already did that.
+    if (block1Data == NULL || block1Data->lastmid != mid)
     {
-       if (block1Data == NULL)
-       {
-           // we never receive the first block
-           // TODO should we clean block1 data for this server ?
-           return COAP_408_REQ_ENTITY_INCOMPLETE;
-       }
-
-       // If this is a retransmission, we already did that.
-       if (block1Data->lastmid != mid)
-       {
-          uint8_t * oldBuffer = block1Data->block1buffer;
-          size_t oldSize = block1Data->block1bufferSize;
-
-          if (block1Data->block1bufferSize != blockSize * blockNum)
-          {
-              // we don't receive block in right order
-              // TODO should we clean block1 data for this server ?
-              return COAP_408_REQ_ENTITY_INCOMPLETE;
-          }
-
-          // is it too large?
-          if (block1Data->block1bufferSize + length >= MAX_BLOCK1_SIZE) {
-              return COAP_413_ENTITY_TOO_LARGE;
-          }
-          // re-alloc new buffer
-          block1Data->block1bufferSize = oldSize+length;
-          block1Data->block1buffer = lwm2m_malloc(block1Data->block1bufferSize);
-          if (NULL == block1Data->block1buffer) return COAP_500_INTERNAL_SERVER_ERROR;
-          memcpy(block1Data->block1buffer, oldBuffer, oldSize);
-          lwm2m_free(oldBuffer);
-
-          // write new block in buffer
-          memcpy(block1Data->block1buffer + oldSize, buffer, length);
-          block1Data->lastmid = mid;
-       }
+        // manage new block1 transfer
+        if (blockNum == 0)
+        {
+            if (block1Data != NULL) prv_dropBlock1Data(pBlock1Data, block1Data);
+            if (totalSize > maxSize || length > maxSize) return COAP_413_ENTITY_TOO_LARGE;
+
+            prv_makeRoom(pBlock1Data);
+
+            block1Data = (lwm2m_block1_data_t *)lwm2m_malloc(sizeof(lwm2m_block1_data_t));
+            if (NULL == block1Data) return COAP_500_INTERNAL_SERVER_ERROR;
+            memset(block1Data, 0, sizeof(lwm2m_block1_data_t));
+            block1Data->uri = lwm2m_strdup(uri);
+            if (NULL == block1Data->uri
+             || !prv_reserve(block1Data, (totalSize > length) ? totalSize : length, maxSize))
+            {
+                prv_freeBlock1Data(block1Data);
+                return COAP_500_INTERNAL_SERVER_ERROR;
+            }
+            block1Data->next = *pBlock1Data;
+            *pBlock1Data = block1Data;
+        }
+        // manage already started block1 transfer
+        else
+        {
+            if (block1Data == NULL)
+            {
+                // we never receive the first block
+                return COAP_408_REQ_ENTITY_INCOMPLETE;
+            }
+
+            if (block1Data->complete
+             || block1Data->streamed
+             || block1Data->block1bufferLength != (size_t)blockSize * blockNum)
+            {
+                // we don't receive block in right order
+                prv_dropBlock1Data(pBlock1Data, block1Data);
+                return COAP_408_REQ_ENTITY_INCOMPLETE;
+            }
+
+            // is it too large?
+            if (block1Data->block1bufferLength + length > maxSize)
+            {
+                prv_dropBlock1Data(pBlock1Data, block1Data);
+                return COAP_413_ENTITY_TOO_LARGE;
+            }
+
+            if (!prv_reserve(block1Data, block1Data->block1bufferLength + length, maxSize))
+            {
+                prv_dropBlock1Data(pBlock1Data, block1Data);
+                return COAP_500_INTERNAL_SERVER_ERROR;
+            }
+        }
+
+        // write new block in buffer
+        memcpy(block1Data->block1buffer + block1Data->block1bufferLength, buffer, length);
+        block1Data->block1bufferLength += length;
+        block1Data->lastmid = mid;
+        block1Data->complete = !blockMore;
     }
 
     if (blockMore)
@@ -132,22 +230,98 @@ uint8_t coap_block1_handler(lwm2m_block1_data_t ** pBlock1Data,
     {
         // buffer is full, set output parameter
         // we don't free it to be able to send retransmission
-        *outputLength = block1Data->block1bufferSize;
+        *outputLength = block1Data->block1bufferLength;
         *outputBuffer = block1Data->block1buffer;
 
         return NO_ERROR;
     }
 }
 
+uint8_t coap_block1_stream(lwm2m_block1_data_t ** pBlock1Data,
+                           const char * uri,
+                           uint16_t mid,
+                           uint16_t blockSize,
+                           uint32_t blockNum,
+                           size_t length,
+                           bool blockMore,
+                           size_t * offsetP)
+{
+    lwm2m_block1_data_t * block1Data;
+
+    if (uri == NULL) uri = "";
+
+    block1Data = prv_findBlock1Data(*pBlock1Data, uri);
+
+    // If this is a retransmission, the block was already handed over.
+    if (block1Data != NULL && block1Data->lastmid == mid) return COAP_IGNORE;
+
+    if (blockNum == 0)
+    {
+        if (block1Data != NULL) prv_dropBlock1Data(pBlock1Data, block1Data);
+        prv_makeRoom(pBlock1Data);
+
+        block1Data = (lwm2m_block1_data_t *)lwm2m_malloc(sizeof(lwm2m_block1_data_t));
+        if (NULL == block1Data) return COAP_500_INTERNAL_SERVER_ERROR;
+        memset(block1Data, 0, sizeof(lwm2m_block1_data_t));
+        block1Data->uri = lwm2m_strdup(uri);
+        if (NULL == block1Data->uri)
+        {
+            prv_freeBlock1Data(block1Data);
+            return COAP_500_INTERNAL_SERVER_ERROR;
+        }
+        block1Data->streamed = true;
+        block1Data->next = *pBlock1Data;
+        *pBlock1Data = block1Data;
+    }
+    else
+    {
+        if (block1Data == NULL) return COAP_408_REQ_ENTITY_INCOMPLETE;
+
+        if (block1Data->complete
+         || !block1Data->streamed
+         || block1Data->block1bufferLength != (size_t)blockSize * blockNum)
+        {
+            prv_dropBlock1Data(pBlock1Data, block1Data);
+            return COAP_408_REQ_ENTITY_INCOMPLETE;
+        }
+    }
+
+    *offsetP = block1Data->block1bufferLength;
+    block1Data->block1bufferLength += length;
+    block1Data->lastmid = mid;
+    block1Data->complete = !blockMore;
+
+    return NO_ERROR;
+}
+
+bool coap_block1_isStreamed(lwm2m_block1_data_t * block1Data,
+                            const char * uri)
+{
+    if (uri == NULL) uri = "";
+
+    block1Data = prv_findBlock1Data(block1Data, uri);
+
+    return block1Data != NULL && block1Data->streamed;
+}
+
+void coap_block1_remove(lwm2m_block1_data_t ** pBlock1Data,
+                        const char * uri)
+{
+    lwm2m_block1_data_t * block1Data;
+
+    if (uri == NULL) uri = "";
+
+    block1Data = prv_findBlock1Data(*pBlock1Data, uri);
+    if (block1Data != NULL) prv_dropBlock1Data(pBlock1Data, block1Data);
+}
+
 void free_block1_buffer(lwm2m_block1_data_t * block1Data)
 {
-    if (block1Data != NULL)
+    while (block1Data != NULL)
     {
-        // free block1 buffer
-        lwm2m_free(block1Data->block1buffer);
-        block1Data->block1bufferSize = 0 ;
+        lwm2m_block1_data_t * nextP = block1Data->next;
 
-        // free current element
-        lwm2m_free(block1Data);
+        prv_freeBlock1Data(block1Data);
+        block1Data = nextP;
     }
 }
@@ -0,0 +1,304 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2017 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ *******************************************************************************/
+
+/*
+ * A response bigger than the block size is cut in blocks (RFC 7959). The whole
+ * representation is kept in the context with an ETag, keyed by peer, URI path and
+ * content format, and the next blocks are sliced from it. Requesting the block 0 again
+ * reads the resource again and gives a new ETag.
+ *
+ * A notification bigger than the block size is cached the same way and only its first
+ * block is sent: the server asks for the next ones with a GET without Observe
+ * (RFC 7959 section 3.4). A newer representation of the same resource replaces it.
+ *
+ * At most LWM2M_BLOCK2_MAX_ENTRIES representations are kept. They are dropped
+ * LWM2M_BLOCK2_LIFETIME seconds after their last block request, or when room is needed
+ * once their last block was sent, the oldest first.
+ */
+
+#include "internals.h"
+
+static void prv_freeBlock2Data(lwm2m_context_t * contextP,
+                               lwm2m_block2_data_t * block2Data)
+{
+    timer_cancel(contextP, &block2Data->timer);
+    lwm2m_free(block2Data->uri);
+    lwm2m_free(block2Data->buffer);
+    lwm2m_free(block2Data);
+}
+
+static void prv_unlinkBlock2Data(lwm2m_context_t * contextP,
+                                 lwm2m_block2_data_t * block2Data)
+{
+    lwm2m_block2_data_t ** pBlock2Data = &contextP->block2List;
+
+    while (*pBlock2Data != block2Data)
+    {
+        pBlock2Data = &(*pBlock2Data)->next;
+    }
+    *pBlock2Data = block2Data->next;
+}
+
+// drops completed representations and the oldest ones to keep a free entry
+static void prv_makeRoom(lwm2m_context_t * contextP)
+{
+    lwm2m_block2_data_t ** pBlock2Data = &contextP->block2List;
+    int count = 0;
+
+    while (*pBlock2Data != NULL)
+    {
+        lwm2m_block2_data_t * block2Data = *pBlock2Data;
+
+        if (block2Data->complete || count >= LWM2M_BLOCK2_MAX_ENTRIES - 1)
+        {
+            *pBlock2Data = block2Data->next;
+            prv_freeBlock2Data(contextP, block2Data);
+        }
+        else
+        {
+            count++;
+            pBlock2Data = &block2Data->next;
+        }
+    }
+}
+
+// sets the block blockNum of buffer as the payload of response
+// returns false if the representation has no such block
+static bool prv_setBlock(coap_packet_t * response,
+                         uint8_t * buffer,
+                         size_t length,
+                         uint32_t blockNum,
+                         uint16_t blockSize)
+{
+    size_t offset = (size_t)blockNum * blockSize;
+    bool more;
+
+    if (offset >= length)
+    {
+        response->code = COAP_402_BAD_OPTION;
+        coap_set_payload(response, "BlockOutOfScope", 15);
+        return false;
+    }
+
+    more = (length - offset > blockSize);
+    coap_set_header_block2(response, blockNum, more, blockSize);
+    coap_set_payload(response, buffer + offset, more ? blockSize : length - offset);
+
+    return true;
+}
+
+// caches buffer and uri, which the entry owns from now on, in place of an older representation
+// with the same key. Returns NULL if there is no memory left, buffer and uri are then left to the caller.
+static lwm2m_block2_data_t * prv_newBlock2Data(lwm2m_context_t * contextP,
+                                               void * sessionH,
+                                               char * uri,
+                                               uint16_t format,
+                                               uint8_t * buffer,
+                                               size_t length)
+{
+    lwm2m_block2_data_t * block2Data;
+
+    for (block2Data = contextP->block2List ; block2Data != NULL ; block2Data = block2Data->next)
+    {
+        if (block2Data->sessionH == sessionH
+         && block2Data->format == format
+         && strcmp(block2Data->uri, uri) == 0)
+        {
+            block2Data->complete = true;
+        }
+    }
+    prv_makeRoom(contextP);
+
+    block2Data = (lwm2m_block2_data_t *)lwm2m_malloc(sizeof(lwm2m_block2_data_t));
+    if (block2Data == NULL) return NULL;
+    memset(block2Data, 0, sizeof(lwm2m_block2_data_t));
+
+    contextP->nextETag++;
+    block2Data->etag[0] = (uint8_t)(contextP->nextETag >> 24);
+    block2Data->etag[1] = (uint8_t)(contextP->nextETag >> 16);
+    block2Data->etag[2] = (uint8_t)(contextP->nextETag >> 8);
+    block2Data->etag[3] = (uint8_t)contextP->nextETag;
+    block2Data->sessionH = sessionH;
+    block2Data->uri = uri;
+    block2Data->format = format;
+    block2Data->buffer = buffer;
+    block2Data->length = length;
+    block2Data->timer.type = LWM2M_TIMER_BLOCK2;
+    block2Data->timer.ownerP = block2Data;
+    block2Data->next = contextP->block2List;
+    contextP->block2List = block2Data;
+
+    LOG_ARG("Caching %u bytes for block transfer", block2Data->length);
+
+    return block2Data;
+}
+
+static void prv_sendBlock(lwm2m_context_t * contextP,
+                          lwm2m_block2_data_t * block2Data,
+                          coap_packet_t * response,
+                          uint32_t blockNum,
+                          uint16_t blockSize)
+{
+    coap_set_header_etag(response, block2Data->etag, sizeof(block2Data->etag));
+    if (prv_setBlock(response, block2Data->buffer, block2Data->length, blockNum, blockSize)
+     && !response->block2_more)
+    {
+        block2Data->complete = true;
+    }
+    (void)timer_schedule(contextP, &block2Data->timer, utils_getTimeMs() + LWM2M_BLOCK2_LIFETIME * 1000);
+}
+
+bool block2_get(lwm2m_context_t * contextP,
+                void * sessionH,
+                coap_packet_t * message,
+                coap_packet_t * response,
+                uint32_t blockNum,
+                uint16_t blockSize)
+{
+    lwm2m_block2_data_t * block2Data;
+    char * uri;
+
+    uri = coap_get_multi_option_as_string(message->uri_path);
+    if (uri == NULL) return false;
+
+    for (block2Data = contextP->block2List ; block2Data != NULL ; block2Data = block2Data->next)
+    {
+        if (block2Data->sessionH == sessionH
+         && strcmp(block2Data->uri, uri) == 0
+         && (message->accept_num == 0 || message->accept[0] == block2Data->format))
+        {
+            break;
+        }
+    }
+    lwm2m_free(uri);
+    if (block2Data == NULL) return false;
+
+    LOG_ARG("Block %u of %u bytes from the cache", blockNum, block2Data->length);
+    coap_set_status_code(response, COAP_205_CONTENT);
+    coap_set_header_content_type(response, block2Data->format);
+    prv_sendBlock(contextP, block2Data, response, blockNum, blockSize);
+
+    return true;
+}
+
+bool block2_set(lwm2m_context_t * contextP,
+                void * sessionH,
+                coap_packet_t * message,
+                coap_packet_t * response,
+                uint32_t blockNum,
+                uint16_t blockSize)
+{
+    lwm2m_block2_data_t * block2Data = NULL;
+    char * uri;
+
+    if (blockNum == 0 && response->payload_len <= blockSize)
+    {
+        if (IS_OPTION(message, COAP_OPTION_BLOCK2))
+        {
+            coap_set_header_block2(response, 0, 0, blockSize);
+        }
+        return false;
+    }
+    if ((size_t)blockNum * blockSize >= response->payload_len)
+    {
+        prv_setBlock(response, response->payload, response->payload_len, blockNum, blockSize);
+        return false;
+    }
+
+    uri = coap_get_multi_option_as_string(message->uri_path);
+    if (uri != NULL)
+    {
+        block2Data = prv_newBlock2Data(contextP, sessionH, uri, (uint16_t)response->content_type, response->payload, response->payload_len);
+        if (block2Data == NULL) lwm2m_free(uri);
+    }
+    if (block2Data == NULL)
+    {
+        // send the block anyway, the next ones will be read again
+        prv_setBlock(response, response->payload, response->payload_len, blockNum, blockSize);
+        return false;
+    }
+
+    prv_sendBlock(contextP, block2Data, response, blockNum, blockSize);
+
+    return true;
+}
+
+#ifdef LWM2M_CLIENT_MODE
+bool block2_notify(lwm2m_context_t * contextP,
+                   void * sessionH,
+                   lwm2m_uri_t * uriP,
+                   coap_packet_t * message,
+                   uint8_t * buffer,
+                   size_t length,
+                   uint16_t blockSize)
+{
+    lwm2m_block2_data_t * block2Data;
+    uint8_t path[URI_MAX_STRING_LEN];
+    size_t altPathLen = 0;
+    char * uri;
+    uint8_t * copy;
+    int res;
+
+    // keyed as the GET asking for the next blocks will name the resource
+    res = uri_toString(uriP, path, sizeof(path), NULL);
+    if (res <= 1) return false;
+    res--; // no trailing slash
+    if (contextP->altPath != NULL) altPathLen = strlen(contextP->altPath);
+
+    uri = (char *)lwm2m_malloc(altPathLen + res + 1);
+    if (uri == NULL) return false;
+    if (altPathLen > 0) memcpy(uri, contextP->altPath, altPathLen);
+    memcpy(uri + altPathLen, path, res);
+    uri[altPathLen + res] = 0;
+
+    copy = (uint8_t *)lwm2m_malloc(length);
+    if (copy == NULL)
+    {
+        lwm2m_free(uri);
+        return false;
+    }
+    memcpy(copy, buffer, length);
+
+    block2Data = prv_newBlock2Data(contextP, sessionH, uri, (uint16_t)message->content_type, copy, length);
+    if (block2Data == NULL)
+    {
+        lwm2m_free(copy);
+        lwm2m_free(uri);
+        return false;
+    }
+    prv_sendBlock(contextP, block2Data, message, 0, blockSize);
+
+    return true;
+}
+#endif
+
+// called from timer_step() when nobody asked for a block of the representation for a while
+void block2_expire(lwm2m_context_t * contextP,
+                   lwm2m_block2_data_t * block2Data)
+{
+    LOG_ARG("Dropping %u bytes", block2Data->length);
+    prv_unlinkBlock2Data(contextP, block2Data);
+    prv_freeBlock2Data(contextP, block2Data);
+}
+
+void block2_free(lwm2m_context_t * contextP)
+{
+    while (contextP->block2List != NULL)
+    {
+        lwm2m_block2_data_t * block2Data = contextP->block2List;
+
+        contextP->block2List = block2Data->next;
+        prv_freeBlock2Data(contextP, block2Data);
+    }
+}
@@ -419,7 +419,7 @@ uint8_t bootstrap_handleCommand(lwm2m_context_t * contextP,
                 }
                 else
                 {
-                    size = lwm2m_data_parse(uriP, message->payload, message->payload_len, format, &dataP);
+                    size = data_parse(&contextP->dataArena, uriP, message->payload, message->payload_len, format, &dataP);
                     if (size == 0)
                     {
                         result = COAP_500_INTERNAL_SERVER_ERROR;
@@ -458,7 +458,7 @@ uint8_t bootstrap_handleCommand(lwm2m_context_t * contextP,
                             result = COAP_400_BAD_REQUEST;
                         }
                     }
-                    lwm2m_data_free(size, dataP);
+                    data_free(&contextP->dataArena, size, dataP);
                 }
             }
         }
@@ -714,7 +714,11 @@ int lwm2m_bootstrap_write(lwm2m_context_t * contextP,
     if (transaction == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
 
     coap_set_header_content_type(transaction->message, format);
-    coap_set_payload(transaction->message, buffer, length);
+    if (!transaction_setPayload(transaction, buffer, length, contextP->blockSize))
+    {
+        transaction_free(transaction);
+        return COAP_500_INTERNAL_SERVER_ERROR;
+    }
 
     dataP = (bs_data_t *)lwm2m_malloc(sizeof(bs_data_t));
     if (dataP == NULL)
@@ -121,11 +121,19 @@ static int prv_textSerialize(lwm2m_data_t * dataP,
     }
 }
 
-static int prv_setBuffer(lwm2m_data_t * dataP,
+static int prv_setBuffer(lwm2m_arena_t * arenaP,
+                         lwm2m_data_t * dataP,
                          uint8_t * buffer,
                          size_t bufferLen)
 {
-    dataP->value.asBuffer.buffer = (uint8_t *)lwm2m_malloc(bufferLen);
+    if (arenaP != NULL)
+    {
+        dataP->value.asBuffer.buffer = (uint8_t *)arena_alloc(arenaP, bufferLen);
+    }
+    else
+    {
+        dataP->value.asBuffer.buffer = (uint8_t *)lwm2m_malloc(bufferLen);
+    }
     if (dataP->value.asBuffer.buffer == NULL)
     {
         return 0;
@@ -136,14 +144,22 @@ static int prv_setBuffer(lwm2m_data_t * dataP,
     return 1;
 }
 
-lwm2m_data_t * lwm2m_data_new(int size)
+lwm2m_data_t * data_new(lwm2m_arena_t * arenaP,
+                        int size)
 {
     lwm2m_data_t * dataP;
 
     LOG_ARG("size: %d", size);
     if (size <= 0) return NULL;
 
-    dataP = (lwm2m_data_t *)lwm2m_malloc(size * sizeof(lwm2m_data_t));
+    if (arenaP != NULL)
+    {
+        dataP = (lwm2m_data_t *)arena_alloc(arenaP, size * sizeof(lwm2m_data_t));
+    }
+    else
+    {
+        dataP = (lwm2m_data_t *)lwm2m_malloc(size * sizeof(lwm2m_data_t));
+    }
 
     if (dataP != NULL)
     {
@@ -153,8 +169,9 @@ lwm2m_data_t * lwm2m_data_new(int size)
     return dataP;
 }
 
-void lwm2m_data_free(int size,
-                     lwm2m_data_t * dataP)
+void data_free(lwm2m_arena_t * arenaP,
+               int size,
+               lwm2m_data_t * dataP)
 {
     int i;
 
@@ -168,12 +185,13 @@ void lwm2m_data_free(int size,
         case LWM2M_TYPE_MULTIPLE_RESOURCE:
         case LWM2M_TYPE_OBJECT_INSTANCE:
         case LWM2M_TYPE_OBJECT:
-            lwm2m_data_free(dataP[i].value.asChildren.count, dataP[i].value.asChildren.array);
+            data_free(arenaP, dataP[i].value.asChildren.count, dataP[i].value.asChildren.array);
             break;
 
         case LWM2M_TYPE_STRING:
         case LWM2M_TYPE_OPAQUE:
-            if (dataP[i].value.asBuffer.buffer != NULL)
+            if (dataP[i].value.asBuffer.buffer != NULL
+             && !arena_contains(arenaP, dataP[i].value.asBuffer.buffer))
             {
                 lwm2m_free(dataP[i].value.asBuffer.buffer);
             }
@@ -183,26 +201,21 @@ void lwm2m_data_free(int size,
             break;
         }
     }
-    lwm2m_free(dataP);
+    if (!arena_contains(arenaP, dataP))
+    {
+        lwm2m_free(dataP);
+    }
 }
 
-void lwm2m_data_encode_string(const char * string,
-                              lwm2m_data_t * dataP)
+void data_encodeOpaque(lwm2m_arena_t * arenaP,
+                       uint8_t * buffer,
+                       size_t length,
+                       lwm2m_data_t * dataP)
 {
-    size_t len;
     int res;
 
-    LOG_ARG("\"%s\"", string);
-    if (string == NULL)
-    {
-        len = 0;
-    }
-    else
-    {
-        for (len = 0; string[len] != 0; len++);
-    }
-
-    if (len == 0)
+    LOG_ARG("length: %d", length);
+    if (length == 0)
     {
         dataP->value.asBuffer.length = 0;
         dataP->value.asBuffer.buffer = NULL;
@@ -210,12 +223,12 @@ void lwm2m_data_encode_string(const char * string,
     }
     else
     {
-        res = prv_setBuffer(dataP, (uint8_t *)string, len);
+        res = prv_setBuffer(arenaP, dataP, buffer, length);
     }
 
     if (res == 1)
     {
-        dataP->type = LWM2M_TYPE_STRING;
+        dataP->type = LWM2M_TYPE_OPAQUE;
     }
     else
     {
@@ -223,14 +236,34 @@ void lwm2m_data_encode_string(const char * string,
     }
 }
 
-void lwm2m_data_encode_opaque(uint8_t * buffer,
-                              size_t length,
+lwm2m_data_t * lwm2m_data_new(int size)
+{
+    return data_new(NULL, size);
+}
+
+void lwm2m_data_free(int size,
+                     lwm2m_data_t * dataP)
+{
+    data_free(NULL, size, dataP);
+}
+
+void lwm2m_data_encode_string(const char * string,
                               lwm2m_data_t * dataP)
 {
+    size_t len;
     int res;
 
-    LOG_ARG("length: %d", length);
-    if (length == 0)
+    LOG_ARG("\"%s\"", string);
+    if (string == NULL)
+    {
+        len = 0;
+    }
+    else
+    {
+        for (len = 0; string[len] != 0; len++);
+    }
+
+    if (len == 0)
     {
         dataP->value.asBuffer.length = 0;
         dataP->value.asBuffer.buffer = NULL;
@@ -238,12 +271,12 @@ void lwm2m_data_encode_opaque(uint8_t * buffer,
     }
     else
     {
-        res = prv_setBuffer(dataP, buffer, length);
+        res = prv_setBuffer(NULL, dataP, (uint8_t *)string, len);
     }
 
     if (res == 1)
     {
-        dataP->type = LWM2M_TYPE_OPAQUE;
+        dataP->type = LWM2M_TYPE_STRING;
     }
     else
     {
@@ -251,6 +284,13 @@ void lwm2m_data_encode_opaque(uint8_t * buffer,
     }
 }
 
+void lwm2m_data_encode_opaque(uint8_t * buffer,
+                              size_t length,
+                              lwm2m_data_t * dataP)
+{
+    data_encodeOpaque(NULL, buffer, length, dataP);
+}
+
 void lwm2m_data_encode_nstring(const char * string,
                                size_t length,
                                lwm2m_data_t * dataP)
@@ -516,11 +556,12 @@ void lwm2m_data_encode_instances(lwm2m_data_t * subDataP,
     dataP->type = LWM2M_TYPE_MULTIPLE_RESOURCE;
 }
 
-int lwm2m_data_parse(lwm2m_uri_t * uriP,
-                     uint8_t * buffer,
-                     size_t bufferLen,
-                     lwm2m_media_type_t format,
-                     lwm2m_data_t ** dataP)
+int data_parse(lwm2m_arena_t * arenaP,
+               lwm2m_uri_t * uriP,
+               uint8_t * buffer,
+               size_t bufferLen,
+               lwm2m_media_type_t format,
+               lwm2m_data_t ** dataP)
 {
     int res;
 
@@ -530,44 +571,44 @@ int lwm2m_data_parse(lwm2m_uri_t * uriP,
     {
     case LWM2M_CONTENT_TEXT:
         if (!LWM2M_URI_IS_SET_RESOURCE(uriP)) return 0;
-        *dataP = lwm2m_data_new(1);
+        *dataP = data_new(arenaP, 1);
         if (*dataP == NULL) return 0;
         (*dataP)->id = uriP->resourceId;
         (*dataP)->type = LWM2M_TYPE_STRING;
-        res = prv_setBuffer(*dataP, buffer, bufferLen);
+        res = prv_setBuffer(arenaP, *dataP, buffer, bufferLen);
         if (res == 0)
         {
-            lwm2m_data_free(1, *dataP);
+            data_free(arenaP, 1, *dataP);
             *dataP = NULL;
         }
         return res;
 
     case LWM2M_CONTENT_OPAQUE:
         if (!LWM2M_URI_IS_SET_RESOURCE(uriP)) return 0;
-        *dataP = lwm2m_data_new(1);
+        *dataP = data_new(arenaP, 1);
         if (*dataP == NULL) return 0;
         (*dataP)->id = uriP->resourceId;
         (*dataP)->type = LWM2M_TYPE_OPAQUE;
-        res = prv_setBuffer(*dataP, buffer, bufferLen);
+        res = prv_setBuffer(arenaP, *dataP, buffer, bufferLen);
         if (res == 0)
         {
-            lwm2m_data_free(1, *dataP);
+            data_free(arenaP, 1, *dataP);
             *dataP = NULL;
-    }
+        }
         return res;
 
 #ifdef LWM2M_OLD_CONTENT_FORMAT_SUPPORT
     case LWM2M_CONTENT_TLV_OLD:
 #endif
     case LWM2M_CONTENT_TLV:
-        return tlv_parse(buffer, bufferLen, dataP);
+        return tlv_parse(arenaP, buffer, bufferLen, dataP);
 
 #ifdef LWM2M_SUPPORT_JSON
 #ifdef LWM2M_OLD_CONTENT_FORMAT_SUPPORT
     case LWM2M_CONTENT_JSON_OLD:
 #endif
     case LWM2M_CONTENT_JSON:
-        return json_parse(uriP, buffer, bufferLen, dataP);
+        return json_parse(arenaP, uriP, buffer, bufferLen, dataP);
 #endif
 
     default:
@@ -575,16 +616,21 @@ int lwm2m_data_parse(lwm2m_uri_t * uriP,
     }
 }
 
-int lwm2m_data_serialize(lwm2m_uri_t * uriP,
-                         int size,
-                         lwm2m_data_t * dataP,
-                         lwm2m_media_type_t * formatP,
-                         uint8_t ** bufferP)
+int lwm2m_data_parse(lwm2m_uri_t * uriP,
+                     uint8_t * buffer,
+                     size_t bufferLen,
+                     lwm2m_media_type_t format,
+                     lwm2m_data_t ** dataP)
 {
-    LOG_URI(uriP);
-    LOG_ARG("size: %d, formatP: %s", size, STR_MEDIA_TYPE(*formatP));
+    return data_parse(NULL, uriP, buffer, bufferLen, format, dataP);
+}
 
-    // Check format
+// falls back to a format able to carry the data and checks it can be used
+static bool prv_checkFormat(lwm2m_uri_t * uriP,
+                            int size,
+                            lwm2m_data_t * dataP,
+                            lwm2m_media_type_t * formatP)
+{
     if (*formatP == LWM2M_CONTENT_TEXT
      || *formatP == LWM2M_CONTENT_OPAQUE)
     {
@@ -606,11 +652,88 @@ int lwm2m_data_serialize(lwm2m_uri_t * uriP,
      && dataP->type != LWM2M_TYPE_OPAQUE)
     {
         LOG("Opaque format is reserved to opaque resources.");
-        return -1;
+        return false;
     }
 
     LOG_ARG("Final format: %s", STR_MEDIA_TYPE(*formatP));
 
+    return true;
+}
+
+static bool prv_isResourceInstance(lwm2m_uri_t * uriP,
+                                   int size,
+                                   lwm2m_data_t * dataP)
+{
+    return uriP != NULL && LWM2M_URI_IS_SET_RESOURCE(uriP)
+        && (size != 1 || dataP->id != uriP->resourceId);
+}
+
+bool data_isChunked(lwm2m_uri_t * uriP,
+                    int size,
+                    lwm2m_data_t * dataP,
+                    lwm2m_media_type_t * formatP)
+{
+    if (!prv_checkFormat(uriP, size, dataP, formatP)) return false;
+
+    switch (*formatP)
+    {
+#ifdef LWM2M_OLD_CONTENT_FORMAT_SUPPORT
+    case LWM2M_CONTENT_TLV_OLD:
+#endif
+    case LWM2M_CONTENT_TLV:
+#ifdef LWM2M_SUPPORT_JSON
+#ifdef LWM2M_OLD_CONTENT_FORMAT_SUPPORT
+    case LWM2M_CONTENT_JSON_OLD:
+#endif
+    case LWM2M_CONTENT_JSON:
+#endif
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+int data_serializeChunk(lwm2m_uri_t * uriP,
+                        int size,
+                        lwm2m_data_t * dataP,
+                        lwm2m_media_type_t format,
+                        size_t * offsetP,
+                        uint8_t * buffer,
+                        size_t length)
+{
+    switch (format)
+    {
+#ifdef LWM2M_OLD_CONTENT_FORMAT_SUPPORT
+    case LWM2M_CONTENT_TLV_OLD:
+#endif
+    case LWM2M_CONTENT_TLV:
+        return tlv_serializeChunk(prv_isResourceInstance(uriP, size, dataP), size, dataP, offsetP, buffer, length);
+
+#ifdef LWM2M_SUPPORT_JSON
+#ifdef LWM2M_OLD_CONTENT_FORMAT_SUPPORT
+    case LWM2M_CONTENT_JSON_OLD:
+#endif
+    case LWM2M_CONTENT_JSON:
+        return json_serializeChunk(uriP, size, dataP, offsetP, buffer, length);
+#endif
+
+    default:
+        return -1;
+    }
+}
+
+int lwm2m_data_serialize(lwm2m_uri_t * uriP,
+                         int size,
+                         lwm2m_data_t * dataP,
+                         lwm2m_media_type_t * formatP,
+                         uint8_t ** bufferP)
+{
+    LOG_URI(uriP);
+    LOG_ARG("size: %d, formatP: %s", size, STR_MEDIA_TYPE(*formatP));
+
+    if (!prv_checkFormat(uriP, size, dataP, formatP)) return -1;
+
     switch (*formatP)
     {
     case LWM2M_CONTENT_TEXT:
@@ -624,20 +747,7 @@ int lwm2m_data_serialize(lwm2m_uri_t * uriP,
 
     case LWM2M_CONTENT_TLV:
     case LWM2M_CONTENT_TLV_OLD:
-    {
-            bool isResourceInstance;
-
-            if (uriP != NULL && LWM2M_URI_IS_SET_RESOURCE(uriP)
-             && (size != 1 || dataP->id != uriP->resourceId))
-            {
-                isResourceInstance = true;
-            }
-            else
-            {
-                isResourceInstance = false;
-            }
-            return tlv_serialize(isResourceInstance, size, dataP, bufferP);
-        }
+        return tlv_serialize(prv_isResourceInstance(uriP, size, dataP), size, dataP, bufferP);
 
 #ifdef LWM2M_CLIENT_MODE
     case LWM2M_CONTENT_LINK:
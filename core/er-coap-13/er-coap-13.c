@@ -63,10 +63,6 @@
 /*-----------------------------------------------------------------------------------*/
 /*- Variables -----------------------------------------------------------------------*/
 /*-----------------------------------------------------------------------------------*/
-static uint16_t current_mid = 0;
-
-coap_status_t coap_error_code = NO_ERROR;
-const char *coap_error_message = "";
 /*-----------------------------------------------------------------------------------*/
 /*- LOCAL HELP FUNCTIONS ------------------------------------------------------------*/
 /*-----------------------------------------------------------------------------------*/
@@ -230,6 +226,39 @@ coap_serialize_multi_option(unsigned int number, unsigned int current_number, ui
 }
 /*-----------------------------------------------------------------------------------*/
 static
+size_t
+coap_array_option_max_size(uint8_t *array, size_t length, char split_char)
+{
+  size_t size = COAP_MAX_OPTION_HEADER_LEN + length;
+  size_t j;
+
+  if (split_char!='\0')
+  {
+    for (j = 0; j<length; ++j)
+    {
+      if (array[j]==split_char) size += COAP_MAX_OPTION_HEADER_LEN;
+    }
+  }
+
+  return size;
+}
+/*-----------------------------------------------------------------------------------*/
+static
+size_t
+coap_multi_option_max_size(multi_option_t *array)
+{
+  size_t size = 0;
+  multi_option_t * j;
+
+  for (j = array; j != NULL; j= j->next)
+  {
+    size += COAP_MAX_OPTION_HEADER_LEN + j->len;
+  }
+
+  return size;
+}
+/*-----------------------------------------------------------------------------------*/
+static
 void
 coap_merge_multi_option(uint8_t **dst, size_t *dst_len, uint8_t *option, size_t option_len, char separator)
 {
@@ -261,6 +290,7 @@ coap_add_multi_option(multi_option_t **dst, uint8_t *option, size_t option_len,
   if (opt)
   {
     opt->next = NULL;
+    opt->is_inline = 0;
     opt->len = (uint8_t)option_len;
     if (is_static)
     {
@@ -306,11 +336,52 @@ free_multi_option(multi_option_t *dst)
     {
         lwm2m_free(dst->data);
     }
-    lwm2m_free(dst);
+    if (dst->is_inline == 0)
+    {
+        lwm2m_free(dst);
+    }
     free_multi_option(n);
   }
 }
 
+/* Append a view on a received option, using the packet storage while it lasts.
+ * Options are ordered by number so the new node always follows 'tail' when the list is not empty. */
+static
+multi_option_t *
+coap_parse_multi_option(coap_packet_t *coap_pkt, multi_option_t **dst, multi_option_t *tail, uint8_t *option, size_t option_len)
+{
+  multi_option_t *opt;
+
+  if (coap_pkt->inline_options_num < COAP_INLINE_OPTION_NUM)
+  {
+    opt = &(coap_pkt->inline_options[coap_pkt->inline_options_num]);
+    coap_pkt->inline_options_num += 1;
+    opt->is_inline = 1;
+  }
+  else
+  {
+    opt = (multi_option_t *)lwm2m_malloc(sizeof(multi_option_t));
+    if (opt == NULL) return tail;
+    opt->is_inline = 0;
+  }
+
+  opt->next = NULL;
+  opt->is_static = 1;
+  opt->len = (uint8_t)option_len;
+  opt->data = option;
+
+  if (*dst == NULL)
+  {
+    *dst = opt;
+  }
+  else
+  {
+    tail->next = opt;
+  }
+
+  return opt;
+}
+
 char * coap_get_multi_option_as_string(multi_option_t * option)
 {
     size_t len = 0;
@@ -379,12 +450,6 @@ coap_get_variable(const uint8_t *buffer, size_t length, const char *name, const
   return 0;
 }
 
-/*-----------------------------------------------------------------------------------*/
-uint16_t
-coap_get_mid()
-{
-  return ++current_mid;
-}
 /*-----------------------------------------------------------------------------------*/
 /*- MEASSAGE PROCESSING -------------------------------------------------------------*/
 /*-----------------------------------------------------------------------------------*/
@@ -415,6 +480,7 @@ coap_free_header(void *packet)
 }
 
 /*-----------------------------------------------------------------------------------*/
+/* each option is budgeted as coap_serialize() checks it, so that many bytes are always enough */
 size_t coap_serialize_get_size(void *packet)
 {
     coap_packet_t *const coap_pkt = (coap_packet_t *) packet;
@@ -428,7 +494,7 @@ size_t coap_serialize_get_size(void *packet)
     }
     if (IS_OPTION(coap_pkt, COAP_OPTION_URI_HOST))
     {
-        length += COAP_MAX_OPTION_HEADER_LEN + coap_pkt->uri_host_len;
+        length += coap_array_option_max_size((uint8_t *)coap_pkt->uri_host, coap_pkt->uri_host_len, '\0');
     }
     if (IS_OPTION(coap_pkt, COAP_OPTION_ETAG))
     {
@@ -437,17 +503,17 @@ size_t coap_serialize_get_size(void *packet)
     if (IS_OPTION(coap_pkt, COAP_OPTION_IF_NONE_MATCH))
     {
         // can be stored in extended fields
-        length += COAP_MAX_OPTION_HEADER_LEN;
+        length += COAP_MAX_OPTION_HEADER_LEN + 4;
     }
     if (IS_OPTION(coap_pkt, COAP_OPTION_OBSERVE))
     {
         // can be stored in extended fields
-        length += COAP_MAX_OPTION_HEADER_LEN;
+        length += COAP_MAX_OPTION_HEADER_LEN + 4;
     }
     if (IS_OPTION(coap_pkt, COAP_OPTION_URI_PORT))
     {
         // can be stored in extended fields
-        length += COAP_MAX_OPTION_HEADER_LEN;
+        length += COAP_MAX_OPTION_HEADER_LEN + 4;
     }
     if (IS_OPTION(coap_pkt, COAP_OPTION_LOCATION_PATH))
     {
@@ -470,12 +536,12 @@ size_t coap_serialize_get_size(void *packet)
     if (IS_OPTION(coap_pkt, COAP_OPTION_CONTENT_TYPE))
     {
         // can be stored in extended fields
-        length += COAP_MAX_OPTION_HEADER_LEN;
+        length += COAP_MAX_OPTION_HEADER_LEN + 4;
     }
     if (IS_OPTION(coap_pkt, COAP_OPTION_MAX_AGE))
     {
         // can be stored in extended fields
-        length += COAP_MAX_OPTION_HEADER_LEN;
+        length += COAP_MAX_OPTION_HEADER_LEN + 4;
     }
     if (IS_OPTION(coap_pkt, COAP_OPTION_URI_QUERY))
     {
@@ -488,30 +554,35 @@ size_t coap_serialize_get_size(void *packet)
     }
     if (IS_OPTION(coap_pkt, COAP_OPTION_ACCEPT))
     {
-        length += coap_pkt->accept_num * COAP_MAX_OPTION_HEADER_LEN;
+        length += coap_pkt->accept_num * (COAP_MAX_OPTION_HEADER_LEN + 4);
     }
     if (IS_OPTION(coap_pkt, COAP_OPTION_LOCATION_QUERY))
     {
-        length += COAP_MAX_OPTION_HEADER_LEN + coap_pkt->location_query_len;
+        length += coap_array_option_max_size((uint8_t *)coap_pkt->location_query, coap_pkt->location_query_len, '&');
     }
     if (IS_OPTION(coap_pkt, COAP_OPTION_BLOCK2))
     {
         // can be stored in extended fields
-        length += COAP_MAX_OPTION_HEADER_LEN;
+        length += COAP_MAX_OPTION_HEADER_LEN + 4;
     }
     if (IS_OPTION(coap_pkt, COAP_OPTION_BLOCK1))
     {
         // can be stored in extended fields
-        length += COAP_MAX_OPTION_HEADER_LEN;
+        length += COAP_MAX_OPTION_HEADER_LEN + 4;
     }
     if (IS_OPTION(coap_pkt, COAP_OPTION_SIZE))
     {
         // can be stored in extended fields
-        length += COAP_MAX_OPTION_HEADER_LEN;
+        length += COAP_MAX_OPTION_HEADER_LEN + 4;
     }
     if (IS_OPTION(coap_pkt, COAP_OPTION_PROXY_URI))
     {
-        length += COAP_MAX_OPTION_HEADER_LEN + coap_pkt->proxy_uri_len;
+        length += coap_array_option_max_size((uint8_t *)coap_pkt->proxy_uri, coap_pkt->proxy_uri_len, '\0');
+    }
+    if (IS_OPTION(coap_pkt, COAP_OPTION_SIZE1))
+    {
+        // can be stored in extended fields
+        length += COAP_MAX_OPTION_HEADER_LEN + 4;
     }
 
     if (coap_pkt->payload_len)
@@ -524,13 +595,20 @@ size_t coap_serialize_get_size(void *packet)
 }
 
 /*-----------------------------------------------------------------------------------*/
+/* end is NULL when the caller already made room for coap_serialize_get_size() bytes */
+static
 size_t
-coap_serialize_message(void *packet, uint8_t *buffer)
+coap_serialize(void *packet, uint8_t *buffer, uint8_t *end, int keep_options)
 {
   coap_packet_t *const coap_pkt = (coap_packet_t *) packet;
   uint8_t *option;
   unsigned int current_number = 0;
 
+  if (end != NULL && (size_t)(end - buffer) < (size_t)(COAP_HEADER_LEN + coap_pkt->token_len))
+  {
+    return 0;
+  }
+
   /* Initialize */
   coap_pkt->buffer = buffer;
   coap_pkt->version = 1;
@@ -580,11 +658,14 @@ coap_serialize_message(void *packet, uint8_t *buffer)
   COAP_SERIALIZE_BLOCK_OPTION(  COAP_OPTION_BLOCK1,         block1, "Block1")
   COAP_SERIALIZE_INT_OPTION(    COAP_OPTION_SIZE,           size, "Size")
   COAP_SERIALIZE_STRING_OPTION( COAP_OPTION_PROXY_URI,      proxy_uri, '\0', "Proxy-Uri")
+  COAP_SERIALIZE_INT_OPTION(    COAP_OPTION_SIZE1,          size1, "Size1")
 
   PRINTF("-Done serializing at %p----\n", option);
 
+  COAP_SERIALIZE_CHECK(coap_pkt->payload_len ? coap_pkt->payload_len + 1 : 0)
+
   /* Free allocated header fields */
-  coap_free_header(packet);
+  if (!keep_options) coap_free_header(packet);
 
   /* Pack payload */
   /* Payload marker */
@@ -612,6 +693,24 @@ coap_serialize_message(void *packet, uint8_t *buffer)
   return (option - buffer) + coap_pkt->payload_len; /* packet length */
 }
 /*-----------------------------------------------------------------------------------*/
+size_t
+coap_serialize_message(void *packet, uint8_t *buffer)
+{
+  return coap_serialize(packet, buffer, NULL, 0);
+}
+/*-----------------------------------------------------------------------------------*/
+size_t
+coap_serialize_message_len(void *packet, uint8_t *buffer, size_t buffer_len)
+{
+  return coap_serialize(packet, buffer, buffer + buffer_len, 0);
+}
+/*-----------------------------------------------------------------------------------*/
+size_t
+coap_serialize_message_keep(void *packet, uint8_t *buffer, size_t buffer_len)
+{
+  return coap_serialize(packet, buffer, buffer + buffer_len, 1);
+}
+/*-----------------------------------------------------------------------------------*/
 coap_status_t
 coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
 {
@@ -621,6 +720,7 @@ coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
   unsigned int option_delta = 0;
   size_t option_length = 0;
   unsigned int *x;
+  multi_option_t *last_option = NULL;
 
   /* Initialize packet */
   memset(coap_pkt, 0, sizeof(coap_packet_t));
@@ -637,7 +737,7 @@ coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
 
   if (coap_pkt->version != 1)
   {
-    coap_error_message = "CoAP version must be 1";
+    coap_pkt->error_message = "CoAP version must be 1";
     return BAD_REQUEST_4_00;
   }
 
@@ -776,18 +876,18 @@ coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
       case COAP_OPTION_URI_PATH:
         /* coap_merge_multi_option() operates in-place on the IPBUF, but final packet field should be const string -> cast to string */
         // coap_merge_multi_option( (char **) &(coap_pkt->uri_path), &(coap_pkt->uri_path_len), current_option, option_length, 0);
-        coap_add_multi_option( &(coap_pkt->uri_path), current_option, option_length, 1);
+        last_option = coap_parse_multi_option(coap_pkt, &(coap_pkt->uri_path), last_option, current_option, option_length);
         PRINTF("Uri-Path [%.*s]\n", option_length, current_option);
         break;
       case COAP_OPTION_URI_QUERY:
         /* coap_merge_multi_option() operates in-place on the IPBUF, but final packet field should be const string -> cast to string */
         // coap_merge_multi_option( (char **) &(coap_pkt->uri_query), &(coap_pkt->uri_query_len), current_option, option_length, '&');
-        coap_add_multi_option( &(coap_pkt->uri_query), current_option, option_length, 1);
+        last_option = coap_parse_multi_option(coap_pkt, &(coap_pkt->uri_query), last_option, current_option, option_length);
         PRINTF("Uri-Query [%.*s]\n", option_length, current_option);
         break;
 
       case COAP_OPTION_LOCATION_PATH:
-        coap_add_multi_option( &(coap_pkt->location_path), current_option, option_length, 1);
+        last_option = coap_parse_multi_option(coap_pkt, &(coap_pkt->location_path), last_option, current_option, option_length);
         break;
       case COAP_OPTION_LOCATION_QUERY:
         /* coap_merge_multi_option() operates in-place on the IPBUF, but final packet field should be const string -> cast to string */
@@ -801,7 +901,7 @@ coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
         coap_pkt->proxy_uri_len = option_length;
         /*TODO length > 270 not implemented (actually not required) */
         PRINTF("Proxy-Uri NOT IMPLEMENTED [%.*s]\n", coap_pkt->proxy_uri_len, coap_pkt->proxy_uri);
-        coap_error_message = "This is a constrained server (Contiki)";
+        coap_pkt->error_message = "This is a constrained server (Contiki)";
         return PROXYING_NOT_SUPPORTED_5_05;
         break;
 
@@ -829,12 +929,16 @@ coap_parse_message(void *packet, uint8_t *data, uint16_t data_len)
         coap_pkt->size = coap_parse_int_option(current_option, option_length);
         PRINTF("Size [%lu]\n", coap_pkt->size);
         break;
+      case COAP_OPTION_SIZE1:
+        coap_pkt->size1 = coap_parse_int_option(current_option, option_length);
+        PRINTF("Size1 [%lu]\n", coap_pkt->size1);
+        break;
       default:
         PRINTF("unknown (%u)\n", option_number);
         /* Check if critical (odd) */
         if (option_number & 1)
         {
-          coap_error_message = "Unsupported critical option";
+          coap_pkt->error_message = "Unsupported critical option";
           return BAD_OPTION_4_02;
         }
     }
@@ -1356,6 +1460,27 @@ coap_set_header_size(void *packet, uint32_t size)
   return 1;
 }
 /*-----------------------------------------------------------------------------------*/
+int
+coap_get_header_size1(void *packet, uint32_t *size)
+{
+  coap_packet_t *const coap_pkt = (coap_packet_t *) packet;
+
+  if (!IS_OPTION(coap_pkt, COAP_OPTION_SIZE1)) return 0;
+
+  *size = coap_pkt->size1;
+  return 1;
+}
+
+int
+coap_set_header_size1(void *packet, uint32_t size)
+{
+  coap_packet_t *const coap_pkt = (coap_packet_t *) packet;
+
+  coap_pkt->size1 = size;
+  SET_OPTION(coap_pkt, COAP_OPTION_SIZE1);
+  return 1;
+}
+/*-----------------------------------------------------------------------------------*/
 /*- PAYLOAD -------------------------------------------------------------------------*/
 /*-----------------------------------------------------------------------------------*/
 int
@@ -69,6 +69,10 @@
 #define COAP_TOKEN_LEN                       8 /* The maximum number of bytes for the Token */
 #define COAP_MAX_ACCEPT_NUM                  2 /* The maximum number of accept preferences to parse/store */
 
+#ifndef COAP_INLINE_OPTION_NUM
+#define COAP_INLINE_OPTION_NUM               8 /* The number of Uri-Path, Uri-Query and Location-Path segments parsed without allocation */
+#endif
+
 #define COAP_MAX_OPTION_HEADER_LEN           5
 
 #define COAP_HEADER_VERSION_MASK             0xC0
@@ -98,8 +102,9 @@
 
 /* Bitmap for set options */
 enum { OPTION_MAP_SIZE = sizeof(uint8_t) * 8 };
-#define SET_OPTION(packet, opt) {if (opt <= sizeof((packet)->options) * OPTION_MAP_SIZE) {(packet)->options[opt / OPTION_MAP_SIZE] |= 1 << (opt % OPTION_MAP_SIZE);}}
-#define IS_OPTION(packet, opt) ((opt <= sizeof((packet)->options) * OPTION_MAP_SIZE)?(packet)->options[opt / OPTION_MAP_SIZE] & (1 << (opt % OPTION_MAP_SIZE)):0)
+#define SET_OPTION(packet, opt) {if (opt < sizeof((packet)->options) * OPTION_MAP_SIZE) {(packet)->options[opt / OPTION_MAP_SIZE] |= 1 << (opt % OPTION_MAP_SIZE);}}
+#define UNSET_OPTION(packet, opt) {if (opt < sizeof((packet)->options) * OPTION_MAP_SIZE) {(packet)->options[opt / OPTION_MAP_SIZE] &= ~(1 << (opt % OPTION_MAP_SIZE));}}
+#define IS_OPTION(packet, opt) ((opt < sizeof((packet)->options) * OPTION_MAP_SIZE)?(packet)->options[opt / OPTION_MAP_SIZE] & (1 << (opt % OPTION_MAP_SIZE)):0)
 
 #ifndef MIN
 #define MIN(a, b) ((a) < (b)? (a) : (b))
@@ -178,6 +183,7 @@ typedef enum {
   COAP_OPTION_BLOCK1 = 27,        /* 1-3 B */
   COAP_OPTION_SIZE = 28,          /* 0-4 B */
   COAP_OPTION_PROXY_URI = 35,     /* 1-270 B */
+  COAP_OPTION_SIZE1 = 60,         /* 0-4 B */
   OPTION_MAX_VALUE = 0xFFFF
 } coap_option_t;
 
@@ -210,7 +216,8 @@ typedef enum {
 
 typedef struct _multi_option_t {
   struct _multi_option_t *next;
-  uint8_t is_static;
+  uint8_t is_static;  /* data is not owned by the option */
+  uint8_t is_inline;  /* the option itself lives in coap_packet_t::inline_options */
   uint8_t len;
   uint8_t *data;
 } multi_option_t;
@@ -224,7 +231,7 @@ typedef struct {
   uint8_t code;
   uint16_t mid;
 
-  uint8_t options[COAP_OPTION_PROXY_URI / OPTION_MAP_SIZE + 1]; /* Bitmap to check if option is set */
+  uint8_t options[COAP_OPTION_SIZE1 / OPTION_MAP_SIZE + 1]; /* Bitmap to check if option is set */
 
   coap_content_type_t content_type; /* Parse options once and store; allows setting options in random order  */
   uint32_t max_age;
@@ -255,23 +262,38 @@ typedef struct {
   uint16_t block1_size;
   uint32_t block1_offset;
   uint32_t size;
+  uint32_t size1;
   multi_option_t *uri_query;
   uint8_t if_none_match;
 
   uint16_t payload_len;
   uint8_t *payload;
 
+  /* Views into the parsed buffer used by uri_path, uri_query and location_path */
+  multi_option_t inline_options[COAP_INLINE_OPTION_NUM];
+  uint8_t inline_options_num;
+
+  /* Human-readable reason set by coap_parse_message() on failure */
+  const char *error_message;
+
 } coap_packet_t;
 
 /* Option format serialization*/
+#define COAP_SERIALIZE_CHECK(size)  \
+    if (end != NULL && (size_t)(end - option) < (size_t)(size)) { \
+      PRINTF("-Buffer too small for option-\n"); \
+      return 0; \
+    }
 #define COAP_SERIALIZE_INT_OPTION(number, field, text)  \
     if (IS_OPTION(coap_pkt, number)) { \
+      COAP_SERIALIZE_CHECK(COAP_MAX_OPTION_HEADER_LEN + 4) \
       PRINTF(text" [%u]\n", coap_pkt->field); \
       option += coap_serialize_int_option(number, current_number, option, coap_pkt->field); \
       current_number = number; \
     }
 #define COAP_SERIALIZE_BYTE_OPTION(number, field, text)      \
     if (IS_OPTION(coap_pkt, number)) { \
+      COAP_SERIALIZE_CHECK(COAP_MAX_OPTION_HEADER_LEN + coap_pkt->field##_len) \
       PRINTF(text" %u [0x%02X%02X%02X%02X%02X%02X%02X%02X]\n", coap_pkt->field##_len, \
         coap_pkt->field[0], \
         coap_pkt->field[1], \
@@ -287,12 +309,14 @@ typedef struct {
     }
 #define COAP_SERIALIZE_STRING_OPTION(number, field, splitter, text)      \
     if (IS_OPTION(coap_pkt, number)) { \
+      COAP_SERIALIZE_CHECK(coap_array_option_max_size((uint8_t *) coap_pkt->field, coap_pkt->field##_len, splitter)) \
       PRINTF(text" [%.*s]\n", coap_pkt->field##_len, coap_pkt->field); \
       option += coap_serialize_array_option(number, current_number, option, (uint8_t *) coap_pkt->field, coap_pkt->field##_len, splitter); \
       current_number = number; \
     }
 #define COAP_SERIALIZE_MULTI_OPTION(number, field, text)      \
         if (IS_OPTION(coap_pkt, number)) { \
+          COAP_SERIALIZE_CHECK(coap_multi_option_max_size(coap_pkt->field)) \
           PRINTF(text); \
           option += coap_serialize_multi_option(number, current_number, option, coap_pkt->field); \
           current_number = number; \
@@ -300,6 +324,7 @@ typedef struct {
 #define COAP_SERIALIZE_ACCEPT_OPTION(number, field, text)  \
     if (IS_OPTION(coap_pkt, number)) { \
       int i; \
+      COAP_SERIALIZE_CHECK(coap_pkt->field##_num * (COAP_MAX_OPTION_HEADER_LEN + 4)) \
       for (i=0; i<coap_pkt->field##_num; ++i) \
       { \
         PRINTF(text" [%u]\n", coap_pkt->field[i]); \
@@ -311,6 +336,7 @@ typedef struct {
     if (IS_OPTION(coap_pkt, number)) \
     { \
       uint32_t block = coap_pkt->field##_num << 4; \
+      COAP_SERIALIZE_CHECK(COAP_MAX_OPTION_HEADER_LEN + 4) \
       PRINTF(text" [%lu%s (%u B/blk)]\n", coap_pkt->field##_num, coap_pkt->field##_more ? "+" : "", coap_pkt->field##_size); \
       if (coap_pkt->field##_more) block |= 0x8; \
       block |= 0xF & coap_log_2(coap_pkt->field##_size/16); \
@@ -319,14 +345,11 @@ typedef struct {
       current_number = number; \
     }
 
-/* To store error code and human-readable payload */
-extern const char *coap_error_message;
-
-uint16_t coap_get_mid(void);
-
 void coap_init_message(void *packet, coap_message_type_t type, uint8_t code, uint16_t mid);
 size_t coap_serialize_get_size(void *packet);
 size_t coap_serialize_message(void *packet, uint8_t *buffer);
+size_t coap_serialize_message_len(void *packet, uint8_t *buffer, size_t buffer_len); /* Returns 0 and keeps the options if buffer_len is too small. */
+size_t coap_serialize_message_keep(void *packet, uint8_t *buffer, size_t buffer_len); /* Same, but always keeps the options so the packet can be serialized again. */
 coap_status_t coap_parse_message(void *request, uint8_t *data, uint16_t data_len);
 void coap_free_header(void *packet);
 
@@ -393,6 +416,9 @@ int coap_set_header_block1(void *packet, uint32_t num, uint8_t more, uint16_t si
 int coap_get_header_size(void *packet, uint32_t *size);
 int coap_set_header_size(void *packet, uint32_t size);
 
+int coap_get_header_size1(void *packet, uint32_t *size);
+int coap_set_header_size1(void *packet, uint32_t size);
+
 int coap_get_payload(void *packet, const uint8_t **payload);
 int coap_set_payload(void *packet, const void *payload, size_t length);
 
@@ -0,0 +1,181 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2017 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ *******************************************************************************/
+
+/*
+ * Chained hash index used next to the sorted lists to avoid linear lookups.
+ * The index does not own the items, it only references them. The bucket
+ * array grows by doubling so the average chain length stays below one.
+ */
+
+#include "internals.h"
+
+#define HASH_MIN_BUCKET_COUNT 16
+
+static size_t prv_getBucket(lwm2m_hash_t * hashP,
+                            uint32_t key)
+{
+    // mix the high bits in as keys such as message IDs are sequential in the low ones
+    key ^= key >> 16;
+    return (size_t)(key & (hashP->bucketCount - 1));
+}
+
+static void prv_grow(lwm2m_hash_t * hashP)
+{
+    lwm2m_hash_node_t ** oldBuckets;
+    size_t oldCount;
+    size_t i;
+
+    oldBuckets = hashP->buckets;
+    oldCount = hashP->bucketCount;
+
+    hashP->bucketCount = (oldCount == 0) ? HASH_MIN_BUCKET_COUNT : oldCount * 2;
+    hashP->buckets = (lwm2m_hash_node_t **)lwm2m_malloc(hashP->bucketCount * sizeof(lwm2m_hash_node_t *));
+    if (hashP->buckets == NULL)
+    {
+        // keep on working with the current chains, only lookups get slower
+        hashP->buckets = oldBuckets;
+        hashP->bucketCount = oldCount;
+        return;
+    }
+    memset(hashP->buckets, 0, hashP->bucketCount * sizeof(lwm2m_hash_node_t *));
+
+    for (i = 0 ; i < oldCount ; i++)
+    {
+        while (oldBuckets[i] != NULL)
+        {
+            lwm2m_hash_node_t * nodeP;
+            size_t index;
+
+            nodeP = oldBuckets[i];
+            oldBuckets[i] = nodeP->next;
+
+            index = prv_getBucket(hashP, nodeP->key);
+            nodeP->next = hashP->buckets[index];
+            hashP->buckets[index] = nodeP;
+        }
+    }
+
+    if (oldBuckets != NULL) lwm2m_free(oldBuckets);
+}
+
+uint32_t hash_buffer(const uint8_t * buffer,
+                     size_t length)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    size_t i;
+
+    for (i = 0 ; i < length ; i++)
+    {
+        hash ^= buffer[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+bool hash_add(lwm2m_hash_t * hashP,
+              uint32_t key,
+              void * itemP)
+{
+    lwm2m_hash_node_t * nodeP;
+    size_t index;
+
+    if (hashP->count >= hashP->bucketCount)
+    {
+        prv_grow(hashP);
+        if (hashP->bucketCount == 0) return false;
+    }
+
+    nodeP = (lwm2m_hash_node_t *)lwm2m_malloc(sizeof(lwm2m_hash_node_t));
+    if (nodeP == NULL) return false;
+
+    nodeP->key = key;
+    nodeP->itemP = itemP;
+
+    index = prv_getBucket(hashP, key);
+    nodeP->next = hashP->buckets[index];
+    hashP->buckets[index] = nodeP;
+    hashP->count++;
+
+    return true;
+}
+
+void hash_remove(lwm2m_hash_t * hashP,
+                 uint32_t key,
+                 void * itemP)
+{
+    lwm2m_hash_node_t ** nodePP;
+
+    if (hashP->bucketCount == 0) return;
+
+    nodePP = &hashP->buckets[prv_getBucket(hashP, key)];
+    while (*nodePP != NULL)
+    {
+        if ((*nodePP)->key == key && (*nodePP)->itemP == itemP)
+        {
+            lwm2m_hash_node_t * nodeP;
+
+            nodeP = *nodePP;
+            *nodePP = nodeP->next;
+            lwm2m_free(nodeP);
+            hashP->count--;
+            return;
+        }
+        nodePP = &(*nodePP)->next;
+    }
+}
+
+void * hash_find(lwm2m_hash_t * hashP,
+                 uint32_t key,
+                 hash_match_callback_t matchFunc,
+                 void * userData)
+{
+    lwm2m_hash_node_t * nodeP;
+
+    if (hashP->bucketCount == 0) return NULL;
+
+    for (nodeP = hashP->buckets[prv_getBucket(hashP, key)] ; nodeP != NULL ; nodeP = nodeP->next)
+    {
+        if (nodeP->key == key
+         && (matchFunc == NULL || matchFunc(nodeP->itemP, userData)))
+        {
+            return nodeP->itemP;
+        }
+    }
+
+    return NULL;
+}
+
+void hash_free(lwm2m_hash_t * hashP)
+{
+    size_t i;
+
+    for (i = 0 ; i < hashP->bucketCount ; i++)
+    {
+        while (hashP->buckets[i] != NULL)
+        {
+            lwm2m_hash_node_t * nodeP;
+
+            nodeP = hashP->buckets[i];
+            hashP->buckets[i] = nodeP->next;
+            lwm2m_free(nodeP);
+        }
+    }
+
+    if (hashP->buckets != NULL) lwm2m_free(hashP->buckets);
+    hashP->buckets = NULL;
+    hashP->bucketCount = 0;
+    hashP->count = 0;
+}
@@ -118,6 +118,34 @@
 
 #define LWM2M_DEFAULT_LIFETIME  86400
 
+#ifndef LWM2M_SEND_BUFFER_SIZE
+#define LWM2M_SEND_BUFFER_SIZE  (REST_MAX_CHUNK_SIZE + 64)  // initial size of the context send buffer
+#endif
+
+#ifndef LWM2M_BLOCK1_MAX_SIZE
+#define LWM2M_BLOCK1_MAX_SIZE   4096    // default maximum payload reassembled from a block1 transfer
+#endif
+
+#ifndef LWM2M_BLOCK1_MAX_TRANSFERS
+#define LWM2M_BLOCK1_MAX_TRANSFERS  4   // block1 transfers kept per server
+#endif
+
+#ifndef LWM2M_BLOCK2_MAX_ENTRIES
+#define LWM2M_BLOCK2_MAX_ENTRIES    4   // representations kept for block2 transfers
+#endif
+
+#ifndef LWM2M_BLOCK2_LIFETIME
+#define LWM2M_BLOCK2_LIFETIME       60  // seconds a representation is kept after its last block request
+#endif
+
+#ifndef LWM2M_BLOCK2_MAX_SIZE
+#define LWM2M_BLOCK2_MAX_SIZE   65535   // maximum payload reassembled from a block2 response
+#endif
+
+#ifndef LWM2M_ARENA_BLOCK_SIZE
+#define LWM2M_ARENA_BLOCK_SIZE  1024    // size of the blocks of the context data arena
+#endif
+
 #ifdef LWM2M_SUPPORT_JSON
 #define REG_LWM2M_RESOURCE_TYPE     ">;rt=\"oma.lwm2m\";ct=11543,"
 #define REG_LWM2M_RESOURCE_TYPE_LEN 25
@@ -129,6 +157,7 @@
 #define REG_DEFAULT_PATH    "/"
 
 #define REG_OBJECT_MIN_LEN  5   // "</n>,"
+#define REG_ENTRY_MAX_LEN   15  // "</65535/65535>,"
 #define REG_PATH_END        ">,"
 #define REG_PATH_SEPARATOR  "/"
 
@@ -216,12 +245,21 @@
 
 typedef struct
 {
-    uint16_t clientID;
+    uint32_t clientID;
     lwm2m_uri_t uri;
     lwm2m_result_callback_t callback;
     void * userData;
 } dm_data_t;
 
+// result of a read left by dm_handleRequest() for lwm2m_handle_packet() to serialize
+typedef struct
+{
+    lwm2m_data_t *     dataP;
+    int                size;
+    lwm2m_uri_t        uri;
+    lwm2m_media_type_t format;
+} dm_read_t;
+
 typedef enum
 {
     URI_DEPTH_OBJECT,
@@ -243,6 +281,7 @@ typedef struct
 // defined in uri.c
 lwm2m_uri_t * uri_decode(char * altPath, multi_option_t *uriPath);
 int uri_getNumber(uint8_t * uriString, size_t uriLength);
+bool uri_getClientId(multi_option_t * uriPath, uint32_t * idP);
 int uri_toString(lwm2m_uri_t * uriP, uint8_t * buffer, size_t bufferLen, uri_depth_t * depthP);
 
 // defined in objects.c
@@ -251,47 +290,80 @@ uint8_t object_read(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_media_
 uint8_t object_write(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_media_type_t format, uint8_t * buffer, size_t length);
 uint8_t object_create(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_media_type_t format, uint8_t * buffer, size_t length);
 uint8_t object_execute(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, uint8_t * buffer, size_t length);
+bool object_isBlockWritable(lwm2m_context_t * contextP, lwm2m_uri_t * uriP);
+uint8_t object_writeBlock(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, size_t offset, uint8_t * buffer, size_t length, bool more);
 uint8_t object_delete(lwm2m_context_t * contextP, lwm2m_uri_t * uriP);
 uint8_t object_discover(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_server_t * serverP, uint8_t ** bufferP, size_t * lengthP);
 uint8_t object_checkReadable(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_attributes_t * attrP);
 bool object_isInstanceNew(lwm2m_context_t * contextP, uint16_t objectId, uint16_t instanceId);
-int object_getRegisterPayloadBufferLength(lwm2m_context_t * contextP);
-int object_getRegisterPayload(lwm2m_context_t * contextP, uint8_t * buffer, size_t length);
+uint8_t * object_getRegisterPayload(lwm2m_context_t * contextP, size_t * lengthP);
+void object_updateRegisterPayload(lwm2m_context_t * contextP, uint16_t objectId);
+void object_freeRegisterPayload(lwm2m_context_t * contextP);
 int object_getServers(lwm2m_context_t * contextP, bool checkOnly);
 uint8_t object_createInstance(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_data_t * dataP);
 uint8_t object_writeInstance(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_data_t * dataP);
 
+// defined in hash.c
+typedef bool (*hash_match_callback_t) (void * itemP, void * userData);
+uint32_t hash_buffer(const uint8_t * buffer, size_t length);
+bool hash_add(lwm2m_hash_t * hashP, uint32_t key, void * itemP);
+void hash_remove(lwm2m_hash_t * hashP, uint32_t key, void * itemP);
+void * hash_find(lwm2m_hash_t * hashP, uint32_t key, hash_match_callback_t matchFunc, void * userData);
+void hash_free(lwm2m_hash_t * hashP);
+
+// defined in arena.c
+void * arena_alloc(lwm2m_arena_t * arenaP, size_t size);
+bool arena_contains(lwm2m_arena_t * arenaP, void * memP);
+bool arena_borrow(lwm2m_arena_t * arenaP, uint8_t * buffer, size_t length);
+void arena_enter(lwm2m_arena_t * arenaP);
+void arena_leave(lwm2m_arena_t * arenaP);
+void arena_reset(lwm2m_arena_t * arenaP);
+void arena_free(lwm2m_arena_t * arenaP);
+
 // defined in transaction.c
 lwm2m_transaction_t * transaction_new(void * sessionH, coap_method_t method, char * altPath, lwm2m_uri_t * uriP, uint16_t mID, uint8_t token_len, uint8_t* token);
 int transaction_send(lwm2m_context_t * contextP, lwm2m_transaction_t * transacP);
+// Set the payload of the request, sent in blocks of blockSize bytes if it does not fit in one.
+// In that case the transaction keeps a copy of buffer.
+bool transaction_setPayload(lwm2m_transaction_t * transacP, uint8_t * buffer, size_t length, uint16_t blockSize);
 void transaction_free(lwm2m_transaction_t * transacP);
 void transaction_remove(lwm2m_context_t * contextP, lwm2m_transaction_t * transacP);
 bool transaction_handleResponse(lwm2m_context_t * contextP, void * fromSessionH, coap_packet_t * message, coap_packet_t * response);
-void transaction_step(lwm2m_context_t * contextP, time_t currentTime, time_t * timeoutP);
+
+// defined in timer.c
+bool timer_schedule(lwm2m_context_t * contextP, lwm2m_timer_t * timerP, int64_t deadline);
+void timer_cancel(lwm2m_context_t * contextP, lwm2m_timer_t * timerP);
+void timer_step(lwm2m_context_t * contextP, int64_t currentTime, int64_t * timeoutP);
+void timer_free(lwm2m_context_t * contextP);
 
 // defined in management.c
-uint8_t dm_handleRequest(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_server_t * serverP, coap_packet_t * message, coap_packet_t * response);
+uint8_t dm_handleRequest(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_server_t * serverP, coap_packet_t * message, coap_packet_t * response, dm_read_t * readP);
+uint8_t dm_handleBlockWrite(lwm2m_context_t * contextP, lwm2m_server_t * serverP, const char * uri, coap_packet_t * message);
 
 // defined in observe.c
 uint8_t observe_handleRequest(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_server_t * serverP, int size, lwm2m_data_t * dataP, coap_packet_t * message, coap_packet_t * response);
 void observe_cancel(lwm2m_context_t * contextP, uint16_t mid, void * fromSessionH);
 uint8_t observe_setParameters(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_server_t * serverP, lwm2m_attributes_t * attrP);
-void observe_step(lwm2m_context_t * contextP, time_t currentTime, time_t * timeoutP);
+void observe_expire(lwm2m_context_t * contextP, lwm2m_watcher_t * watcherP, int64_t currentTime);
 void observe_clear(lwm2m_context_t * contextP, lwm2m_uri_t * uriP);
 bool observe_handleNotify(lwm2m_context_t * contextP, void * fromSessionH, coap_packet_t * message, coap_packet_t * response);
-void observe_remove(lwm2m_observation_t * observationP);
+void observe_remove(lwm2m_context_t * contextP, lwm2m_observation_t * observationP);
 lwm2m_observed_t * observe_findByUri(lwm2m_context_t * contextP, lwm2m_uri_t * uriP);
 
 // defined in registration.c
 uint8_t registration_handleRequest(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, void * fromSessionH, coap_packet_t * message, coap_packet_t * response);
 void registration_deregister(lwm2m_context_t * contextP, lwm2m_server_t * serverP);
-void registration_freeClient(lwm2m_client_t * clientP);
+void registration_freeClient(lwm2m_context_t * contextP, lwm2m_client_t * clientP);
+lwm2m_client_t * registration_findClient(lwm2m_context_t * contextP, uint32_t clientID);
+void registration_expireClient(lwm2m_context_t * contextP, lwm2m_client_t * clientP);
 uint8_t registration_start(lwm2m_context_t * contextP);
+int registration_update(lwm2m_context_t * contextP, uint16_t shortServerID, bool withObjects);
 void registration_step(lwm2m_context_t * contextP, time_t currentTime, time_t * timeoutP);
 lwm2m_status_t registration_getStatus(lwm2m_context_t * contextP);
 
 // defined in packet.c
 uint8_t message_send(lwm2m_context_t * contextP, coap_packet_t * message, void * sessionH);
+uint8_t * message_serialize(lwm2m_context_t * contextP, coap_packet_t * message, bool keepOptions, size_t * lengthP);
 
 // defined in bootstrap.c
 void bootstrap_step(lwm2m_context_t * contextP, time_t currentTime, time_t* timeoutP);
@@ -302,23 +374,48 @@ uint8_t bootstrap_handleRequest(lwm2m_context_t * contextP, lwm2m_uri_t * uriP,
 void bootstrap_start(lwm2m_context_t * contextP);
 lwm2m_status_t bootstrap_getStatus(lwm2m_context_t * contextP);
 
+// defined in data.c
+lwm2m_data_t * data_new(lwm2m_arena_t * arenaP, int size);
+void data_free(lwm2m_arena_t * arenaP, int size, lwm2m_data_t * dataP);
+void data_encodeOpaque(lwm2m_arena_t * arenaP, uint8_t * buffer, size_t length, lwm2m_data_t * dataP);
+int data_parse(lwm2m_arena_t * arenaP, lwm2m_uri_t * uriP, uint8_t * buffer, size_t bufferLen, lwm2m_media_type_t format, lwm2m_data_t ** dataP);
+bool data_isChunked(lwm2m_uri_t * uriP, int size, lwm2m_data_t * dataP, lwm2m_media_type_t * formatP);
+int data_serializeChunk(lwm2m_uri_t * uriP, int size, lwm2m_data_t * dataP, lwm2m_media_type_t format, size_t * offsetP, uint8_t * buffer, size_t length);
+
 // defined in tlv.c
-int tlv_parse(uint8_t * buffer, size_t bufferLen, lwm2m_data_t ** dataP);
+int tlv_parse(lwm2m_arena_t * arenaP, uint8_t * buffer, size_t bufferLen, lwm2m_data_t ** dataP);
 int tlv_serialize(bool isResourceInstance, int size, lwm2m_data_t * dataP, uint8_t ** bufferP);
+int tlv_serializeChunk(bool isResourceInstance, int size, lwm2m_data_t * dataP, size_t * offsetP, uint8_t * buffer, size_t length);
 
 // defined in json.c
 #ifdef LWM2M_SUPPORT_JSON
-int json_parse(lwm2m_uri_t * uriP, uint8_t * buffer, size_t bufferLen, lwm2m_data_t ** dataP);
+int json_parse(lwm2m_arena_t * arenaP, lwm2m_uri_t * uriP, uint8_t * buffer, size_t bufferLen, lwm2m_data_t ** dataP);
 int json_serialize(lwm2m_uri_t * uriP, int size, lwm2m_data_t * tlvP, uint8_t ** bufferP);
+int json_serializeChunk(lwm2m_uri_t * uriP, int size, lwm2m_data_t * tlvP, size_t * offsetP, uint8_t * buffer, size_t length);
 #endif
 
 // defined in discover.c
 int discover_serialize(lwm2m_context_t * contextP, lwm2m_uri_t * uriP, lwm2m_server_t * serverP, int size, lwm2m_data_t * dataP, uint8_t ** bufferP);
 
 // defined in block1.c
-uint8_t coap_block1_handler(lwm2m_block1_data_t ** block1Data, uint16_t mid, uint8_t * buffer, size_t length, uint16_t blockSize, uint32_t blockNum, bool blockMore, uint8_t ** outputBuffer, size_t * outputLength);
+uint8_t coap_block1_handler(lwm2m_block1_data_t ** block1Data, const char * uri, uint16_t mid, uint8_t * buffer, size_t length, uint16_t blockSize, uint32_t blockNum, bool blockMore, uint32_t totalSize, size_t maxSize, uint8_t ** outputBuffer, size_t * outputLength);
+// Track a block1 transfer whose blocks are not kept. Returns NO_ERROR and the offset of a new block,
+// COAP_IGNORE for a retransmitted one or an error code.
+uint8_t coap_block1_stream(lwm2m_block1_data_t ** block1Data, const char * uri, uint16_t mid, uint16_t blockSize, uint32_t blockNum, size_t length, bool blockMore, size_t * offsetP);
+bool coap_block1_isStreamed(lwm2m_block1_data_t * block1Data, const char * uri);
+void coap_block1_remove(lwm2m_block1_data_t ** block1Data, const char * uri);
 void free_block1_buffer(lwm2m_block1_data_t * block1Data);
 
+// defined in block2.c
+bool block2_get(lwm2m_context_t * contextP, void * sessionH, coap_packet_t * message, coap_packet_t * response, uint32_t blockNum, uint16_t blockSize);
+bool block2_set(lwm2m_context_t * contextP, void * sessionH, coap_packet_t * message, coap_packet_t * response, uint32_t blockNum, uint16_t blockSize);
+#ifdef LWM2M_CLIENT_MODE
+// Caches a notification bigger than the block size and sets its first block in message.
+bool block2_notify(lwm2m_context_t * contextP, void * sessionH, lwm2m_uri_t * uriP, coap_packet_t * message, uint8_t * buffer, size_t length, uint16_t blockSize);
+#endif
+void block2_expire(lwm2m_context_t * contextP, lwm2m_block2_data_t * block2Data);
+void block2_free(lwm2m_context_t * contextP);
+
 // defined in utils.c
 lwm2m_data_type_t utils_depthToDatatype(uri_depth_t depth);
 lwm2m_binding_t utils_stringToBinding(uint8_t *buffer, size_t length);
@@ -332,6 +429,7 @@ int utils_textToFloat(uint8_t * buffer, int length, double * dataP);
 void utils_copyValue(void * dst, const void * src, size_t len);
 size_t utils_base64GetSize(size_t dataLen);
 size_t utils_base64Encode(uint8_t * dataP, size_t dataLen, uint8_t * bufferP, size_t bufferLen);
+int64_t utils_getTimeMs(void);
 #ifdef LWM2M_CLIENT_MODE
 lwm2m_server_t * utils_findServer(lwm2m_context_t * contextP, void * fromSessionH);
 lwm2m_server_t * utils_findBootstrapServer(lwm2m_context_t * contextP, void * fromSessionH);
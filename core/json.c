@@ -25,7 +25,8 @@
 
 #ifdef LWM2M_SUPPORT_JSON
 
-#define PRV_JSON_BUFFER_SIZE 1024
+#define JSON_VALUE_BUFFER_SIZE  64      // text of a numerical value or of a base64 chunk
+#define JSON_BASE64_CHUNK_SIZE  48      // multiple of 3 so that chunks are encoded independently
 
 #define JSON_MIN_ARRAY_LEN      21      // e":[{"n":"N","v":X}]}
 #define JSON_MIN_BASE_LEN        7      // n":"N",
@@ -37,18 +38,20 @@
 
 #define JSON_RES_ITEM_URI           "{\"n\":\""
 #define JSON_RES_ITEM_URI_SIZE      6
-#define JSON_ITEM_BOOL_TRUE         "\",\"bv\":true},"
-#define JSON_ITEM_BOOL_TRUE_SIZE    13
-#define JSON_ITEM_BOOL_FALSE        "\",\"bv\":false},"
-#define JSON_ITEM_BOOL_FALSE_SIZE   14
+#define JSON_ITEM_BOOL_TRUE         "\",\"bv\":true}"
+#define JSON_ITEM_BOOL_TRUE_SIZE    12
+#define JSON_ITEM_BOOL_FALSE        "\",\"bv\":false}"
+#define JSON_ITEM_BOOL_FALSE_SIZE   13
 #define JSON_ITEM_NUM               "\",\"v\":"
 #define JSON_ITEM_NUM_SIZE          6
-#define JSON_ITEM_NUM_END           "},"
-#define JSON_ITEM_NUM_END_SIZE      2
+#define JSON_ITEM_NUM_END           "}"
+#define JSON_ITEM_NUM_END_SIZE      1
 #define JSON_ITEM_STRING_BEGIN      "\",\"sv\":\""
 #define JSON_ITEM_STRING_BEGIN_SIZE 8
-#define JSON_ITEM_STRING_END        "\"},"
-#define JSON_ITEM_STRING_END_SIZE   3
+#define JSON_ITEM_STRING_END        "\"}"
+#define JSON_ITEM_STRING_END_SIZE   2
+#define JSON_ITEM_SEPARATOR         ","
+#define JSON_ITEM_SEPARATOR_SIZE    1
 
 #define JSON_BN_HEADER_1        "{\"bn\":\""
 #define JSON_BN_HEADER_1_SIZE   7
@@ -440,7 +443,8 @@ static int prv_parseItem(uint8_t * buffer,
     return 0;
 }
 
-static bool prv_convertValue(_record_t * recordP,
+static bool prv_convertValue(lwm2m_arena_t * arenaP,
+                             _record_t * recordP,
                              lwm2m_data_t * targetP)
 {
     switch (recordP->type)
@@ -457,7 +461,9 @@ static bool prv_convertValue(_record_t * recordP,
 
         i = 0;
         while (i < recordP->valueLen
-            && recordP->value[i] != '.')
+            && recordP->value[i] != '.'
+            && recordP->value[i] != 'e'
+            && recordP->value[i] != 'E')
         {
             i++;
         }
@@ -491,7 +497,7 @@ static bool prv_convertValue(_record_t * recordP,
     break;
 
     case _TYPE_STRING:
-        lwm2m_data_encode_opaque(recordP->value, recordP->valueLen, targetP);
+        data_encodeOpaque(arenaP, recordP->value, recordP->valueLen, targetP);
         targetP->type = LWM2M_TYPE_STRING;
         break;
 
@@ -539,7 +545,9 @@ static uri_depth_t prv_decreaseLevel(uri_depth_t level)
     }
 }
 
-static lwm2m_data_t * prv_extendData(lwm2m_data_t * parentP)
+// grown one record at a time, hence kept on the heap rather than in the arena
+static lwm2m_data_t * prv_extendData(lwm2m_arena_t * arenaP,
+                                     lwm2m_data_t * parentP)
 {
     lwm2m_data_t * newP;
 
@@ -548,7 +556,10 @@ static lwm2m_data_t * prv_extendData(lwm2m_data_t * parentP)
     if (parentP->value.asChildren.array != NULL)
     {
         memcpy(newP, parentP->value.asChildren.array, parentP->value.asChildren.count * sizeof(lwm2m_data_t));
-        lwm2m_free(parentP->value.asChildren.array);     // do not use lwm2m_data_free() to keep pointed values
+        if (!arena_contains(arenaP, parentP->value.asChildren.array))
+        {
+            lwm2m_free(parentP->value.asChildren.array);     // do not use lwm2m_data_free() to keep pointed values
+        }
     }
     parentP->value.asChildren.array = newP;
     parentP->value.asChildren.count += 1;
@@ -556,7 +567,8 @@ static lwm2m_data_t * prv_extendData(lwm2m_data_t * parentP)
     return newP + parentP->value.asChildren.count - 1;
 }
 
-static int prv_convertRecord(lwm2m_uri_t * uriP,
+static int prv_convertRecord(lwm2m_arena_t * arenaP,
+                             lwm2m_uri_t * uriP,
                              _record_t * recordArray,
                              int count,
                              lwm2m_data_t ** dataP)
@@ -570,7 +582,7 @@ static int prv_convertRecord(lwm2m_uri_t * uriP,
     if (uriP == NULL)
     {
         size = count;
-        *dataP = lwm2m_data_new(count);
+        *dataP = data_new(arenaP, count);
         if (NULL == *dataP) return -1;
         rootLevel = URI_DEPTH_OBJECT;
         rootP = *dataP;
@@ -580,7 +592,7 @@ static int prv_convertRecord(lwm2m_uri_t * uriP,
         lwm2m_data_t * parentP;
         size = 1;
 
-        *dataP = lwm2m_data_new(1);
+        *dataP = data_new(arenaP, 1);
         if (NULL == *dataP) return -1;
         (*dataP)->type = LWM2M_TYPE_OBJECT;
         (*dataP)->id = uriP->objectId;
@@ -589,7 +601,7 @@ static int prv_convertRecord(lwm2m_uri_t * uriP,
         if (LWM2M_URI_IS_SET_INSTANCE(uriP))
         {
             parentP->value.asChildren.count = 1;
-            parentP->value.asChildren.array = lwm2m_data_new(1);
+            parentP->value.asChildren.array = data_new(arenaP, 1);
             if (NULL == parentP->value.asChildren.array) goto error;
             parentP = parentP->value.asChildren.array;
             parentP->type = LWM2M_TYPE_OBJECT_INSTANCE;
@@ -598,7 +610,7 @@ static int prv_convertRecord(lwm2m_uri_t * uriP,
             if (LWM2M_URI_IS_SET_RESOURCE(uriP))
             {
                 parentP->value.asChildren.count = 1;
-                parentP->value.asChildren.array = lwm2m_data_new(1);
+                parentP->value.asChildren.array = data_new(arenaP, 1);
                 if (NULL == parentP->value.asChildren.array) goto error;
                 parentP = parentP->value.asChildren.array;
                 parentP->type = LWM2M_TYPE_MULTIPLE_RESOURCE;
@@ -607,7 +619,7 @@ static int prv_convertRecord(lwm2m_uri_t * uriP,
             }
         }
         parentP->value.asChildren.count = count;
-        parentP->value.asChildren.array = lwm2m_data_new(count);
+        parentP->value.asChildren.array = data_new(arenaP, count);
         if (NULL == parentP->value.asChildren.array) goto error;
         rootP = parentP->value.asChildren.array;
     }
@@ -667,7 +679,7 @@ static int prv_convertRecord(lwm2m_uri_t * uriP,
                 targetP = prv_findDataItem(parentP->value.asChildren.array, parentP->value.asChildren.count, recordArray[index].ids[i]);
                 if (targetP == NULL)
                 {
-                    targetP = prv_extendData(parentP);
+                    targetP = prv_extendData(arenaP, parentP);
                     if (targetP == NULL) goto error;
                     targetP->id = recordArray[index].ids[i];
                     targetP->type = utils_depthToDatatype(level);
@@ -678,26 +690,27 @@ static int prv_convertRecord(lwm2m_uri_t * uriP,
             if (recordArray[index].ids[resSegmentIndex + 1] != LWM2M_MAX_ID)
             {
                 targetP->type = LWM2M_TYPE_MULTIPLE_RESOURCE;
-                targetP = prv_extendData(targetP);
+                targetP = prv_extendData(arenaP, targetP);
                 if (targetP == NULL) goto error;
                 targetP->id = recordArray[index].ids[resSegmentIndex + 1];
                 targetP->type = LWM2M_TYPE_UNDEFINED;
             }
         }
 
-        if (true != prv_convertValue(recordArray + index, targetP)) goto error;
+        if (true != prv_convertValue(arenaP, recordArray + index, targetP)) goto error;
     }
 
     return size;
 
 error:
-    lwm2m_data_free(size, *dataP);
+    data_free(arenaP, size, *dataP);
     *dataP = NULL;
 
     return -1;
 }
 
-static int prv_dataStrip(int size,
+static int prv_dataStrip(lwm2m_arena_t * arenaP,
+                         int size,
                          lwm2m_data_t * dataP,
                          lwm2m_data_t ** resultP)
 {
@@ -714,7 +727,7 @@ static int prv_dataStrip(int size,
         }
     }
 
-    *resultP = lwm2m_data_new(realSize);
+    *resultP = data_new(arenaP, realSize);
     if (*resultP == NULL) return -1;
 
     j = 0;
@@ -730,7 +743,7 @@ static int prv_dataStrip(int size,
             {
                 int childLen;
 
-                childLen = prv_dataStrip(dataP[i].value.asChildren.count, dataP[i].value.asChildren.array, &((*resultP)[j].value.asChildren.array));
+                childLen = prv_dataStrip(arenaP, dataP[i].value.asChildren.count, dataP[i].value.asChildren.array, &((*resultP)[j].value.asChildren.array));
                 if (childLen <= 0)
                 {
                     // skip this one
@@ -753,7 +766,8 @@ static int prv_dataStrip(int size,
     return realSize;
 }
 
-int json_parse(lwm2m_uri_t * uriP,
+int json_parse(lwm2m_arena_t * arenaP,
+               lwm2m_uri_t * uriP,
                uint8_t * buffer,
                size_t bufferLen,
                lwm2m_data_t ** dataP)
@@ -935,7 +949,7 @@ int json_parse(lwm2m_uri_t * uriP,
             }
         }
 
-        count = prv_convertRecord(baseUriP, recordArray, count, &parsedP);
+        count = prv_convertRecord(arenaP, baseUriP, recordArray, count, &parsedP);
         lwm2m_free(recordArray);
         recordArray = NULL;
 
@@ -984,9 +998,9 @@ int json_parse(lwm2m_uri_t * uriP,
                             }
                             else
                             {
-                                size = prv_dataStrip(1, targetP, &resP);
+                                size = prv_dataStrip(arenaP, 1, targetP, &resP);
                                 if (size <= 0) goto error;
-                                lwm2m_data_free(count, parsedP);
+                                data_free(arenaP, count, parsedP);
                                 parsedP = NULL;
                             }
                         }
@@ -1006,9 +1020,9 @@ int json_parse(lwm2m_uri_t * uriP,
         {
             lwm2m_data_t * tempP;
 
-            size = prv_dataStrip(size, resultP, &tempP);
+            size = prv_dataStrip(arenaP, size, resultP, &tempP);
             if (size <= 0) goto error;
-            lwm2m_data_free(count, parsedP);
+            data_free(arenaP, count, parsedP);
             resultP = tempP;
         }
         count = size;
@@ -1022,7 +1036,7 @@ error:
     LOG("Parsing failed");
     if (parsedP != NULL)
     {
-        lwm2m_data_free(count, parsedP);
+        data_free(arenaP, count, parsedP);
         parsedP = NULL;
     }
     if (recordArray != NULL)
@@ -1032,28 +1046,64 @@ error:
     return -1;
 }
 
-static int prv_serializeValue(lwm2m_data_t * tlvP,
-                              uint8_t * buffer,
-                              size_t bufferLen)
+/*
+ * The writer emits the window [start, start + length) of the JSON output into
+ * the caller buffer, so large payloads can be produced chunk by chunk. Without
+ * a buffer, it only measures the output.
+ */
+typedef struct
+{
+    uint8_t * buffer;     // NULL to only measure the output
+    size_t    length;
+    size_t    start;      // offset in the output of buffer[0]
+    size_t    position;   // offset in the output of the next byte
+    bool      first;      // no record was emitted yet
+} _json_stream_t;
+
+static bool prv_isFull(_json_stream_t * streamP)
+{
+    return streamP->buffer != NULL
+        && streamP->position >= streamP->start + streamP->length;
+}
+
+static bool prv_isInWindow(_json_stream_t * streamP,
+                           size_t dataLen)
+{
+    return streamP->buffer != NULL
+        && streamP->position < streamP->start + streamP->length
+        && streamP->position + dataLen > streamP->start;
+}
+
+static void prv_emit(_json_stream_t * streamP,
+                     const uint8_t * data,
+                     size_t dataLen)
 {
+    if (prv_isInWindow(streamP, dataLen))
+    {
+        size_t end;
+        size_t from;
+        size_t to;
+
+        end = streamP->start + streamP->length;
+        from = (streamP->position < streamP->start) ? streamP->start - streamP->position : 0;
+        to = (streamP->position + dataLen > end) ? end - streamP->position : dataLen;
+        memcpy(streamP->buffer + streamP->position + from - streamP->start, data + from, to - from);
+    }
+    streamP->position += dataLen;
+}
+
+static int prv_serializeValue(_json_stream_t * streamP,
+                              lwm2m_data_t * tlvP)
+{
+    uint8_t valueStr[JSON_VALUE_BUFFER_SIZE];
     int res;
-    int head;
 
     switch (tlvP->type)
     {
     case LWM2M_TYPE_STRING:
-        if (bufferLen < JSON_ITEM_STRING_BEGIN_SIZE) return -1;
-        memcpy(buffer, JSON_ITEM_STRING_BEGIN, JSON_ITEM_STRING_BEGIN_SIZE);
-        head = JSON_ITEM_STRING_BEGIN_SIZE;
-
-        if (bufferLen - head < tlvP->value.asBuffer.length) return -1;
-        memcpy(buffer + head, tlvP->value.asBuffer.buffer, tlvP->value.asBuffer.length);
-        head += tlvP->value.asBuffer.length;
-
-        if (bufferLen - head < JSON_ITEM_STRING_END_SIZE) return -1;
-        memcpy(buffer + head, JSON_ITEM_STRING_END, JSON_ITEM_STRING_END_SIZE);
-        head += JSON_ITEM_STRING_END_SIZE;
-
+        prv_emit(streamP, (uint8_t *)JSON_ITEM_STRING_BEGIN, JSON_ITEM_STRING_BEGIN_SIZE);
+        prv_emit(streamP, tlvP->value.asBuffer.buffer, tlvP->value.asBuffer.length);
+        prv_emit(streamP, (uint8_t *)JSON_ITEM_STRING_END, JSON_ITEM_STRING_END_SIZE);
         break;
 
     case LWM2M_TYPE_INTEGER:
@@ -1062,17 +1112,12 @@ static int prv_serializeValue(lwm2m_data_t * tlvP,
 
         if (0 == lwm2m_data_decode_int(tlvP, &value)) return -1;
 
-        if (bufferLen < JSON_ITEM_NUM_SIZE) return -1;
-        memcpy(buffer, JSON_ITEM_NUM, JSON_ITEM_NUM_SIZE);
-        head = JSON_ITEM_NUM_SIZE;
-
-        res = utils_intToText(value, buffer + head, bufferLen - head);
+        res = utils_intToText(value, valueStr, JSON_VALUE_BUFFER_SIZE);
         if (res <= 0) return -1;
-        head += res;
 
-        if (bufferLen - head < JSON_ITEM_NUM_END_SIZE) return -1;
-        memcpy(buffer + head, JSON_ITEM_NUM_END, JSON_ITEM_NUM_END_SIZE);
-        head += JSON_ITEM_NUM_END_SIZE;
+        prv_emit(streamP, (uint8_t *)JSON_ITEM_NUM, JSON_ITEM_NUM_SIZE);
+        prv_emit(streamP, valueStr, res);
+        prv_emit(streamP, (uint8_t *)JSON_ITEM_NUM_END, JSON_ITEM_NUM_END_SIZE);
     }
     break;
 
@@ -1082,17 +1127,12 @@ static int prv_serializeValue(lwm2m_data_t * tlvP,
 
         if (0 == lwm2m_data_decode_float(tlvP, &value)) return -1;
 
-        if (bufferLen < JSON_ITEM_NUM_SIZE) return -1;
-        memcpy(buffer, JSON_ITEM_NUM, JSON_ITEM_NUM_SIZE);
-        head = JSON_ITEM_NUM_SIZE;
-
-        res = utils_floatToText(value, buffer + head, bufferLen - head);
+        res = utils_floatToText(value, valueStr, JSON_VALUE_BUFFER_SIZE);
         if (res <= 0) return -1;
-        head += res;
 
-        if (bufferLen - head < JSON_ITEM_NUM_END_SIZE) return -1;
-        memcpy(buffer + head, JSON_ITEM_NUM_END, JSON_ITEM_NUM_END_SIZE);
-        head += JSON_ITEM_NUM_END_SIZE;
+        prv_emit(streamP, (uint8_t *)JSON_ITEM_NUM, JSON_ITEM_NUM_SIZE);
+        prv_emit(streamP, valueStr, res);
+        prv_emit(streamP, (uint8_t *)JSON_ITEM_NUM_END, JSON_ITEM_NUM_END_SIZE);
     }
     break;
 
@@ -1104,32 +1144,43 @@ static int prv_serializeValue(lwm2m_data_t * tlvP,
 
         if (value == true)
         {
-            if (bufferLen < JSON_ITEM_BOOL_TRUE_SIZE) return -1;
-            memcpy(buffer, JSON_ITEM_BOOL_TRUE, JSON_ITEM_BOOL_TRUE_SIZE);
-            head = JSON_ITEM_BOOL_TRUE_SIZE;
+            prv_emit(streamP, (uint8_t *)JSON_ITEM_BOOL_TRUE, JSON_ITEM_BOOL_TRUE_SIZE);
         }
         else
         {
-            if (bufferLen < JSON_ITEM_BOOL_FALSE_SIZE) return -1;
-            memcpy(buffer, JSON_ITEM_BOOL_FALSE, JSON_ITEM_BOOL_FALSE_SIZE);
-            head = JSON_ITEM_BOOL_FALSE_SIZE;
+            prv_emit(streamP, (uint8_t *)JSON_ITEM_BOOL_FALSE, JSON_ITEM_BOOL_FALSE_SIZE);
         }
     }
     break;
 
     case LWM2M_TYPE_OPAQUE:
-        if (bufferLen < JSON_ITEM_STRING_BEGIN_SIZE) return -1;
-        memcpy(buffer, JSON_ITEM_STRING_BEGIN, JSON_ITEM_STRING_BEGIN_SIZE);
-        head = JSON_ITEM_STRING_BEGIN_SIZE;
+    {
+        size_t encodedLen;
 
-        res = utils_base64Encode(tlvP->value.asBuffer.buffer, tlvP->value.asBuffer.length, buffer+head, bufferLen - head);
-        if (tlvP->value.asBuffer.length != 0 && res == 0) return -1;
-        head += res;
+        prv_emit(streamP, (uint8_t *)JSON_ITEM_STRING_BEGIN, JSON_ITEM_STRING_BEGIN_SIZE);
 
-        if (bufferLen - head < JSON_ITEM_STRING_END_SIZE) return -1;
-        memcpy(buffer + head, JSON_ITEM_STRING_END, JSON_ITEM_STRING_END_SIZE);
-        head += JSON_ITEM_STRING_END_SIZE;
-        break;
+        encodedLen = utils_base64GetSize(tlvP->value.asBuffer.length);
+        if (prv_isInWindow(streamP, encodedLen))
+        {
+            size_t index;
+
+            for (index = 0 ; index < tlvP->value.asBuffer.length && !prv_isFull(streamP) ; index += JSON_BASE64_CHUNK_SIZE)
+            {
+                res = utils_base64Encode(tlvP->value.asBuffer.buffer + index,
+                                         MIN(JSON_BASE64_CHUNK_SIZE, tlvP->value.asBuffer.length - index),
+                                         valueStr, JSON_VALUE_BUFFER_SIZE);
+                if (res == 0) return -1;
+                prv_emit(streamP, valueStr, res);
+            }
+        }
+        else
+        {
+            streamP->position += encodedLen;
+        }
+
+        prv_emit(streamP, (uint8_t *)JSON_ITEM_STRING_END, JSON_ITEM_STRING_END_SIZE);
+    }
+    break;
 
     case LWM2M_TYPE_OBJECT_LINK:
         // TODO: implement
@@ -1139,27 +1190,23 @@ static int prv_serializeValue(lwm2m_data_t * tlvP,
         return -1;
     }
 
-    return head;
+    return 0;
 }
 
-int prv_serializeData(lwm2m_data_t * tlvP,
-                      uint8_t * parentUriStr,
-                      size_t parentUriLen,
-                      uint8_t * buffer,
-                      size_t bufferLen)
+static int prv_serializeData(_json_stream_t * streamP,
+                             lwm2m_data_t * tlvP,
+                             uint8_t * parentUriStr,
+                             size_t parentUriLen)
 {
-    int head;
+    uint8_t uriStr[URI_MAX_STRING_LEN];
     int res;
 
-    head = 0;
-
     switch (tlvP->type)
     {
     case LWM2M_TYPE_OBJECT:
     case LWM2M_TYPE_OBJECT_INSTANCE:
     case LWM2M_TYPE_MULTIPLE_RESOURCE:
     {
-        uint8_t uriStr[URI_MAX_STRING_LEN];
         size_t uriLen;
         size_t index;
 
@@ -1176,42 +1223,42 @@ int prv_serializeData(lwm2m_data_t * tlvP,
         res = utils_intToText(tlvP->id, uriStr + uriLen, URI_MAX_STRING_LEN - uriLen);
         if (res <= 0) return -1;
         uriLen += res;
+        if (uriLen >= URI_MAX_STRING_LEN) return -1;
         uriStr[uriLen] = '/';
         uriLen++;
 
-        head = 0;
-        for (index = 0 ; index < tlvP->value.asChildren.count; index++)
+        for (index = 0 ; index < tlvP->value.asChildren.count && !prv_isFull(streamP) ; index++)
         {
-            res = prv_serializeData(tlvP->value.asChildren.array + index, uriStr, uriLen, buffer + head, bufferLen - head);
+            res = prv_serializeData(streamP, tlvP->value.asChildren.array + index, uriStr, uriLen);
             if (res < 0) return -1;
-            head += res;
         }
     }
     break;
 
     default:
-        if (bufferLen < JSON_RES_ITEM_URI_SIZE) return -1;
-        memcpy(buffer, JSON_RES_ITEM_URI, JSON_RES_ITEM_URI_SIZE);
-        head = JSON_RES_ITEM_URI_SIZE;
-
+        if (streamP->first)
+        {
+            streamP->first = false;
+        }
+        else
+        {
+            prv_emit(streamP, (uint8_t *)JSON_ITEM_SEPARATOR, JSON_ITEM_SEPARATOR_SIZE);
+        }
+        prv_emit(streamP, (uint8_t *)JSON_RES_ITEM_URI, JSON_RES_ITEM_URI_SIZE);
         if (parentUriLen > 0)
         {
-            if (bufferLen - head < parentUriLen) return -1;
-            memcpy(buffer + head, parentUriStr, parentUriLen);
-            head += parentUriLen;
+            prv_emit(streamP, parentUriStr, parentUriLen);
         }
 
-        res = utils_intToText(tlvP->id, buffer + head, bufferLen - head);
+        res = utils_intToText(tlvP->id, uriStr, URI_MAX_STRING_LEN);
         if (res <= 0) return -1;
-        head += res;
+        prv_emit(streamP, uriStr, res);
 
-        res = prv_serializeValue(tlvP, buffer + head, bufferLen - head);
-        if (res < 0) return -1;
-        head += res;
+        if (0 != prv_serializeValue(streamP, tlvP)) return -1;
         break;
     }
 
-    return head;
+    return 0;
 }
 
 static int prv_findAndCheckData(lwm2m_uri_t * uriP,
@@ -1356,22 +1403,18 @@ static int prv_findAndCheckData(lwm2m_uri_t * uriP,
     return result;
 }
 
-int json_serialize(lwm2m_uri_t * uriP,
-                   int size,
-                   lwm2m_data_t * tlvP,
-                   uint8_t ** bufferP)
+static int prv_serialize(_json_stream_t * streamP,
+                         lwm2m_uri_t * uriP,
+                         int size,
+                         lwm2m_data_t * tlvP)
 {
     int index;
-    size_t head;
-    uint8_t bufferJSON[PRV_JSON_BUFFER_SIZE];
     uint8_t baseUriStr[URI_MAX_STRING_LEN];
     int baseUriLen;
     uri_depth_t rootLevel;
     int num;
     lwm2m_data_t * targetP;
 
-    LOG_ARG("size: %d", size);
-    LOG_URI(uriP);
     if (size != 0 && tlvP == NULL) return -1;
 
     baseUriLen = uri_toString(uriP, baseUriStr, URI_MAX_STRING_LEN, &rootLevel);
@@ -1388,9 +1431,9 @@ int json_serialize(lwm2m_uri_t * uriP,
         int res;
 
         res = utils_intToText(targetP->id, baseUriStr + baseUriLen, URI_MAX_STRING_LEN - baseUriLen);
-        if (res <= 0) return 0;
+        if (res <= 0) return -1;
         baseUriLen += res;
-        if (baseUriLen >= URI_MAX_STRING_LEN -1) return 0;
+        if (baseUriLen >= URI_MAX_STRING_LEN -1) return -1;
         num = targetP->value.asChildren.count;
         targetP = targetP->value.asChildren.array;
         baseUriStr[baseUriLen] = '/';
@@ -1399,40 +1442,93 @@ int json_serialize(lwm2m_uri_t * uriP,
 
     if (baseUriLen > 0)
     {
-        memcpy(bufferJSON, JSON_BN_HEADER_1, JSON_BN_HEADER_1_SIZE);
-        head = JSON_BN_HEADER_1_SIZE;
-        memcpy(bufferJSON + head, baseUriStr, baseUriLen);
-        head += baseUriLen;
-        memcpy(bufferJSON + head, JSON_BN_HEADER_2, JSON_BN_HEADER_2_SIZE);
-        head += JSON_BN_HEADER_2_SIZE;
+        prv_emit(streamP, (uint8_t *)JSON_BN_HEADER_1, JSON_BN_HEADER_1_SIZE);
+        prv_emit(streamP, baseUriStr, baseUriLen);
+        prv_emit(streamP, (uint8_t *)JSON_BN_HEADER_2, JSON_BN_HEADER_2_SIZE);
     }
     else
     {
-        memcpy(bufferJSON, JSON_HEADER, JSON_HEADER_SIZE);
-        head = JSON_HEADER_SIZE;
+        prv_emit(streamP, (uint8_t *)JSON_HEADER, JSON_HEADER_SIZE);
     }
 
-    for (index = 0 ; index < num && head < PRV_JSON_BUFFER_SIZE ; index++)
+    for (index = 0 ; index < num && !prv_isFull(streamP) ; index++)
     {
-        int res;
+        if (0 != prv_serializeData(streamP, targetP + index, NULL, 0)) return -1;
+    }
+
+    prv_emit(streamP, (uint8_t *)JSON_FOOTER, JSON_FOOTER_SIZE);
+
+    return 0;
+}
+
+int json_serializeChunk(lwm2m_uri_t * uriP,
+                        int size,
+                        lwm2m_data_t * tlvP,
+                        size_t * offsetP,
+                        uint8_t * buffer,
+                        size_t length)
+{
+    _json_stream_t stream;
+    size_t written;
+
+    LOG_ARG("size: %d, offset: %u, length: %u", size, *offsetP, length);
+    LOG_URI(uriP);
+
+    memset(&stream, 0, sizeof(_json_stream_t));
+    stream.buffer = buffer;
+    stream.length = length;
+    stream.start = *offsetP;
+    stream.first = true;
 
-        res = prv_serializeData(targetP + index, NULL, 0, bufferJSON + head, PRV_JSON_BUFFER_SIZE - head);
-        if (res < 0) return res;
-        head += res;
+    if (0 != prv_serialize(&stream, uriP, size, tlvP)) return -1;
+
+    if (stream.position <= stream.start)
+    {
+        written = 0;
+    }
+    else if (stream.position >= stream.start + stream.length)
+    {
+        written = stream.length;
+    }
+    else
+    {
+        written = stream.position - stream.start;
     }
+    *offsetP += written;
 
-    if (head + JSON_FOOTER_SIZE - 1 > PRV_JSON_BUFFER_SIZE) return 0;
+    return (int)written;
+}
+
+int json_serialize(lwm2m_uri_t * uriP,
+                   int size,
+                   lwm2m_data_t * tlvP,
+                   uint8_t ** bufferP)
+{
+    _json_stream_t stream;
+    size_t offset;
+    int length;
 
-    if (num > 0) head = head - 1;
+    LOG_ARG("size: %d", size);
+    LOG_URI(uriP);
 
-    memcpy(bufferJSON + head, JSON_FOOTER, JSON_FOOTER_SIZE);
-    head = head + JSON_FOOTER_SIZE;
+    // measure first so that the output is allocated once at its exact size
+    memset(&stream, 0, sizeof(_json_stream_t));
+    stream.first = true;
+    if (0 != prv_serialize(&stream, uriP, size, tlvP)) return -1;
+    length = (int)stream.position;
 
-    *bufferP = (uint8_t *)lwm2m_malloc(head);
+    *bufferP = (uint8_t *)lwm2m_malloc(length);
     if (*bufferP == NULL) return -1;
-    memcpy(*bufferP, bufferJSON, head);
 
-    return head;
+    offset = 0;
+    if (length != json_serializeChunk(uriP, size, tlvP, &offset, *bufferP, length))
+    {
+        lwm2m_free(*bufferP);
+        *bufferP = NULL;
+        return -1;
+    }
+
+    return length;
 }
 
 #endif
@@ -67,6 +67,10 @@ lwm2m_context_t * lwm2m_init(void * userData)
     {
         memset(contextP, 0, sizeof(lwm2m_context_t));
         contextP->userData = userData;
+        contextP->blockSize = REST_MAX_CHUNK_SIZE;
+#ifdef LWM2M_CLIENT_MODE
+        contextP->block1MaxSize = LWM2M_BLOCK1_MAX_SIZE;
+#endif
         srand((int)lwm2m_gettime());
         contextP->nextMID = rand();
     }
@@ -148,12 +152,20 @@ static void prv_deleteObservedList(lwm2m_context_t * contextP)
 
         for (watcherP = targetP->watcherList ; watcherP != NULL ; watcherP = watcherP->next)
         {
+            timer_cancel(contextP, &watcherP->timer);
             if (watcherP->parameters != NULL) lwm2m_free(watcherP->parameters);
+            if (watcherP->transaction != NULL)
+            {
+                // pending confirmable notification
+                lwm2m_free(watcherP->transaction->userData);
+                transaction_remove(contextP, watcherP->transaction);
+            }
         }
         LWM2M_LIST_FREE(targetP->watcherList);
 
         lwm2m_free(targetP);
     }
+    hash_free(&contextP->observedIndex);
 }
 #endif
 
@@ -167,6 +179,9 @@ void prv_deleteTransactionList(lwm2m_context_t * context)
         context->transactionList = context->transactionList->next;
         transaction_free(transaction);
     }
+    hash_free(&context->transactionMidIndex);
+    hash_free(&context->transactionTokenIndex);
+    timer_free(context);
 }
 
 void lwm2m_close(lwm2m_context_t * contextP)
@@ -187,6 +202,8 @@ void lwm2m_close(lwm2m_context_t * contextP)
     {
         lwm2m_free(contextP->altPath);
     }
+    object_freeRegisterPayload(contextP);
+    lwm2m_list_index_free(&contextP->objectIndex);
 
 #endif
 
@@ -198,14 +215,33 @@ void lwm2m_close(lwm2m_context_t * contextP)
         clientP = contextP->clientList;
         contextP->clientList = contextP->clientList->next;
 
-        registration_freeClient(clientP);
+        registration_freeClient(contextP, clientP);
     }
+    hash_free(&contextP->clientNameIndex);
+    hash_free(&contextP->clientIdIndex);
+    hash_free(&contextP->observationIndex);
 #endif
 
+    block2_free(contextP);
     prv_deleteTransactionList(contextP);
+    if (contextP->sendBuffer != NULL) lwm2m_free(contextP->sendBuffer);
+    arena_free(&contextP->dataArena);
     lwm2m_free(contextP);
 }
 
+int lwm2m_set_block_size(lwm2m_context_t * contextP,
+                         uint16_t size)
+{
+    LOG_ARG("size: %u", size);
+
+    // a power of two between 16 and 1024
+    if (size < 16 || size > 1024 || (size & (size - 1)) != 0) return COAP_400_BAD_REQUEST;
+
+    contextP->blockSize = size;
+
+    return COAP_NO_ERROR;
+}
+
 #ifdef LWM2M_CLIENT_MODE
 static int prv_refreshServerList(lwm2m_context_t * contextP)
 {
@@ -314,7 +350,7 @@ int lwm2m_configure(lwm2m_context_t * contextP,
     for (i = 0; i < numObject; i++)
     {
         objectList[i]->next = NULL;
-        contextP->objectList = (lwm2m_object_t *)LWM2M_LIST_ADD(contextP->objectList, objectList[i]);
+        contextP->objectList = (lwm2m_object_t *)LWM2M_INDEX_ADD(&contextP->objectIndex, contextP->objectList, objectList[i]);
     }
 
     return COAP_NO_ERROR;
@@ -326,15 +362,16 @@ int lwm2m_add_object(lwm2m_context_t * contextP,
     lwm2m_object_t * targetP;
 
     LOG_ARG("ID: %d", objectP->objID);
-    targetP = (lwm2m_object_t *)LWM2M_LIST_FIND(contextP->objectList, objectP->objID);
+    targetP = (lwm2m_object_t *)LWM2M_INDEX_FIND(&contextP->objectIndex, contextP->objectList, objectP->objID);
     if (targetP != NULL) return COAP_406_NOT_ACCEPTABLE;
     objectP->next = NULL;
 
-    contextP->objectList = (lwm2m_object_t *)LWM2M_LIST_ADD(contextP->objectList, objectP);
+    contextP->objectList = (lwm2m_object_t *)LWM2M_INDEX_ADD(&contextP->objectIndex, contextP->objectList, objectP);
+    object_updateRegisterPayload(contextP, objectP->objID);
 
     if (contextP->state == STATE_READY)
     {
-        return lwm2m_update_registration(contextP, 0, true);
+        return registration_update(contextP, 0, true);
     }
 
     return COAP_NO_ERROR;
@@ -346,30 +383,61 @@ int lwm2m_remove_object(lwm2m_context_t * contextP,
     lwm2m_object_t * targetP;
 
     LOG_ARG("ID: %d", id);
-    contextP->objectList = (lwm2m_object_t *)LWM2M_LIST_RM(contextP->objectList, id, &targetP);
+    contextP->objectList = (lwm2m_object_t *)LWM2M_INDEX_RM(&contextP->objectIndex, contextP->objectList, id, &targetP);
 
     if (targetP == NULL) return COAP_404_NOT_FOUND;
+    object_updateRegisterPayload(contextP, id);
 
     if (contextP->state == STATE_READY)
     {
-        return lwm2m_update_registration(contextP, 0, true);
+        return registration_update(contextP, 0, true);
     }
 
     return 0;
 }
 
+void lwm2m_set_block1_max_size(lwm2m_context_t * contextP,
+                               size_t maxSize)
+{
+    LOG_ARG("maxSize: %u", maxSize);
+    contextP->block1MaxSize = maxSize;
+}
+
 #endif
 
 
 int lwm2m_step(lwm2m_context_t * contextP,
                time_t * timeoutP)
+{
+    int64_t timeoutMs;
+    int result;
+
+    timeoutMs = (int64_t)*timeoutP * 1000;
+    result = lwm2m_step_ms(contextP, &timeoutMs);
+    // round up to avoid waking up before the next deadline
+    *timeoutP = (time_t)((timeoutMs + 999) / 1000);
+
+    return result;
+}
+
+int lwm2m_step_ms(lwm2m_context_t * contextP,
+                  int64_t * timeoutMsP)
 {
     time_t tv_sec;
+    int64_t currentTime;
+    time_t timeout;
+    time_t * timeoutP;
     int result;
 
-    LOG_ARG("timeoutP: %" PRId64, *timeoutP);
+    LOG_ARG("timeoutMsP: %" PRId64, *timeoutMsP);
     tv_sec = lwm2m_gettime();
     if (tv_sec < 0) return COAP_500_INTERNAL_SERVER_ERROR;
+    currentTime = utils_getTimeMs();
+    if (currentTime < 0) return COAP_500_INTERNAL_SERVER_ERROR;
+
+    // registrations and observations are handled with a one second resolution
+    timeout = (time_t)((*timeoutMsP + 999) / 1000);
+    timeoutP = &timeout;
 
 #ifdef LWM2M_CLIENT_MODE
     LOG_ARG("State: %s", STR_STATE(contextP->state));
@@ -469,13 +537,17 @@ next_step:
         break;
     }
 
-    observe_step(contextP, tv_sec, timeoutP);
 #endif
 
     registration_step(contextP, tv_sec, timeoutP);
-    transaction_step(contextP, tv_sec, timeoutP);
 
-    LOG_ARG("Final timeoutP: %" PRId64, *timeoutP);
+    if ((int64_t)timeout * 1000 < *timeoutMsP)
+    {
+        *timeoutMsP = (int64_t)timeout * 1000;
+    }
+    timer_step(contextP, currentTime, timeoutMsP);
+
+    LOG_ARG("Final timeoutMsP: %" PRId64, *timeoutMsP);
 #ifdef LWM2M_CLIENT_MODE
     LOG_ARG("Final state: %s", STR_STATE(contextP->state));
 #endif
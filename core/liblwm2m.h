@@ -104,6 +104,11 @@ int lwm2m_strncmp(const char * s1, const char * s2, size_t n);
 // In case of error, this must return a negative value.
 // Per POSIX specifications, time_t is a signed integer.
 time_t lwm2m_gettime(void);
+#ifdef LWM2M_WITH_MS_CLOCK
+// Same as lwm2m_gettime() with a millisecond resolution. Its origin may differ from lwm2m_gettime() one.
+// It is used for CoAP retransmissions. When LWM2M_WITH_MS_CLOCK is not defined, lwm2m_gettime() is used instead.
+int64_t lwm2m_gettime_ms(void);
+#endif
 
 #ifdef LWM2M_WITH_LOGS
 // Same usage as C89 printf()
@@ -198,6 +203,7 @@ bool lwm2m_session_is_equal(void * session1, void * session2, void * userData);
 #define LWM2M_SERVER_STORING_ID     6
 #define LWM2M_SERVER_BINDING_ID     7
 #define LWM2M_SERVER_UPDATE_ID      8
+#define LWM2M_SERVER_NOTIF_MODE_ID  26
 
 #define LWM2M_SECURITY_MODE_PRE_SHARED_KEY  0
 #define LWM2M_SECURITY_MODE_RAW_PUBLIC_KEY  1
@@ -233,6 +239,81 @@ void lwm2m_list_free(lwm2m_list_t * head);
 #define LWM2M_LIST_FIND(H,I) lwm2m_list_find((lwm2m_list_t *)H, I)
 #define LWM2M_LIST_FREE(H) lwm2m_list_free((lwm2m_list_t *)H)
 
+/*
+ * Sorted array of the nodes of a list, giving lookups, insertions and new IDs in O(log n)
+ * for big lists (e.g. thousands of instances of an object). The nodes stay linked so the
+ * list can still be walked. Once a node was added through an index, the list must only be
+ * changed with the lwm2m_list_index_*() functions. An index left zeroed, or dropped after
+ * a memory error, makes these functions work on the list alone.
+ */
+
+typedef struct
+{
+    lwm2m_list_t ** nodes;  // sorted by ID, NULL when the list is not indexed
+    size_t          count;
+    size_t          size;
+} lwm2m_list_index_t;
+
+// defined in list.c
+// Add 'node' to the list 'head' and its index and return the new list
+lwm2m_list_t * lwm2m_list_index_add(lwm2m_list_index_t * indexP, lwm2m_list_t * head, lwm2m_list_t * node);
+// Return the node with ID 'id' from the list 'head' or NULL if not found
+lwm2m_list_t * lwm2m_list_index_find(lwm2m_list_index_t * indexP, lwm2m_list_t * head, uint16_t id);
+// Remove the node with ID 'id' from the list 'head' and its index and return the new list
+lwm2m_list_t * lwm2m_list_index_remove(lwm2m_list_index_t * indexP, lwm2m_list_t * head, uint16_t id, lwm2m_list_t ** nodeP);
+// Return the lowest unused ID in the list 'head'
+uint16_t lwm2m_list_index_newId(lwm2m_list_index_t * indexP, lwm2m_list_t * head);
+// Free the index only, the nodes are left untouched.
+void lwm2m_list_index_free(lwm2m_list_index_t * indexP);
+
+#define LWM2M_INDEX_ADD(X,H,N) lwm2m_list_index_add(X, (lwm2m_list_t *)H, (lwm2m_list_t *)N);
+#define LWM2M_INDEX_RM(X,H,I,N) lwm2m_list_index_remove(X, (lwm2m_list_t *)H, I, (lwm2m_list_t **)N);
+#define LWM2M_INDEX_FIND(X,H,I) lwm2m_list_index_find(X, (lwm2m_list_t *)H, I)
+
+/*
+ * Hash index referencing list nodes, used internally to avoid linear lookups
+ */
+
+typedef struct _lwm2m_hash_node_t
+{
+    struct _lwm2m_hash_node_t * next;
+    uint32_t                    key;
+    void *                      itemP;
+} lwm2m_hash_node_t;
+
+typedef struct
+{
+    lwm2m_hash_node_t ** buckets;
+    size_t               bucketCount;   // zero or a power of two
+    size_t               count;
+} lwm2m_hash_t;
+
+/*
+ * Bump allocator backing the lwm2m_data_t trees built while handling a message,
+ * used internally. It is reset in one shot once the message is handled.
+ */
+
+typedef struct _lwm2m_arena_block_t
+{
+    struct _lwm2m_arena_block_t * next;
+    size_t                        size;   // usable bytes after the header
+    size_t                        used;
+} lwm2m_arena_block_t;
+
+typedef struct _lwm2m_arena_view_t
+{
+    struct _lwm2m_arena_view_t * next;
+    uint8_t *                    buffer;   // memory of the caller the arena data points into
+    size_t                       length;
+} lwm2m_arena_view_t;
+
+typedef struct
+{
+    lwm2m_arena_block_t * blockList;   // block being filled first
+    lwm2m_arena_view_t *  viewList;    // borrowed buffers, allocated in the blocks
+    int                   depth;       // nesting of arena_enter() calls
+} lwm2m_arena_t;
+
 /*
  * URI
  *
@@ -381,6 +462,15 @@ int lwm2m_decode_TLV(const uint8_t * buffer, size_t buffer_len, lwm2m_data_type_
  * For the read callback, if *numDataP is not zero, *dataArrayP is pre-allocated
  * and contains the list of resources to read.
  *
+ * The optional block write callback receives the opaque payload of a write to a resource
+ * sent in several blocks, one block at a time, instead of the write callback receiving
+ * the whole payload. offset is the position of buffer in the payload and more is false
+ * for the last block. It returns COAP_204_CHANGED for each accepted block; any other
+ * code aborts the transfer.
+ * The block writable callback tells which resources take their blocks this way. It is
+ * called once, on the first block of a transfer. Writes to other resources are reassembled
+ * and handed to the write callback as usual.
+ *
  */
 
 typedef struct _lwm2m_object_t lwm2m_object_t;
@@ -391,18 +481,23 @@ typedef uint8_t (*lwm2m_write_callback_t) (uint16_t instanceId, int numData, lwm
 typedef uint8_t (*lwm2m_execute_callback_t) (uint16_t instanceId, uint16_t resourceId, uint8_t * buffer, int length, lwm2m_object_t * objectP);
 typedef uint8_t (*lwm2m_create_callback_t) (uint16_t instanceId, int numData, lwm2m_data_t * dataArray, lwm2m_object_t * objectP);
 typedef uint8_t (*lwm2m_delete_callback_t) (uint16_t instanceId, lwm2m_object_t * objectP);
+typedef uint8_t (*lwm2m_block_write_callback_t) (uint16_t instanceId, uint16_t resourceId, size_t offset, uint8_t * buffer, size_t length, bool more, lwm2m_object_t * objectP);
+typedef bool (*lwm2m_block_writable_callback_t) (uint16_t instanceId, uint16_t resourceId, lwm2m_object_t * objectP);
 
 struct _lwm2m_object_t
 {
     struct _lwm2m_object_t * next;           // for internal use only.
     uint16_t       objID;
     lwm2m_list_t * instanceList;
+    lwm2m_list_index_t instanceIndex;       // optional, see lwm2m_list_index_add()
     lwm2m_read_callback_t     readFunc;
     lwm2m_write_callback_t    writeFunc;
     lwm2m_execute_callback_t  executeFunc;
     lwm2m_create_callback_t   createFunc;
     lwm2m_delete_callback_t   deleteFunc;
     lwm2m_discover_callback_t discoverFunc;
+    lwm2m_block_write_callback_t blockWriteFunc;
+    lwm2m_block_writable_callback_t blockWritableFunc;
     void * userData;
 };
 
@@ -447,15 +542,20 @@ typedef enum
  * LWM2M block1 data
  *
  * Temporary data needed to handle block1 request.
- * Currently support only one block1 request by server.
+ * A server can run several block1 transfers at once, one per URI path.
  */
 typedef struct _lwm2m_block1_data_ lwm2m_block1_data_t;
 
 struct _lwm2m_block1_data_
 {
-    uint8_t *             block1buffer;     // data buffer
-    size_t                block1bufferSize; // buffer size
-    uint16_t              lastmid;          // mid of the last message received
+    lwm2m_block1_data_t * next;
+    char *                uri;                // URI path of the request, identifies the transfer
+    uint8_t *             block1buffer;       // data buffer
+    size_t                block1bufferSize;   // allocated size of block1buffer
+    size_t                block1bufferLength; // length of the data received so far
+    uint16_t              lastmid;            // mid of the last message received
+    bool                  complete;           // the last block was received
+    bool                  streamed;           // the blocks are handed to the object, block1buffer is not used
 };
 
 typedef struct _lwm2m_server_
@@ -470,7 +570,8 @@ typedef struct _lwm2m_server_
     lwm2m_status_t          status;
     char *                  location;
     bool                    dirty;
-    lwm2m_block1_data_t *   block1Data;   // buffer to handle block1 data, should be replace by a list to support several block1 transfer by server.
+    lwm2m_block1_data_t *   block1Data;   // ongoing block1 transfers
+    bool                    confirmableNotify; // notifications are sent as CON messages
 } lwm2m_server_t;
 
 
@@ -479,7 +580,7 @@ typedef struct _lwm2m_server_
  *
  * When used with an observe, if 'data' is not nil, 'status' holds the observe counter.
  */
-typedef void (*lwm2m_result_callback_t) (uint16_t clientID, lwm2m_uri_t * uriP, int status, lwm2m_media_type_t format, uint8_t * data, int dataLength, void * userData);
+typedef void (*lwm2m_result_callback_t) (uint32_t clientID, lwm2m_uri_t * uriP, int status, lwm2m_media_type_t format, uint8_t * data, int dataLength, void * userData);
 
 /*
  * LWM2M Observations
@@ -500,6 +601,7 @@ typedef struct _lwm2m_observation_
     lwm2m_status_t          status;     // latest user operation
     lwm2m_result_callback_t callback;
     void *                  userData;
+    lwm2m_media_type_t      format;     // used to decode notifications without Content-Format
 } lwm2m_observation_t;
 
 /*
@@ -526,6 +628,57 @@ typedef struct
     double      step;
 } lwm2m_attributes_t;
 
+/*
+ * Deadlines handled by lwm2m_step()
+ *
+ * Timers are embedded in the structure they belong to and are kept in a min-heap
+ * in the context.
+ */
+
+typedef enum
+{
+    LWM2M_TIMER_TRANSACTION = 0,      // ownerP is a lwm2m_transaction_t
+    LWM2M_TIMER_CLIENT_LIFETIME,      // ownerP is a lwm2m_client_t
+    LWM2M_TIMER_BLOCK2,               // ownerP is a lwm2m_block2_data_t
+    LWM2M_TIMER_WATCHER               // ownerP is a lwm2m_watcher_t
+} lwm2m_timer_type_t;
+
+typedef struct
+{
+    int64_t            deadline;   // in milliseconds
+    size_t             position;   // 1-based index in the timer heap, 0 when not scheduled
+    lwm2m_timer_type_t type;
+    void *             ownerP;
+} lwm2m_timer_t;
+
+typedef struct
+{
+    lwm2m_timer_t ** entries;
+    size_t           count;
+    size_t           size;
+} lwm2m_timer_heap_t;
+
+/*
+ * Responses sent in several blocks
+ *
+ * A representation bigger than the block size, answered or notified, is kept with an ETag,
+ * per peer and URI, so that its next blocks are sliced from it instead of reading the
+ * resource again.
+ */
+
+typedef struct _lwm2m_block2_data_
+{
+    struct _lwm2m_block2_data_ * next;
+    lwm2m_timer_t   timer;          // expiry
+    void *          sessionH;       // peer the representation was sent to
+    char *          uri;            // URI path of the request
+    uint16_t        format;         // content format of buffer
+    uint8_t         etag[4];
+    uint8_t *       buffer;
+    size_t          length;
+    bool            complete;       // the last block was sent
+} lwm2m_block2_data_t;
+
 /*
  * LWM2M Clients
  *
@@ -543,8 +696,9 @@ typedef struct _lwm2m_client_object_
 
 typedef struct _lwm2m_client_
 {
-    struct _lwm2m_client_ * next;       // matches lwm2m_list_t::next
-    uint16_t                internalID; // matches lwm2m_list_t::id
+    struct _lwm2m_client_ * next;
+    struct _lwm2m_client_ * prev;
+    uint32_t                internalID;
     char *                  name;
     lwm2m_binding_t         binding;
     char *                  msisdn;
@@ -552,10 +706,12 @@ typedef struct _lwm2m_client_
     bool                    supportJSON;
     uint32_t                lifetime;
     time_t                  endOfLife;
+    lwm2m_timer_t           lifetimeTimer;  // expiry of the registration
     void *                  sessionH;
     lwm2m_client_object_t * objectList;
     lwm2m_observation_t *   observationList;
     uint16_t                observationId;
+    uint16_t                blockSize;      // block size accepted by the client for requests, 0 until known
 } lwm2m_client_t;
 
 
@@ -577,12 +733,28 @@ struct _lwm2m_transaction_
     uint8_t               ack_received; // indicates, that the ACK was received
     time_t                response_timeout; // timeout to wait for response, if token is used. When 0, use calculated acknowledge timeout.
     uint8_t  retrans_counter;
-    time_t   retrans_time;
+    int64_t  retrans_time;  // in milliseconds
+    uint32_t ack_timeout;   // randomized initial acknowledge timeout in milliseconds
     void * message;
     uint16_t buffer_len;
     uint8_t * buffer;
     lwm2m_transaction_callback_t callback;
     void * userData;
+    lwm2m_timer_t timer;   // retransmission deadline, mirrors retrans_time
+    uint8_t * block2Buffer; // response payload received so far when it comes in several blocks
+    size_t    block2Length;
+    size_t    block2Size;
+    bool      block2Observe; // the first block was an answer to an observe request
+    uint8_t   block2ETag[8]; // ETag of the first block, the next ones must carry the same
+    uint8_t   block2ETagLen;
+    uint8_t * block1Buffer; // request payload sent in several blocks, owned by the transaction
+    size_t    block1Length;
+    size_t    block1Offset; // offset of the block being sent
+    uint16_t  block1Size;   // lowered when the peer asks for smaller blocks
+#ifdef LWM2M_SERVER_MODE
+    bool      toClient;     // the request targets the registered client clientID
+    uint32_t  clientID;     // internalID of the client, its block size follows block1Size
+#endif
 };
 
 /*
@@ -595,6 +767,8 @@ typedef struct _lwm2m_watcher_
     bool active;
     bool update;
     lwm2m_server_t * server;
+    struct _lwm2m_observed_ * observed;
+    lwm2m_timer_t timer;    // next time the watcher must be looked at
     lwm2m_attributes_t * parameters;
     lwm2m_media_type_t format;
     uint8_t token[8];
@@ -607,6 +781,9 @@ typedef struct _lwm2m_watcher_
         int64_t asInteger;
         double  asFloat;
     } lastValue;
+    lwm2m_transaction_t * transaction; // confirmable notification waiting for its ACK
+    uint32_t ackLatency;    // smoothed ACK latency of the confirmable notifications in ms
+    int64_t holdUntil;      // no notification is sent before this time in ms
 } lwm2m_watcher_t;
 
 typedef struct _lwm2m_observed_
@@ -655,10 +832,20 @@ typedef struct
     lwm2m_server_t *     bootstrapServerList;
     lwm2m_server_t *     serverList;
     lwm2m_object_t *     objectList;
+    lwm2m_list_index_t   objectIndex;           // objectList by objID
     lwm2m_observed_t *   observedList;
+    lwm2m_hash_t         observedIndex;         // observedList by URI
+    uint8_t *            registerPayload;       // cached link format of objectList, built on first use
+    size_t               registerPayloadLength;
+    size_t               registerPayloadSize;
+    size_t               block1MaxSize;         // maximum payload reassembled from a block1 transfer
 #endif
 #ifdef LWM2M_SERVER_MODE
-    lwm2m_client_t *        clientList;
+    lwm2m_client_t *        clientList;         // registered clients, newest first, not sorted by internalID
+    lwm2m_hash_t            clientNameIndex;    // registered clients by endpoint name
+    lwm2m_hash_t            clientIdIndex;      // registered clients by internalID
+    lwm2m_hash_t            observationIndex;   // observations of all clients by token
+    uint32_t                nextClientID;
     lwm2m_result_callback_t monitorCallback;
     void *                  monitorUserData;
 #endif
@@ -668,6 +855,15 @@ typedef struct
 #endif
     uint16_t                nextMID;
     lwm2m_transaction_t *   transactionList;
+    lwm2m_hash_t            transactionMidIndex;    // pending transactions by message ID
+    lwm2m_hash_t            transactionTokenIndex;  // pending transactions by token
+    lwm2m_timer_heap_t      timerHeap;
+    uint8_t *               sendBuffer;             // scratch buffer reused to serialize outgoing messages
+    size_t                  sendBufferSize;
+    lwm2m_arena_t           dataArena;              // backs lwm2m_data_t trees built while handling a message
+    lwm2m_block2_data_t *   block2List;             // representations being sent block by block
+    uint32_t                nextETag;
+    uint16_t                blockSize;              // largest block sent or requested, see lwm2m_set_block_size()
     void *                  userData;
 } lwm2m_context_t;
 
@@ -679,8 +875,13 @@ void lwm2m_close(lwm2m_context_t * contextP);
 
 // perform any required pending operation and adjust timeoutP to the maximal time interval to wait in seconds.
 int lwm2m_step(lwm2m_context_t * contextP, time_t * timeoutP);
+// same as lwm2m_step() with a timeout in milliseconds.
+int lwm2m_step_ms(lwm2m_context_t * contextP, int64_t * timeoutMsP);
 // dispatch received data to liblwm2m
 void lwm2m_handle_packet(lwm2m_context_t * contextP, uint8_t * buffer, int length, void * fromSessionH);
+// set the largest block size used in blockwise transfers, a power of two from 16 to 1024 (default is REST_MAX_CHUNK_SIZE).
+// Peers asking for smaller blocks get smaller blocks.
+int lwm2m_set_block_size(lwm2m_context_t * contextP, uint16_t size);
 
 #ifdef LWM2M_CLIENT_MODE
 // configure the client side with the Endpoint Name, binding, MSISDN (can be nil), alternative path
@@ -694,9 +895,16 @@ int lwm2m_remove_object(lwm2m_context_t * contextP, uint16_t id);
 // send a registration update to the server specified by the server short identifier
 // or all if the ID is 0.
 // If withObjects is true, the registration update contains the object list.
+// The object list is cached: an application adding or removing instances directly in an
+// object's instanceList must call this function with withObjects set to true, otherwise
+// registration updates keep advertising the old list until the next full registration.
 int lwm2m_update_registration(lwm2m_context_t * contextP, uint16_t shortServerID, bool withObjects);
 
 void lwm2m_resource_value_changed(lwm2m_context_t * contextP, lwm2m_uri_t * uriP);
+
+// set the maximum size of a payload received in several blocks (default is LWM2M_BLOCK1_MAX_SIZE).
+// Bigger transfers are rejected with a 4.13 Request Entity Too Large.
+void lwm2m_set_block1_max_size(lwm2m_context_t * contextP, size_t maxSize);
 #endif
 
 #ifdef LWM2M_SERVER_MODE
@@ -707,19 +915,21 @@ void lwm2m_resource_value_changed(lwm2m_context_t * contextP, lwm2m_uri_t * uriP
 // The callback's parameters uri, data, dataLength are always NULL.
 // The lwm2m_client_t is present in the lwm2m_context_t's clientList when the callback is called. On a deregistration, it deleted when the callback returns.
 void lwm2m_set_monitoring_callback(lwm2m_context_t * contextP, lwm2m_result_callback_t callback, void * userData);
+// Returns the registered client with this internal ID or NULL. The clientList is not sorted by ID.
+lwm2m_client_t * lwm2m_get_client(lwm2m_context_t * contextP, uint32_t clientID);
 
 // Device Management APIs
-int lwm2m_dm_read(lwm2m_context_t * contextP, uint16_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
-int lwm2m_dm_discover(lwm2m_context_t * contextP, uint16_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
-int lwm2m_dm_write(lwm2m_context_t * contextP, uint16_t clientID, lwm2m_uri_t * uriP, lwm2m_media_type_t format, uint8_t * buffer, int length, lwm2m_result_callback_t callback, void * userData);
-int lwm2m_dm_write_attributes(lwm2m_context_t * contextP, uint16_t clientID, lwm2m_uri_t * uriP, lwm2m_attributes_t * attrP, lwm2m_result_callback_t callback, void * userData);
-int lwm2m_dm_execute(lwm2m_context_t * contextP, uint16_t clientID, lwm2m_uri_t * uriP, lwm2m_media_type_t format, uint8_t * buffer, int length, lwm2m_result_callback_t callback, void * userData);
-int lwm2m_dm_create(lwm2m_context_t * contextP, uint16_t clientID, lwm2m_uri_t * uriP, lwm2m_media_type_t format, uint8_t * buffer, int length, lwm2m_result_callback_t callback, void * userData);
-int lwm2m_dm_delete(lwm2m_context_t * contextP, uint16_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
+int lwm2m_dm_read(lwm2m_context_t * contextP, uint32_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
+int lwm2m_dm_discover(lwm2m_context_t * contextP, uint32_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
+int lwm2m_dm_write(lwm2m_context_t * contextP, uint32_t clientID, lwm2m_uri_t * uriP, lwm2m_media_type_t format, uint8_t * buffer, int length, lwm2m_result_callback_t callback, void * userData);
+int lwm2m_dm_write_attributes(lwm2m_context_t * contextP, uint32_t clientID, lwm2m_uri_t * uriP, lwm2m_attributes_t * attrP, lwm2m_result_callback_t callback, void * userData);
+int lwm2m_dm_execute(lwm2m_context_t * contextP, uint32_t clientID, lwm2m_uri_t * uriP, lwm2m_media_type_t format, uint8_t * buffer, int length, lwm2m_result_callback_t callback, void * userData);
+int lwm2m_dm_create(lwm2m_context_t * contextP, uint32_t clientID, lwm2m_uri_t * uriP, lwm2m_media_type_t format, uint8_t * buffer, int length, lwm2m_result_callback_t callback, void * userData);
+int lwm2m_dm_delete(lwm2m_context_t * contextP, uint32_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
 
 // Information Reporting APIs
-int lwm2m_observe(lwm2m_context_t * contextP, uint16_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
-int lwm2m_observe_cancel(lwm2m_context_t * contextP, uint16_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
+int lwm2m_observe(lwm2m_context_t * contextP, uint32_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
+int lwm2m_observe_cancel(lwm2m_context_t * contextP, uint32_t clientID, lwm2m_uri_t * uriP, lwm2m_result_callback_t callback, void * userData);
 #endif
 
 #ifdef LWM2M_BOOTSTRAP_SERVER_MODE
@@ -123,3 +123,141 @@ void lwm2m_list_free(lwm2m_list_t * head)
         lwm2m_list_free(nextP);
     }
 }
+
+#define LIST_INDEX_MIN_SIZE 8
+
+// returns the position of the first node with an ID not lower than id
+static size_t prv_indexSearch(lwm2m_list_index_t * indexP,
+                              uint16_t id)
+{
+    size_t low = 0;
+    size_t high = indexP->count;
+
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+
+        if (indexP->nodes[middle]->id < id)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+lwm2m_list_t * lwm2m_list_index_add(lwm2m_list_index_t * indexP,
+                                    lwm2m_list_t * head,
+                                    lwm2m_list_t * node)
+{
+    size_t position;
+
+    // a list built without the index stays so
+    if (indexP->nodes == NULL && head != NULL) return lwm2m_list_add(head, node);
+
+    if (indexP->count == indexP->size)
+    {
+        lwm2m_list_t ** nodes;
+        size_t size;
+
+        size = (indexP->size == 0) ? LIST_INDEX_MIN_SIZE : indexP->size * 2;
+        nodes = (lwm2m_list_t **)lwm2m_malloc(size * sizeof(lwm2m_list_t *));
+        if (nodes == NULL)
+        {
+            lwm2m_list_index_free(indexP);
+            return lwm2m_list_add(head, node);
+        }
+        if (indexP->nodes != NULL)
+        {
+            memcpy(nodes, indexP->nodes, indexP->count * sizeof(lwm2m_list_t *));
+            lwm2m_free(indexP->nodes);
+        }
+        indexP->nodes = nodes;
+        indexP->size = size;
+    }
+
+    position = prv_indexSearch(indexP, node->id);
+    node->next = (position < indexP->count) ? indexP->nodes[position] : NULL;
+    if (position > 0) indexP->nodes[position - 1]->next = node;
+    memmove(indexP->nodes + position + 1, indexP->nodes + position, (indexP->count - position) * sizeof(lwm2m_list_t *));
+    indexP->nodes[position] = node;
+    indexP->count++;
+
+    return indexP->nodes[0];
+}
+
+lwm2m_list_t * lwm2m_list_index_find(lwm2m_list_index_t * indexP,
+                                     lwm2m_list_t * head,
+                                     uint16_t id)
+{
+    size_t position;
+
+    if (indexP->nodes == NULL) return lwm2m_list_find(head, id);
+
+    position = prv_indexSearch(indexP, id);
+    if (position < indexP->count && indexP->nodes[position]->id == id) return indexP->nodes[position];
+
+    return NULL;
+}
+
+lwm2m_list_t * lwm2m_list_index_remove(lwm2m_list_index_t * indexP,
+                                       lwm2m_list_t * head,
+                                       uint16_t id,
+                                       lwm2m_list_t ** nodeP)
+{
+    size_t position;
+
+    if (indexP->nodes == NULL) return lwm2m_list_remove(head, id, nodeP);
+
+    position = prv_indexSearch(indexP, id);
+    if (position < indexP->count && indexP->nodes[position]->id == id)
+    {
+        if (nodeP) *nodeP = indexP->nodes[position];
+        if (position > 0) indexP->nodes[position - 1]->next = indexP->nodes[position]->next;
+        indexP->count--;
+        memmove(indexP->nodes + position, indexP->nodes + position + 1, (indexP->count - position) * sizeof(lwm2m_list_t *));
+    }
+    else
+    {
+        if (nodeP) *nodeP = NULL;
+    }
+
+    return (indexP->count > 0) ? indexP->nodes[0] : NULL;
+}
+
+uint16_t lwm2m_list_index_newId(lwm2m_list_index_t * indexP,
+                                lwm2m_list_t * head)
+{
+    size_t low = 0;
+    size_t high;
+
+    if (indexP->nodes == NULL) return lwm2m_list_newId(head);
+
+    // IDs are unique and sorted so the node at position i has an ID of i until the first gap
+    high = indexP->count;
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+
+        if (indexP->nodes[middle]->id == middle)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return (uint16_t)low;
+}
+
+void lwm2m_list_index_free(lwm2m_list_index_t * indexP)
+{
+    if (indexP->nodes != NULL) lwm2m_free(indexP->nodes);
+    memset(indexP, 0, sizeof(lwm2m_list_index_t));
+}
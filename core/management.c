@@ -159,11 +159,79 @@ static int prv_readAttributes(multi_option_t * query,
     return 0;
 }
 
+// Hands the blocks of an opaque write over to the object as they arrive.
+// Returns NO_ERROR when the request is not for a block write callback.
+uint8_t dm_handleBlockWrite(lwm2m_context_t * contextP,
+                            lwm2m_server_t * serverP,
+                            const char * uri,
+                            coap_packet_t * message)
+{
+    lwm2m_uri_t * uriP;
+    uint32_t blockNum;
+    uint8_t blockMore;
+    uint16_t blockSize;
+    size_t offset = 0;
+    uint8_t result;
+
+    if (message->code != COAP_PUT
+     || !IS_OPTION(message, COAP_OPTION_CONTENT_TYPE)
+     || utils_convertMediaType(message->content_type) != LWM2M_CONTENT_OPAQUE)
+    {
+        return NO_ERROR;
+    }
+
+    uriP = uri_decode(contextP->altPath, message->uri_path);
+    if (uriP == NULL) return NO_ERROR;
+
+    // the object tells on the first block whether it takes the transfer, later blocks follow that
+    coap_get_header_block1(message, &blockNum, &blockMore, &blockSize, NULL);
+    if ((uriP->flag & LWM2M_URI_MASK_TYPE) != LWM2M_URI_FLAG_DM
+     || uriP->objectId == LWM2M_SECURITY_OBJECT_ID
+     || (blockNum == 0 && !object_isBlockWritable(contextP, uriP))
+     || (blockNum != 0 && !coap_block1_isStreamed(serverP->block1Data, uri)))
+    {
+        lwm2m_free(uriP);
+        return NO_ERROR;
+    }
+
+    if (serverP->status != STATE_REGISTERED
+        && serverP->status != STATE_REG_UPDATE_NEEDED
+        && serverP->status != STATE_REG_FULL_UPDATE_NEEDED
+        && serverP->status != STATE_REG_UPDATE_PENDING)
+    {
+        lwm2m_free(uriP);
+        return COAP_IGNORE;
+    }
+
+    result = coap_block1_stream(&serverP->block1Data, uri, message->mid, blockSize, blockNum, message->payload_len, blockMore, &offset);
+    if (result == NO_ERROR)
+    {
+        result = object_writeBlock(contextP, uriP, offset, message->payload, message->payload_len, blockMore);
+        if (result != COAP_204_CHANGED)
+        {
+            coap_block1_remove(&serverP->block1Data, uri);
+        }
+    }
+    else if (result == COAP_IGNORE)
+    {
+        // retransmission of a block already accepted
+        result = COAP_204_CHANGED;
+    }
+    if (result == COAP_204_CHANGED && blockMore)
+    {
+        result = COAP_231_CONTINUE;
+    }
+
+    lwm2m_free(uriP);
+    return result;
+}
+
 uint8_t dm_handleRequest(lwm2m_context_t * contextP,
                          lwm2m_uri_t * uriP,
                          lwm2m_server_t * serverP,
                          coap_packet_t * message,
-                         coap_packet_t * response)
+                         coap_packet_t * response,
+                         dm_read_t * readP)
 {
     uint8_t result;
     lwm2m_media_type_t format;
@@ -234,7 +302,7 @@ uint8_t dm_handleRequest(lwm2m_context_t * contextP,
                             LOG_ARG("Observe Request[/%d/%d/%d]: %.*s\n", uriP->objectId, uriP->instanceId, uriP->resourceId, length, buffer);
                         }
                     }
-                    lwm2m_data_free(size, dataP);
+                    data_free(&contextP->dataArena, size, dataP);
                 }
             }
             else if (IS_OPTION(message, COAP_OPTION_ACCEPT)
@@ -246,12 +314,40 @@ uint8_t dm_handleRequest(lwm2m_context_t * contextP,
             }
             else
             {
+                lwm2m_data_t * dataP = NULL;
+                int size = 0;
+
                 if (IS_OPTION(message, COAP_OPTION_ACCEPT))
                 {
                     format = utils_convertMediaType(message->accept[0]);
                 }
 
-                result = object_read(contextP, uriP, &format, &buffer, &length);
+                result = object_readData(contextP, uriP, &size, &dataP);
+                if (COAP_205_CONTENT == result
+                 && data_isChunked(uriP, size, dataP, &format))
+                {
+                    // lwm2m_handle_packet() serializes it straight into the send buffer
+                    readP->dataP = dataP;
+                    readP->size = size;
+                    memcpy(&readP->uri, uriP, sizeof(lwm2m_uri_t));
+                    readP->format = format;
+                }
+                else
+                {
+                    if (COAP_205_CONTENT == result)
+                    {
+                        res = lwm2m_data_serialize(uriP, size, dataP, &format, &buffer);
+                        if (res < 0)
+                        {
+                            result = COAP_500_INTERNAL_SERVER_ERROR;
+                        }
+                        else
+                        {
+                            length = (size_t)res;
+                        }
+                    }
+                    data_free(&contextP->dataArena, size, dataP);
+                }
             }
             if (COAP_205_CONTENT == result)
             {
@@ -289,7 +385,7 @@ uint8_t dm_handleRequest(lwm2m_context_t * contextP,
                     }
                     coap_set_header_location_path(response, location_path);
 
-                    lwm2m_update_registration(contextP, 0, true);
+                    registration_update(contextP, 0, true);
                 }
             }
             else if (!LWM2M_URI_IS_SET_RESOURCE(uriP))
@@ -340,7 +436,7 @@ uint8_t dm_handleRequest(lwm2m_context_t * contextP,
                 result = object_delete(contextP, uriP);
                 if (result == COAP_202_DELETED)
                 {
-                    lwm2m_update_registration(contextP, 0, true);
+                    registration_update(contextP, 0, true);
                 }
             }
         }
@@ -418,7 +514,7 @@ static void prv_resultCallback(lwm2m_transaction_t * transacP,
 }
 
 static int prv_makeOperation(lwm2m_context_t * contextP,
-                             uint16_t clientID,
+                             uint32_t clientID,
                              lwm2m_uri_t * uriP,
                              coap_method_t method,
                              lwm2m_media_type_t format,
@@ -431,11 +527,13 @@ static int prv_makeOperation(lwm2m_context_t * contextP,
     lwm2m_transaction_t * transaction;
     dm_data_t * dataP;
 
-    clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)contextP->clientList, clientID);
+    clientP = registration_findClient(contextP, clientID);
     if (clientP == NULL) return COAP_404_NOT_FOUND;
 
     transaction = transaction_new(clientP->sessionH, method, clientP->altPath, uriP, contextP->nextMID++, 4, NULL);
     if (transaction == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
+    transaction->toClient = true;
+    transaction->clientID = clientP->internalID;
 
     if (method == COAP_GET)
     {
@@ -444,8 +542,12 @@ static int prv_makeOperation(lwm2m_context_t * contextP,
     else if (buffer != NULL)
     {
         coap_set_header_content_type(transaction->message, format);
-        // TODO: Take care of fragmentation
-        coap_set_payload(transaction->message, buffer, length);
+        if (!transaction_setPayload(transaction, buffer, length,
+                                    clientP->blockSize != 0 ? clientP->blockSize : contextP->blockSize))
+        {
+            transaction_free(transaction);
+            return COAP_500_INTERNAL_SERVER_ERROR;
+        }
     }
 
     if (callback != NULL)
@@ -471,7 +573,7 @@ static int prv_makeOperation(lwm2m_context_t * contextP,
 }
 
 int lwm2m_dm_read(lwm2m_context_t * contextP,
-                  uint16_t clientID,
+                  uint32_t clientID,
                   lwm2m_uri_t * uriP,
                   lwm2m_result_callback_t callback,
                   void * userData)
@@ -479,10 +581,10 @@ int lwm2m_dm_read(lwm2m_context_t * contextP,
     lwm2m_client_t * clientP;
     lwm2m_media_type_t format;
 
-    LOG_ARG("clientID: %d", clientID);
+    LOG_ARG("clientID: %u", clientID);
     LOG_URI(uriP);
 
-    clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)contextP->clientList, clientID);
+    clientP = registration_findClient(contextP, clientID);
     if (clientP == NULL) return COAP_404_NOT_FOUND;
 
     if (clientP->supportJSON == true)
@@ -502,7 +604,7 @@ int lwm2m_dm_read(lwm2m_context_t * contextP,
 }
 
 int lwm2m_dm_write(lwm2m_context_t * contextP,
-                   uint16_t clientID,
+                   uint32_t clientID,
                    lwm2m_uri_t * uriP,
                    lwm2m_media_type_t format,
                    uint8_t * buffer,
@@ -510,7 +612,7 @@ int lwm2m_dm_write(lwm2m_context_t * contextP,
                    lwm2m_result_callback_t callback,
                    void * userData)
 {
-    LOG_ARG("clientID: %d, format: %s, length: %d", clientID, STR_MEDIA_TYPE(format), length);
+    LOG_ARG("clientID: %u, format: %s, length: %d", clientID, STR_MEDIA_TYPE(format), length);
     LOG_URI(uriP);
     if (!LWM2M_URI_IS_SET_INSTANCE(uriP)
      || length == 0)
@@ -535,7 +637,7 @@ int lwm2m_dm_write(lwm2m_context_t * contextP,
 }
 
 int lwm2m_dm_execute(lwm2m_context_t * contextP,
-                     uint16_t clientID,
+                     uint32_t clientID,
                      lwm2m_uri_t * uriP,
                      lwm2m_media_type_t format,
                      uint8_t * buffer,
@@ -543,7 +645,7 @@ int lwm2m_dm_execute(lwm2m_context_t * contextP,
                      lwm2m_result_callback_t callback,
                      void * userData)
 {
-    LOG_ARG("clientID: %d, format: %s, length: %d", clientID, STR_MEDIA_TYPE(format), length);
+    LOG_ARG("clientID: %u, format: %s, length: %d", clientID, STR_MEDIA_TYPE(format), length);
     LOG_URI(uriP);
     if (!LWM2M_URI_IS_SET_RESOURCE(uriP))
     {
@@ -557,7 +659,7 @@ int lwm2m_dm_execute(lwm2m_context_t * contextP,
 }
 
 int lwm2m_dm_create(lwm2m_context_t * contextP,
-                    uint16_t clientID,
+                    uint32_t clientID,
                     lwm2m_uri_t * uriP,
                     lwm2m_media_type_t format,
                     uint8_t * buffer,
@@ -565,7 +667,7 @@ int lwm2m_dm_create(lwm2m_context_t * contextP,
                     lwm2m_result_callback_t callback,
                     void * userData)
 {
-    LOG_ARG("clientID: %d, format: %s, length: %d", clientID, STR_MEDIA_TYPE(format), length);
+    LOG_ARG("clientID: %u, format: %s, length: %d", clientID, STR_MEDIA_TYPE(format), length);
     LOG_URI(uriP);
 
     if (LWM2M_URI_IS_SET_INSTANCE(uriP)
@@ -581,12 +683,12 @@ int lwm2m_dm_create(lwm2m_context_t * contextP,
 }
 
 int lwm2m_dm_delete(lwm2m_context_t * contextP,
-                    uint16_t clientID,
+                    uint32_t clientID,
                     lwm2m_uri_t * uriP,
                     lwm2m_result_callback_t callback,
                     void * userData)
 {
-    LOG_ARG("clientID: %d", clientID);
+    LOG_ARG("clientID: %u", clientID);
     LOG_URI(uriP);
     if (!LWM2M_URI_IS_SET_INSTANCE(uriP)
      || LWM2M_URI_IS_SET_RESOURCE(uriP))
@@ -601,7 +703,7 @@ int lwm2m_dm_delete(lwm2m_context_t * contextP,
 }
 
 int lwm2m_dm_write_attributes(lwm2m_context_t * contextP,
-                              uint16_t clientID,
+                              uint32_t clientID,
                               lwm2m_uri_t * uriP,
                               lwm2m_attributes_t * attrP,
                               lwm2m_result_callback_t callback,
@@ -614,7 +716,7 @@ int lwm2m_dm_write_attributes(lwm2m_context_t * contextP,
     uint8_t buffer[_PRV_BUFFER_SIZE];
     size_t length;
 
-    LOG_ARG("clientID: %d", clientID);
+    LOG_ARG("clientID: %u", clientID);
     LOG_URI(uriP);
     if (attrP == NULL) return COAP_400_BAD_REQUEST;
 
@@ -623,7 +725,7 @@ int lwm2m_dm_write_attributes(lwm2m_context_t * contextP,
     if (ATTR_FLAG_NUMERIC == (attrP->toSet & ATTR_FLAG_NUMERIC)
      && (attrP->lessThan + 2 * attrP->step >= attrP->greaterThan)) return COAP_400_BAD_REQUEST;
 
-    clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)contextP->clientList, clientID);
+    clientP = registration_findClient(contextP, clientID);
     if (clientP == NULL) return COAP_404_NOT_FOUND;
 
     transaction = transaction_new(clientP->sessionH, COAP_PUT, clientP->altPath, uriP, contextP->nextMID++, 4, NULL);
@@ -742,7 +844,7 @@ int lwm2m_dm_write_attributes(lwm2m_context_t * contextP,
 }
 
 int lwm2m_dm_discover(lwm2m_context_t * contextP,
-                      uint16_t clientID,
+                      uint32_t clientID,
                       lwm2m_uri_t * uriP,
                       lwm2m_result_callback_t callback,
                       void * userData)
@@ -751,9 +853,9 @@ int lwm2m_dm_discover(lwm2m_context_t * contextP,
     lwm2m_transaction_t * transaction;
     dm_data_t * dataP;
 
-    LOG_ARG("clientID: %d", clientID);
+    LOG_ARG("clientID: %u", clientID);
     LOG_URI(uriP);
-    clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)contextP->clientList, clientID);
+    clientP = registration_findClient(contextP, clientID);
     if (clientP == NULL) return COAP_404_NOT_FOUND;
 
     transaction = transaction_new(clientP->sessionH, COAP_GET, clientP->altPath, uriP, contextP->nextMID++, 4, NULL);
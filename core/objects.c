@@ -70,18 +70,18 @@ uint8_t object_checkReadable(lwm2m_context_t * contextP,
     int size;
 
     LOG_URI(uriP);
-    targetP = (lwm2m_object_t *)LWM2M_LIST_FIND(contextP->objectList, uriP->objectId);
+    targetP = (lwm2m_object_t *)LWM2M_INDEX_FIND(&contextP->objectIndex, contextP->objectList, uriP->objectId);
     if (NULL == targetP) return COAP_404_NOT_FOUND;
     if (NULL == targetP->readFunc) return COAP_405_METHOD_NOT_ALLOWED;
 
     if (!LWM2M_URI_IS_SET_INSTANCE(uriP)) return COAP_205_CONTENT;
 
-    if (NULL == LWM2M_LIST_FIND(targetP->instanceList, uriP->instanceId)) return COAP_404_NOT_FOUND;
+    if (NULL == LWM2M_INDEX_FIND(&targetP->instanceIndex, targetP->instanceList, uriP->instanceId)) return COAP_404_NOT_FOUND;
 
     if (!LWM2M_URI_IS_SET_RESOURCE(uriP)) return COAP_205_CONTENT;
 
     size = 1;
-    dataP = lwm2m_data_new(1);
+    dataP = data_new(&contextP->dataArena, 1);
     if (dataP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
 
     dataP->id = uriP->resourceId;
@@ -101,7 +101,7 @@ uint8_t object_checkReadable(lwm2m_context_t * contextP,
             }
         }
     }
-    lwm2m_data_free(1, dataP);
+    data_free(&contextP->dataArena, 1, dataP);
     return result;
 }
 
@@ -114,19 +114,19 @@ uint8_t object_readData(lwm2m_context_t * contextP,
     lwm2m_object_t * targetP;
 
     LOG_URI(uriP);
-    targetP = (lwm2m_object_t *)LWM2M_LIST_FIND(contextP->objectList, uriP->objectId);
+    targetP = (lwm2m_object_t *)LWM2M_INDEX_FIND(&contextP->objectIndex, contextP->objectList, uriP->objectId);
     if (NULL == targetP) return COAP_404_NOT_FOUND;
     if (NULL == targetP->readFunc) return COAP_405_METHOD_NOT_ALLOWED;
 
     if (LWM2M_URI_IS_SET_INSTANCE(uriP))
     {
-        if (NULL == lwm2m_list_find(targetP->instanceList, uriP->instanceId)) return COAP_404_NOT_FOUND;
+        if (NULL == LWM2M_INDEX_FIND(&targetP->instanceIndex, targetP->instanceList, uriP->instanceId)) return COAP_404_NOT_FOUND;
 
         // single instance read
         if (LWM2M_URI_IS_SET_RESOURCE(uriP))
         {
             *sizeP = 1;
-            *dataP = lwm2m_data_new(*sizeP);
+            *dataP = data_new(&contextP->dataArena, *sizeP);
             if (*dataP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
 
             (*dataP)->id = uriP->resourceId;
@@ -154,7 +154,7 @@ uint8_t object_readData(lwm2m_context_t * contextP,
         }
         else
         {
-            *dataP = lwm2m_data_new(*sizeP);
+            *dataP = data_new(&contextP->dataArena, *sizeP);
             if (*dataP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
 
             instanceP = targetP->instanceList;
@@ -200,13 +200,71 @@ uint8_t object_read(lwm2m_context_t * contextP,
             *lengthP = (size_t)res;
         }
     }
-    lwm2m_data_free(size, dataP);
+    data_free(&contextP->dataArena, size, dataP);
 
     LOG_ARG("result: %u.%2u, length: %d", (result & 0xFF) >> 5, (result & 0x1F), *lengthP);
 
     return result;
 }
 
+// the Default Notification Mode is optional, notifications are non-confirmable by default
+static void prv_getNotificationMode(lwm2m_object_t * objectP,
+                                    uint16_t instanceID,
+                                    lwm2m_server_t * targetP)
+{
+    lwm2m_data_t * dataP;
+    int size;
+    int64_t value;
+
+    targetP->confirmableNotify = false;
+
+    size = 1;
+    dataP = lwm2m_data_new(size);
+    if (dataP == NULL) return;
+    dataP[0].id = LWM2M_SERVER_NOTIF_MODE_ID;
+
+    if (objectP->readFunc(instanceID, &size, &dataP, objectP) == COAP_205_CONTENT
+     && 1 == lwm2m_data_decode_int(dataP, &value))
+    {
+        targetP->confirmableNotify = (value == 1);
+    }
+
+    lwm2m_data_free(size, dataP);
+}
+
+// a new Default Notification Mode applies to the next notifications of the server
+static void prv_refreshNotificationMode(lwm2m_context_t * contextP,
+                                        lwm2m_object_t * objectP,
+                                        lwm2m_uri_t * uriP)
+{
+    lwm2m_data_t * dataP;
+    int size;
+    int64_t shortID;
+    lwm2m_server_t * serverP;
+
+    if (LWM2M_URI_IS_SET_RESOURCE(uriP) && uriP->resourceId != LWM2M_SERVER_NOTIF_MODE_ID) return;
+
+    size = 1;
+    dataP = lwm2m_data_new(size);
+    if (dataP == NULL) return;
+    dataP[0].id = LWM2M_SERVER_SHORT_ID_ID;
+
+    if (objectP->readFunc != NULL
+     && objectP->readFunc(uriP->instanceId, &size, &dataP, objectP) == COAP_205_CONTENT
+     && 1 == lwm2m_data_decode_int(dataP, &shortID))
+    {
+        for (serverP = contextP->serverList ; serverP != NULL ; serverP = serverP->next)
+        {
+            if (serverP->shortID == shortID)
+            {
+                prv_getNotificationMode(objectP, uriP->instanceId, serverP);
+            }
+        }
+    }
+
+    lwm2m_data_free(size, dataP);
+}
+
 uint8_t object_write(lwm2m_context_t * contextP,
                      lwm2m_uri_t * uriP,
                      lwm2m_media_type_t format,
@@ -219,7 +277,7 @@ uint8_t object_write(lwm2m_context_t * contextP,
     int size = 0;
 
     LOG_URI(uriP);
-    targetP = (lwm2m_object_t *)LWM2M_LIST_FIND(contextP->objectList, uriP->objectId);
+    targetP = (lwm2m_object_t *)LWM2M_INDEX_FIND(&contextP->objectIndex, contextP->objectList, uriP->objectId);
     if (NULL == targetP)
     {
         result = COAP_404_NOT_FOUND;
@@ -230,7 +288,7 @@ uint8_t object_write(lwm2m_context_t * contextP,
     }
     else
     {
-        size = lwm2m_data_parse(uriP, buffer, length, format, &dataP);
+        size = data_parse(&contextP->dataArena, uriP, buffer, length, format, &dataP);
         if (size == 0)
         {
             result = COAP_406_NOT_ACCEPTABLE;
@@ -239,7 +297,13 @@ uint8_t object_write(lwm2m_context_t * contextP,
     if (result == NO_ERROR)
     {
         result = targetP->writeFunc(uriP->instanceId, size, dataP, targetP);
-        lwm2m_data_free(size, dataP);
+        data_free(&contextP->dataArena, size, dataP);
+    }
+    if (result == COAP_204_CHANGED
+     && uriP->objectId == LWM2M_SERVER_OBJECT_ID
+     && LWM2M_URI_IS_SET_INSTANCE(uriP))
+    {
+        prv_refreshNotificationMode(contextP, targetP, uriP);
     }
 
     LOG_ARG("result: %u.%2u", (result & 0xFF) >> 5, (result & 0x1F));
@@ -255,14 +319,51 @@ uint8_t object_execute(lwm2m_context_t * contextP,
     lwm2m_object_t * targetP;
 
     LOG_URI(uriP);
-    targetP = (lwm2m_object_t *)LWM2M_LIST_FIND(contextP->objectList, uriP->objectId);
+    targetP = (lwm2m_object_t *)LWM2M_INDEX_FIND(&contextP->objectIndex, contextP->objectList, uriP->objectId);
     if (NULL == targetP) return COAP_404_NOT_FOUND;
     if (NULL == targetP->executeFunc) return COAP_405_METHOD_NOT_ALLOWED;
-    if (NULL == lwm2m_list_find(targetP->instanceList, uriP->instanceId)) return COAP_404_NOT_FOUND;
+    if (NULL == LWM2M_INDEX_FIND(&targetP->instanceIndex, targetP->instanceList, uriP->instanceId)) return COAP_404_NOT_FOUND;
 
     return targetP->executeFunc(uriP->instanceId, uriP->resourceId, buffer, length, targetP);
 }
 
+bool object_isBlockWritable(lwm2m_context_t * contextP,
+                            lwm2m_uri_t * uriP)
+{
+    lwm2m_object_t * targetP;
+
+    if (!LWM2M_URI_IS_SET_RESOURCE(uriP)) return false;
+
+    targetP = (lwm2m_object_t *)LWM2M_INDEX_FIND(&contextP->objectIndex, contextP->objectList, uriP->objectId);
+    if (NULL == targetP
+     || NULL == targetP->blockWriteFunc
+     || NULL == targetP->blockWritableFunc)
+    {
+        return false;
+    }
+
+    return targetP->blockWritableFunc(uriP->instanceId, uriP->resourceId, targetP);
+}
+
+uint8_t object_writeBlock(lwm2m_context_t * contextP,
+                          lwm2m_uri_t * uriP,
+                          size_t offset,
+                          uint8_t * buffer,
+                          size_t length,
+                          bool more)
+{
+    lwm2m_object_t * targetP;
+
+    LOG_URI(uriP);
+    LOG_ARG("offset: %u, length: %u, more: %d", offset, length, more);
+    targetP = (lwm2m_object_t *)LWM2M_INDEX_FIND(&contextP->objectIndex, contextP->objectList, uriP->objectId);
+    if (NULL == targetP) return COAP_404_NOT_FOUND;
+    if (NULL == targetP->blockWriteFunc) return COAP_405_METHOD_NOT_ALLOWED;
+    if (NULL == LWM2M_INDEX_FIND(&targetP->instanceIndex, targetP->instanceList, uriP->instanceId)) return COAP_404_NOT_FOUND;
+
+    return targetP->blockWriteFunc(uriP->instanceId, uriP->resourceId, offset, buffer, length, more, targetP);
+}
+
 uint8_t object_create(lwm2m_context_t * contextP,
                       lwm2m_uri_t * uriP,
                       lwm2m_media_type_t format,
@@ -281,11 +382,11 @@ uint8_t object_create(lwm2m_context_t * contextP,
         return COAP_400_BAD_REQUEST;
     }
 
-    targetP = (lwm2m_object_t *)LWM2M_LIST_FIND(contextP->objectList, uriP->objectId);
+    targetP = (lwm2m_object_t *)LWM2M_INDEX_FIND(&contextP->objectIndex, contextP->objectList, uriP->objectId);
     if (NULL == targetP) return COAP_404_NOT_FOUND;
     if (NULL == targetP->createFunc) return COAP_405_METHOD_NOT_ALLOWED;
 
-    size = lwm2m_data_parse(uriP, buffer, length, format, &dataP);
+    size = data_parse(&contextP->dataArena, uriP, buffer, length, format, &dataP);
     if (size <= 0) return COAP_400_BAD_REQUEST;
 
     switch (dataP[0].type)
@@ -300,7 +401,7 @@ uint8_t object_create(lwm2m_context_t * contextP,
             result = COAP_400_BAD_REQUEST;
             goto exit;
         }
-        if (NULL != lwm2m_list_find(targetP->instanceList, dataP[0].id))
+        if (NULL != LWM2M_INDEX_FIND(&targetP->instanceIndex, targetP->instanceList, dataP[0].id))
         {
             // Instance already exists
             result = COAP_406_NOT_ACCEPTABLE;
@@ -314,7 +415,7 @@ uint8_t object_create(lwm2m_context_t * contextP,
     default:
         if (!LWM2M_URI_IS_SET_INSTANCE(uriP))
         {
-            uriP->instanceId = lwm2m_list_newId(targetP->instanceList);
+            uriP->instanceId = lwm2m_list_index_newId(&targetP->instanceIndex, targetP->instanceList);
             uriP->flag |= LWM2M_URI_FLAG_INSTANCE_ID;
         }
         result = targetP->createFunc(uriP->instanceId, size, dataP, targetP);
@@ -322,7 +423,11 @@ uint8_t object_create(lwm2m_context_t * contextP,
     }
 
 exit:
-    lwm2m_data_free(size, dataP);
+    data_free(&contextP->dataArena, size, dataP);
+    if (result == COAP_201_CREATED)
+    {
+        object_updateRegisterPayload(contextP, targetP->objID);
+    }
 
     LOG_ARG("result: %u.%2u", (result & 0xFF) >> 5, (result & 0x1F));
 
@@ -336,7 +441,7 @@ uint8_t object_delete(lwm2m_context_t * contextP,
     uint8_t result;
 
     LOG_URI(uriP);
-    objectP = (lwm2m_object_t *)LWM2M_LIST_FIND(contextP->objectList, uriP->objectId);
+    objectP = (lwm2m_object_t *)LWM2M_INDEX_FIND(&contextP->objectIndex, contextP->objectList, uriP->objectId);
     if (NULL == objectP) return COAP_404_NOT_FOUND;
     if (NULL == objectP->deleteFunc) return COAP_405_METHOD_NOT_ALLOWED;
 
@@ -370,6 +475,8 @@ uint8_t object_delete(lwm2m_context_t * contextP,
             instanceP = objectP->instanceList;
         }
     }
+    // even a failed deletion of all instances may have removed some
+    object_updateRegisterPayload(contextP, objectP->objID);
 
     LOG_ARG("result: %u.%2u", (result & 0xFF) >> 5, (result & 0x1F));
 
@@ -388,19 +495,19 @@ uint8_t object_discover(lwm2m_context_t * contextP,
     int size = 0;
 
     LOG_URI(uriP);
-    targetP = (lwm2m_object_t *)LWM2M_LIST_FIND(contextP->objectList, uriP->objectId);
+    targetP = (lwm2m_object_t *)LWM2M_INDEX_FIND(&contextP->objectIndex, contextP->objectList, uriP->objectId);
     if (NULL == targetP) return COAP_404_NOT_FOUND;
     if (NULL == targetP->discoverFunc) return COAP_501_NOT_IMPLEMENTED;
 
     if (LWM2M_URI_IS_SET_INSTANCE(uriP))
     {
-        if (NULL == lwm2m_list_find(targetP->instanceList, uriP->instanceId)) return COAP_404_NOT_FOUND;
+        if (NULL == LWM2M_INDEX_FIND(&targetP->instanceIndex, targetP->instanceList, uriP->instanceId)) return COAP_404_NOT_FOUND;
 
         // single instance read
         if (LWM2M_URI_IS_SET_RESOURCE(uriP))
         {
             size = 1;
-            dataP = lwm2m_data_new(size);
+            dataP = data_new(&contextP->dataArena, size);
             if (dataP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
 
             dataP->id = uriP->resourceId;
@@ -424,7 +531,7 @@ uint8_t object_discover(lwm2m_context_t * contextP,
 
         if (size != 0)
         {
-            dataP = lwm2m_data_new(size);
+            dataP = data_new(&contextP->dataArena, size);
             if (dataP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
 
             instanceP = targetP->instanceList;
@@ -448,7 +555,7 @@ uint8_t object_discover(lwm2m_context_t * contextP,
         if (len <= 0) result = COAP_500_INTERNAL_SERVER_ERROR;
         else *lengthP = len;
     }
-    lwm2m_data_free(size, dataP);
+    data_free(&contextP->dataArena, size, dataP);
 
     LOG_ARG("result: %u.%2u", (result & 0xFF) >> 5, (result & 0x1F));
 
@@ -462,10 +569,10 @@ bool object_isInstanceNew(lwm2m_context_t * contextP,
     lwm2m_object_t * targetP;
 
     LOG("Entering");
-    targetP = (lwm2m_object_t *)LWM2M_LIST_FIND(contextP->objectList, objectId);
+    targetP = (lwm2m_object_t *)LWM2M_INDEX_FIND(&contextP->objectIndex, contextP->objectList, objectId);
     if (targetP != NULL)
     {
-        if (NULL != lwm2m_list_find(targetP->instanceList, instanceId))
+        if (NULL != LWM2M_INDEX_FIND(&targetP->instanceIndex, targetP->instanceList, instanceId))
         {
             return false;
         }
@@ -498,159 +605,223 @@ static int prv_getObjectTemplate(uint8_t * buffer,
     return index;
 }
 
-int object_getRegisterPayloadBufferLength(lwm2m_context_t * contextP)
+/*
+ * The registration payload is cached in the context: the "<altPath>;rt=..."
+ * header, then one "</id/instance>," entry per instance or "</id>," for an
+ * object without instances, in objectList order. The trailing comma is kept in
+ * the cache and left out of the payload. When an object or its instances
+ * change, only the entries of this object are rewritten.
+ */
+
+static size_t prv_getPayloadHeader(lwm2m_context_t * contextP,
+                                   uint8_t * buffer)
 {
-    size_t index;
-    int result;
-    lwm2m_object_t * objectP;
-    char buffer[REG_OBJECT_MIN_LEN + 5];
-
-    LOG("Entering");
-    index = strlen(REG_START);
+    const char * path;
+    size_t length;
 
     if ((contextP->altPath != NULL)
      && (contextP->altPath[0] != 0))
     {
-        index += strlen(contextP->altPath);
+        path = contextP->altPath;
     }
     else
     {
-        index += strlen(REG_DEFAULT_PATH);
+        path = REG_DEFAULT_PATH;
     }
 
-    index += strlen(REG_LWM2M_RESOURCE_TYPE);
+    length = strlen(REG_START) + strlen(path) + strlen(REG_LWM2M_RESOURCE_TYPE);
+    if (buffer != NULL)
+    {
+        memcpy(buffer, REG_START, strlen(REG_START));
+        buffer += strlen(REG_START);
+        memcpy(buffer, path, strlen(path));
+        buffer += strlen(path);
+        memcpy(buffer, REG_LWM2M_RESOURCE_TYPE, strlen(REG_LWM2M_RESOURCE_TYPE));
+    }
 
-    for (objectP = contextP->objectList; objectP != NULL; objectP = objectP->next)
+    return length;
+}
+
+// writes the entries of an object, or only counts them when buffer is NULL
+static size_t prv_getObjectEntries(lwm2m_object_t * objectP,
+                                   uint8_t * buffer)
+{
+    uint8_t entry[REG_ENTRY_MAX_LEN];
+    size_t templateLength;
+    size_t length;
+    lwm2m_list_t * instanceP;
+
+    if (objectP->objID == LWM2M_SECURITY_OBJECT_ID) return 0;
+
+    // "</id/" is shared by all the entries of the object
+    templateLength = (size_t)prv_getObjectTemplate(entry, sizeof(entry), objectP->objID);
+
+    if (objectP->instanceList == NULL)
     {
-        size_t start;
-        size_t length;
+        length = templateLength - 1;
+        memcpy(entry + length, REG_PATH_END, strlen(REG_PATH_END));
+        length += strlen(REG_PATH_END);
+        if (buffer != NULL) memcpy(buffer, entry, length);
 
-        if (objectP->objID == LWM2M_SECURITY_OBJECT_ID) continue;
+        return length;
+    }
 
-        start = index;
-        result = prv_getObjectTemplate(buffer, sizeof(buffer), objectP->objID);
-        if (result < 0) return 0;
-        length = result;
-        index += length;
+    length = 0;
+    for (instanceP = objectP->instanceList ; instanceP != NULL ; instanceP = instanceP->next)
+    {
+        size_t entryLength;
+
+        entryLength = templateLength;
+        entryLength += utils_intToText(instanceP->id, entry + entryLength, sizeof(entry) - entryLength);
+        memcpy(entry + entryLength, REG_PATH_END, strlen(REG_PATH_END));
+        entryLength += strlen(REG_PATH_END);
+        if (buffer != NULL) memcpy(buffer + length, entry, entryLength);
+        length += entryLength;
+    }
 
-        if (objectP->instanceList == NULL)
-        {
-            index -= 1;
-            index += strlen(REG_PATH_END);
-        }
-        else
-        {
-            lwm2m_list_t * targetP;
-            for (targetP = objectP->instanceList ; targetP != NULL ; targetP = targetP->next)
-            {
-                if (index != start + length)
-                {
-                    index += length;
-                }
+    return length;
+}
 
-                result = utils_intToText(targetP->id, buffer, sizeof(buffer));
-                if (result == 0) return 0;
-                index += result;
+static uint32_t prv_getEntryObjectId(uint8_t * entry)
+{
+    uint32_t id = 0;
+    size_t i;
 
-                index += strlen(REG_PATH_END);
-            }
-        }
+    // skip "</"
+    for (i = 2 ; '0' <= entry[i] && entry[i] <= '9' ; i++)
+    {
+        id = id * 10 + (entry[i] - '0');
     }
 
-    index += 1;  // account for trailing null
+    return id;
+}
 
-    // Note that object_getRegisterPayload() has REG_PATH_END added after each
-    // object or instance, and then the trailing comma is replaced by null. The
-    // trailing nulls are not counted as part of the payload length, so this
-    // will return a size two bytes greater than what
-    // object_getRegisterPayload() returns.
+static size_t prv_getNextEntry(lwm2m_context_t * contextP,
+                               size_t offset)
+{
+    uint8_t * endP;
 
-    return index;
+    endP = (uint8_t *)memchr(contextP->registerPayload + offset, REG_DELIMITER, contextP->registerPayloadLength - offset);
+    if (endP == NULL) return contextP->registerPayloadLength;
+
+    return endP - contextP->registerPayload + 1;
 }
 
-int object_getRegisterPayload(lwm2m_context_t * contextP,
-                           uint8_t * buffer,
-                           size_t bufferLen)
+static bool prv_buildRegisterPayload(lwm2m_context_t * contextP)
 {
-    size_t index;
-    int result;
     lwm2m_object_t * objectP;
+    size_t length;
+    uint8_t * buffer;
 
-    LOG("Entering");
-    // index can not be greater than bufferLen
-    index = 0;
+    length = prv_getPayloadHeader(contextP, NULL);
+    for (objectP = contextP->objectList ; objectP != NULL ; objectP = objectP->next)
+    {
+        length += prv_getObjectEntries(objectP, NULL);
+    }
 
-    result = utils_stringCopy((char *)buffer, bufferLen, REG_START);
-    if (result < 0) return 0;
-    index += result;
+    buffer = (uint8_t *)lwm2m_malloc(length);
+    if (buffer == NULL) return false;
 
-    if ((contextP->altPath != NULL)
-     && (contextP->altPath[0] != 0))
+    contextP->registerPayload = buffer;
+    contextP->registerPayloadLength = length;
+    contextP->registerPayloadSize = length;
+
+    buffer += prv_getPayloadHeader(contextP, buffer);
+    for (objectP = contextP->objectList ; objectP != NULL ; objectP = objectP->next)
     {
-        result = utils_stringCopy((char *)buffer + index, bufferLen - index, contextP->altPath);
+        buffer += prv_getObjectEntries(objectP, buffer);
     }
-    else
+
+    return true;
+}
+
+uint8_t * object_getRegisterPayload(lwm2m_context_t * contextP,
+                                    size_t * lengthP)
+{
+    LOG("Entering");
+
+    if (contextP->registerPayload == NULL
+     && !prv_buildRegisterPayload(contextP))
     {
-        result = utils_stringCopy((char *)buffer + index, bufferLen - index, REG_DEFAULT_PATH);
+        return NULL;
     }
-    if (result < 0) return 0;
-    index += result;
 
-    result = utils_stringCopy((char *)buffer + index, bufferLen - index, REG_LWM2M_RESOURCE_TYPE);
-    if (result < 0) return 0;
-    index += result;
+    // remove trailing ','
+    *lengthP = contextP->registerPayloadLength - 1;
 
-    for (objectP = contextP->objectList; objectP != NULL; objectP = objectP->next)
-    {
-        size_t start;
-        size_t length;
+    return contextP->registerPayload;
+}
 
-        if (objectP->objID == LWM2M_SECURITY_OBJECT_ID) continue;
+void object_updateRegisterPayload(lwm2m_context_t * contextP,
+                                  uint16_t objectId)
+{
+    lwm2m_object_t * objectP;
+    size_t start;
+    size_t end;
+    size_t entriesLength;
+    size_t length;
 
-        start = index;
-        result = prv_getObjectTemplate(buffer + index, bufferLen - index, objectP->objID);
-        if (result < 0) return 0;
-        length = result;
-        index += length;
+    LOG_ARG("objectId: %d", objectId);
 
-        if (objectP->instanceList == NULL)
-        {
-            index--;
-            result = utils_stringCopy((char *)buffer + index, bufferLen - index, REG_PATH_END);
-            if (result < 0) return 0;
-            index += result;
-        }
-        else
-        {
-            lwm2m_list_t * targetP;
-            for (targetP = objectP->instanceList ; targetP != NULL ; targetP = targetP->next)
-            {
-                if (index != start + length)
-                {
-                    if (bufferLen - index <= length) return 0;
-                    memcpy(buffer + index, buffer + start, length);
-                    index += length;
-                }
+    // built on first use
+    if (contextP->registerPayload == NULL) return;
+
+    // find the entries of the object, or where to insert them
+    start = prv_getPayloadHeader(contextP, NULL);
+    while (start < contextP->registerPayloadLength
+        && prv_getEntryObjectId(contextP->registerPayload + start) < objectId)
+    {
+        start = prv_getNextEntry(contextP, start);
+    }
+    end = start;
+    while (end < contextP->registerPayloadLength
+        && prv_getEntryObjectId(contextP->registerPayload + end) == objectId)
+    {
+        end = prv_getNextEntry(contextP, end);
+    }
 
-                result = utils_intToText(targetP->id, buffer + index, bufferLen - index);
-                if (result == 0) return 0;
-                index += result;
+    objectP = (lwm2m_object_t *)LWM2M_INDEX_FIND(&contextP->objectIndex, contextP->objectList, objectId);
+    entriesLength = (objectP != NULL) ? prv_getObjectEntries(objectP, NULL) : 0;
 
-                result = utils_stringCopy((char *)buffer + index, bufferLen - index, REG_PATH_END);
-                if (result < 0) return 0;
-                index += result;
-            }
+    length = contextP->registerPayloadLength - (end - start) + entriesLength;
+    if (length > contextP->registerPayloadSize)
+    {
+        uint8_t * buffer;
+        size_t size;
+
+        size = length + length / 2;
+        buffer = (uint8_t *)lwm2m_malloc(size);
+        if (buffer == NULL)
+        {
+            // rebuilt on next use
+            object_freeRegisterPayload(contextP);
+            return;
         }
+        memcpy(buffer, contextP->registerPayload, start);
+        memcpy(buffer + start + entriesLength, contextP->registerPayload + end, contextP->registerPayloadLength - end);
+        lwm2m_free(contextP->registerPayload);
+        contextP->registerPayload = buffer;
+        contextP->registerPayloadSize = size;
     }
-
-    if (index > 0)
+    else
     {
-        index = index - 1;  // remove trailing ','
+        memmove(contextP->registerPayload + start + entriesLength,
+                contextP->registerPayload + end,
+                contextP->registerPayloadLength - end);
     }
+    if (objectP != NULL) prv_getObjectEntries(objectP, contextP->registerPayload + start);
+    contextP->registerPayloadLength = length;
+}
 
-    buffer[index] = 0;
-
-    return index;
+void object_freeRegisterPayload(lwm2m_context_t * contextP)
+{
+    if (contextP->registerPayload != NULL)
+    {
+        lwm2m_free(contextP->registerPayload);
+        contextP->registerPayload = NULL;
+    }
+    contextP->registerPayloadLength = 0;
+    contextP->registerPayloadSize = 0;
 }
 
 static lwm2m_list_t * prv_findServerInstance(lwm2m_object_t * objectP,
@@ -843,6 +1014,7 @@ int object_getServers(lwm2m_context_t * contextP, bool checkOnly)
                         lwm2m_data_free(size, dataP);
                         return -1;
                     }
+                    prv_getNotificationMode(serverObjP, serverInstP->id, targetP);
                     targetP->status = STATE_DEREGISTERED;
                     if (checkOnly)
                     {
@@ -867,9 +1039,10 @@ uint8_t object_createInstance(lwm2m_context_t * contextP,
                                     lwm2m_data_t * dataP)
 {
     lwm2m_object_t * targetP;
+    uint8_t result;
 
     LOG_URI(uriP);
-    targetP = (lwm2m_object_t *)LWM2M_LIST_FIND(contextP->objectList, uriP->objectId);
+    targetP = (lwm2m_object_t *)LWM2M_INDEX_FIND(&contextP->objectIndex, contextP->objectList, uriP->objectId);
     if (NULL == targetP) return COAP_404_NOT_FOUND;
 
     if (NULL == targetP->createFunc)
@@ -877,7 +1050,13 @@ uint8_t object_createInstance(lwm2m_context_t * contextP,
         return COAP_405_METHOD_NOT_ALLOWED;
     }
 
-    return targetP->createFunc(lwm2m_list_newId(targetP->instanceList), dataP->value.asChildren.count, dataP->value.asChildren.array, targetP);
+    result = targetP->createFunc(lwm2m_list_index_newId(&targetP->instanceIndex, targetP->instanceList), dataP->value.asChildren.count, dataP->value.asChildren.array, targetP);
+    if (result == COAP_201_CREATED)
+    {
+        object_updateRegisterPayload(contextP, targetP->objID);
+    }
+
+    return result;
 }
 
 uint8_t object_writeInstance(lwm2m_context_t * contextP,
@@ -887,7 +1066,7 @@ uint8_t object_writeInstance(lwm2m_context_t * contextP,
     lwm2m_object_t * targetP;
 
     LOG_URI(uriP);
-    targetP = (lwm2m_object_t *)LWM2M_LIST_FIND(contextP->objectList, uriP->objectId);
+    targetP = (lwm2m_object_t *)LWM2M_INDEX_FIND(&contextP->objectIndex, contextP->objectList, uriP->objectId);
     if (NULL == targetP) return COAP_404_NOT_FOUND;
 
     if (NULL == targetP->writeFunc)
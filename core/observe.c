@@ -52,27 +52,142 @@
 
 
 #ifdef LWM2M_CLIENT_MODE
-static lwm2m_observed_t * prv_findObserved(lwm2m_context_t * contextP,
-                                           lwm2m_uri_t * uriP)
+
+/*
+ * Observed resources are not polled. Each active watcher has a timer set to the next
+ * time it must be looked at: as soon as the minimum period allows it once
+ * lwm2m_resource_value_changed() tagged it, or when the maximum period elapses.
+ * The resource is read in observe_expire() only when one of its watchers is due.
+ *
+ * When the server asked for confirmable notifications, a watcher has at most one of them
+ * waiting for an ACK. A change tagged in the meantime replaces it (RFC 7641 section 4.5.2):
+ * the pending retransmission is cancelled and the newest value is sent right away, carrying
+ * over the retransmission counter and timeout, so a flapping resource never costs more than
+ * the COAP_MAX_RETRANSMIT retransmissions of a single notification. Once acknowledged, the
+ * next notification is held back by the smoothed ACK latency so the notification rate follows
+ * what the link can carry. A watcher whose notification times out or is reset is removed.
+ */
+
+// the watcher is cleared when it is freed before the end of the transaction
+typedef struct
 {
-    lwm2m_observed_t * targetP;
+    lwm2m_context_t * contextP;
+    lwm2m_watcher_t * watcherP;
+    int64_t           sentTime;
+} notify_data_t;
 
-    targetP = contextP->observedList;
-    while (targetP != NULL
-        && (targetP->uri.objectId != uriP->objectId
-         || targetP->uri.flag != uriP->flag
-         || (LWM2M_URI_IS_SET_INSTANCE(uriP) && targetP->uri.instanceId != uriP->instanceId)
-         || (LWM2M_URI_IS_SET_RESOURCE(uriP) && targetP->uri.resourceId != uriP->resourceId)))
+// a pending confirmable notification gives way to a newer value while it has a transmission left
+static bool prv_isReplaceable(lwm2m_watcher_t * watcherP)
+{
+    return watcherP->transaction == NULL
+        || (watcherP->update == true
+         && watcherP->transaction->retrans_counter <= COAP_MAX_RETRANSMIT + 1);
+}
+
+static void prv_scheduleWatcher(lwm2m_context_t * contextP,
+                                lwm2m_watcher_t * watcherP,
+                                time_t currentTime)
+{
+    time_t interval = -1;
+    int64_t deadline;
+
+    if (!prv_isReplaceable(watcherP))
     {
-        targetP = targetP->next;
+        // rescheduled when the pending notification is acknowledged
+        timer_cancel(contextP, &watcherP->timer);
+        return;
     }
 
-    return targetP;
+    if (watcherP->active == true && watcherP->update == true)
+    {
+        interval = 0;
+        if (watcherP->parameters != NULL
+         && (watcherP->parameters->toSet & LWM2M_ATTR_FLAG_MIN_PERIOD) != 0
+         && watcherP->lastTime + watcherP->parameters->minPeriod > currentTime)
+        {
+            interval = watcherP->lastTime + watcherP->parameters->minPeriod - currentTime;
+        }
+    }
+    if (watcherP->active == true
+     && watcherP->parameters != NULL
+     && (watcherP->parameters->toSet & LWM2M_ATTR_FLAG_MAX_PERIOD) != 0)
+    {
+        time_t maxInterval;
+
+        maxInterval = watcherP->lastTime + watcherP->parameters->maxPeriod - currentTime;
+        if (maxInterval < 0) maxInterval = 0;
+        if (interval < 0 || maxInterval < interval) interval = maxInterval;
+    }
+
+    if (interval < 0)
+    {
+        timer_cancel(contextP, &watcherP->timer);
+    }
+    else
+    {
+        deadline = utils_getTimeMs() + (int64_t)interval * 1000;
+        if (deadline < watcherP->holdUntil) deadline = watcherP->holdUntil;
+        (void)timer_schedule(contextP, &watcherP->timer, deadline);
+    }
+}
+
+static void prv_freeWatcher(lwm2m_context_t * contextP,
+                            lwm2m_watcher_t * watcherP)
+{
+    timer_cancel(contextP, &watcherP->timer);
+    if (watcherP->transaction != NULL)
+    {
+        ((notify_data_t *)watcherP->transaction->userData)->watcherP = NULL;
+    }
+    if (watcherP->parameters != NULL) lwm2m_free(watcherP->parameters);
+    lwm2m_free(watcherP);
+}
+
+// observed URIs are indexed by their object, instance and resource IDs
+static uint32_t prv_uriKey(lwm2m_uri_t * uriP)
+{
+    uint8_t key[7];
+
+    memset(key, 0, sizeof(key));
+    key[0] = uriP->flag & LWM2M_URI_MASK_ID;
+    key[1] = (uint8_t)(uriP->objectId >> 8);
+    key[2] = (uint8_t)uriP->objectId;
+    if (LWM2M_URI_IS_SET_INSTANCE(uriP))
+    {
+        key[3] = (uint8_t)(uriP->instanceId >> 8);
+        key[4] = (uint8_t)uriP->instanceId;
+    }
+    if (LWM2M_URI_IS_SET_RESOURCE(uriP))
+    {
+        key[5] = (uint8_t)(uriP->resourceId >> 8);
+        key[6] = (uint8_t)uriP->resourceId;
+    }
+
+    return hash_buffer(key, sizeof(key));
+}
+
+static bool prv_matchObserved(void * itemP,
+                              void * userData)
+{
+    lwm2m_observed_t * targetP = (lwm2m_observed_t *)itemP;
+    lwm2m_uri_t * uriP = (lwm2m_uri_t *)userData;
+
+    return targetP->uri.objectId == uriP->objectId
+        && (targetP->uri.flag & LWM2M_URI_MASK_ID) == (uriP->flag & LWM2M_URI_MASK_ID)
+        && (!LWM2M_URI_IS_SET_INSTANCE(uriP) || targetP->uri.instanceId == uriP->instanceId)
+        && (!LWM2M_URI_IS_SET_RESOURCE(uriP) || targetP->uri.resourceId == uriP->resourceId);
+}
+
+static lwm2m_observed_t * prv_findObserved(lwm2m_context_t * contextP,
+                                           lwm2m_uri_t * uriP)
+{
+    return (lwm2m_observed_t *)hash_find(&contextP->observedIndex, prv_uriKey(uriP), prv_matchObserved, uriP);
 }
 
 static void prv_unlinkObserved(lwm2m_context_t * contextP,
                                lwm2m_observed_t * observedP)
 {
+    hash_remove(&contextP->observedIndex, prv_uriKey(&observedP->uri), observedP);
     if (contextP->observedList == observedP)
     {
         contextP->observedList = contextP->observedList->next;
@@ -127,6 +242,11 @@ static lwm2m_watcher_t * prv_getWatcher(lwm2m_context_t * contextP,
         allocatedObserver = true;
         memset(observedP, 0, sizeof(lwm2m_observed_t));
         memcpy(&(observedP->uri), uriP, sizeof(lwm2m_uri_t));
+        if (!hash_add(&contextP->observedIndex, prv_uriKey(uriP), observedP))
+        {
+            lwm2m_free(observedP);
+            return NULL;
+        }
         observedP->next = contextP->observedList;
         contextP->observedList = observedP;
     }
@@ -139,6 +259,7 @@ static lwm2m_watcher_t * prv_getWatcher(lwm2m_context_t * contextP,
         {
             if (allocatedObserver == true)
             {
+                prv_unlinkObserved(contextP, observedP);
                 lwm2m_free(observedP);
             }
             return NULL;
@@ -146,6 +267,9 @@ static lwm2m_watcher_t * prv_getWatcher(lwm2m_context_t * contextP,
         memset(watcherP, 0, sizeof(lwm2m_watcher_t));
         watcherP->active = false;
         watcherP->server = serverP;
+        watcherP->observed = observedP;
+        watcherP->timer.type = LWM2M_TIMER_WATCHER;
+        watcherP->timer.ownerP = watcherP;
         watcherP->next = observedP->watcherList;
         observedP->watcherList = watcherP;
     }
@@ -209,6 +333,7 @@ uint8_t observe_handleRequest(lwm2m_context_t * contextP,
         }
 
         coap_set_header_observe(response, watcherP->counter++);
+        prv_scheduleWatcher(contextP, watcherP, watcherP->lastTime);
 
         return COAP_205_CONTENT;
 
@@ -269,8 +394,7 @@ void observe_cancel(lwm2m_context_t * contextP,
         }
         if (targetP != NULL)
         {
-            if (targetP->parameters != NULL) lwm2m_free(targetP->parameters);
-            lwm2m_free(targetP);
+            prv_freeWatcher(contextP, targetP);
             if (observedP->watcherList == NULL)
             {
                 prv_unlinkObserved(contextP, observedP);
@@ -300,11 +424,12 @@ void observe_clear(lwm2m_context_t * contextP,
 
             nextP = observedP->next;
 
-            for (watcherP = observedP->watcherList; watcherP != NULL; watcherP = watcherP->next)
+            while (observedP->watcherList != NULL)
             {
-                if (watcherP->parameters != NULL) lwm2m_free(watcherP->parameters);
+                watcherP = observedP->watcherList;
+                observedP->watcherList = watcherP->next;
+                prv_freeWatcher(contextP, watcherP);
             }
-            LWM2M_LIST_FREE(observedP->watcherList);
 
             prv_unlinkObserved(contextP, observedP);
             lwm2m_free(observedP);
@@ -385,6 +510,7 @@ uint8_t observe_setParameters(lwm2m_context_t * contextP,
     else
     {
         watcherP->parameters->toSet &= ~attrP->toClear;
+        watcherP->parameters->toSet |= attrP->toSet;
         if (attrP->toSet & LWM2M_ATTR_FLAG_MIN_PERIOD)
         {
             watcherP->parameters->minPeriod = attrP->minPeriod;
@@ -407,6 +533,8 @@ uint8_t observe_setParameters(lwm2m_context_t * contextP,
         }
     }
 
+    if (watcherP->active == true) prv_scheduleWatcher(contextP, watcherP, lwm2m_gettime());
+
     LOG_ARG("Final toSet: %08X, minPeriod: %d, maxPeriod: %d, greaterThan: %f, lessThan: %f, step: %f",
             watcherP->parameters->toSet, watcherP->parameters->minPeriod, watcherP->parameters->maxPeriod, watcherP->parameters->greaterThan, watcherP->parameters->lessThan, watcherP->parameters->step);
 
@@ -417,38 +545,66 @@ lwm2m_observed_t * observe_findByUri(lwm2m_context_t * contextP,
                                      lwm2m_uri_t * uriP)
 {
     lwm2m_observed_t * targetP;
+    lwm2m_uri_t uri;
 
     LOG_URI(uriP);
-    targetP = contextP->observedList;
-    while (targetP != NULL)
+    memcpy(&uri, uriP, sizeof(lwm2m_uri_t));
+    uri.flag |= LWM2M_URI_FLAG_OBJECT_ID;
+    targetP = prv_findObserved(contextP, &uri);
+    if (targetP != NULL)
     {
-        if (targetP->uri.objectId == uriP->objectId)
-        {
-            if ((!LWM2M_URI_IS_SET_INSTANCE(uriP) && !LWM2M_URI_IS_SET_INSTANCE(&(targetP->uri)))
-             || (LWM2M_URI_IS_SET_INSTANCE(uriP) && LWM2M_URI_IS_SET_INSTANCE(&(targetP->uri)) && (uriP->instanceId == targetP->uri.instanceId)))
-             {
-                 if ((!LWM2M_URI_IS_SET_RESOURCE(uriP) && !LWM2M_URI_IS_SET_RESOURCE(&(targetP->uri)))
-                     || (LWM2M_URI_IS_SET_RESOURCE(uriP) && LWM2M_URI_IS_SET_RESOURCE(&(targetP->uri)) && (uriP->resourceId == targetP->uri.resourceId)))
-                 {
-                     LOG_ARG("Found one with%s observers.", targetP->watcherList ? "" : " no");
-                     LOG_URI(&(targetP->uri));
-                     return targetP;
-                 }
-             }
-        }
-        targetP = targetP->next;
+        LOG_ARG("Found one with%s observers.", targetP->watcherList ? "" : " no");
+        LOG_URI(&(targetP->uri));
+        return targetP;
     }
 
     LOG("Found nothing");
     return NULL;
 }
 
+static void prv_tagWatchers(lwm2m_context_t * contextP,
+                            lwm2m_observed_t * targetP)
+{
+    lwm2m_watcher_t * watcherP;
+
+    LOG("Found an observation");
+    LOG_URI(&(targetP->uri));
+
+    for (watcherP = targetP->watcherList ; watcherP != NULL ; watcherP = watcherP->next)
+    {
+        if (watcherP->active == true)
+        {
+            LOG("Tagging a watcher");
+            watcherP->update = true;
+            prv_scheduleWatcher(contextP, watcherP, lwm2m_gettime());
+        }
+    }
+}
+
 void lwm2m_resource_value_changed(lwm2m_context_t * contextP,
                                   lwm2m_uri_t * uriP)
 {
     lwm2m_observed_t * targetP;
 
     LOG_URI(uriP);
+    if (LWM2M_URI_IS_SET_INSTANCE(uriP) && LWM2M_URI_IS_SET_RESOURCE(uriP))
+    {
+        lwm2m_uri_t uri;
+
+        // only the resource, its instance and its object can be observed
+        memcpy(&uri, uriP, sizeof(lwm2m_uri_t));
+        uri.flag = LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID | LWM2M_URI_FLAG_RESOURCE_ID;
+        targetP = prv_findObserved(contextP, &uri);
+        if (targetP != NULL) prv_tagWatchers(contextP, targetP);
+        uri.flag &= ~LWM2M_URI_FLAG_RESOURCE_ID;
+        targetP = prv_findObserved(contextP, &uri);
+        if (targetP != NULL) prv_tagWatchers(contextP, targetP);
+        uri.flag &= ~LWM2M_URI_FLAG_INSTANCE_ID;
+        targetP = prv_findObserved(contextP, &uri);
+        if (targetP != NULL) prv_tagWatchers(contextP, targetP);
+        return;
+    }
+
     targetP = contextP->observedList;
     while (targetP != NULL)
     {
@@ -462,19 +618,7 @@ void lwm2m_resource_value_changed(lwm2m_context_t * contextP,
                  || (targetP->uri.flag & LWM2M_URI_FLAG_RESOURCE_ID) == 0
                  || uriP->resourceId == targetP->uri.resourceId)
                 {
-                    lwm2m_watcher_t * watcherP;
-
-                    LOG("Found an observation");
-                    LOG_URI(&(targetP->uri));
-
-                    for (watcherP = targetP->watcherList ; watcherP != NULL ; watcherP = watcherP->next)
-                    {
-                        if (watcherP->active == true)
-                        {
-                            LOG("Tagging a watcher");
-                            watcherP->update = true;
-                        }
-                    }
+                    prv_tagWatchers(contextP, targetP);
                 }
             }
         }
@@ -482,282 +626,552 @@ void lwm2m_resource_value_changed(lwm2m_context_t * contextP,
     }
 }
 
-void observe_step(lwm2m_context_t * contextP,
-                  time_t currentTime,
-                  time_t * timeoutP)
+// returns true if the change of value of the resource must be notified to this watcher
+static bool prv_checkConditions(lwm2m_watcher_t * watcherP,
+                                lwm2m_data_t * dataP,
+                                int64_t integerValue,
+                                double floatValue,
+                                time_t currentTime)
 {
-    lwm2m_observed_t * targetP;
+    bool notify = false;
 
-    LOG("Entering");
-    for (targetP = contextP->observedList ; targetP != NULL ; targetP = targetP->next)
-    {
-        lwm2m_watcher_t * watcherP;
-        uint8_t * buffer = NULL;
-        size_t length = 0;
-        lwm2m_data_t * dataP = NULL;
-        int size = 0;
-        double floatValue = 0;
-        int64_t integerValue = 0;
-        bool storeValue = false;
-        coap_packet_t message[1];
-        time_t interval;
+    if (watcherP->parameters == NULL || watcherP->parameters->toSet == 0)
+    {
+        // no conditions
+        LOG("Notify with no conditions");
+        return true;
+    }
 
-        LOG_URI(&(targetP->uri));
-        if (LWM2M_URI_IS_SET_RESOURCE(&targetP->uri))
+    if ((watcherP->parameters->toSet & ATTR_FLAG_NUMERIC) != 0 && dataP != NULL)
+    {
+        if ((watcherP->parameters->toSet & LWM2M_ATTR_FLAG_LESS_THAN) != 0)
         {
-            if (COAP_205_CONTENT != object_readData(contextP, &targetP->uri, &size, &dataP)) continue;
+            LOG("Checking lower threshold");
+            // Did we cross the lower threshold ?
             switch (dataP->type)
             {
             case LWM2M_TYPE_INTEGER:
-                if (1 != lwm2m_data_decode_int(dataP, &integerValue))
+                if ((integerValue < watcherP->parameters->lessThan
+                  && watcherP->lastValue.asInteger > watcherP->parameters->lessThan)
+                 || (integerValue > watcherP->parameters->lessThan
+                  && watcherP->lastValue.asInteger < watcherP->parameters->lessThan))
                 {
-                    lwm2m_data_free(size, dataP);
-                    continue;
+                    LOG("Notify on lower threshold crossing");
+                    notify = true;
                 }
-                storeValue = true;
                 break;
             case LWM2M_TYPE_FLOAT:
-                if (1 != lwm2m_data_decode_float(dataP, &floatValue))
+                if ((floatValue < watcherP->parameters->lessThan
+                  && watcherP->lastValue.asFloat > watcherP->parameters->lessThan)
+                 || (floatValue > watcherP->parameters->lessThan
+                  && watcherP->lastValue.asFloat < watcherP->parameters->lessThan))
                 {
-                    lwm2m_data_free(size, dataP);
-                    continue;
+                    LOG("Notify on lower threshold crossing");
+                    notify = true;
                 }
-                storeValue = true;
                 break;
             default:
                 break;
             }
         }
-        for (watcherP = targetP->watcherList ; watcherP != NULL ; watcherP = watcherP->next)
+        if ((watcherP->parameters->toSet & LWM2M_ATTR_FLAG_GREATER_THAN) != 0)
         {
-            if (watcherP->active == true)
+            LOG("Checking upper threshold");
+            // Did we cross the upper threshold ?
+            switch (dataP->type)
             {
-                bool notify = false;
+            case LWM2M_TYPE_INTEGER:
+                if ((integerValue < watcherP->parameters->greaterThan
+                  && watcherP->lastValue.asInteger > watcherP->parameters->greaterThan)
+                 || (integerValue > watcherP->parameters->greaterThan
+                  && watcherP->lastValue.asInteger < watcherP->parameters->greaterThan))
+                {
+                    LOG("Notify on lower upper crossing");
+                    notify = true;
+                }
+                break;
+            case LWM2M_TYPE_FLOAT:
+                if ((floatValue < watcherP->parameters->greaterThan
+                  && watcherP->lastValue.asFloat > watcherP->parameters->greaterThan)
+                 || (floatValue > watcherP->parameters->greaterThan
+                  && watcherP->lastValue.asFloat < watcherP->parameters->greaterThan))
+                {
+                    LOG("Notify on lower upper crossing");
+                    notify = true;
+                }
+                break;
+            default:
+                break;
+            }
+        }
+        if ((watcherP->parameters->toSet & LWM2M_ATTR_FLAG_STEP) != 0)
+        {
+            LOG("Checking step");
 
-                if (watcherP->update == true)
+            switch (dataP->type)
+            {
+            case LWM2M_TYPE_INTEGER:
+            {
+                int64_t diff;
+
+                diff = integerValue - watcherP->lastValue.asInteger;
+                if ((diff < 0 && (0 - diff) >= watcherP->parameters->step)
+                 || (diff >= 0 && diff >= watcherP->parameters->step))
                 {
-                    // value changed, should we notify the server ?
-
-                    if (watcherP->parameters == NULL || watcherP->parameters->toSet == 0)
-                    {
-                        // no conditions
-                        notify = true;
-                        LOG("Notify with no conditions");
-                        LOG_URI(&(targetP->uri));
-                    }
-
-                    if (notify == false
-                     && watcherP->parameters != NULL
-                     && (watcherP->parameters->toSet & ATTR_FLAG_NUMERIC) != 0)
-                    {
-                        if ((watcherP->parameters->toSet & LWM2M_ATTR_FLAG_LESS_THAN) != 0)
-                        {
-                            LOG("Checking lower threshold");
-                            // Did we cross the lower threshold ?
-                            switch (dataP->type)
-                            {
-                            case LWM2M_TYPE_INTEGER:
-                                if ((integerValue < watcherP->parameters->lessThan
-                                  && watcherP->lastValue.asInteger > watcherP->parameters->lessThan)
-                                 || (integerValue > watcherP->parameters->lessThan
-                                  && watcherP->lastValue.asInteger < watcherP->parameters->lessThan))
-                                {
-                                    LOG("Notify on lower threshold crossing");
-                                    notify = true;
-                                }
-                                break;
-                            case LWM2M_TYPE_FLOAT:
-                                if ((floatValue < watcherP->parameters->lessThan
-                                  && watcherP->lastValue.asFloat > watcherP->parameters->lessThan)
-                                 || (floatValue > watcherP->parameters->lessThan
-                                  && watcherP->lastValue.asFloat < watcherP->parameters->lessThan))
-                                {
-                                    LOG("Notify on lower threshold crossing");
-                                    notify = true;
-                                }
-                                break;
-                            default:
-                                break;
-                            }
-                        }
-                        if ((watcherP->parameters->toSet & LWM2M_ATTR_FLAG_GREATER_THAN) != 0)
-                        {
-                            LOG("Checking upper threshold");
-                            // Did we cross the upper threshold ?
-                            switch (dataP->type)
-                            {
-                            case LWM2M_TYPE_INTEGER:
-                                if ((integerValue < watcherP->parameters->greaterThan
-                                  && watcherP->lastValue.asInteger > watcherP->parameters->greaterThan)
-                                 || (integerValue > watcherP->parameters->greaterThan
-                                  && watcherP->lastValue.asInteger < watcherP->parameters->greaterThan))
-                                {
-                                    LOG("Notify on lower upper crossing");
-                                    notify = true;
-                                }
-                                break;
-                            case LWM2M_TYPE_FLOAT:
-                                if ((floatValue < watcherP->parameters->greaterThan
-                                  && watcherP->lastValue.asFloat > watcherP->parameters->greaterThan)
-                                 || (floatValue > watcherP->parameters->greaterThan
-                                  && watcherP->lastValue.asFloat < watcherP->parameters->greaterThan))
-                                {
-                                    LOG("Notify on lower upper crossing");
-                                    notify = true;
-                                }
-                                break;
-                            default:
-                                break;
-                            }
-                        }
-                        if ((watcherP->parameters->toSet & LWM2M_ATTR_FLAG_STEP) != 0)
-                        {
-                            LOG("Checking step");
-
-                            switch (dataP->type)
-                            {
-                            case LWM2M_TYPE_INTEGER:
-                            {
-                                int64_t diff;
-
-                                diff = integerValue - watcherP->lastValue.asInteger;
-                                if ((diff < 0 && (0 - diff) >= watcherP->parameters->step)
-                                 || (diff >= 0 && diff >= watcherP->parameters->step))
-                                {
-                                    LOG("Notify on step condition");
-                                    notify = true;
-                                }
-                            }
-                                break;
-                            case LWM2M_TYPE_FLOAT:
-                            {
-                                double diff;
-
-                                diff = floatValue - watcherP->lastValue.asFloat;
-                                if ((diff < 0 && (0 - diff) >= watcherP->parameters->step)
-                                 || (diff >= 0 && diff >= watcherP->parameters->step))
-                                {
-                                    LOG("Notify on step condition");
-                                    notify = true;
-                                }
-                            }
-                                break;
-                            default:
-                                break;
-                            }
-                        }
-                    }
-
-                    if (watcherP->parameters != NULL
-                     && (watcherP->parameters->toSet & LWM2M_ATTR_FLAG_MIN_PERIOD) != 0)
-                    {
-                        LOG_ARG("Checking minimal period (%d s)", watcherP->parameters->minPeriod);
-
-                        if (watcherP->lastTime + watcherP->parameters->minPeriod > currentTime)
-                        {
-                            // Minimum Period did not elapse yet
-                            interval = watcherP->lastTime + watcherP->parameters->minPeriod - currentTime;
-                            if (*timeoutP > interval) *timeoutP = interval;
-                            notify = false;
-                        }
-                        else
-                        {
-                            LOG("Notify on minimal period");
-                            notify = true;
-                        }
-                    }
+                    LOG("Notify on step condition");
+                    notify = true;
                 }
+            }
+                break;
+            case LWM2M_TYPE_FLOAT:
+            {
+                double diff;
 
-                // Is the Maximum Period reached ?
-                if (notify == false
-                 && watcherP->parameters != NULL
-                 && (watcherP->parameters->toSet & LWM2M_ATTR_FLAG_MAX_PERIOD) != 0)
+                diff = floatValue - watcherP->lastValue.asFloat;
+                if ((diff < 0 && (0 - diff) >= watcherP->parameters->step)
+                 || (diff >= 0 && diff >= watcherP->parameters->step))
                 {
-                    LOG_ARG("Checking maximal period (%d s)", watcherP->parameters->maxPeriod);
+                    LOG("Notify on step condition");
+                    notify = true;
+                }
+            }
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    if ((watcherP->parameters->toSet & LWM2M_ATTR_FLAG_MIN_PERIOD) != 0)
+    {
+        LOG_ARG("Checking minimal period (%d s)", watcherP->parameters->minPeriod);
+
+        if (watcherP->lastTime + watcherP->parameters->minPeriod > currentTime)
+        {
+            // Minimum Period did not elapse yet
+            notify = false;
+        }
+        else
+        {
+            LOG("Notify on minimal period");
+            notify = true;
+        }
+    }
+
+    return notify;
+}
+
+/*
+ * Watchers of a resource may ask for different media types. A notification is serialized
+ * once per media type while the watchers due at the same time are handled, and the
+ * payloads are released once they are all notified.
+ */
+#define OBSERVE_MAX_FORMATS 4
+
+typedef struct
+{
+    lwm2m_media_type_t format;      // asked by the watchers
+    lwm2m_media_type_t usedFormat;  // picked by the serializer
+    uint8_t *          buffer;
+    size_t             length;
+} notify_payload_t;
+
+static notify_payload_t * prv_getPayload(lwm2m_context_t * contextP,
+                                         lwm2m_observed_t * targetP,
+                                         int size,
+                                         lwm2m_data_t * dataP,
+                                         lwm2m_media_type_t format,
+                                         notify_payload_t * payloads,
+                                         int * countP)
+{
+    notify_payload_t * payloadP;
+    int i;
+
+    for (i = 0 ; i < *countP ; i++)
+    {
+        if (payloads[i].format == format) return payloads + i;
+    }
+
+    if (*countP < OBSERVE_MAX_FORMATS)
+    {
+        payloadP = payloads + *countP;
+    }
+    else
+    {
+        // more media types than expected, the last one is replaced
+        payloadP = payloads + OBSERVE_MAX_FORMATS - 1;
+        lwm2m_free(payloadP->buffer);
+        (*countP)--;
+    }
+
+    payloadP->format = format;
+    payloadP->usedFormat = format;
+    payloadP->buffer = NULL;
+    payloadP->length = 0;
+    if (dataP != NULL)
+    {
+        int res;
+
+        res = lwm2m_data_serialize(&targetP->uri, size, dataP, &(payloadP->usedFormat), &(payloadP->buffer));
+        if (res < 0) return NULL;
+        payloadP->length = (size_t)res;
+    }
+    else
+    {
+        if (COAP_205_CONTENT != object_read(contextP, &targetP->uri, &(payloadP->usedFormat), &(payloadP->buffer), &(payloadP->length)))
+        {
+            return NULL;
+        }
+    }
+    if (payloadP->buffer == NULL) return NULL;
+    (*countP)++;
+
+    return payloadP;
+}
+
+static void prv_removeWatcher(lwm2m_context_t * contextP,
+                              lwm2m_watcher_t * watcherP)
+{
+    lwm2m_observed_t * observedP = watcherP->observed;
+
+    if (observedP->watcherList == watcherP)
+    {
+        observedP->watcherList = watcherP->next;
+    }
+    else
+    {
+        lwm2m_watcher_t * parentP;
+
+        parentP = observedP->watcherList;
+        while (parentP->next != NULL
+            && parentP->next != watcherP)
+        {
+            parentP = parentP->next;
+        }
+        if (parentP->next != NULL)
+        {
+            parentP->next = watcherP->next;
+        }
+    }
+    prv_freeWatcher(contextP, watcherP);
+
+    if (observedP->watcherList == NULL)
+    {
+        prv_unlinkObserved(contextP, observedP);
+        lwm2m_free(observedP);
+    }
+}
+
+static void prv_notifyCallback(lwm2m_transaction_t * transacP,
+                               void * message)
+{
+    notify_data_t * dataP = (notify_data_t *)transacP->userData;
+    coap_packet_t * packet = (coap_packet_t *)message;
+    lwm2m_watcher_t * watcherP = dataP->watcherP;
+
+    if (watcherP != NULL)
+    {
+        watcherP->transaction = NULL;
+        if (packet == NULL || packet->type == COAP_TYPE_RST)
+        {
+            // the server is gone or not interested anymore (RFC 7641 sections 3.6 and 4.5)
+            LOG("Confirmable notification failed, removing the watcher");
+            prv_removeWatcher(dataP->contextP, watcherP);
+        }
+        else
+        {
+            int64_t now;
+            uint32_t latency;
+
+            now = utils_getTimeMs();
+            latency = (uint32_t)(now - dataP->sentTime);
+            if (watcherP->ackLatency == 0)
+            {
+                watcherP->ackLatency = latency;
+            }
+            else
+            {
+                watcherP->ackLatency = (7 * watcherP->ackLatency + latency) / 8;
+            }
+            LOG_ARG("ACK latency: %u ms", watcherP->ackLatency);
+            watcherP->holdUntil = now + watcherP->ackLatency;
+            prv_scheduleWatcher(dataP->contextP, watcherP, lwm2m_gettime());
+        }
+    }
+
+    lwm2m_free(dataP);
+}
+
+// a notification bigger than the block size only carries its first block (RFC 7959 section 3.4)
+static bool prv_setNotificationPayload(lwm2m_context_t * contextP,
+                                       lwm2m_watcher_t * watcherP,
+                                       coap_packet_t * message,
+                                       notify_payload_t * payloadP)
+{
+    if (payloadP->length <= contextP->blockSize)
+    {
+        coap_set_payload(message, payloadP->buffer, payloadP->length);
+        return true;
+    }
+
+    return block2_notify(contextP, watcherP->server->sessionH, &watcherP->observed->uri, message,
+                         payloadP->buffer, payloadP->length, contextP->blockSize);
+}
+
+static bool prv_notifyConfirmable(lwm2m_context_t * contextP,
+                                  lwm2m_watcher_t * watcherP,
+                                  notify_payload_t * payloadP)
+{
+    lwm2m_transaction_t * transacP;
+    notify_data_t * dataP;
+
+    dataP = (notify_data_t *)lwm2m_malloc(sizeof(notify_data_t));
+    if (dataP == NULL) return false;
+
+    transacP = transaction_new(watcherP->server->sessionH, (coap_method_t)COAP_205_CONTENT, NULL, NULL, contextP->nextMID++, watcherP->tokenLen, watcherP->token);
+    if (transacP == NULL)
+    {
+        lwm2m_free(dataP);
+        return false;
+    }
+    coap_set_header_content_type(transacP->message, watcherP->format);
+    coap_set_header_observe(transacP->message, watcherP->counter);
+    if (!prv_setNotificationPayload(contextP, watcherP, transacP->message, payloadP))
+    {
+        transaction_free(transacP);
+        lwm2m_free(dataP);
+        return false;
+    }
+    if (watcherP->transaction != NULL)
+    {
+        // sent in place of the next retransmission of the pending notification
+        transacP->retrans_counter = watcherP->transaction->retrans_counter;
+        transacP->ack_timeout = watcherP->transaction->ack_timeout;
+        transacP->retrans_time = utils_getTimeMs();
+    }
 
-                    if (watcherP->lastTime + watcherP->parameters->maxPeriod <= currentTime)
-                    {
-                        LOG("Notify on maximal period");
-                        notify = true;
-                    }
+    // the watcher is only attached once sent, so that a failure right away
+    // does not remove it while observe_expire() goes through the watchers
+    dataP->contextP = contextP;
+    dataP->watcherP = NULL;
+    dataP->sentTime = utils_getTimeMs();
+    transacP->callback = prv_notifyCallback;
+    transacP->userData = (void *)dataP;
+    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transacP);
+
+    switch (transaction_send(contextP, transacP))
+    {
+    case 0:
+        if (watcherP->transaction != NULL)
+        {
+            lwm2m_transaction_t * pendingP = watcherP->transaction;
+
+            lwm2m_free(pendingP->userData);
+            transaction_remove(contextP, pendingP);
+        }
+        dataP->watcherP = watcherP;
+        watcherP->transaction = transacP;
+        watcherP->lastMid = transacP->mID;
+        watcherP->counter++;
+        return true;
+
+    case COAP_500_INTERNAL_SERVER_ERROR:
+        // the transaction was removed without calling back
+        lwm2m_free(dataP);
+        return false;
+
+    default:
+        // the transaction already failed and was released, try again later
+        return false;
+    }
+}
+
+static bool prv_isDue(lwm2m_watcher_t * watcherP,
+                      int64_t currentTimeMs)
+{
+    return watcherP->active
+        && watcherP->timer.position != 0
+        && watcherP->timer.deadline <= currentTimeMs;
+}
+
+// called from timer_step() when the deadline of a watcher is reached
+void observe_expire(lwm2m_context_t * contextP,
+                    lwm2m_watcher_t * watcherP,
+                    int64_t currentTimeMs)
+{
+    lwm2m_observed_t * targetP = watcherP->observed;
+    time_t currentTime;
+    notify_payload_t payloads[OBSERVE_MAX_FORMATS];
+    int payloadCount = 0;
+    lwm2m_data_t * dataP = NULL;
+    int size = 0;
+    double floatValue = 0;
+    int64_t integerValue = 0;
+    bool storeValue = false;
+    coap_packet_t message[1];
+
+    LOG_URI(&(targetP->uri));
+    currentTime = lwm2m_gettime();
+    arena_enter(&contextP->dataArena);
+
+    if (LWM2M_URI_IS_SET_RESOURCE(&targetP->uri))
+    {
+        bool readable;
+
+        readable = (COAP_205_CONTENT == object_readData(contextP, &targetP->uri, &size, &dataP));
+        if (readable)
+        {
+            switch (dataP->type)
+            {
+            case LWM2M_TYPE_INTEGER:
+                readable = (1 == lwm2m_data_decode_int(dataP, &integerValue));
+                storeValue = true;
+                break;
+            case LWM2M_TYPE_FLOAT:
+                readable = (1 == lwm2m_data_decode_float(dataP, &floatValue));
+                storeValue = true;
+                break;
+            default:
+                break;
+            }
+        }
+        if (!readable)
+        {
+            // try again later
+            for (watcherP = targetP->watcherList ; watcherP != NULL ; watcherP = watcherP->next)
+            {
+                if (prv_isDue(watcherP, currentTimeMs))
+                {
+                    (void)timer_schedule(contextP, &watcherP->timer, currentTimeMs + 1000);
                 }
+            }
+            if (dataP != NULL) data_free(&contextP->dataArena, size, dataP);
+            arena_leave(&contextP->dataArena);
+            return;
+        }
+    }
+
+    for (watcherP = targetP->watcherList ; watcherP != NULL ; watcherP = watcherP->next)
+    {
+        bool notify = false;
+        notify_payload_t * payloadP = NULL;
 
-                if (notify == true)
+        if (!prv_isDue(watcherP, currentTimeMs)) continue;
+        if (!prv_isReplaceable(watcherP))
+        {
+            prv_scheduleWatcher(contextP, watcherP, currentTime);
+            continue;
+        }
+
+        if (watcherP->update == true)
+        {
+            // value changed, should we notify the server ?
+            notify = prv_checkConditions(watcherP, dataP, integerValue, floatValue, currentTime);
+            if (notify == false
+             && (watcherP->parameters == NULL
+              || (watcherP->parameters->toSet & LWM2M_ATTR_FLAG_MIN_PERIOD) == 0
+              || watcherP->lastTime + watcherP->parameters->minPeriod <= currentTime))
+            {
+                // the change does not match the conditions, wait for the next one
+                watcherP->update = false;
+            }
+        }
+
+        // Is the Maximum Period reached ?
+        if (notify == false
+         && watcherP->parameters != NULL
+         && (watcherP->parameters->toSet & LWM2M_ATTR_FLAG_MAX_PERIOD) != 0)
+        {
+            LOG_ARG("Checking maximal period (%d s)", watcherP->parameters->maxPeriod);
+
+            if (watcherP->lastTime + watcherP->parameters->maxPeriod <= currentTime)
+            {
+                LOG("Notify on maximal period");
+                notify = true;
+            }
+        }
+
+        if (notify == true)
+        {
+            payloadP = prv_getPayload(contextP, targetP, size, dataP, watcherP->format, payloads, &payloadCount);
+        }
+
+        if (payloadP != NULL)
+        {
+            watcherP->format = payloadP->usedFormat;
+            if (watcherP->server->confirmableNotify == true)
+            {
+                if (!prv_notifyConfirmable(contextP, watcherP, payloadP)) payloadP = NULL;
+            }
+            else
+            {
+                coap_init_message(message, COAP_TYPE_NON, COAP_205_CONTENT, 0);
+                coap_set_header_content_type(message, watcherP->format);
+                if (prv_setNotificationPayload(contextP, watcherP, message, payloadP))
                 {
-                    if (buffer == NULL)
-                    {
-                        if (dataP != NULL)
-                        {
-                            int res;
-
-                            res = lwm2m_data_serialize(&targetP->uri, size, dataP, &(watcherP->format), &buffer);
-                            if (res < 0)
-                            {
-                                break;
-                            }
-                            else
-                            {
-                                length = (size_t)res;
-                            }
-
-                        }
-                        else
-                        {
-                            if (COAP_205_CONTENT != object_read(contextP, &targetP->uri, &(watcherP->format), &buffer, &length))
-                            {
-                                buffer = NULL;
-                                break;
-                            }
-                        }
-                        coap_init_message(message, COAP_TYPE_NON, COAP_205_CONTENT, 0);
-                        coap_set_header_content_type(message, watcherP->format);
-                        coap_set_payload(message, buffer, length);
-                    }
-                    watcherP->lastTime = currentTime;
                     watcherP->lastMid = contextP->nextMID++;
                     message->mid = watcherP->lastMid;
                     coap_set_header_token(message, watcherP->token, watcherP->tokenLen);
                     coap_set_header_observe(message, watcherP->counter++);
                     (void)message_send(contextP, message, watcherP->server->sessionH);
-                    watcherP->update = false;
                 }
-
-                // Store this value
-                if (notify == true && storeValue == true)
+                else
                 {
-                    switch (dataP->type)
-                    {
-                    case LWM2M_TYPE_INTEGER:
-                        watcherP->lastValue.asInteger = integerValue;
-                        break;
-                    case LWM2M_TYPE_FLOAT:
-                        watcherP->lastValue.asFloat = floatValue;
-                        break;
-                    default:
-                        break;
-                    }
+                    payloadP = NULL;
                 }
+            }
+        }
+
+        if (payloadP != NULL)
+        {
+            watcherP->lastTime = currentTime;
+            watcherP->update = false;
 
-                if (watcherP->parameters != NULL && (watcherP->parameters->toSet & LWM2M_ATTR_FLAG_MAX_PERIOD) != 0)
+            // Store this value
+            if (storeValue == true)
+            {
+                switch (dataP->type)
                 {
-                    // update timers
-                    interval = watcherP->lastTime + watcherP->parameters->maxPeriod - currentTime;
-                    if (*timeoutP > interval) *timeoutP = interval;
+                case LWM2M_TYPE_INTEGER:
+                    watcherP->lastValue.asInteger = integerValue;
+                    break;
+                case LWM2M_TYPE_FLOAT:
+                    watcherP->lastValue.asFloat = floatValue;
+                    break;
+                default:
+                    break;
                 }
             }
         }
-        if (dataP != NULL) lwm2m_data_free(size, dataP);
-        if (buffer != NULL) lwm2m_free(buffer);
+        else if (notify == true)
+        {
+            // the resource could not be serialized, try again later
+            (void)timer_schedule(contextP, &watcherP->timer, currentTimeMs + 1000);
+            continue;
+        }
+
+        prv_scheduleWatcher(contextP, watcherP, currentTime);
+    }
+
+    while (payloadCount > 0)
+    {
+        payloadCount--;
+        lwm2m_free(payloads[payloadCount].buffer);
     }
+    if (dataP != NULL) data_free(&contextP->dataArena, size, dataP);
+    arena_leave(&contextP->dataArena);
 }
 
 #endif
 
 #ifdef LWM2M_SERVER_MODE
 
+// observation tokens are the client internal ID followed by the observation ID
+#define OBSERVE_TOKEN_LEN   6
+
 typedef struct
 {
-    uint16_t                client;
+    uint32_t                client;
     lwm2m_uri_t             uri;
     lwm2m_result_callback_t callbackP;
     void *                  userDataP;
@@ -767,14 +1181,78 @@ typedef struct
 typedef struct
 {
     uint16_t                id;
-    uint16_t                client;
+    uint32_t                client;
     lwm2m_uri_t             uri;
     lwm2m_result_callback_t callback;
     void *                  userData;
     lwm2m_context_t *       contextP;
+    lwm2m_media_type_t      format;
 } observation_data_t;
 
+// a notification sent in several blocks, while its next blocks are asked for
+typedef struct
+{
+    lwm2m_context_t *       contextP;
+    uint8_t                 token[OBSERVE_TOKEN_LEN];
+    uint32_t                count;
+} notify_blocks_data_t;
+
+
+
+static void prv_setToken(uint8_t token[OBSERVE_TOKEN_LEN],
+                         uint32_t clientID,
+                         uint16_t obsID)
+{
+    token[0] = (uint8_t)(clientID >> 24);
+    token[1] = (uint8_t)(clientID >> 16);
+    token[2] = (uint8_t)(clientID >> 8);
+    token[3] = (uint8_t)clientID;
+    token[4] = (uint8_t)(obsID >> 8);
+    token[5] = (uint8_t)obsID;
+}
+
+/*
+ * Observations of all the clients are indexed by their token so that a notification
+ * is routed with a single lookup.
+ */
+static bool prv_matchToken(void * itemP,
+                           void * userData)
+{
+    lwm2m_observation_t * observationP = (lwm2m_observation_t *)itemP;
+    uint8_t token[OBSERVE_TOKEN_LEN];
 
+    prv_setToken(token, observationP->clientP->internalID, observationP->id);
+
+    return memcmp(token, userData, OBSERVE_TOKEN_LEN) == 0;
+}
+
+static lwm2m_observation_t * prv_findObservation(lwm2m_context_t * contextP,
+                                                 uint8_t token[OBSERVE_TOKEN_LEN])
+{
+    return (lwm2m_observation_t *)hash_find(&contextP->observationIndex, hash_buffer(token, OBSERVE_TOKEN_LEN), prv_matchToken, token);
+}
+
+static bool prv_addObservation(lwm2m_context_t * contextP,
+                               lwm2m_observation_t * observationP)
+{
+    uint8_t token[OBSERVE_TOKEN_LEN];
+
+    prv_setToken(token, observationP->clientP->internalID, observationP->id);
+    if (!hash_add(&contextP->observationIndex, hash_buffer(token, OBSERVE_TOKEN_LEN), observationP)) return false;
+    observationP->clientP->observationList = (lwm2m_observation_t *)LWM2M_LIST_ADD(observationP->clientP->observationList, observationP);
+
+    return true;
+}
+
+static void prv_unlinkObservation(lwm2m_context_t * contextP,
+                                  lwm2m_observation_t * observationP)
+{
+    uint8_t token[OBSERVE_TOKEN_LEN];
+
+    prv_setToken(token, observationP->clientP->internalID, observationP->id);
+    hash_remove(&contextP->observationIndex, hash_buffer(token, OBSERVE_TOKEN_LEN), observationP);
+    observationP->clientP->observationList = (lwm2m_observation_t *)LWM2M_LIST_RM(observationP->clientP->observationList, observationP->id, NULL);
+}
 
 static lwm2m_observation_t * prv_findObservationByURI(lwm2m_client_t * clientP,
                                                       lwm2m_uri_t * uriP)
@@ -798,10 +1276,11 @@ static lwm2m_observation_t * prv_findObservationByURI(lwm2m_client_t * clientP,
     return targetP;
 }
 
-void observe_remove(lwm2m_observation_t * observationP)
+void observe_remove(lwm2m_context_t * contextP,
+                    lwm2m_observation_t * observationP)
 {
     LOG("Entering");
-    observationP->clientP->observationList = (lwm2m_observation_t *) LWM2M_LIST_RM(observationP->clientP->observationList, observationP->id, NULL);
+    prv_unlinkObservation(contextP, observationP);
     lwm2m_free(observationP);
 }
 
@@ -815,7 +1294,7 @@ static void prv_obsRequestCallback(lwm2m_transaction_t * transacP,
     lwm2m_client_t * clientP;
     lwm2m_uri_t * uriP = & observationData->uri;
 
-    clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)observationData->contextP->clientList, observationData->client);
+    clientP = registration_findClient(observationData->contextP, observationData->client);
     if (clientP == NULL)
     {
         observationData->callback(observationData->client,
@@ -865,7 +1344,7 @@ static void prv_obsRequestCallback(lwm2m_transaction_t * transacP,
         }
         else
         {
-            observationP->clientP->observationList = (lwm2m_observation_t *) LWM2M_LIST_RM(observationP->clientP->observationList, observationP->id, NULL);
+            prv_unlinkObservation(observationData->contextP, observationP);
 
             // give the user chance to free previous observation userData
             // indicator: COAP_202_DELETED and (Length ==0)
@@ -883,13 +1362,30 @@ static void prv_obsRequestCallback(lwm2m_transaction_t * transacP,
         observationP->userData = observationData->userData;
         observationP->status = STATE_REGISTERED;
         memcpy(&observationP->uri, uriP, sizeof(lwm2m_uri_t));
+        if (IS_OPTION(packet, COAP_OPTION_CONTENT_TYPE))
+        {
+            observationP->format = (lwm2m_media_type_t)packet->content_type;
+        }
+        else
+        {
+            observationP->format = observationData->format;
+        }
 
-        observationP->clientP->observationList = (lwm2m_observation_t *)LWM2M_LIST_ADD(observationP->clientP->observationList, observationP);
+        if (!prv_addObservation(observationData->contextP, observationP))
+        {
+            lwm2m_free(observationP);
+            observationData->callback(observationData->client,
+                    &observationData->uri,
+                    COAP_500_INTERNAL_SERVER_ERROR,
+                    LWM2M_CONTENT_TEXT, NULL, 0,
+                    observationData->userData);
+            goto end;
+        }
 
         observationData->callback(observationData->client,
                 &observationData->uri,
                 0,
-                packet->content_type, packet->payload, packet->payload_len,
+                (lwm2m_media_type_t)packet->content_type, packet->payload, packet->payload_len,
                 observationData->userData);
     }
 
@@ -904,14 +1400,14 @@ static void prv_obsCancelRequestCallback(lwm2m_transaction_t * transacP,
     cancellation_data_t * cancelP = (cancellation_data_t *)transacP->userData;
     coap_packet_t * packet = (coap_packet_t *)message;
     uint8_t code;
-    lwm2m_client_t * clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)cancelP->contextP->clientList, cancelP->client);
+    lwm2m_client_t * clientP = registration_findClient(cancelP->contextP, cancelP->client);
 
     if (clientP == NULL)
     {
         cancelP->callbackP(cancelP->client,
                 &cancelP->uri,
                 COAP_500_INTERNAL_SERVER_ERROR,
-                packet->content_type, NULL, 0,
+                LWM2M_CONTENT_TEXT, NULL, 0,
                 cancelP->userDataP);
         goto end;
     }
@@ -940,18 +1436,21 @@ static void prv_obsCancelRequestCallback(lwm2m_transaction_t * transacP,
         cancelP->callbackP(cancelP->client,
                 &cancelP->uri,
                 0,
-                packet->content_type, packet->payload, packet->payload_len,
+                (lwm2m_media_type_t)packet->content_type, packet->payload, packet->payload_len,
                 cancelP->userDataP);
     }
 
-    observe_remove(observationP);
+    if (observationP != NULL)
+    {
+        observe_remove(cancelP->contextP, observationP);
+    }
 end:
     lwm2m_free(cancelP);
 }
 
 
 int lwm2m_observe(lwm2m_context_t * contextP,
-        uint16_t clientID,
+        uint32_t clientID,
         lwm2m_uri_t * uriP,
         lwm2m_result_callback_t callback,
         void * userData)
@@ -960,14 +1459,14 @@ int lwm2m_observe(lwm2m_context_t * contextP,
     lwm2m_transaction_t * transactionP;
     observation_data_t * observationData;
     lwm2m_observation_t * observationP;
-    uint8_t token[4];
+    uint8_t token[OBSERVE_TOKEN_LEN];
 
-    LOG_ARG("clientID: %d", clientID);
+    LOG_ARG("clientID: %u", clientID);
     LOG_URI(uriP);
 
     if (!LWM2M_URI_IS_SET_INSTANCE(uriP) && LWM2M_URI_IS_SET_RESOURCE(uriP)) return COAP_400_BAD_REQUEST;
 
-    clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)contextP->clientList, clientID);
+    clientP = registration_findClient(contextP, clientID);
     if (clientP == NULL) return COAP_404_NOT_FOUND;
 
     observationP = prv_findObservationByURI(clientP, uriP);
@@ -977,9 +1476,10 @@ int lwm2m_observe(lwm2m_context_t * contextP,
     memset(observationData, 0, sizeof(observation_data_t));
 
     observationData->id = ++clientP->observationId;
+    prv_setToken(token, clientP->internalID, observationData->id);
 
     // observationId can overflow. ensure new ID is not already present
-    if(lwm2m_list_find((lwm2m_list_t *)clientP->observationList, observationData->id))
+    if (prv_findObservation(contextP, token) != NULL)
     {
         LOG("Can't get available observation ID. Request failed.\n");
         lwm2m_free(observationData);
@@ -994,12 +1494,7 @@ int lwm2m_observe(lwm2m_context_t * contextP,
     observationData->userData = userData;
     observationData->contextP = contextP;
 
-    token[0] = clientP->internalID >> 8;
-    token[1] = clientP->internalID & 0xFF;
-    token[2] = observationData->id >> 8;
-    token[3] = observationData->id & 0xFF;
-
-    transactionP = transaction_new(clientP->sessionH, COAP_GET, clientP->altPath, uriP, contextP->nextMID++, 4, token);
+    transactionP = transaction_new(clientP->sessionH, COAP_GET, clientP->altPath, uriP, contextP->nextMID++, OBSERVE_TOKEN_LEN, token);
     if (transactionP == NULL)
     {
         lwm2m_free(observationData);
@@ -1009,12 +1504,13 @@ int lwm2m_observe(lwm2m_context_t * contextP,
     coap_set_header_observe(transactionP->message, 0);
     if (clientP->supportJSON == true)
     {
-        coap_set_header_accept(transactionP->message, LWM2M_CONTENT_JSON);
+        observationData->format = LWM2M_CONTENT_JSON;
     }
     else
     {
-        coap_set_header_accept(transactionP->message, LWM2M_CONTENT_TLV);
+        observationData->format = LWM2M_CONTENT_TLV;
     }
+    coap_set_header_accept(transactionP->message, observationData->format);
 
     transactionP->callback = prv_obsRequestCallback;
     transactionP->userData = (void *)observationData;
@@ -1034,7 +1530,7 @@ int lwm2m_observe(lwm2m_context_t * contextP,
 }
 
 int lwm2m_observe_cancel(lwm2m_context_t * contextP,
-        uint16_t clientID,
+        uint32_t clientID,
         lwm2m_uri_t * uriP,
         lwm2m_result_callback_t callback,
         void * userData)
@@ -1043,10 +1539,10 @@ int lwm2m_observe_cancel(lwm2m_context_t * contextP,
     lwm2m_observation_t * observationP;
     int ret;
 
-    LOG_ARG("clientID: %d", clientID);
+    LOG_ARG("clientID: %u", clientID);
     LOG_URI(uriP);
 
-    clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)contextP->clientList, clientID);
+    clientP = registration_findClient(contextP, clientID);
     if (clientP == NULL) return COAP_404_NOT_FOUND;
 
     observationP = prv_findObservationByURI(clientP, uriP);
@@ -1058,14 +1554,11 @@ int lwm2m_observe_cancel(lwm2m_context_t * contextP,
     {
         lwm2m_transaction_t * transactionP;
         cancellation_data_t * cancelP;
-        uint8_t token[4];
+        uint8_t token[OBSERVE_TOKEN_LEN];
 
-        token[0] = clientP->internalID >> 8;
-        token[1] = clientP->internalID & 0xFF;
-        token[2] = observationP->id >> 8;
-        token[3] = observationP->id & 0xFF;
+        prv_setToken(token, clientP->internalID, observationP->id);
 
-        transactionP = transaction_new(clientP->sessionH, COAP_GET, clientP->altPath, uriP, contextP->nextMID++, 4, token);
+        transactionP = transaction_new(clientP->sessionH, COAP_GET, clientP->altPath, uriP, contextP->nextMID++, OBSERVE_TOKEN_LEN, token);
         if (transactionP == NULL)
         {
             return COAP_500_INTERNAL_SERVER_ERROR;
@@ -1093,7 +1586,7 @@ int lwm2m_observe_cancel(lwm2m_context_t * contextP,
 
         observationP->status = STATE_DEREG_PENDING;
 
-        int ret = transaction_send(contextP, transactionP);
+        ret = transaction_send(contextP, transactionP);
         if (ret != 0) lwm2m_free(cancelP);
         return ret;
     }
@@ -1110,12 +1603,96 @@ int lwm2m_observe_cancel(lwm2m_context_t * contextP,
     }
 
     // no other chance to remove the observationP since not sending a transaction
-    observe_remove(observationP);
+    observe_remove(contextP, observationP);
 
     // need to give a indicator (non-zero) to user for properly freeing the userData
     return ret;
 }
 
+static void prv_notifyBlocksCallback(lwm2m_transaction_t * transacP,
+                                     void * message)
+{
+    notify_blocks_data_t * dataP = (notify_blocks_data_t *)transacP->userData;
+    coap_packet_t * packet = (coap_packet_t *)message;
+    lwm2m_observation_t * observationP;
+
+    observationP = prv_findObservation(dataP->contextP, dataP->token);
+    if (observationP == NULL)
+    {
+        LOG("Observation cancelled while getting the notification blocks");
+    }
+    else if (packet == NULL || packet->code != COAP_205_CONTENT)
+    {
+        // the representation changed or the client is gone, the next notification will tell
+        LOG("Notification blocks could not be retrieved");
+    }
+    else
+    {
+        observationP->callback(observationP->clientP->internalID,
+                               &observationP->uri,
+                               (int)dataP->count,
+                               observationP->format, packet->payload, packet->payload_len,
+                               observationP->userData);
+    }
+
+    lwm2m_free(dataP);
+}
+
+// asks for the blocks following the first one of a notification (RFC 7959 section 3.4),
+// the transaction reassembles them after the payload of message
+static void prv_getNotificationBlocks(lwm2m_context_t * contextP,
+                                      lwm2m_observation_t * observationP,
+                                      coap_packet_t * message,
+                                      uint32_t count)
+{
+    lwm2m_transaction_t * transacP;
+    notify_blocks_data_t * dataP;
+    const uint8_t * etag;
+    int etagLen;
+    uint16_t size;
+
+    if (!coap_get_header_block2(message, NULL, NULL, &size, NULL)) return;
+    etagLen = coap_get_header_etag(message, &etag);
+    if (etagLen > (int)sizeof(((lwm2m_transaction_t *)NULL)->block2ETag)) return;
+
+    dataP = (notify_blocks_data_t *)lwm2m_malloc(sizeof(notify_blocks_data_t));
+    if (dataP == NULL) return;
+    dataP->contextP = contextP;
+    prv_setToken(dataP->token, observationP->clientP->internalID, observationP->id);
+    dataP->count = count;
+
+    transacP = transaction_new(observationP->clientP->sessionH, COAP_GET, observationP->clientP->altPath, &observationP->uri, contextP->nextMID++, 4, NULL);
+    if (transacP == NULL)
+    {
+        lwm2m_free(dataP);
+        return;
+    }
+    transacP->block2Buffer = (uint8_t *)lwm2m_malloc(message->payload_len);
+    if (transacP->block2Buffer == NULL)
+    {
+        transaction_free(transacP);
+        lwm2m_free(dataP);
+        return;
+    }
+    memcpy(transacP->block2Buffer, message->payload, message->payload_len);
+    transacP->block2Length = message->payload_len;
+    transacP->block2Size = message->payload_len;
+    transacP->block2ETagLen = (uint8_t)etagLen;
+    if (etagLen > 0) memcpy(transacP->block2ETag, etag, etagLen);
+    coap_set_header_block2(transacP->message, 1, 0, size);
+    coap_set_header_accept(transacP->message, observationP->format);
+
+    transacP->callback = prv_notifyBlocksCallback;
+    transacP->userData = (void *)dataP;
+    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transacP);
+
+    if (transaction_send(contextP, transacP) == COAP_500_INTERNAL_SERVER_ERROR)
+    {
+        // the transaction was removed without calling back
+        lwm2m_free(dataP);
+    }
+}
+
 bool observe_handleNotify(lwm2m_context_t * contextP,
                            void * fromSessionH,
                            coap_packet_t * message,
@@ -1123,27 +1700,23 @@ bool observe_handleNotify(lwm2m_context_t * contextP,
 {
     uint8_t * tokenP;
     int token_len;
-    uint16_t clientID;
-    uint16_t obsID;
-    lwm2m_client_t * clientP;
     lwm2m_observation_t * observationP;
     uint32_t count;
 
     LOG("Entering");
     token_len = coap_get_header_token(message, (const uint8_t **)&tokenP);
-    if (token_len != sizeof(uint32_t)) return false;
+    if (token_len != OBSERVE_TOKEN_LEN) return false;
 
     if (1 != coap_get_header_observe(message, &count)) return false;
 
-    clientID = (tokenP[0] << 8) | tokenP[1];
-    obsID = (tokenP[2] << 8) | tokenP[3];
-
-    clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)contextP->clientList, clientID);
-    if (clientP == NULL) return false;
-
-    observationP = (lwm2m_observation_t *)lwm2m_list_find((lwm2m_list_t *)clientP->observationList, obsID);
+    observationP = prv_findObservation(contextP, tokenP);
     if (observationP == NULL)
     {
+        uint32_t clientID;
+
+        clientID = ((uint32_t)tokenP[0] << 24) | ((uint32_t)tokenP[1] << 16) | ((uint32_t)tokenP[2] << 8) | tokenP[3];
+        if (registration_findClient(contextP, clientID) == NULL) return false;
+
         coap_init_message(response, COAP_TYPE_RST, 0, message->mid);
         message_send(contextP, response, fromSessionH);
     }
@@ -1153,11 +1726,22 @@ bool observe_handleNotify(lwm2m_context_t * contextP,
             coap_init_message(response, COAP_TYPE_ACK, 0, message->mid);
             message_send(contextP, response, fromSessionH);
         }
-        observationP->callback(clientID,
-                               &observationP->uri,
-                               (int)count,
-                               message->content_type, message->payload, message->payload_len,
-                               observationP->userData);
+        if (IS_OPTION(message, COAP_OPTION_CONTENT_TYPE))
+        {
+            observationP->format = (lwm2m_media_type_t)message->content_type;
+        }
+        if (IS_OPTION(message, COAP_OPTION_BLOCK2) && message->block2_more)
+        {
+            prv_getNotificationBlocks(contextP, observationP, message, count);
+        }
+        else
+        {
+            observationP->callback(observationP->clientP->internalID,
+                                   &observationP->uri,
+                                   (int)count,
+                                   observationP->format, message->payload, message->payload_len,
+                                   observationP->userData);
+        }
     }
     return true;
 }
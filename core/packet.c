@@ -106,7 +106,8 @@ static void handle_reset(lwm2m_context_t * contextP,
 static uint8_t handle_request(lwm2m_context_t * contextP,
                               void * fromSessionH,
                               coap_packet_t * message,
-                              coap_packet_t * response)
+                              coap_packet_t * response,
+                              dm_read_t * readP)
 {
     lwm2m_uri_t * uriP;
     uint8_t result = COAP_IGNORE;
@@ -131,7 +132,7 @@ static uint8_t handle_request(lwm2m_context_t * contextP,
         serverP = utils_findServer(contextP, fromSessionH);
         if (serverP != NULL)
         {
-            result = dm_handleRequest(contextP, uriP, serverP, message, response);
+            result = dm_handleRequest(contextP, uriP, serverP, message, response, readP);
         }
 #ifdef LWM2M_BOOTSTRAP
         else
@@ -193,6 +194,92 @@ static uint8_t handle_request(lwm2m_context_t * contextP,
     return result;
 }
 
+static bool prv_reserveSendBuffer(lwm2m_context_t * contextP,
+                                  size_t length)
+{
+    if (length < LWM2M_SEND_BUFFER_SIZE) length = LWM2M_SEND_BUFFER_SIZE;
+    if (contextP->sendBuffer != NULL && length <= contextP->sendBufferSize) return true;
+
+    if (contextP->sendBuffer != NULL) lwm2m_free(contextP->sendBuffer);
+    contextP->sendBuffer = (uint8_t *)lwm2m_malloc(length);
+    if (contextP->sendBuffer == NULL)
+    {
+        contextP->sendBufferSize = 0;
+        return false;
+    }
+    contextP->sendBufferSize = length;
+
+    return true;
+}
+
+#ifdef LWM2M_CLIENT_MODE
+/*
+ * The result of a read answered in a single message is serialized straight into the send
+ * buffer. The payload is written first, after room for the header reserved with
+ * coap_serialize_get_size(), so the header is only serialized once the payload is known
+ * to fit in a block.
+ * A larger result, or one asked block by block, is serialized in its own buffer and left in
+ * the response for block2_set(), which needs a stable representation to slice.
+ * Returns false when the payload was left in the response.
+ */
+static bool prv_sendReadData(lwm2m_context_t * contextP,
+                             dm_read_t * readP,
+                             coap_packet_t * message,
+                             coap_packet_t * response,
+                             void * sessionH,
+                             uint16_t blockSize,
+                             uint8_t * resultP)
+{
+    uint8_t * buffer = NULL;
+    size_t headerSize;
+    size_t length;
+    size_t offset = 0;
+    int res;
+
+    headerSize = coap_serialize_get_size(response);
+    if (!IS_OPTION(message, COAP_OPTION_BLOCK2)
+     && prv_reserveSendBuffer(contextP, headerSize + 1 + blockSize + 1))
+    {
+        // one more byte than a block tells whether it fits
+        res = data_serializeChunk(&readP->uri, readP->size, readP->dataP, readP->format,
+                                  &offset, contextP->sendBuffer + headerSize + 1, blockSize + 1);
+        if (res < 0)
+        {
+            *resultP = COAP_500_INTERNAL_SERVER_ERROR;
+            return true;
+        }
+        if (res <= blockSize)
+        {
+            length = coap_serialize_message_len(response, contextP->sendBuffer, headerSize);
+            if (length == 0)
+            {
+                *resultP = COAP_500_INTERNAL_SERVER_ERROR;
+                return true;
+            }
+            if (res > 0)
+            {
+                // payload marker
+                contextP->sendBuffer[length] = 0xFF;
+                memmove(contextP->sendBuffer + length + 1, contextP->sendBuffer + headerSize + 1, (size_t)res);
+                length += 1 + (size_t)res;
+            }
+            *resultP = lwm2m_buffer_send(sessionH, contextP->sendBuffer, length, contextP->userData);
+            return true;
+        }
+    }
+
+    res = lwm2m_data_serialize(&readP->uri, readP->size, readP->dataP, &readP->format, &buffer);
+    if (res < 0)
+    {
+        *resultP = COAP_500_INTERNAL_SERVER_ERROR;
+        return true;
+    }
+    coap_set_payload(response, buffer, (size_t)res);
+
+    return false;
+}
+#endif
+
 /* This function is an adaptation of function coap_receive() from Erbium's er-coap-13-engine.c.
  * Erbium is Copyright (c) 2013, Institute for Pervasive Computing, ETH Zurich
  * All rights reserved.
@@ -203,10 +290,14 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
                          void * fromSessionH)
 {
     uint8_t coap_error_code = NO_ERROR;
-    static coap_packet_t message[1];
-    static coap_packet_t response[1];
+    coap_packet_t message[1];
+    coap_packet_t response[1];
+    dm_read_t read;
+    const char * error_message;
 
     LOG("Entering");
+    memset(&read, 0, sizeof(dm_read_t));
+    arena_enter(&contextP->dataArena);
     coap_error_code = coap_parse_message(message, buffer, (uint16_t)length);
     if (coap_error_code == NO_ERROR)
     {
@@ -216,9 +307,8 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
         if (message->code >= COAP_GET && message->code <= COAP_DELETE)
         {
             uint32_t block_num = 0;
-            uint16_t block_size = REST_MAX_CHUNK_SIZE;
-            uint32_t block_offset = 0;
-            int64_t new_offset = 0;
+            uint16_t block_size = contextP->blockSize;
+            bool cached = false;
 
             /* prepare response */
             if (message->type == COAP_TYPE_CON)
@@ -238,12 +328,11 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
                 coap_set_header_token(response, message->token, message->token_len);
             }
 
-            /* get offset for blockwise transfers */
-            if (coap_get_header_block2(message, &block_num, NULL, &block_size, &block_offset))
+            /* get block size for blockwise transfers */
+            if (coap_get_header_block2(message, &block_num, NULL, &block_size, NULL))
             {
-                LOG_ARG("Blockwise: block request %u (%u/%u) @ %u bytes", block_num, block_size, REST_MAX_CHUNK_SIZE, block_offset);
-                block_size = MIN(block_size, REST_MAX_CHUNK_SIZE);
-                new_offset = block_offset;
+                LOG_ARG("Blockwise: block request %u (%u/%u)", block_num, block_size, contextP->blockSize);
+                block_size = MIN(block_size, contextP->blockSize);
             }
 
             /* handle block1 option */
@@ -252,7 +341,9 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
 #ifdef LWM2M_CLIENT_MODE
                 // get server
                 lwm2m_server_t * serverP;
+                bool isDmServer;
                 serverP = utils_findServer(contextP, fromSessionH);
+                isDmServer = (serverP != NULL);
 #ifdef LWM2M_BOOTSTRAP
                 if (serverP == NULL)
                 {
@@ -268,15 +359,35 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
                     uint32_t block1_num;
                     uint8_t  block1_more;
                     uint16_t block1_size;
+                    uint32_t size1 = 0;
                     uint8_t * complete_buffer = NULL;
                     size_t complete_buffer_size;
+                    char * uri;
 
                     // parse block1 header
                     coap_get_header_block1(message, &block1_num, &block1_more, &block1_size, NULL);
+                    coap_get_header_size1(message, &size1);
                     LOG_ARG("Blockwise: block1 request NUM %u (SZX %u/ SZX Max%u) MORE %u", block1_num, block1_size, REST_MAX_CHUNK_SIZE, block1_more);
 
                     // handle block 1
-                    coap_error_code = coap_block1_handler(&serverP->block1Data, message->mid, message->payload, message->payload_len, block1_size, block1_num, block1_more, &complete_buffer, &complete_buffer_size);
+                    uri = coap_get_multi_option_as_string(message->uri_path);
+                    if (uri == NULL)
+                    {
+                        coap_error_code = COAP_500_INTERNAL_SERVER_ERROR;
+                    }
+                    else
+                    {
+                        // objects may take the blocks as they arrive
+                        if (isDmServer)
+                        {
+                            coap_error_code = dm_handleBlockWrite(contextP, serverP, uri, message);
+                        }
+                        if (coap_error_code == NO_ERROR)
+                        {
+                            coap_error_code = coap_block1_handler(&serverP->block1Data, uri, message->mid, message->payload, message->payload_len, block1_size, block1_num, block1_more, size1, contextP->block1MaxSize, &complete_buffer, &complete_buffer_size);
+                        }
+                        lwm2m_free(uri);
+                    }
 
                     // if payload is complete, replace it in the coap message.
                     if (coap_error_code == NO_ERROR)
@@ -284,11 +395,15 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
                         message->payload = complete_buffer;
                         message->payload_len = complete_buffer_size;
                     }
-                    else if (coap_error_code == COAP_231_CONTINUE)
+                    else if (coap_error_code == COAP_231_CONTINUE || coap_error_code == COAP_204_CHANGED)
                     {
-                        block1_size = MIN(block1_size, REST_MAX_CHUNK_SIZE);
+                        block1_size = MIN(block1_size, contextP->blockSize);
                         coap_set_header_block1(response,block1_num, block1_more,block1_size);
                     }
+                    else if (coap_error_code == COAP_413_ENTITY_TOO_LARGE)
+                    {
+                        coap_set_header_size1(response, (uint32_t)contextP->block1MaxSize);
+                    }
                 }
 #else
                 coap_error_code = COAP_501_NOT_IMPLEMENTED;
@@ -296,52 +411,45 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
             }
             if (coap_error_code == NO_ERROR)
             {
-                coap_error_code = handle_request(contextP, fromSessionH, message, response);
+                /* next blocks of a representation are served from the block2 cache */
+                if (message->code == COAP_GET && block_num > 0)
+                {
+                    cached = block2_get(contextP, fromSessionH, message, response, block_num, block_size);
+                }
+                if (!cached)
+                {
+                    coap_error_code = handle_request(contextP, fromSessionH, message, response, &read);
+                }
             }
             if (coap_error_code==NO_ERROR)
             {
-                /* Save original payload pointer for later freeing. Payload in response may be updated. */
-                uint8_t *payload = response->payload;
-                if ( IS_OPTION(message, COAP_OPTION_BLOCK2) )
-                {
-                    /* unchanged new_offset indicates that resource is unaware of blockwise transfer */
-                    if (new_offset==block_offset)
-                    {
-                        LOG_ARG("Blockwise: unaware resource with payload length %u/%u", response->payload_len, block_size);
-                        if (block_offset >= response->payload_len)
-                        {
-                            LOG("handle_incoming_data(): block_offset >= response->payload_len");
+                bool sent = false;
 
-                            response->code = COAP_402_BAD_OPTION;
-                            coap_set_payload(response, "BlockOutOfScope", 15); /* a const char str[] and sizeof(str) produces larger code size */
-                        }
-                        else
-                        {
-                            coap_set_header_block2(response, block_num, response->payload_len - block_offset > block_size, block_size);
-                            coap_set_payload(response, response->payload+block_offset, MIN(response->payload_len - block_offset, block_size));
-                        } /* if (valid offset) */
-                    }
-                    else
-                    {
-                        /* resource provides chunk-wise data */
-                        LOG_ARG("Blockwise: blockwise resource, new offset %d", (int) new_offset);
-                        coap_set_header_block2(response, block_num, new_offset!=-1 || response->payload_len > block_size, block_size);
-                        if (response->payload_len > block_size) coap_set_payload(response, response->payload, block_size);
-                    } /* if (resource aware of blockwise) */
+#ifdef LWM2M_CLIENT_MODE
+                if (read.dataP != NULL)
+                {
+                    sent = prv_sendReadData(contextP, &read, message, response, fromSessionH, block_size, &coap_error_code);
                 }
-                else if (new_offset!=0)
+#endif
+                if (!sent)
                 {
-                    LOG_ARG("Blockwise: no block option for blockwise resource, using block size %u", REST_MAX_CHUNK_SIZE);
+                    /* Save original payload pointer for later freeing. Payload in response may be updated. */
+                    uint8_t *payload = cached ? NULL : response->payload;
 
-                    coap_set_header_block2(response, 0, new_offset!=-1, REST_MAX_CHUNK_SIZE);
-                    coap_set_payload(response, response->payload, MIN(response->payload_len, REST_MAX_CHUNK_SIZE));
-                } /* if (blockwise request) */
+                    if (!cached
+                     && response->code == COAP_205_CONTENT
+                     && block2_set(contextP, fromSessionH, message, response, block_num, block_size))
+                    {
+                        /* the payload is kept by the block2 cache */
+                        payload = NULL;
+                    }
 
-                coap_error_code = message_send(contextP, response, fromSessionH);
+                    coap_error_code = message_send(contextP, response, fromSessionH);
 
-                lwm2m_free(payload);
-                response->payload = NULL;
-                response->payload_len = 0;
+                    lwm2m_free(payload);
+                    response->payload = NULL;
+                    response->payload_len = 0;
+                }
             }
             else if (coap_error_code != COAP_IGNORE)
             {
@@ -399,7 +507,8 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
 
     if (coap_error_code != NO_ERROR && coap_error_code != COAP_IGNORE)
     {
-        LOG_ARG("ERROR %u: %s", coap_error_code, coap_error_message);
+        error_message = message->error_message != NULL ? message->error_message : "";
+        LOG_ARG("ERROR %u: %s", coap_error_code, error_message);
 
         /* Set to sendable error code. */
         if (coap_error_code >= 192)
@@ -408,38 +517,75 @@ void lwm2m_handle_packet(lwm2m_context_t * contextP,
         }
         /* Reuse input buffer for error message. */
         coap_init_message(message, COAP_TYPE_ACK, coap_error_code, message->mid);
-        coap_set_payload(message, coap_error_message, strlen(coap_error_message));
+        coap_set_payload(message, error_message, strlen(error_message));
         message_send(contextP, message, fromSessionH);
     }
+
+    if (read.dataP != NULL)
+    {
+        data_free(&contextP->dataArena, read.size, read.dataP);
+    }
+
+    // the data trees built while handling the message are gone
+    arena_leave(&contextP->dataArena);
 }
 
 
-uint8_t message_send(lwm2m_context_t * contextP,
-                     coap_packet_t * message,
-                     void * sessionH)
+/*
+ * Serializes the message in the context send buffer and returns it. The buffer
+ * is only valid until the next call. It grows to coap_serialize_get_size() when
+ * the message does not fit so the size is only computed for large messages.
+ * The options of the message are released unless keepOptions is set.
+ */
+uint8_t * message_serialize(lwm2m_context_t * contextP,
+                            coap_packet_t * message,
+                            bool keepOptions,
+                            size_t * lengthP)
 {
-    uint8_t result = COAP_500_INTERNAL_SERVER_ERROR;
-    uint8_t * pktBuffer;
-    size_t pktBufferLen = 0;
     size_t allocLen;
 
-    LOG("Entering");
+    if (!prv_reserveSendBuffer(contextP, LWM2M_SEND_BUFFER_SIZE)) return NULL;
+
+    if (keepOptions)
+    {
+        *lengthP = coap_serialize_message_keep(message, contextP->sendBuffer, contextP->sendBufferSize);
+    }
+    else
+    {
+        *lengthP = coap_serialize_message_len(message, contextP->sendBuffer, contextP->sendBufferSize);
+    }
+    if (*lengthP != 0) return contextP->sendBuffer;
+
     allocLen = coap_serialize_get_size(message);
     LOG_ARG("Size to allocate: %d", allocLen);
-    if (allocLen == 0) return COAP_500_INTERNAL_SERVER_ERROR;
+    if (allocLen == 0) return NULL;
+    if (!prv_reserveSendBuffer(contextP, allocLen)) return NULL;
 
-    pktBuffer = (uint8_t *)lwm2m_malloc(allocLen);
-    if (pktBuffer != NULL)
+    if (keepOptions)
     {
-        pktBufferLen = coap_serialize_message(message, pktBuffer);
-        LOG_ARG("coap_serialize_message() returned %d", pktBufferLen);
-        if (0 != pktBufferLen)
-        {
-            result = lwm2m_buffer_send(sessionH, pktBuffer, pktBufferLen, contextP->userData);
-        }
-        lwm2m_free(pktBuffer);
+        *lengthP = coap_serialize_message_keep(message, contextP->sendBuffer, allocLen);
+    }
+    else
+    {
+        *lengthP = coap_serialize_message(message, contextP->sendBuffer);
     }
+    if (*lengthP == 0) return NULL;
 
-    return result;
+    return contextP->sendBuffer;
+}
+
+uint8_t message_send(lwm2m_context_t * contextP,
+                     coap_packet_t * message,
+                     void * sessionH)
+{
+    uint8_t * pktBuffer;
+    size_t pktBufferLen = 0;
+
+    LOG("Entering");
+    pktBuffer = message_serialize(contextP, message, false, &pktBufferLen);
+    LOG_ARG("message_serialize() returned %d bytes", pktBufferLen);
+    if (pktBuffer == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
+
+    return lwm2m_buffer_send(sessionH, pktBuffer, pktBufferLen, contextP->userData);
 }
 
@@ -60,7 +60,7 @@
 #include <string.h>
 #include <stdio.h>
 
-#define MAX_LOCATION_LENGTH 10      // strlen("/rd/65534") + 1
+#define MAX_LOCATION_LENGTH 15      // strlen("/rd/4294967295") + 1
 
 #ifdef LWM2M_CLIENT_MODE
 
@@ -226,35 +226,18 @@ static uint8_t prv_register(lwm2m_context_t * contextP,
     char * query;
     int query_length;
     uint8_t * payload;
-    int payload_length;
+    size_t payload_length;
     lwm2m_transaction_t * transaction;
 
-    payload_length = object_getRegisterPayloadBufferLength(contextP);
-    if(payload_length == 0) return COAP_500_INTERNAL_SERVER_ERROR;
-    payload = lwm2m_malloc(payload_length);
-    if(!payload) return COAP_500_INTERNAL_SERVER_ERROR;
-    payload_length = object_getRegisterPayload(contextP, payload, payload_length);
-    if(payload_length == 0)
-    {
-        lwm2m_free(payload);
-        return COAP_500_INTERNAL_SERVER_ERROR;
-    }
+    payload = object_getRegisterPayload(contextP, &payload_length);
+    if(payload == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
 
     query_length = prv_getRegistrationQueryLength(contextP, server);
-    if(query_length == 0)
-    {
-        lwm2m_free(payload);
-        return COAP_500_INTERNAL_SERVER_ERROR;
-    }
+    if(query_length == 0) return COAP_500_INTERNAL_SERVER_ERROR;
     query = lwm2m_malloc(query_length);
-    if(!query)
-    {
-        lwm2m_free(payload);
-        return COAP_500_INTERNAL_SERVER_ERROR;
-    }
+    if(!query) return COAP_500_INTERNAL_SERVER_ERROR;
     if(prv_getRegistrationQuery(contextP, server, query, query_length) != query_length)
     {
-        lwm2m_free(payload);
         lwm2m_free(query);
         return COAP_500_INTERNAL_SERVER_ERROR;
     }
@@ -266,7 +249,6 @@ static uint8_t prv_register(lwm2m_context_t * contextP,
 
     if (NULL == server->sessionH)
     {
-        lwm2m_free(payload);
         lwm2m_free(query);
         return COAP_503_SERVICE_UNAVAILABLE;
     }
@@ -274,7 +256,6 @@ static uint8_t prv_register(lwm2m_context_t * contextP,
     transaction = transaction_new(server->sessionH, COAP_POST, NULL, NULL, contextP->nextMID++, 4, NULL);
     if (transaction == NULL)
     {
-        lwm2m_free(payload);
         lwm2m_free(query);
         return COAP_503_SERVICE_UNAVAILABLE;
     }
@@ -282,6 +263,7 @@ static uint8_t prv_register(lwm2m_context_t * contextP,
     coap_set_header_uri_path(transaction->message, "/"URI_REGISTRATION_SEGMENT);
     coap_set_header_uri_query(transaction->message, query);
     coap_set_header_content_type(transaction->message, LWM2M_CONTENT_LINK);
+    // the cached payload is copied when the transaction is first sent
     coap_set_payload(transaction->message, payload, payload_length);
 
     transaction->callback = prv_handleRegistrationReply;
@@ -290,12 +272,10 @@ static uint8_t prv_register(lwm2m_context_t * contextP,
     contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transaction);
     if (transaction_send(contextP, transaction) != 0)
     {
-        lwm2m_free(payload);
         lwm2m_free(query);
         return COAP_503_SERVICE_UNAVAILABLE;
     }
 
-    lwm2m_free(payload);
     lwm2m_free(query);
     server->status = STATE_REG_PENDING;
 
@@ -333,8 +313,8 @@ static int prv_updateRegistration(lwm2m_context_t * contextP,
                                   bool withObjects)
 {
     lwm2m_transaction_t * transaction;
-    uint8_t * payload = NULL;
-    int payload_length;
+    uint8_t * payload;
+    size_t payload_length;
 
     transaction = transaction_new(server->sessionH, COAP_POST, NULL, NULL, contextP->nextMID++, 4, NULL);
     if (transaction == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
@@ -343,27 +323,13 @@ static int prv_updateRegistration(lwm2m_context_t * contextP,
 
     if (withObjects == true)
     {
-        payload_length = object_getRegisterPayloadBufferLength(contextP);
-        if(payload_length == 0)
+        payload = object_getRegisterPayload(contextP, &payload_length);
+        if(payload == NULL)
         {
             transaction_free(transaction);
             return COAP_500_INTERNAL_SERVER_ERROR;
         }
-
-        payload = lwm2m_malloc(payload_length);
-        if(!payload)
-        {
-            transaction_free(transaction);
-            return COAP_500_INTERNAL_SERVER_ERROR;
-        }
-
-        payload_length = object_getRegisterPayload(contextP, payload, payload_length);
-        if(payload_length == 0)
-        {
-            transaction_free(transaction);
-            lwm2m_free(payload);
-            return COAP_500_INTERNAL_SERVER_ERROR;
-        }
+        // the cached payload is copied when the transaction is first sent
         coap_set_payload(transaction->message, payload, payload_length);
     }
 
@@ -377,10 +343,6 @@ static int prv_updateRegistration(lwm2m_context_t * contextP,
         server->status = STATE_REG_UPDATE_PENDING;
     }
 
-    if (withObjects == true)
-    {
-        lwm2m_free(payload);
-    }
     return COAP_NO_ERROR;
 }
 
@@ -388,6 +350,20 @@ static int prv_updateRegistration(lwm2m_context_t * contextP,
 int lwm2m_update_registration(lwm2m_context_t * contextP,
                               uint16_t shortServerID,
                               bool withObjects)
+{
+    if (withObjects == true)
+    {
+        // the application may have changed instance lists on its own
+        object_freeRegisterPayload(contextP);
+    }
+
+    return registration_update(contextP, shortServerID, withObjects);
+}
+
+// trigger an update of the registration, the cached payload being up to date
+int registration_update(lwm2m_context_t * contextP,
+                        uint16_t shortServerID,
+                        bool withObjects)
 {
     lwm2m_server_t * targetP;
     uint8_t result;
@@ -478,6 +454,10 @@ uint8_t registration_start(lwm2m_context_t * contextP)
 
     result = COAP_NO_ERROR;
 
+    // a full registration always rebuilds the object list, picking up
+    // instances the application added or removed behind our back
+    object_freeRegisterPayload(contextP);
+
     targetP = contextP->serverList;
     while (targetP != NULL && result == COAP_NO_ERROR)
     {
@@ -980,21 +960,78 @@ error:
     return NULL;
 }
 
+static bool prv_matchClientName(void * itemP,
+                                void * userData)
+{
+    return strcmp(((lwm2m_client_t *)itemP)->name, (char *)userData) == 0;
+}
+
 static lwm2m_client_t * prv_getClientByName(lwm2m_context_t * contextP,
                                             char * name)
 {
-    lwm2m_client_t * targetP;
+    return (lwm2m_client_t *)hash_find(&contextP->clientNameIndex,
+                                       hash_buffer((uint8_t *)name, strlen(name)),
+                                       prv_matchClientName,
+                                       name);
+}
 
-    targetP = contextP->clientList;
-    while (targetP != NULL && strcmp(name, targetP->name) != 0)
+lwm2m_client_t * registration_findClient(lwm2m_context_t * contextP,
+                                         uint32_t clientID)
+{
+    return (lwm2m_client_t *)hash_find(&contextP->clientIdIndex, clientID, NULL, NULL);
+}
+
+// IDs are handed out in sequence. The index is only checked once the counter wrapped.
+static uint32_t prv_newClientId(lwm2m_context_t * contextP)
+{
+    uint32_t id;
+
+    do
     {
-        targetP = targetP->next;
+        id = contextP->nextClientID++;
+    } while (registration_findClient(contextP, id) != NULL);
+
+    return id;
+}
+
+// clientP->name must be set
+static bool prv_addClient(lwm2m_context_t * contextP,
+                          lwm2m_client_t * clientP)
+{
+    clientP->internalID = prv_newClientId(contextP);
+    clientP->lifetimeTimer.type = LWM2M_TIMER_CLIENT_LIFETIME;
+    clientP->lifetimeTimer.ownerP = clientP;
+    if (!hash_add(&contextP->clientIdIndex, clientP->internalID, clientP)) return false;
+    if (!hash_add(&contextP->clientNameIndex, hash_buffer((uint8_t *)clientP->name, strlen(clientP->name)), clientP))
+    {
+        hash_remove(&contextP->clientIdIndex, clientP->internalID, clientP);
+        return false;
     }
 
-    return targetP;
+    clientP->prev = NULL;
+    clientP->next = contextP->clientList;
+    if (clientP->next != NULL) clientP->next->prev = clientP;
+    contextP->clientList = clientP;
+
+    return true;
+}
+
+static void prv_removeClient(lwm2m_context_t * contextP,
+                             lwm2m_client_t * clientP)
+{
+    timer_cancel(contextP, &clientP->lifetimeTimer);
+    hash_remove(&contextP->clientIdIndex, clientP->internalID, clientP);
+    hash_remove(&contextP->clientNameIndex, hash_buffer((uint8_t *)clientP->name, strlen(clientP->name)), clientP);
+
+    if (clientP->prev != NULL) clientP->prev->next = clientP->next;
+    else contextP->clientList = clientP->next;
+    if (clientP->next != NULL) clientP->next->prev = clientP->prev;
+    clientP->next = NULL;
+    clientP->prev = NULL;
 }
 
-void registration_freeClient(lwm2m_client_t * clientP)
+void registration_freeClient(lwm2m_context_t * contextP,
+                             lwm2m_client_t * clientP)
 {
     LOG("Entering");
     if (clientP->name != NULL) lwm2m_free(clientP->name);
@@ -1003,16 +1040,12 @@ void registration_freeClient(lwm2m_client_t * clientP)
     prv_freeClientObjectList(clientP->objectList);
     while(clientP->observationList != NULL)
     {
-        lwm2m_observation_t * targetP;
-
-        targetP = clientP->observationList;
-        clientP->observationList = clientP->observationList->next;
-        lwm2m_free(targetP);
+        observe_remove(contextP, clientP->observationList);
     }
     lwm2m_free(clientP);
 }
 
-static int prv_getLocationString(uint16_t id,
+static int prv_getLocationString(uint32_t id,
                                  char location[MAX_LOCATION_LENGTH])
 {
     int index;
@@ -1024,7 +1057,8 @@ static int prv_getLocationString(uint16_t id,
     if (result < 0) return 0;
     index = result;
 
-    result = utils_intToText(id, (uint8_t*)location + index, MAX_LOCATION_LENGTH - index);
+    // keep the terminating zero
+    result = utils_intToText(id, (uint8_t*)location + index, MAX_LOCATION_LENGTH - index - 1);
     if (result == 0) return 0;
 
     return index + result;
@@ -1056,6 +1090,7 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
         lwm2m_client_object_t * objects;
         bool supportJSON;
         lwm2m_client_t * clientP;
+        uint32_t clientId;
         char location[MAX_LOCATION_LENGTH];
 
         if (0 != prv_getParameters(message->uri_query, &name, &lifetime, &msisdn, &binding, &version))
@@ -1133,9 +1168,18 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
                     return COAP_500_INTERNAL_SERVER_ERROR;
                 }
                 memset(clientP, 0, sizeof(lwm2m_client_t));
-                clientP->internalID = lwm2m_list_newId((lwm2m_list_t *)contextP->clientList);
-                contextP->clientList = (lwm2m_client_t *)LWM2M_LIST_ADD(contextP->clientList, clientP);
+                clientP->name = name;
+                if (!prv_addClient(contextP, clientP))
+                {
+                    lwm2m_free(clientP);
+                    lwm2m_free(name);
+                    lwm2m_free(altPath);
+                    if (msisdn != NULL) lwm2m_free(msisdn);
+                    prv_freeClientObjectList(objects);
+                    return COAP_500_INTERNAL_SERVER_ERROR;
+                }
             }
+            // the name is identical so the index entry stays valid
             clientP->name = name;
             clientP->binding = binding;
             clientP->msisdn = msisdn;
@@ -1146,14 +1190,22 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
             clientP->objectList = objects;
             clientP->sessionH = fromSessionH;
 
+            if (!timer_schedule(contextP, &clientP->lifetimeTimer, utils_getTimeMs() + (int64_t)lifetime * 1000))
+            {
+                prv_removeClient(contextP, clientP);
+                registration_freeClient(contextP, clientP);
+                return COAP_500_INTERNAL_SERVER_ERROR;
+            }
             if (prv_getLocationString(clientP->internalID, location) == 0)
             {
-                registration_freeClient(clientP);
+                prv_removeClient(contextP, clientP);
+                registration_freeClient(contextP, clientP);
                 return COAP_500_INTERNAL_SERVER_ERROR;
             }
             if (coap_set_header_location_path(response, location) == 0)
             {
-                registration_freeClient(clientP);
+                prv_removeClient(contextP, clientP);
+                registration_freeClient(contextP, clientP);
                 return COAP_500_INTERNAL_SERVER_ERROR;
             }
 
@@ -1165,7 +1217,8 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
             break;
 
         case LWM2M_URI_FLAG_OBJECT_ID:
-            clientP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)contextP->clientList, uriP->objectId);
+            if (!uri_getClientId(message->uri_path, &clientId)) return COAP_400_BAD_REQUEST;
+            clientP = registration_findClient(contextP, clientId);
             if (clientP == NULL) return COAP_404_NOT_FOUND;
 
             // Endpoint client name MUST NOT be present
@@ -1213,7 +1266,7 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
                                                COAP_202_DELETED,
                                                LWM2M_CONTENT_TEXT, NULL, 0,
                                                observationP->userData);
-                        observe_remove(observationP);
+                        observe_remove(contextP, observationP);
                     }
                     else
                     {
@@ -1226,7 +1279,7 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
                                                        COAP_202_DELETED,
                                                        LWM2M_CONTENT_TEXT, NULL, 0,
                                                        observationP->userData);
-                                observe_remove(observationP);
+                                observe_remove(contextP, observationP);
                             }
                         }
                     }
@@ -1239,6 +1292,8 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
             }
 
             clientP->endOfLife = tv_sec + clientP->lifetime;
+            // the timer is already scheduled, moving it does not allocate
+            (void)timer_schedule(contextP, &clientP->lifetimeTimer, utils_getTimeMs() + (int64_t)clientP->lifetime * 1000);
 
             if (contextP->monitorCallback != NULL)
             {
@@ -1256,16 +1311,19 @@ uint8_t registration_handleRequest(lwm2m_context_t * contextP,
     case COAP_DELETE:
     {
         lwm2m_client_t * clientP;
+        uint32_t clientId;
 
         if ((uriP->flag & LWM2M_URI_MASK_ID) != LWM2M_URI_FLAG_OBJECT_ID) return COAP_400_BAD_REQUEST;
+        if (!uri_getClientId(message->uri_path, &clientId)) return COAP_400_BAD_REQUEST;
 
-        contextP->clientList = (lwm2m_client_t *)LWM2M_LIST_RM(contextP->clientList, uriP->objectId, &clientP);
+        clientP = registration_findClient(contextP, clientId);
         if (clientP == NULL) return COAP_400_BAD_REQUEST;
+        prv_removeClient(contextP, clientP);
         if (contextP->monitorCallback != NULL)
         {
             contextP->monitorCallback(clientP->internalID, NULL, COAP_202_DELETED, LWM2M_CONTENT_TEXT, NULL, 0, contextP->monitorUserData);
         }
-        registration_freeClient(clientP);
+        registration_freeClient(contextP, clientP);
         result = COAP_202_DELETED;
     }
     break;
@@ -1285,10 +1343,29 @@ void lwm2m_set_monitoring_callback(lwm2m_context_t * contextP,
     contextP->monitorCallback = callback;
     contextP->monitorUserData = userData;
 }
+
+// called from timer_step() when the lifetime of the client is over
+void registration_expireClient(lwm2m_context_t * contextP,
+                               lwm2m_client_t * clientP)
+{
+    LOG_ARG("Client %u expired", clientP->internalID);
+    prv_removeClient(contextP, clientP);
+    if (contextP->monitorCallback != NULL)
+    {
+        contextP->monitorCallback(clientP->internalID, NULL, COAP_202_DELETED, LWM2M_CONTENT_TEXT, NULL, 0, contextP->monitorUserData);
+    }
+    registration_freeClient(contextP, clientP);
+}
+
+lwm2m_client_t * lwm2m_get_client(lwm2m_context_t * contextP,
+                                  uint32_t clientID)
+{
+    return registration_findClient(contextP, clientID);
+}
 #endif
 
 // for each server update the registration if needed
-// for each client check if the registration expired
+// registered clients expire through their lifetime timer, see registration_expireClient()
 void registration_step(lwm2m_context_t * contextP,
                        time_t currentTime,
                        time_t * timeoutP)
@@ -1354,39 +1431,5 @@ void registration_step(lwm2m_context_t * contextP,
     }
 
 #endif
-#ifdef LWM2M_SERVER_MODE
-    lwm2m_client_t * clientP;
-
-    LOG("Entering");
-    // monitor clients lifetime
-    clientP = contextP->clientList;
-    while (clientP != NULL)
-    {
-        lwm2m_client_t * nextP = clientP->next;
-
-        if (clientP->endOfLife <= currentTime)
-        {
-            contextP->clientList = (lwm2m_client_t *)LWM2M_LIST_RM(contextP->clientList, clientP->internalID, NULL);
-            if (contextP->monitorCallback != NULL)
-            {
-                contextP->monitorCallback(clientP->internalID, NULL, COAP_202_DELETED, LWM2M_CONTENT_TEXT, NULL, 0, contextP->monitorUserData);
-            }
-            registration_freeClient(clientP);
-        }
-        else
-        {
-            time_t interval;
-
-            interval = clientP->endOfLife - currentTime;
-
-            if (*timeoutP > interval)
-            {
-                *timeoutP = interval;
-            }
-        }
-        clientP = nextP;
-    }
-#endif
-
 }
 
@@ -0,0 +1,212 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2017 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ *******************************************************************************/
+
+/*
+ * Deadlines of the context are kept in a binary min-heap of lwm2m_timer_t.
+ * Deadlines are in milliseconds, as returned by utils_getTimeMs().
+ * The timers are embedded in their owner (transaction, ...) and remember
+ * their position in the heap so they can be moved or removed in O(log n).
+ * lwm2m_step() only handles the timers which are due and reads the next
+ * deadline from the top of the heap.
+ *
+ * A handler called from timer_step() reschedules or cancels its timer. A timer
+ * left in the past is postponed to the next step so a late step does not
+ * trigger bursts. Rescheduling a timer already in the heap never allocates.
+ */
+
+#include "internals.h"
+
+#define TIMER_MIN_HEAP_SIZE 16
+
+static void prv_place(lwm2m_timer_heap_t * heapP,
+                      size_t index,
+                      lwm2m_timer_t * timerP)
+{
+    heapP->entries[index] = timerP;
+    timerP->position = index + 1;
+}
+
+static void prv_siftUp(lwm2m_timer_heap_t * heapP,
+                       size_t index)
+{
+    lwm2m_timer_t * timerP = heapP->entries[index];
+
+    while (index > 0)
+    {
+        size_t parent = (index - 1) / 2;
+
+        if (heapP->entries[parent]->deadline <= timerP->deadline) break;
+
+        prv_place(heapP, index, heapP->entries[parent]);
+        index = parent;
+    }
+    prv_place(heapP, index, timerP);
+}
+
+static void prv_siftDown(lwm2m_timer_heap_t * heapP,
+                         size_t index)
+{
+    lwm2m_timer_t * timerP = heapP->entries[index];
+
+    while (2 * index + 1 < heapP->count)
+    {
+        size_t child = 2 * index + 1;
+
+        if (child + 1 < heapP->count
+         && heapP->entries[child + 1]->deadline < heapP->entries[child]->deadline)
+        {
+            child++;
+        }
+        if (timerP->deadline <= heapP->entries[child]->deadline) break;
+
+        prv_place(heapP, index, heapP->entries[child]);
+        index = child;
+    }
+    prv_place(heapP, index, timerP);
+}
+
+bool timer_schedule(lwm2m_context_t * contextP,
+                    lwm2m_timer_t * timerP,
+                    int64_t deadline)
+{
+    lwm2m_timer_heap_t * heapP = &contextP->timerHeap;
+
+    if (timerP->position != 0)
+    {
+        timerP->deadline = deadline;
+        prv_siftUp(heapP, timerP->position - 1);
+        prv_siftDown(heapP, timerP->position - 1);
+        return true;
+    }
+
+    if (heapP->count == heapP->size)
+    {
+        lwm2m_timer_t ** entries;
+        size_t size;
+
+        size = (heapP->size == 0) ? TIMER_MIN_HEAP_SIZE : heapP->size * 2;
+        entries = (lwm2m_timer_t **)lwm2m_malloc(size * sizeof(lwm2m_timer_t *));
+        if (entries == NULL) return false;
+        if (heapP->entries != NULL)
+        {
+            memcpy(entries, heapP->entries, heapP->count * sizeof(lwm2m_timer_t *));
+            lwm2m_free(heapP->entries);
+        }
+        heapP->entries = entries;
+        heapP->size = size;
+    }
+
+    timerP->deadline = deadline;
+    heapP->entries[heapP->count] = timerP;
+    heapP->count++;
+    prv_siftUp(heapP, heapP->count - 1);
+
+    return true;
+}
+
+void timer_cancel(lwm2m_context_t * contextP,
+                  lwm2m_timer_t * timerP)
+{
+    lwm2m_timer_heap_t * heapP = &contextP->timerHeap;
+    size_t index;
+
+    if (timerP->position == 0) return;
+
+    index = timerP->position - 1;
+    timerP->position = 0;
+    heapP->count--;
+    if (index != heapP->count)
+    {
+        lwm2m_timer_t * lastP = heapP->entries[heapP->count];
+
+        prv_place(heapP, index, lastP);
+        prv_siftUp(heapP, index);
+        prv_siftDown(heapP, lastP->position - 1);
+    }
+}
+
+void timer_step(lwm2m_context_t * contextP,
+                int64_t currentTime,
+                int64_t * timeoutP)
+{
+    lwm2m_timer_heap_t * heapP = &contextP->timerHeap;
+
+    LOG_ARG("%d timers", heapP->count);
+    while (heapP->count > 0 && heapP->entries[0]->deadline <= currentTime)
+    {
+        lwm2m_timer_t * timerP = heapP->entries[0];
+
+        switch (timerP->type)
+        {
+        case LWM2M_TIMER_TRANSACTION:
+            if (0 != transaction_send(contextP, (lwm2m_transaction_t *)timerP->ownerP))
+            {
+                // the transaction is over and freed, let the caller react right away
+                timerP = NULL;
+                *timeoutP = 0;
+            }
+            break;
+
+        case LWM2M_TIMER_BLOCK2:
+            block2_expire(contextP, (lwm2m_block2_data_t *)timerP->ownerP);
+            timerP = NULL;
+            break;
+
+#ifdef LWM2M_CLIENT_MODE
+        case LWM2M_TIMER_WATCHER:
+            // reschedules or cancels the timer
+            observe_expire(contextP, (lwm2m_watcher_t *)timerP->ownerP, currentTime);
+            break;
+#endif
+
+#ifdef LWM2M_SERVER_MODE
+        case LWM2M_TIMER_CLIENT_LIFETIME:
+            registration_expireClient(contextP, (lwm2m_client_t *)timerP->ownerP);
+            timerP = NULL;
+            break;
+#endif
+
+        default:
+            timer_cancel(contextP, timerP);
+            break;
+        }
+
+        if (timerP != NULL
+         && timerP->position != 0
+         && timerP->deadline <= currentTime)
+        {
+            // the owner is late on its schedule, catch up on next step
+            timer_schedule(contextP, timerP, currentTime + 1);
+        }
+    }
+
+    if (heapP->count > 0)
+    {
+        int64_t interval;
+
+        interval = heapP->entries[0]->deadline - currentTime;
+        if (*timeoutP > interval)
+        {
+            *timeoutP = interval;
+        }
+    }
+}
+
+void timer_free(lwm2m_context_t * contextP)
+{
+    lwm2m_timer_heap_t * heapP = &contextP->timerHeap;
+
+    if (heapP->entries != NULL) lwm2m_free(heapP->entries);
+    memset(heapP, 0, sizeof(lwm2m_timer_heap_t));
+}
@@ -301,280 +301,353 @@ int lwm2m_decode_TLV(const uint8_t * buffer,
 }
 
 
-int tlv_parse(uint8_t * buffer,
-              size_t bufferLen,
-              lwm2m_data_t ** dataP)
+static int prv_countRecords(uint8_t * buffer,
+                            size_t bufferLen)
 {
     lwm2m_data_type_t type;
     uint16_t id;
     size_t dataIndex;
     size_t dataLen;
-    int index = 0;
+    size_t index = 0;
     int result;
-    int size = 0;
+    int count = 0;
 
-    LOG_ARG("bufferLen: %d", bufferLen);
+    while (0 != (result = lwm2m_decode_TLV(buffer + index, bufferLen - index, &type, &id, &dataIndex, &dataLen)))
+    {
+        count++;
+        index += result;
+    }
+
+    return count;
+}
+
+// With an arena, the buffer is borrowed and values point into it.
+static int prv_parseRecords(lwm2m_arena_t * arenaP,
+                            uint8_t * buffer,
+                            size_t bufferLen,
+                            lwm2m_data_t ** dataP)
+{
+    lwm2m_data_type_t type;
+    uint16_t id;
+    size_t dataIndex;
+    size_t dataLen;
+    size_t index = 0;
+    int result;
+    int count;
+    int i;
 
     *dataP = NULL;
 
-    while (0 != (result = lwm2m_decode_TLV((uint8_t*)buffer + index, bufferLen - index, &type, &id, &dataIndex, &dataLen)))
+    count = prv_countRecords(buffer, bufferLen);
+    if (count == 0) return 0;
+
+    *dataP = data_new(arenaP, count);
+    if (*dataP == NULL) return 0;
+
+    for (i = 0 ; i < count ; i++)
     {
-        lwm2m_data_t * newTlvP;
+        lwm2m_data_t * targetP = (*dataP) + i;
+        uint8_t * valueP;
 
-        newTlvP = lwm2m_data_new(size + 1);
-        if (size >= 1)
-        {
-            if (newTlvP == NULL)
-            {
-                lwm2m_data_free(size, *dataP);
-                return 0;
-            }
-            else
-            {
-                memcpy(newTlvP, *dataP, size * sizeof(lwm2m_data_t));
-                lwm2m_free(*dataP);
-            }
-        }
-        *dataP = newTlvP;
+        result = lwm2m_decode_TLV(buffer + index, bufferLen - index, &type, &id, &dataIndex, &dataLen);
+        valueP = buffer + index + dataIndex;
+        index += result;
 
-        (*dataP)[size].type = type;
-        (*dataP)[size].id = id;
+        targetP->type = type;
+        targetP->id = id;
         if (type == LWM2M_TYPE_OBJECT_INSTANCE || type == LWM2M_TYPE_MULTIPLE_RESOURCE)
         {
-            (*dataP)[size].value.asChildren.count = tlv_parse(buffer + index + dataIndex,
-                                                          dataLen,
-                                                          &((*dataP)[size].value.asChildren.array));
-            if ((*dataP)[size].value.asChildren.count == 0)
+            targetP->value.asChildren.count = prv_parseRecords(arenaP,
+                                                               valueP,
+                                                               dataLen,
+                                                               &(targetP->value.asChildren.array));
+            if (targetP->value.asChildren.count == 0)
             {
-                lwm2m_data_free(size + 1, *dataP);
+                data_free(arenaP, i + 1, *dataP);
+                *dataP = NULL;
                 return 0;
             }
         }
+        else if (arenaP != NULL)
+        {
+            targetP->type = LWM2M_TYPE_OPAQUE;
+            targetP->value.asBuffer.length = dataLen;
+            targetP->value.asBuffer.buffer = (dataLen == 0) ? NULL : valueP;
+        }
         else
         {
-            lwm2m_data_encode_opaque(buffer + index + dataIndex, dataLen, (*dataP) + size);
+            data_encodeOpaque(NULL, valueP, dataLen, targetP);
         }
-        size++;
-        index += result;
     }
 
-    return size;
+    return count;
 }
 
+int tlv_parse(lwm2m_arena_t * arenaP,
+              uint8_t * buffer,
+              size_t bufferLen,
+              lwm2m_data_t ** dataP)
+{
+    LOG_ARG("bufferLen: %d", bufferLen);
 
-static int prv_getLength(int size,
-                         lwm2m_data_t * dataP)
+    *dataP = NULL;
+    if (arenaP != NULL && !arena_borrow(arenaP, buffer, bufferLen)) return 0;
+
+    return prv_parseRecords(arenaP, buffer, bufferLen, dataP);
+}
+
+
+/*
+ * The serializer writes the window [start, start + length) of the TLV stream
+ * into the caller buffer. Records entirely before the window are skipped
+ * without being encoded and the walk stops once the window is full.
+ * Container headers need the length of their content, which is computed
+ * without encoding the values.
+ */
+typedef struct
 {
-    int length;
-    int i;
+    uint8_t * buffer;
+    size_t    length;
+    size_t    start;      // offset in the TLV stream of buffer[0]
+    size_t    position;   // offset in the TLV stream of the next byte
+} _tlv_stream_t;
 
-    length = 0;
+static size_t prv_getIntLength(int64_t data)
+{
+    if (data >= INT8_MIN && data <= INT8_MAX) return 1;
+    if (data >= INT16_MIN && data <= INT16_MAX) return 2;
+    if (data >= INT32_MIN && data <= INT32_MAX) return 4;
+    return 8;
+}
+
+static int prv_getLength(int size,
+                         lwm2m_data_t * dataP);
 
-    for (i = 0 ; i < size && length != -1 ; i++)
+static int prv_getValueLength(lwm2m_data_t * dataP)
+{
+    switch (dataP->type)
     {
-        switch (dataP[i].type)
+    case LWM2M_TYPE_OBJECT_INSTANCE:
+    case LWM2M_TYPE_MULTIPLE_RESOURCE:
+        return prv_getLength(dataP->value.asChildren.count, dataP->value.asChildren.array);
+
+    case LWM2M_TYPE_STRING:
+    case LWM2M_TYPE_OPAQUE:
+        return (int)dataP->value.asBuffer.length;
+
+    case LWM2M_TYPE_INTEGER:
+        return (int)prv_getIntLength(dataP->value.asInteger);
+
+    case LWM2M_TYPE_FLOAT:
+        if ((dataP->value.asFloat < 0.0 - (double)FLT_MAX)
+         || (dataP->value.asFloat > (double)FLT_MAX))
         {
-        case LWM2M_TYPE_OBJECT_INSTANCE:
-        case LWM2M_TYPE_MULTIPLE_RESOURCE:
-            {
-                int subLength;
-
-                subLength = prv_getLength(dataP[i].value.asChildren.count, dataP[i].value.asChildren.array);
-                if (subLength == -1)
-                {
-                    length = -1;
-                }
-                else
-                {
-                    length += prv_getHeaderLength(dataP[i].id, subLength) + subLength;
-                }
-            }
-            break;
+            return 8;
+        }
+        return 4;
 
-        case LWM2M_TYPE_STRING:
-        case LWM2M_TYPE_OPAQUE:
-            length += prv_getHeaderLength(dataP[i].id, dataP[i].value.asBuffer.length) + dataP[i].value.asBuffer.length;
-            break;
+    case LWM2M_TYPE_BOOLEAN:
+        // Booleans are always encoded on one byte
+        return 1;
 
-        case LWM2M_TYPE_INTEGER:
-            {
-                size_t data_len;
-                uint8_t unused_buffer[_PRV_64BIT_BUFFER_SIZE];
+    case LWM2M_TYPE_OBJECT_LINK:
+        // Object Link are always encoded on four bytes
+        return 4;
 
-                data_len = prv_encodeInt(dataP[i].value.asInteger, unused_buffer);
-                length += prv_getHeaderLength(dataP[i].id, data_len) + data_len;
-            }
-            break;
+    default:
+        return -1;
+    }
+}
 
-        case LWM2M_TYPE_FLOAT:
-            {
-                size_t data_len;
-
-                if ((dataP[i].value.asFloat < 0.0 - (double)FLT_MAX)
-                    || (dataP[i].value.asFloat >(double)FLT_MAX))
-                {
-                    data_len = 8;
-                }
-                else
-                {
-                    data_len = 4;
-                }
-
-                length += prv_getHeaderLength(dataP[i].id, data_len) + data_len;
-            }
-            break;
+static int prv_getLength(int size,
+                         lwm2m_data_t * dataP)
+{
+    int length;
+    int i;
 
-        case LWM2M_TYPE_BOOLEAN:
-            // Booleans are always encoded on one byte
-            length += prv_getHeaderLength(dataP[i].id, 1) + 1;
-            break;
+    length = 0;
 
-        case LWM2M_TYPE_OBJECT_LINK:
-            // Object Link are always encoded on four bytes
-            length += prv_getHeaderLength(dataP[i].id, 4) + 4;
-            break;
+    for (i = 0 ; i < size ; i++)
+    {
+        int valueLength;
 
-        default:
-            length = -1;
-            break;
-        }
+        valueLength = prv_getValueLength(dataP + i);
+        if (valueLength < 0) return -1;
+
+        length += prv_getHeaderLength(dataP[i].id, valueLength) + valueLength;
     }
 
     return length;
 }
 
-
-int tlv_serialize(bool isResourceInstance, 
-                  int size,
-                  lwm2m_data_t * dataP,
-                  uint8_t ** bufferP)
+static void prv_emit(_tlv_stream_t * streamP,
+                     const uint8_t * data,
+                     size_t dataLen)
 {
-    int length;
-    int index;
-    int i;
+    size_t end;
 
-    LOG_ARG("isResourceInstance: %s, size: %d", isResourceInstance?"true":"false", size);
+    end = streamP->start + streamP->length;
+    if (streamP->position < end
+     && streamP->position + dataLen > streamP->start)
+    {
+        size_t from;
+        size_t to;
 
-    *bufferP = NULL;
-    length = prv_getLength(size, dataP);
-    if (length <= 0) return length;
+        from = (streamP->position < streamP->start) ? streamP->start - streamP->position : 0;
+        to = (streamP->position + dataLen > end) ? end - streamP->position : dataLen;
+        memcpy(streamP->buffer + streamP->position + from - streamP->start, data + from, to - from);
+    }
+    streamP->position += dataLen;
+}
 
-    *bufferP = (uint8_t *)lwm2m_malloc(length);
-    if (*bufferP == NULL) return 0;
+static int prv_serializeRecords(_tlv_stream_t * streamP,
+                                bool isResourceInstance,
+                                int size,
+                                lwm2m_data_t * dataP)
+{
+    int i;
 
-    index = 0;
-    for (i = 0 ; i < size && length != 0 ; i++)
+    for (i = 0 ; i < size && streamP->position < streamP->start + streamP->length ; i++)
     {
+        uint8_t header[_PRV_TLV_HEADER_MAX_LENGTH];
+        uint8_t data_buffer[_PRV_64BIT_BUFFER_SIZE];
+        int valueLength;
         int headerLen;
-        bool isInstance;
 
-        isInstance = isResourceInstance;
+        valueLength = prv_getValueLength(dataP + i);
+        if (valueLength < 0) return -1;
+
+        headerLen = prv_getHeaderLength(dataP[i].id, valueLength);
+        if (streamP->position + headerLen + valueLength <= streamP->start)
+        {
+            streamP->position += headerLen + valueLength;
+            continue;
+        }
+
         switch (dataP[i].type)
         {
         case LWM2M_TYPE_MULTIPLE_RESOURCE:
-            isInstance = true;
-            // fall through
         case LWM2M_TYPE_OBJECT_INSTANCE:
+            prv_createHeader(header, false, dataP[i].type, dataP[i].id, valueLength);
+            prv_emit(streamP, header, headerLen);
+            if (0 != prv_serializeRecords(streamP,
+                                          dataP[i].type == LWM2M_TYPE_MULTIPLE_RESOURCE ? true : isResourceInstance,
+                                          dataP[i].value.asChildren.count,
+                                          dataP[i].value.asChildren.array))
             {
-                uint8_t * tmpBuffer;
-                int res;
-
-                res = tlv_serialize(isInstance, dataP[i].value.asChildren.count, dataP[i].value.asChildren.array, &tmpBuffer);
-                if (res < 0)
-                {
-                    length = -1;
-                }
-                else
-                {
-                    size_t tmpLength;
-
-                    tmpLength = (size_t)res;
-                    headerLen = prv_createHeader(*bufferP + index, false, dataP[i].type, dataP[i].id, tmpLength);
-                    index += headerLen;
-                    if (tmpLength > 0)
-                    {
-                        memcpy(*bufferP + index, tmpBuffer, tmpLength);
-                        index += tmpLength;
-                        lwm2m_free(tmpBuffer);
-                    }
-                }
+                return -1;
             }
             break;
 
         case LWM2M_TYPE_OBJECT_LINK:
-            {
-                int k;
-                uint8_t buf[4];
-                uint32_t v = dataP[i].value.asObjLink.objectId;
-                v <<= 16;
-                v |= dataP[i].value.asObjLink.objectInstanceId;
-                for (k = 3; k >= 0; --k) {
-                    buf[k] = (uint8_t)(v & 0xFF);
-                    v >>= 8;
-                }
-                // keep encoding as buffer
-                headerLen = prv_createHeader(*bufferP + index, isInstance, dataP[i].type, dataP[i].id, 4);
-                index += headerLen;
-                memcpy(*bufferP + index, buf, 4);
-                index += 4;
-            }
+            data_buffer[0] = (dataP[i].value.asObjLink.objectId >> 8) & 0xFF;
+            data_buffer[1] = dataP[i].value.asObjLink.objectId & 0xFF;
+            data_buffer[2] = (dataP[i].value.asObjLink.objectInstanceId >> 8) & 0xFF;
+            data_buffer[3] = dataP[i].value.asObjLink.objectInstanceId & 0xFF;
+            // keep encoding as buffer
+            prv_createHeader(header, isResourceInstance, dataP[i].type, dataP[i].id, 4);
+            prv_emit(streamP, header, headerLen);
+            prv_emit(streamP, data_buffer, 4);
             break;
 
         case LWM2M_TYPE_STRING:
         case LWM2M_TYPE_OPAQUE:
-            headerLen = prv_createHeader(*bufferP + index, isInstance, dataP[i].type, dataP[i].id, dataP[i].value.asBuffer.length);
-            index += headerLen;
-            memcpy(*bufferP + index, dataP[i].value.asBuffer.buffer, dataP[i].value.asBuffer.length);
-            index += dataP[i].value.asBuffer.length;
+            prv_createHeader(header, isResourceInstance, dataP[i].type, dataP[i].id, valueLength);
+            prv_emit(streamP, header, headerLen);
+            prv_emit(streamP, dataP[i].value.asBuffer.buffer, valueLength);
             break;
 
         case LWM2M_TYPE_INTEGER:
-            {
-                size_t data_len;
-                uint8_t data_buffer[_PRV_64BIT_BUFFER_SIZE];
-
-                data_len = prv_encodeInt(dataP[i].value.asInteger, data_buffer);
-                headerLen = prv_createHeader(*bufferP + index, isInstance, dataP[i].type, dataP[i].id, data_len);
-                index += headerLen;
-                memcpy(*bufferP + index, data_buffer, data_len);
-                index += data_len;
-            }
+            prv_encodeInt(dataP[i].value.asInteger, data_buffer);
+            prv_createHeader(header, isResourceInstance, dataP[i].type, dataP[i].id, valueLength);
+            prv_emit(streamP, header, headerLen);
+            prv_emit(streamP, data_buffer, valueLength);
             break;
 
         case LWM2M_TYPE_FLOAT:
-            {
-                size_t data_len;
-                uint8_t data_buffer[_PRV_64BIT_BUFFER_SIZE];
-
-                data_len = prv_encodeFloat(dataP[i].value.asFloat, data_buffer);
-                headerLen = prv_createHeader(*bufferP + index, isInstance, dataP[i].type, dataP[i].id, data_len);
-                index += headerLen;
-                memcpy(*bufferP + index, data_buffer, data_len);
-                index += data_len;
-            }
+            prv_encodeFloat(dataP[i].value.asFloat, data_buffer);
+            prv_createHeader(header, isResourceInstance, dataP[i].type, dataP[i].id, valueLength);
+            prv_emit(streamP, header, headerLen);
+            prv_emit(streamP, data_buffer, valueLength);
             break;
 
         case LWM2M_TYPE_BOOLEAN:
-            headerLen = prv_createHeader(*bufferP + index, isInstance, dataP[i].type, dataP[i].id, 1);
-            index += headerLen;
-            (*bufferP)[index] = dataP[i].value.asBoolean ? 1 : 0;
-            index += 1;
+            data_buffer[0] = dataP[i].value.asBoolean ? 1 : 0;
+            prv_createHeader(header, isResourceInstance, dataP[i].type, dataP[i].id, 1);
+            prv_emit(streamP, header, headerLen);
+            prv_emit(streamP, data_buffer, 1);
             break;
 
         default:
-            length = -1;
-            break;
+            return -1;
         }
     }
 
-    if (length < 0)
+    return 0;
+}
+
+int tlv_serializeChunk(bool isResourceInstance,
+                       int size,
+                       lwm2m_data_t * dataP,
+                       size_t * offsetP,
+                       uint8_t * buffer,
+                       size_t length)
+{
+    _tlv_stream_t stream;
+    size_t written;
+
+    LOG_ARG("isResourceInstance: %s, size: %d, offset: %u, length: %u", isResourceInstance?"true":"false", size, *offsetP, length);
+
+    stream.buffer = buffer;
+    stream.length = length;
+    stream.start = *offsetP;
+    stream.position = 0;
+
+    if (0 != prv_serializeRecords(&stream, isResourceInstance, size, dataP)) return -1;
+
+    if (stream.position <= stream.start)
+    {
+        written = 0;
+    }
+    else if (stream.position >= stream.start + stream.length)
+    {
+        written = stream.length;
+    }
+    else
+    {
+        written = stream.position - stream.start;
+    }
+    *offsetP += written;
+
+    return (int)written;
+}
+
+int tlv_serialize(bool isResourceInstance,
+                  int size,
+                  lwm2m_data_t * dataP,
+                  uint8_t ** bufferP)
+{
+    int length;
+    size_t offset;
+
+    LOG_ARG("isResourceInstance: %s, size: %d", isResourceInstance?"true":"false", size);
+
+    *bufferP = NULL;
+    length = prv_getLength(size, dataP);
+    if (length <= 0) return length;
+
+    *bufferP = (uint8_t *)lwm2m_malloc(length);
+    if (*bufferP == NULL) return 0;
+
+    offset = 0;
+    if (length != tlv_serializeChunk(isResourceInstance, size, dataP, &offset, *bufferP, length))
     {
         lwm2m_free(*bufferP);
         *bufferP = NULL;
+        length = -1;
     }
 
     LOG_ARG("returning %u", length);
 
     return length;
 }
-
@@ -108,11 +108,19 @@ Contains code snippets which are:
 
 
 /*
- * Modulo mask (+1 and +0.5 for rounding) for a random number to get the tick number for the random
- * retransmission time between COAP_RESPONSE_TIMEOUT and COAP_RESPONSE_TIMEOUT*COAP_RESPONSE_RANDOM_FACTOR.
+ * The initial acknowledge timeout is picked at random between COAP_RESPONSE_TIMEOUT and
+ * COAP_RESPONSE_TIMEOUT * COAP_ACK_RANDOM_FACTOR (rfc7252 section 4.8) so that peers do not
+ * retransmit in lockstep. Values are in milliseconds.
  */
-#define COAP_RESPONSE_TIMEOUT_TICKS         (CLOCK_SECOND * COAP_RESPONSE_TIMEOUT)
-#define COAP_RESPONSE_TIMEOUT_BACKOFF_MASK  ((CLOCK_SECOND * COAP_RESPONSE_TIMEOUT * (COAP_RESPONSE_RANDOM_FACTOR - 1)) + 1.5)
+#define COAP_RESPONSE_TIMEOUT_MS        (COAP_RESPONSE_TIMEOUT * 1000)
+#define COAP_RESPONSE_TIMEOUT_RANGE_MS  ((uint32_t)(COAP_RESPONSE_TIMEOUT_MS * (COAP_ACK_RANDOM_FACTOR - 1)))
+
+typedef struct
+{
+    lwm2m_context_t * contextP;
+    void *            sessionH;
+    coap_packet_t *   message;
+} prv_match_data_t;
 
 static int prv_checkFinished(lwm2m_transaction_t * transacP,
                              coap_packet_t * receivedMessage)
@@ -172,6 +180,8 @@ lwm2m_transaction_t * transaction_new(void * sessionH,
     transacP->peerH = sessionH;
 
     transacP->mID = mID;
+    transacP->timer.type = LWM2M_TIMER_TRANSACTION;
+    transacP->timer.ownerP = transacP;
 
     if (altPath != NULL)
     {
@@ -251,142 +261,408 @@ void transaction_free(lwm2m_transaction_t * transacP)
     }
 
     if (transacP->buffer) lwm2m_free(transacP->buffer);
+    if (transacP->block2Buffer) lwm2m_free(transacP->block2Buffer);
+    if (transacP->block1Buffer) lwm2m_free(transacP->block1Buffer);
     lwm2m_free(transacP);
 }
 
+static bool prv_matchMid(void * itemP,
+                         void * userData)
+{
+    lwm2m_transaction_t * transacP = (lwm2m_transaction_t *)itemP;
+    prv_match_data_t * dataP = (prv_match_data_t *)userData;
+
+    return !transacP->ack_received
+        && lwm2m_session_is_equal(dataP->sessionH, transacP->peerH, dataP->contextP->userData);
+}
+
+static bool prv_matchToken(void * itemP,
+                           void * userData)
+{
+    lwm2m_transaction_t * transacP = (lwm2m_transaction_t *)itemP;
+    prv_match_data_t * dataP = (prv_match_data_t *)userData;
+
+    return lwm2m_session_is_equal(dataP->sessionH, transacP->peerH, dataP->contextP->userData)
+        && prv_checkFinished(transacP, dataP->message);
+}
+
+static bool prv_indexTransaction(lwm2m_context_t * contextP,
+                                 lwm2m_transaction_t * transacP)
+{
+    coap_packet_t * messageP = (coap_packet_t *)transacP->message;
+
+    if (!hash_add(&contextP->transactionMidIndex, transacP->mID, transacP)) return false;
+
+    if (IS_OPTION(messageP, COAP_OPTION_TOKEN)
+     && !hash_add(&contextP->transactionTokenIndex, hash_buffer(messageP->token, messageP->token_len), transacP))
+    {
+        hash_remove(&contextP->transactionMidIndex, transacP->mID, transacP);
+        return false;
+    }
+
+    return true;
+}
+
+static void prv_unindexTransaction(lwm2m_context_t * contextP,
+                                   lwm2m_transaction_t * transacP)
+{
+    coap_packet_t * messageP = (coap_packet_t *)transacP->message;
+
+    timer_cancel(contextP, &transacP->timer);
+    hash_remove(&contextP->transactionMidIndex, transacP->mID, transacP);
+    if (IS_OPTION(messageP, COAP_OPTION_TOKEN))
+    {
+        hash_remove(&contextP->transactionTokenIndex, hash_buffer(messageP->token, messageP->token_len), transacP);
+    }
+}
+
 void transaction_remove(lwm2m_context_t * contextP,
                         lwm2m_transaction_t * transacP)
 {
     LOG_ARG("Entering. transaction=%p", transacP);
+    prv_unindexTransaction(contextP, transacP);
     contextP->transactionList = (lwm2m_transaction_t *) LWM2M_LIST_RM(contextP->transactionList, transacP->mID, NULL);
     transaction_free(transacP);
 }
 
+bool transaction_setPayload(lwm2m_transaction_t * transacP,
+                            uint8_t * buffer,
+                            size_t length,
+                            uint16_t blockSize)
+{
+    coap_packet_t * messageP = (coap_packet_t *)transacP->message;
+
+    if (length <= blockSize)
+    {
+        coap_set_payload(messageP, buffer, length);
+        return true;
+    }
+
+    // the payload is copied, the caller may release buffer once this returns
+    transacP->block1Buffer = (uint8_t *)lwm2m_malloc(length);
+    if (transacP->block1Buffer == NULL) return false;
+    memcpy(transacP->block1Buffer, buffer, length);
+    transacP->block1Length = length;
+    transacP->block1Offset = 0;
+    transacP->block1Size = blockSize;
+
+    coap_set_header_block1(messageP, 0, 1, blockSize);
+    coap_set_header_size1(messageP, (uint32_t)length);
+    coap_set_payload(messageP, transacP->block1Buffer, blockSize);
+
+    return true;
+}
+
+/*
+ * Takes the transaction out of the list and the indexes, and gives it a new message ID
+ * so that it is serialized again by transaction_send(). The options of the request were
+ * kept by its first serialization.
+ */
+static void prv_reuseTransaction(lwm2m_context_t * contextP,
+                                 lwm2m_transaction_t * transacP)
+{
+    prv_unindexTransaction(contextP, transacP);
+    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_RM(contextP->transactionList, transacP->mID, NULL);
+
+    lwm2m_free(transacP->buffer);
+    transacP->buffer = NULL;
+    transacP->buffer_len = 0;
+    transacP->mID = contextP->nextMID++;
+    ((coap_packet_t *)transacP->message)->mid = transacP->mID;
+    transacP->ack_received = false;
+    transacP->retrans_counter = 0;
+    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transacP);
+}
+
+#ifdef LWM2M_SERVER_MODE
+// keeps the block size a client asked for for the next requests to it
+static void prv_setClientBlockSize(lwm2m_context_t * contextP,
+                                   lwm2m_transaction_t * transacP,
+                                   uint16_t size)
+{
+    lwm2m_client_t * clientP;
+
+    if (!transacP->toClient) return;
+
+    clientP = registration_findClient(contextP, transacP->clientID);
+    if (clientP != NULL) clientP->blockSize = size;
+}
+#endif
+
+/*
+ * Sends the next block of a request payload (RFC 7959) when the peer asks for it with
+ * 2.31 Continue, or the first block again with a smaller size when the peer answers
+ * 4.13 with a Block1 option. Returns true if the transaction goes on.
+ */
+static bool prv_handleBlock1(lwm2m_context_t * contextP,
+                             lwm2m_transaction_t * transacP,
+                             coap_packet_t * message)
+{
+    coap_packet_t * requestP = (coap_packet_t *)transacP->message;
+    uint32_t num;
+    uint8_t more;
+    uint16_t size;
+    size_t offset;
+    size_t length;
+
+    if (transacP->block1Buffer == NULL
+     || !coap_get_header_block1(message, &num, &more, &size, NULL))
+    {
+        return false;
+    }
+
+    offset = transacP->block1Offset;
+    if (message->code == COAP_231_CONTINUE)
+    {
+        offset += MIN(transacP->block1Size, transacP->block1Length - offset);
+    }
+    else if (message->code != COAP_413_ENTITY_TOO_LARGE
+          || offset != 0
+          || size >= transacP->block1Size)
+    {
+        return false;
+    }
+    if (offset >= transacP->block1Length) return false;
+
+    if (size < transacP->block1Size)
+    {
+        LOG_ARG("Peer asks for blocks of %u bytes", size);
+        transacP->block1Size = size;
+#ifdef LWM2M_SERVER_MODE
+        prv_setClientBlockSize(contextP, transacP, size);
+#endif
+    }
+    transacP->block1Offset = offset;
+
+    prv_reuseTransaction(contextP, transacP);
+
+    length = MIN(transacP->block1Size, transacP->block1Length - offset);
+    LOG_ARG("Sending %u bytes at offset %u", length, offset);
+    coap_set_header_block1(requestP, (uint32_t)(offset / transacP->block1Size), offset + length < transacP->block1Length, transacP->block1Size);
+    coap_set_payload(requestP, transacP->block1Buffer + offset, length);
+    (void)transaction_send(contextP, transacP);
+
+    return true;
+}
+
+/*
+ * Collects the blocks of a response to a GET (RFC 7959). While more blocks are expected,
+ * the transaction is sent again with a new message ID asking for the next block, and
+ * true is returned. Once the last block arrived, message is given the whole payload.
+ */
+static bool prv_handleBlock2(lwm2m_context_t * contextP,
+                             lwm2m_transaction_t * transacP,
+                             coap_packet_t * message)
+{
+    coap_packet_t * requestP = (coap_packet_t *)transacP->message;
+    uint32_t num;
+    uint8_t more;
+    uint16_t size;
+    const uint8_t * etag;
+    int etagLen;
+
+    if (requestP->code != COAP_GET
+     || message->code != COAP_205_CONTENT
+     || !coap_get_header_block2(message, &num, &more, &size, NULL))
+    {
+        return false;
+    }
+    if (num == 0 && !more) return false;
+
+    LOG_ARG("Block %u (%u bytes), more: %u", num, size, more);
+    etagLen = coap_get_header_etag(message, &etag);
+    if (num == 0)
+    {
+        transacP->block2Observe = IS_OPTION(message, COAP_OPTION_OBSERVE);
+        transacP->block2ETagLen = (uint8_t)etagLen;
+        if (etagLen > 0) memcpy(transacP->block2ETag, etag, etagLen);
+    }
+    if (transacP->block2Length != (size_t)num * size
+     || transacP->block2Length + message->payload_len > LWM2M_BLOCK2_MAX_SIZE
+     || transacP->block2ETagLen != etagLen
+     || (etagLen > 0 && memcmp(transacP->block2ETag, etag, etagLen) != 0))
+    {
+        // not the expected block or the representation changed, give up on the response
+        message->code = COAP_408_REQ_ENTITY_INCOMPLETE;
+        coap_set_payload(message, NULL, 0);
+        return false;
+    }
+
+    if (transacP->block2Length + message->payload_len > transacP->block2Size)
+    {
+        uint8_t * buffer;
+        size_t bufferSize;
+
+        bufferSize = transacP->block2Size * 2;
+        if (bufferSize < transacP->block2Length + message->payload_len) bufferSize = transacP->block2Length + message->payload_len;
+        buffer = (uint8_t *)lwm2m_malloc(bufferSize);
+        if (buffer == NULL)
+        {
+            message->code = COAP_500_INTERNAL_SERVER_ERROR;
+            coap_set_payload(message, NULL, 0);
+            return false;
+        }
+        if (transacP->block2Buffer != NULL)
+        {
+            memcpy(buffer, transacP->block2Buffer, transacP->block2Length);
+            lwm2m_free(transacP->block2Buffer);
+        }
+        transacP->block2Buffer = buffer;
+        transacP->block2Size = bufferSize;
+    }
+    memcpy(transacP->block2Buffer + transacP->block2Length, message->payload, message->payload_len);
+    transacP->block2Length += message->payload_len;
+
+    if (!more)
+    {
+        coap_set_payload(message, transacP->block2Buffer, transacP->block2Length);
+        if (transacP->block2Observe) SET_OPTION(message, COAP_OPTION_OBSERVE);
+        return false;
+    }
+
+    // ask for the next block, without registering the observation again
+    prv_reuseTransaction(contextP, transacP);
+    UNSET_OPTION(requestP, COAP_OPTION_OBSERVE);
+    coap_set_header_block2(requestP, num + 1, 0, size);
+    (void)transaction_send(contextP, transacP);
+
+    return true;
+}
+
 bool transaction_handleResponse(lwm2m_context_t * contextP,
                                  void * fromSessionH,
                                  coap_packet_t * message,
                                  coap_packet_t * response)
 {
-    bool found = false;
     bool reset = false;
-    lwm2m_transaction_t * transacP;
+    lwm2m_transaction_t * transacP = NULL;
+    prv_match_data_t matchData;
 
     LOG("Entering");
-    transacP = contextP->transactionList;
+    matchData.contextP = contextP;
+    matchData.sessionH = fromSessionH;
+    matchData.message = message;
 
-    while (NULL != transacP)
+    if ((COAP_TYPE_ACK == message->type) || (COAP_TYPE_RST == message->type))
     {
-        if (lwm2m_session_is_equal(fromSessionH, transacP->peerH, contextP->userData) == true)
+        transacP = (lwm2m_transaction_t *)hash_find(&contextP->transactionMidIndex, message->mid, prv_matchMid, &matchData);
+        if (NULL != transacP)
         {
-            if (!transacP->ack_received)
-            {
-                if ((COAP_TYPE_ACK == message->type) || (COAP_TYPE_RST == message->type))
-                {
-                    if (transacP->mID == message->mid)
-	                {
-    	                found = true;
-        	            transacP->ack_received = true;
-            	        reset = COAP_TYPE_RST == message->type;
-            	    }
-                }
-            }
+            transacP->ack_received = true;
+            reset = COAP_TYPE_RST == message->type;
 
-            if (reset || prv_checkFinished(transacP, message))
+            if (!reset && !prv_checkFinished(transacP, message))
             {
-                // HACK: If a message is sent from the monitor callback,
-                // it will arrive before the registration ACK.
-                // So we resend transaction that were denied for authentication reason.
-                if (!reset)
-                {
-                    if (COAP_TYPE_CON == message->type && NULL != response)
-                    {
-                        coap_init_message(response, COAP_TYPE_ACK, 0, message->mid);
-                        message_send(contextP, response, fromSessionH);
-                    }
-                
-	                if ((COAP_401_UNAUTHORIZED == message->code) && (COAP_MAX_RETRANSMIT > transacP->retrans_counter))
-    	            {
-        	            transacP->ack_received = false;
-            	        transacP->retrans_time += COAP_RESPONSE_TIMEOUT;
-                	    return true;
-                	}
-				}       
-                if (transacP->callback != NULL)
+                // empty ACK, the response will come separately
+                int64_t currentTime = utils_getTimeMs();
+                if (0 <= currentTime)
                 {
-                    transacP->callback(transacP, message);
-                }
-                transaction_remove(contextP, transacP);
-                return true;
-            }
-            // if we found our guy, exit
-            if (found)
-            {
-                time_t tv_sec = lwm2m_gettime();
-                if (0 <= tv_sec)
-                {
-                    transacP->retrans_time = tv_sec;
+                    transacP->retrans_time = currentTime;
                 }
                 if (transacP->response_timeout)
                 {
-                    transacP->retrans_time += transacP->response_timeout;
+                    transacP->retrans_time += (int64_t)transacP->response_timeout * 1000;
                 }
                 else
                 {
-                    transacP->retrans_time += COAP_RESPONSE_TIMEOUT * transacP->retrans_counter;
+                    transacP->retrans_time += (int64_t)transacP->ack_timeout * transacP->retrans_counter;
                 }
+                timer_schedule(contextP, &transacP->timer, transacP->retrans_time);
                 return true;
             }
         }
+    }
+
+    if (NULL == transacP && IS_OPTION(message, COAP_OPTION_TOKEN))
+    {
+        transacP = (lwm2m_transaction_t *)hash_find(&contextP->transactionTokenIndex,
+                                                    hash_buffer(message->token, message->token_len),
+                                                    prv_matchToken, &matchData);
+    }
+
+    if (NULL == transacP) return false;
+
+    // HACK: If a message is sent from the monitor callback,
+    // it will arrive before the registration ACK.
+    // So we resend transaction that were denied for authentication reason.
+    if (!reset)
+    {
+        if (COAP_TYPE_CON == message->type && NULL != response)
+        {
+            coap_init_message(response, COAP_TYPE_ACK, 0, message->mid);
+            message_send(contextP, response, fromSessionH);
+        }
 
-        transacP = transacP->next;
+        if ((COAP_401_UNAUTHORIZED == message->code) && (COAP_MAX_RETRANSMIT > transacP->retrans_counter))
+        {
+            transacP->ack_received = false;
+            transacP->retrans_time += transacP->ack_timeout;
+            timer_schedule(contextP, &transacP->timer, transacP->retrans_time);
+            return true;
+        }
     }
-    return false;
+    if (!reset
+     && (prv_handleBlock1(contextP, transacP, message)
+      || prv_handleBlock2(contextP, transacP, message)))
+    {
+        return true;
+    }
+    if (transacP->callback != NULL)
+    {
+        transacP->callback(transacP, message);
+    }
+    transaction_remove(contextP, transacP);
+    return true;
 }
 
 int transaction_send(lwm2m_context_t * contextP,
                      lwm2m_transaction_t * transacP)
 {
     bool maxRetriesReached = false;
+    uint8_t * pktBuffer;
+    size_t pktBufferLen;
 
     LOG_ARG("Entering: transaction=%p", transacP);
     if (transacP->buffer == NULL)
     {
-        transacP->buffer_len = coap_serialize_get_size(transacP->message);
-        if (transacP->buffer_len == 0)
+        if (!prv_indexTransaction(contextP, transacP)
+         || !timer_schedule(contextP, &transacP->timer, transacP->retrans_time))
         {
            transaction_remove(contextP, transacP);
            return COAP_500_INTERNAL_SERVER_ERROR;
         }
 
-        transacP->buffer = (uint8_t*)lwm2m_malloc(transacP->buffer_len);
-        if (transacP->buffer == NULL)
+        // serialize once in the send buffer and keep an exact copy for retransmissions,
+        // the options are kept for the next blocks
+        pktBuffer = message_serialize(contextP, (coap_packet_t *)transacP->message, true, &pktBufferLen);
+        if (pktBuffer == NULL || pktBufferLen > UINT16_MAX)
         {
            transaction_remove(contextP, transacP);
            return COAP_500_INTERNAL_SERVER_ERROR;
         }
 
-        transacP->buffer_len = coap_serialize_message(transacP->message, transacP->buffer);
-        if (transacP->buffer_len == 0)
+        transacP->buffer = (uint8_t*)lwm2m_malloc(pktBufferLen);
+        if (transacP->buffer == NULL)
         {
-            lwm2m_free(transacP->buffer);
-            transacP->buffer = NULL;
-            transaction_remove(contextP, transacP);
-            return COAP_500_INTERNAL_SERVER_ERROR;
+           transaction_remove(contextP, transacP);
+           return COAP_500_INTERNAL_SERVER_ERROR;
         }
+        memcpy(transacP->buffer, pktBuffer, pktBufferLen);
+        transacP->buffer_len = (uint16_t)pktBufferLen;
     }
 
     if (!transacP->ack_received)
     {
-        long unsigned timeout;
+        int64_t timeout = 0;
 
         if (0 == transacP->retrans_counter)
         {
-            time_t tv_sec = lwm2m_gettime();
-            if (0 <= tv_sec)
+            int64_t currentTime = utils_getTimeMs();
+            if (0 <= currentTime)
             {
-                transacP->retrans_time = tv_sec + COAP_RESPONSE_TIMEOUT;
+                transacP->ack_timeout = COAP_RESPONSE_TIMEOUT_MS + (uint32_t)rand() % (COAP_RESPONSE_TIMEOUT_RANGE_MS + 1);
+                transacP->retrans_time = currentTime + transacP->ack_timeout;
                 transacP->retrans_counter = 1;
-                timeout = 0;
             }
             else
             {
@@ -395,7 +671,7 @@ int transaction_send(lwm2m_context_t * contextP,
         }
         else
         {
-            timeout = COAP_RESPONSE_TIMEOUT << (transacP->retrans_counter - 1);
+            timeout = (int64_t)transacP->ack_timeout << (transacP->retrans_counter - 1);
         }
 
         if (COAP_MAX_RETRANSMIT + 1 >= transacP->retrans_counter)
@@ -404,6 +680,7 @@ int transaction_send(lwm2m_context_t * contextP,
 
             transacP->retrans_time += timeout;
             transacP->retrans_counter += 1;
+            timer_schedule(contextP, &transacP->timer, transacP->retrans_time);
         }
         else
         {
@@ -424,49 +701,3 @@ int transaction_send(lwm2m_context_t * contextP,
 
     return 0;
 }
-
-void transaction_step(lwm2m_context_t * contextP,
-                      time_t currentTime,
-                      time_t * timeoutP)
-{
-    lwm2m_transaction_t * transacP;
-
-    LOG("Entering");
-    transacP = contextP->transactionList;
-    while (transacP != NULL)
-    {
-        // transaction_send() may remove transaction from the linked list
-        lwm2m_transaction_t * nextP = transacP->next;
-        int removed = 0;
-
-        if (transacP->retrans_time <= currentTime)
-        {
-            removed = transaction_send(contextP, transacP);
-        }
-
-        if (0 == removed)
-        {
-            time_t interval;
-
-            if (transacP->retrans_time > currentTime)
-            {
-                interval = transacP->retrans_time - currentTime;
-            }
-            else
-            {
-                interval = 1;
-            }
-
-            if (*timeoutP > interval)
-            {
-                *timeoutP = interval;
-            }
-        }
-        else
-        {
-            *timeoutP = 1;
-        }
-
-        transacP = nextP;
-    }
-}
@@ -93,6 +93,33 @@ int uri_getNumber(uint8_t * uriString,
 }
 
 
+static bool prv_parseClientId(multi_option_t * segmentP,
+                              uint32_t * idP)
+{
+    int64_t value;
+
+    if (segmentP->len == 0 || segmentP->data[0] == '-') return false;
+    if (utils_textToInt(segmentP->data, segmentP->len, &value) != 1) return false;
+    if (value > UINT32_MAX) return false;
+
+    *idP = (uint32_t)value;
+    return true;
+}
+
+bool uri_getClientId(multi_option_t * uriPath,
+                     uint32_t * idP)
+{
+    if (uriPath == NULL
+     || URI_REGISTRATION_SEGMENT_LEN != uriPath->len
+     || 0 != strncmp(URI_REGISTRATION_SEGMENT, (char *)uriPath->data, uriPath->len))
+    {
+        return false;
+    }
+    if (uriPath->next == NULL || uriPath->next->next != NULL) return false;
+
+    return prv_parseClientId(uriPath->next, idP);
+}
+
 lwm2m_uri_t * uri_decode(char * altPath,
                          multi_option_t *uriPath)
 {
@@ -153,17 +180,24 @@ lwm2m_uri_t * uri_decode(char * altPath,
         }
     }
 
+    if ((uriP->flag & LWM2M_URI_MASK_TYPE) == LWM2M_URI_FLAG_REGISTRATION)
+    {
+        uint32_t clientId;
+
+        // client IDs are 32-bit and must be read with uri_getClientId()
+        if (!prv_parseClientId(uriPath, &clientId)) goto error;
+        if (clientId <= LWM2M_MAX_ID) uriP->objectId = (uint16_t)clientId;
+        uriP->flag |= LWM2M_URI_FLAG_OBJECT_ID;
+        if (uriPath->next != NULL) goto error;
+        return uriP;
+    }
+
     readNum = uri_getNumber(uriPath->data, uriPath->len);
     if (readNum < 0 || readNum > LWM2M_MAX_ID) goto error;
     uriP->objectId = (uint16_t)readNum;
     uriP->flag |= LWM2M_URI_FLAG_OBJECT_ID;
     uriPath = uriPath->next;
 
-    if ((uriP->flag & LWM2M_URI_MASK_TYPE) == LWM2M_URI_FLAG_REGISTRATION)
-    {
-        if (uriPath != NULL) goto error;
-        return uriP;
-    }
     uriP->flag |= LWM2M_URI_FLAG_DM;
 
     if (uriPath == NULL) return uriP;
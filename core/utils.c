@@ -50,7 +50,6 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
-#include <float.h>
 
 
 int utils_textToInt(uint8_t * buffer,
@@ -98,67 +97,753 @@ int utils_textToInt(uint8_t * buffer,
     return 1;
 }
 
+/*
+ * Floats are printed with Grisu2 (F. Loitsch, "Printing Floating-Point Numbers
+ * Quickly and Accurately with Integers"): the digits are generated with 64-bit
+ * integer arithmetic from a table of cached powers of ten and stop as soon as
+ * they fall inside the rounding interval of the double. The text always reads
+ * back to the same double and is the shortest one in nearly all cases.
+ *
+ * Text is read into a mantissa of up to 19 digits and a decimal exponent. When
+ * both are exact doubles, a single multiplication or division gives the
+ * correctly rounded result. Otherwise an approximation built from the cached
+ * powers is checked against the decimal value with big integers and moved to
+ * the nearest double. The big integer holds up to 770 significant digits of
+ * the text, more than the 767 a midpoint between two doubles can have, and
+ * the digits after them only tell whether the value is above such a midpoint.
+ * The result is always correctly rounded.
+ */
+
+#define FLOAT_SIGNIFICAND_SIZE  52
+#define FLOAT_HIDDEN_BIT        ((uint64_t)1 << FLOAT_SIGNIFICAND_SIZE)
+#define FLOAT_SIGNIFICAND_MASK  (FLOAT_HIDDEN_BIT - 1)
+#define FLOAT_EXPONENT_MASK     ((uint64_t)0x7FF << FLOAT_SIGNIFICAND_SIZE)
+#define FLOAT_SIGN_MASK         ((uint64_t)1 << 63)
+#define FLOAT_EXPONENT_BIAS     (0x3FF + FLOAT_SIGNIFICAND_SIZE)
+#define FLOAT_MIN_EXPONENT      (1 - FLOAT_EXPONENT_BIAS)
+
+#define FLOAT_MAX_DIGITS        19
+#define FLOAT_MAX_BIG_DIGITS    770
+#define FLOAT_MAX_EXACT_POW10   22
+#define FLOAT_MAX_TEXT_LENGTH   32
+// 32-bit words, enough for 2^54 * 5^1094 * 2^18 which is the biggest number compared
+#define FLOAT_BIG_SIZE          84
+
+#define FLOAT_CACHED_POWER_MIN  -348
+#define FLOAT_CACHED_POWER_STEP 8
+
+// f * 2^e
+typedef struct
+{
+    uint64_t f;
+    int      e;
+} _diy_fp_t;
+
+typedef struct
+{
+    uint32_t words[FLOAT_BIG_SIZE];
+    size_t   count;
+} _big_int_t;
+
+static const uint64_t prv_pow10[] =
+{
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+    10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+    100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+static const double prv_exactPow10[FLOAT_MAX_EXACT_POW10 + 1] =
+{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// 10^(-348 + 8 * i) normalized to 64 bits, rounded to nearest
+static const uint64_t prv_cachedPowerF[] =
+{
+    0xFA8FD5A0081C0288ULL, 0xBAAEE17FA23EBF76ULL, 0x8B16FB203055AC76ULL,
+    0xCF42894A5DCE35EAULL, 0x9A6BB0AA55653B2DULL, 0xE61ACF033D1A45DFULL,
+    0xAB70FE17C79AC6CAULL, 0xFF77B1FCBEBCDC4FULL, 0xBE5691EF416BD60CULL,
+    0x8DD01FAD907FFC3CULL, 0xD3515C2831559A83ULL, 0x9D71AC8FADA6C9B5ULL,
+    0xEA9C227723EE8BCBULL, 0xAECC49914078536DULL, 0x823C12795DB6CE57ULL,
+    0xC21094364DFB5637ULL, 0x9096EA6F3848984FULL, 0xD77485CB25823AC7ULL,
+    0xA086CFCD97BF97F4ULL, 0xEF340A98172AACE5ULL, 0xB23867FB2A35B28EULL,
+    0x84C8D4DFD2C63F3BULL, 0xC5DD44271AD3CDBAULL, 0x936B9FCEBB25C996ULL,
+    0xDBAC6C247D62A584ULL, 0xA3AB66580D5FDAF6ULL, 0xF3E2F893DEC3F126ULL,
+    0xB5B5ADA8AAFF80B8ULL, 0x87625F056C7C4A8BULL, 0xC9BCFF6034C13053ULL,
+    0x964E858C91BA2655ULL, 0xDFF9772470297EBDULL, 0xA6DFBD9FB8E5B88FULL,
+    0xF8A95FCF88747D94ULL, 0xB94470938FA89BCFULL, 0x8A08F0F8BF0F156BULL,
+    0xCDB02555653131B6ULL, 0x993FE2C6D07B7FACULL, 0xE45C10C42A2B3B06ULL,
+    0xAA242499697392D3ULL, 0xFD87B5F28300CA0EULL, 0xBCE5086492111AEBULL,
+    0x8CBCCC096F5088CCULL, 0xD1B71758E219652CULL, 0x9C40000000000000ULL,
+    0xE8D4A51000000000ULL, 0xAD78EBC5AC620000ULL, 0x813F3978F8940984ULL,
+    0xC097CE7BC90715B3ULL, 0x8F7E32CE7BEA5C70ULL, 0xD5D238A4ABE98068ULL,
+    0x9F4F2726179A2245ULL, 0xED63A231D4C4FB27ULL, 0xB0DE65388CC8ADA8ULL,
+    0x83C7088E1AAB65DBULL, 0xC45D1DF942711D9AULL, 0x924D692CA61BE758ULL,
+    0xDA01EE641A708DEAULL, 0xA26DA3999AEF774AULL, 0xF209787BB47D6B85ULL,
+    0xB454E4A179DD1877ULL, 0x865B86925B9BC5C2ULL, 0xC83553C5C8965D3DULL,
+    0x952AB45CFA97A0B3ULL, 0xDE469FBD99A05FE3ULL, 0xA59BC234DB398C25ULL,
+    0xF6C69A72A3989F5CULL, 0xB7DCBF5354E9BECEULL, 0x88FCF317F22241E2ULL,
+    0xCC20CE9BD35C78A5ULL, 0x98165AF37B2153DFULL, 0xE2A0B5DC971F303AULL,
+    0xA8D9D1535CE3B396ULL, 0xFB9B7CD9A4A7443CULL, 0xBB764C4CA7A44410ULL,
+    0x8BAB8EEFB6409C1AULL, 0xD01FEF10A657842CULL, 0x9B10A4E5E9913129ULL,
+    0xE7109BFBA19C0C9DULL, 0xAC2820D9623BF429ULL, 0x80444B5E7AA7CF85ULL,
+    0xBF21E44003ACDD2DULL, 0x8E679C2F5E44FF8FULL, 0xD433179D9C8CB841ULL,
+    0x9E19DB92B4E31BA9ULL, 0xEB96BF6EBADF77D9ULL, 0xAF87023B9BF0EE6BULL
+};
+
+static const int16_t prv_cachedPowerE[] =
+{
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007,  -980,
+     -954,  -927,  -901,  -874,  -847,  -821,  -794,  -768,  -741,  -715,
+     -688,  -661,  -635,  -608,  -582,  -555,  -529,  -502,  -475,  -449,
+     -422,  -396,  -369,  -343,  -316,  -289,  -263,  -236,  -210,  -183,
+     -157,  -130,  -103,   -77,   -50,   -24,     3,    30,    56,    83,
+      109,   136,   162,   189,   216,   242,   269,   295,   322,   348,
+      375,   402,   428,   455,   481,   508,   534,   561,   588,   614,
+      641,   667,   694,   720,   747,   774,   800,   827,   853,   880,
+      907,   933,   960,   986,  1013,  1039,  1066
+};
+
+static uint64_t prv_doubleToBits(double value)
+{
+    uint64_t bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static double prv_bitsToDouble(uint64_t bits)
+{
+    double value;
+
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// bits must be finite and positive
+static void prv_bitsToDiyFp(uint64_t bits,
+                            _diy_fp_t * fpP)
+{
+    int biasedExponent;
+
+    biasedExponent = (int)((bits & FLOAT_EXPONENT_MASK) >> FLOAT_SIGNIFICAND_SIZE);
+    fpP->f = bits & FLOAT_SIGNIFICAND_MASK;
+    if (biasedExponent != 0)
+    {
+        fpP->f += FLOAT_HIDDEN_BIT;
+        fpP->e = biasedExponent - FLOAT_EXPONENT_BIAS;
+    }
+    else
+    {
+        fpP->e = FLOAT_MIN_EXPONENT;
+    }
+}
+
+// fpP->f must not be zero
+static void prv_diyNormalize(_diy_fp_t * fpP)
+{
+    int shift;
+
+    for (shift = 32 ; shift > 0 ; shift /= 2)
+    {
+        if ((fpP->f >> (64 - shift)) == 0)
+        {
+            fpP->f <<= shift;
+            fpP->e -= shift;
+        }
+    }
+}
+
+// keeps the upper 64 bits of the 128-bit product, rounded
+static void prv_diyMultiply(_diy_fp_t * fpP,
+                            const _diy_fp_t * factorP)
+{
+    uint64_t a = fpP->f >> 32;
+    uint64_t b = fpP->f & 0xFFFFFFFF;
+    uint64_t c = factorP->f >> 32;
+    uint64_t d = factorP->f & 0xFFFFFFFF;
+    uint64_t bd = b * d;
+    uint64_t ad = a * d;
+    uint64_t bc = b * c;
+    uint64_t middle;
+
+    middle = (bd >> 32) + (ad & 0xFFFFFFFF) + (bc & 0xFFFFFFFF);
+    middle += (uint64_t)1 << 31;
+
+    fpP->f = a * c + (ad >> 32) + (bc >> 32) + (middle >> 32);
+    fpP->e += factorP->e + 64;
+}
+
+// returns the decimal exponent of the power
+static int prv_getCachedPower(int index,
+                              _diy_fp_t * powerP)
+{
+    powerP->f = prv_cachedPowerF[index];
+    powerP->e = prv_cachedPowerE[index];
+
+    return FLOAT_CACHED_POWER_MIN + index * FLOAT_CACHED_POWER_STEP;
+}
+
+static int prv_countDigits(uint32_t value)
+{
+    int count = 1;
+
+    while (count < 10 && value >= (uint32_t)prv_pow10[count])
+    {
+        count++;
+    }
+
+    return count;
+}
+
+static void prv_grisuRound(char * digits,
+                           int length,
+                           uint64_t delta,
+                           uint64_t rest,
+                           uint64_t tenKappa,
+                           uint64_t distance)
+{
+    while (rest < distance
+        && delta - rest >= tenKappa
+        && (rest + tenKappa < distance || distance - rest > rest + tenKappa - distance))
+    {
+        digits[length - 1]--;
+        rest += tenKappa;
+    }
+}
+
+/*
+ * Writes the digits of a finite positive double and returns their count. The
+ * value is digits * 10^(*exponentP).
+ */
+static int prv_grisu2(uint64_t bits,
+                      char * digits,
+                      int * exponentP)
+{
+    _diy_fp_t value;
+    _diy_fp_t upper;
+    _diy_fp_t lower;
+    _diy_fp_t power;
+    double dk;
+    int k;
+    int shift;
+    uint64_t one;
+    uint64_t delta;
+    uint64_t distance;
+    uint32_t integral;
+    uint64_t fractional;
+    int kappa;
+    int length;
+
+    prv_bitsToDiyFp(bits, &value);
+
+    // boundaries halfway to the neighbouring doubles
+    upper.f = (value.f << 1) + 1;
+    upper.e = value.e - 1;
+    prv_diyNormalize(&upper);
+    if (value.f == FLOAT_HIDDEN_BIT && (bits & FLOAT_EXPONENT_MASK) > FLOAT_HIDDEN_BIT)
+    {
+        // the double below is closer
+        lower.f = (value.f << 2) - 1;
+        lower.e = value.e - 2;
+    }
+    else
+    {
+        lower.f = (value.f << 1) - 1;
+        lower.e = value.e - 1;
+    }
+    lower.f <<= lower.e - upper.e;
+    lower.e = upper.e;
+    prv_diyNormalize(&value);
+
+    // pick the power of ten bringing the binary exponent in [-60, -32]
+    dk = (-61 - upper.e) * 0.30102999566398114 + 347;
+    k = (int)dk;
+    if (dk - k > 0.0) k++;
+    *exponentP = -prv_getCachedPower((k >> 3) + 1, &power);
+
+    prv_diyMultiply(&value, &power);
+    prv_diyMultiply(&upper, &power);
+    prv_diyMultiply(&lower, &power);
+    upper.f--;
+    lower.f++;
+    delta = upper.f - lower.f;
+    distance = upper.f - value.f;
+
+    shift = -upper.e;
+    one = (uint64_t)1 << shift;
+    integral = (uint32_t)(upper.f >> shift);
+    fractional = upper.f & (one - 1);
+    kappa = prv_countDigits(integral);
+    length = 0;
+
+    while (kappa > 0)
+    {
+        uint32_t divisor;
+        uint32_t digit;
+        uint64_t rest;
+
+        divisor = (uint32_t)prv_pow10[kappa - 1];
+        digit = integral / divisor;
+        integral %= divisor;
+        if (digit != 0 || length != 0) digits[length++] = '0' + digit;
+        kappa--;
+
+        rest = ((uint64_t)integral << shift) + fractional;
+        if (rest <= delta)
+        {
+            *exponentP += kappa;
+            prv_grisuRound(digits, length, delta, rest, prv_pow10[kappa] << shift, distance);
+            return length;
+        }
+    }
+
+    while (1)
+    {
+        uint32_t digit;
+
+        fractional *= 10;
+        delta *= 10;
+        digit = (uint32_t)(fractional >> shift);
+        if (digit != 0 || length != 0) digits[length++] = '0' + digit;
+        fractional &= one - 1;
+        kappa--;
+
+        if (fractional < delta)
+        {
+            *exponentP += kappa;
+            prv_grisuRound(digits, length, delta, fractional, one, (-kappa < 20) ? distance * prv_pow10[-kappa] : 0);
+            return length;
+        }
+    }
+}
+
+static void prv_bigSet(_big_int_t * bigP,
+                       uint64_t value)
+{
+    bigP->words[0] = (uint32_t)value;
+    bigP->words[1] = (uint32_t)(value >> 32);
+    bigP->count = (bigP->words[1] != 0) ? 2 : 1;
+}
+
+static void prv_bigMultiply(_big_int_t * bigP,
+                            uint32_t factor)
+{
+    uint64_t carry = 0;
+    size_t i;
+
+    for (i = 0 ; i < bigP->count ; i++)
+    {
+        carry += (uint64_t)bigP->words[i] * factor;
+        bigP->words[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    if (carry != 0)
+    {
+        bigP->words[bigP->count] = (uint32_t)carry;
+        bigP->count++;
+    }
+}
+
+static void prv_bigMultiplyPow5(_big_int_t * bigP,
+                                int exponent)
+{
+    // 5^13 is the biggest power of 5 fitting in 32 bits
+    while (exponent >= 13)
+    {
+        prv_bigMultiply(bigP, 1220703125);
+        exponent -= 13;
+    }
+    if (exponent > 0)
+    {
+        prv_bigMultiply(bigP, (uint32_t)(prv_pow10[exponent] >> exponent));
+    }
+}
+
+static void prv_bigShiftLeft(_big_int_t * bigP,
+                             int shift)
+{
+    size_t words = (size_t)shift / 32;
+    int bits = shift % 32;
+    size_t i;
+
+    if (bits != 0)
+    {
+        uint32_t carry = 0;
+
+        for (i = 0 ; i < bigP->count ; i++)
+        {
+            uint32_t word = bigP->words[i];
+
+            bigP->words[i] = (word << bits) | carry;
+            carry = word >> (32 - bits);
+        }
+        if (carry != 0)
+        {
+            bigP->words[bigP->count] = carry;
+            bigP->count++;
+        }
+    }
+    if (words != 0)
+    {
+        memmove(bigP->words + words, bigP->words, bigP->count * sizeof(uint32_t));
+        memset(bigP->words, 0, words * sizeof(uint32_t));
+        bigP->count += words;
+    }
+}
+
+static void prv_bigAdd(_big_int_t * bigP,
+                       uint32_t value)
+{
+    uint64_t carry = value;
+    size_t i;
+
+    for (i = 0 ; i < bigP->count && carry != 0 ; i++)
+    {
+        carry += bigP->words[i];
+        bigP->words[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    if (carry != 0)
+    {
+        bigP->words[bigP->count] = (uint32_t)carry;
+        bigP->count++;
+    }
+}
+
+static int prv_bigCompare(const _big_int_t * leftP,
+                          const _big_int_t * rightP)
+{
+    size_t i;
+
+    if (leftP->count != rightP->count) return (leftP->count > rightP->count) ? 1 : -1;
+
+    for (i = leftP->count ; i > 0 ; i--)
+    {
+        if (leftP->words[i - 1] != rightP->words[i - 1])
+        {
+            return (leftP->words[i - 1] > rightP->words[i - 1]) ? 1 : -1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Compares decimal * 10^exponent, plus a bit more when sticky is true, with the midpoint
+ * between the double of bits and the next one up. Returns a value less than, equal to
+ * or greater than 0.
+ */
+static int prv_compareMidpoint(const _big_int_t * decimalP,
+                               int exponent,
+                               bool sticky,
+                               uint64_t bits)
+{
+    _big_int_t decimal;
+    _big_int_t midpoint;
+    _diy_fp_t value;
+    int shift;
+    int result;
+
+    prv_bitsToDiyFp(bits, &value);
+
+    // midpoint is (2 * f + 1) * 2^(e - 1)
+    decimal = *decimalP;
+    prv_bigSet(&midpoint, 2 * value.f + 1);
+    if (exponent >= 0)
+    {
+        prv_bigMultiplyPow5(&decimal, exponent);
+    }
+    else
+    {
+        prv_bigMultiplyPow5(&midpoint, -exponent);
+    }
+    shift = exponent - (value.e - 1);
+    if (shift > 0)
+    {
+        prv_bigShiftLeft(&decimal, shift);
+    }
+    else
+    {
+        prv_bigShiftLeft(&midpoint, -shift);
+    }
+
+    result = prv_bigCompare(&decimal, &midpoint);
+    if (result == 0 && sticky) result = 1;
+
+    return result;
+}
+
+// rounds a normalized number to a nearby double
+static uint64_t prv_diyToBits(const _diy_fp_t * fpP)
+{
+    int exponent;
+    int shift;
+    uint64_t significand;
+
+    // the value is in [2^exponent, 2^(exponent + 1))
+    exponent = fpP->e + 63;
+    if (exponent > 0x3FF) return FLOAT_EXPONENT_MASK;
+
+    if (exponent >= 1 - 0x3FF)
+    {
+        shift = 63 - FLOAT_SIGNIFICAND_SIZE;
+        significand = (fpP->f >> shift) + ((fpP->f >> (shift - 1)) & 1);
+
+        // a carry out of the significand bumps the exponent
+        return ((uint64_t)(exponent + 0x3FF - 1) << FLOAT_SIGNIFICAND_SIZE) + significand;
+    }
+
+    shift = 63 - FLOAT_SIGNIFICAND_SIZE + 1 - 0x3FF - exponent;
+    if (shift > 63) return 0;
+    significand = (fpP->f >> shift) + ((fpP->f >> (shift - 1)) & 1);
+
+    // subnormal, a carry makes it the smallest normal
+    return significand;
+}
+
+/*
+ * Reads up to FLOAT_MAX_BIG_DIGITS significant digits of the significand text in a big
+ * integer. Returns how many were read and sets *stickyP if any digit left is not zero.
+ */
+static int prv_bigReadDigits(_big_int_t * bigP,
+                             const uint8_t * text,
+                             int length,
+                             bool * stickyP)
+{
+    uint32_t chunk = 0;
+    int chunkDigits = 0;
+    int count = 0;
+    int i;
+
+    prv_bigSet(bigP, 0);
+    *stickyP = false;
+    for (i = 0 ; i < length ; i++)
+    {
+        if (text[i] == '.') continue;
+        if (count == 0 && text[i] == '0') continue;
+
+        if (count == FLOAT_MAX_BIG_DIGITS)
+        {
+            if (text[i] != '0')
+            {
+                *stickyP = true;
+                break;
+            }
+            continue;
+        }
+
+        // 9 digits at a time fit in 32 bits
+        chunk = chunk * 10 + (text[i] - '0');
+        chunkDigits++;
+        count++;
+        if (chunkDigits == 9)
+        {
+            prv_bigMultiply(bigP, (uint32_t)prv_pow10[9]);
+            prv_bigAdd(bigP, chunk);
+            chunk = 0;
+            chunkDigits = 0;
+        }
+    }
+    if (chunkDigits != 0)
+    {
+        prv_bigMultiply(bigP, (uint32_t)prv_pow10[chunkDigits]);
+        prv_bigAdd(bigP, chunk);
+    }
+
+    return count;
+}
+
+/*
+ * mantissa holds the first digits significant digits of the significand text and
+ * mantissa * 10^exponent must be less than 10^309 and more than 10^-324.
+ */
+static uint64_t prv_decimalToBits(uint64_t mantissa,
+                                  int digits,
+                                  int exponent,
+                                  const uint8_t * text,
+                                  int length)
+{
+    _diy_fp_t value;
+    _diy_fp_t power;
+    _big_int_t decimal;
+    int decimalExponent;
+    bool sticky;
+    int index;
+    int remainder;
+    uint64_t bits;
+
+    // approximate
+    value.f = mantissa;
+    value.e = 0;
+    prv_diyNormalize(&value);
+    index = (exponent - FLOAT_CACHED_POWER_MIN) / FLOAT_CACHED_POWER_STEP;
+    remainder = exponent - prv_getCachedPower(index, &power);
+    prv_diyMultiply(&value, &power);
+    prv_diyNormalize(&value);
+    if (remainder > 0)
+    {
+        power.f = prv_pow10[remainder];
+        power.e = 0;
+        prv_diyNormalize(&power);
+        prv_diyMultiply(&value, &power);
+        prv_diyNormalize(&value);
+    }
+    bits = prv_diyToBits(&value);
+    if (bits == FLOAT_EXPONENT_MASK) bits--;
+
+    // every digit read after the ones of the mantissa lowers the exponent
+    decimalExponent = exponent + digits - prv_bigReadDigits(&decimal, text, length, &sticky);
+
+    // move to the nearest double, ties to even
+    while (bits < FLOAT_EXPONENT_MASK)
+    {
+        int result;
+
+        result = prv_compareMidpoint(&decimal, decimalExponent, sticky, bits);
+        if (result > 0 || (result == 0 && (bits & 1) != 0))
+        {
+            bits++;
+            continue;
+        }
+        if (bits == 0) break;
+        result = prv_compareMidpoint(&decimal, decimalExponent, sticky, bits - 1);
+        if (result < 0 || (result == 0 && (bits & 1) != 0))
+        {
+            bits--;
+            continue;
+        }
+        break;
+    }
+
+    return bits;
+}
+
 int utils_textToFloat(uint8_t * buffer,
                       int length,
                       double * dataP)
 {
+    uint64_t mantissa;
+    int digits;
+    int exponent;
+    int start;
+    int end;
+    bool hasDigits;
+    bool negative;
     double result;
-    int sign;
     int i;
 
     if (0 == length) return 0;
 
     if (buffer[0] == '-')
     {
-        sign = -1;
+        negative = true;
         i = 1;
     }
     else
     {
-        sign = 1;
+        negative = false;
         i = 0;
     }
+    start = i;
 
-    result = 0;
-    while (i < length && buffer[i] != '.')
+    mantissa = 0;
+    digits = 0;
+    exponent = 0;
+    hasDigits = false;
+    while (i < length && '0' <= buffer[i] && buffer[i] <= '9')
     {
-        if ('0' <= buffer[i] && buffer[i] <= '9')
+        if (digits < FLOAT_MAX_DIGITS)
         {
-            if (result > (DBL_MAX / 10)) return 0;
-            result *= 10;
-            result += (buffer[i] - '0');
+            mantissa = mantissa * 10 + (buffer[i] - '0');
+            if (mantissa != 0) digits++;
         }
         else
         {
-            return 0;
+            exponent++;
         }
+        hasDigits = true;
         i++;
     }
-    if (buffer[i] == '.')
+    if (i < length && buffer[i] == '.')
     {
-        double dec;
-
         i++;
         if (i == length) return 0;
 
-        dec = 0.1;
-        while (i < length)
+        while (i < length && '0' <= buffer[i] && buffer[i] <= '9')
         {
-            if ('0' <= buffer[i] && buffer[i] <= '9')
+            if (digits < FLOAT_MAX_DIGITS)
             {
-                if (result > (DBL_MAX - 1)) return 0;
-                result += (buffer[i] - '0') * dec;
-                dec /= 10;
-            }
-            else
-            {
-                return 0;
+                mantissa = mantissa * 10 + (buffer[i] - '0');
+                if (mantissa != 0) digits++;
+                exponent--;
             }
+            hasDigits = true;
             i++;
         }
     }
+    if (!hasDigits) return 0;
+    end = i;
+
+    if (i < length && (buffer[i] == 'e' || buffer[i] == 'E'))
+    {
+        int sign = 1;
+        int value = 0;
+
+        i++;
+        if (i < length && (buffer[i] == '-' || buffer[i] == '+'))
+        {
+            if (buffer[i] == '-') sign = -1;
+            i++;
+        }
+        if (i == length) return 0;
+
+        while (i < length && '0' <= buffer[i] && buffer[i] <= '9')
+        {
+            // anything bigger is out of range anyway
+            if (value < 100000) value = value * 10 + (buffer[i] - '0');
+            i++;
+        }
+        exponent += sign * value;
+    }
+    if (i != length) return 0;
+
+    if (mantissa == 0 || exponent + digits <= -324)
+    {
+        result = 0;
+    }
+    else if (exponent + digits > 309)
+    {
+        return 0;
+    }
+    else if (mantissa <= FLOAT_HIDDEN_BIT * 2
+          && exponent >= -FLOAT_MAX_EXACT_POW10
+          && exponent <= FLOAT_MAX_EXACT_POW10)
+    {
+        // both operands are exact so the result is correctly rounded
+        result = (double)mantissa;
+        if (exponent < 0)
+        {
+            result /= prv_exactPow10[-exponent];
+        }
+        else
+        {
+            result *= prv_exactPow10[exponent];
+        }
+    }
+    else
+    {
+        uint64_t bits;
+
+        bits = prv_decimalToBits(mantissa, digits, exponent, buffer + start, end - start);
+        if (bits >= FLOAT_EXPONENT_MASK) return 0;
+        result = prv_bitsToDouble(bits);
+    }
 
-    *dataP = result * sign;
+    *dataP = negative ? -result : result;
     return 1;
 }
 
@@ -214,64 +899,89 @@ size_t utils_floatToText(double data,
                          uint8_t * string,
                          size_t length)
 {
-    size_t intLength;
-    size_t decLength;
-    int64_t intPart;
-    double decPart;
+    uint64_t bits;
+    _diy_fp_t value;
+    char digits[FLOAT_MAX_DIGITS + 1];
+    uint8_t text[FLOAT_MAX_TEXT_LENGTH];
+    int count;
+    int exponent;
+    int point;
+    size_t result;
+    int i;
 
-    if (data <= (double)INT64_MIN || data >= (double)INT64_MAX) return 0;
+    bits = prv_doubleToBits(data);
+    if ((bits & FLOAT_EXPONENT_MASK) == FLOAT_EXPONENT_MASK) return 0;
 
-    intPart = (int64_t)data;
-    decPart = data - intPart;
-    if (decPart < 0)
-    {
-        decPart = 1 - decPart;
-    }
-    else
+    result = 0;
+    if ((bits & FLOAT_SIGN_MASK) != 0)
     {
-        decPart = 1 + decPart;
+        bits &= ~FLOAT_SIGN_MASK;
+        if (bits != 0) text[result++] = '-';
     }
+    prv_bitsToDiyFp(bits, &value);
 
-    if (decPart <= 1 + FLT_EPSILON)
+    if (bits == 0)
     {
-        decPart = 0;
+        text[result++] = '0';
     }
-
-    if (intPart == 0 && data < 0)
+    else if (value.e <= 0
+          && value.e > -64
+          && (value.f & (((uint64_t)1 << -value.e) - 1)) == 0)
     {
-        // deal with numbers between -1 and 0
-        if (length < 4) return 0;   // "-0.n"
-        string[0] = '-';
-        string[1] = '0';
-        intLength = 2;
+        // integers below 2^53 are printed as is
+        result += utils_intToText((int64_t)(value.f >> -value.e), text + result, FLOAT_MAX_TEXT_LENGTH - result);
     }
     else
     {
-        intLength = utils_intToText(intPart, string, length);
-        if (intLength == 0) return 0;
-    }
-    decLength = 0;
-    if (decPart >= FLT_EPSILON)
-    {
-        double noiseFloor;
+        count = prv_grisu2(bits, digits, &exponent);
 
-        if (intLength >= length - 1) return 0;
-
-        noiseFloor = FLT_EPSILON;
-        do
+        // same layout as ECMAScript Number.prototype.toString()
+        point = count + exponent;
+        if (count <= point && point <= 21)
         {
-            decPart *= 10;
-            noiseFloor *= 10;
-        } while (decPart - (int64_t)decPart > noiseFloor);
-
-        decLength = utils_intToText(decPart, string + intLength, length - intLength);
-        if (decLength <= 1) return 0;
-
-        // replace the leading 1 with a dot
-        string[intLength] = '.';
+            for (i = 0 ; i < count ; i++) text[result++] = digits[i];
+            for ( ; i < point ; i++) text[result++] = '0';
+        }
+        else if (0 < point && point <= 21)
+        {
+            for (i = 0 ; i < point ; i++) text[result++] = digits[i];
+            text[result++] = '.';
+            for ( ; i < count ; i++) text[result++] = digits[i];
+        }
+        else if (-6 < point && point <= 0)
+        {
+            text[result++] = '0';
+            text[result++] = '.';
+            for (i = point ; i < 0 ; i++) text[result++] = '0';
+            for (i = 0 ; i < count ; i++) text[result++] = digits[i];
+        }
+        else
+        {
+            text[result++] = digits[0];
+            if (count > 1)
+            {
+                text[result++] = '.';
+                for (i = 1 ; i < count ; i++) text[result++] = digits[i];
+            }
+            text[result++] = 'e';
+            if (point - 1 < 0)
+            {
+                text[result++] = '-';
+                exponent = 1 - point;
+            }
+            else
+            {
+                text[result++] = '+';
+                exponent = point - 1;
+            }
+            result += utils_intToText(exponent, text + result, FLOAT_MAX_TEXT_LENGTH - result);
+        }
     }
 
-    return intLength + decLength;
+    if (result > length) return 0;
+    memcpy(string, text, result);
+
+    return result;
 }
 
 lwm2m_binding_t utils_stringToBinding(uint8_t * buffer,
@@ -396,6 +1106,20 @@ lwm2m_server_t * utils_findBootstrapServer(lwm2m_context_t * contextP,
 #endif
 }
 
+int64_t utils_getTimeMs(void)
+{
+#ifdef LWM2M_WITH_MS_CLOCK
+    return lwm2m_gettime_ms();
+#else
+    time_t tv_sec;
+
+    tv_sec = lwm2m_gettime();
+    if (tv_sec < 0) return -1;
+
+    return (int64_t)tv_sec * 1000;
+#endif
+}
+
 int utils_isAltPathValid(const char * altPath)
 {
     int i;
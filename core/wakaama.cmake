@@ -20,8 +20,11 @@ set(WAKAAMA_SOURCES
     ${WAKAAMA_SOURCES_DIR}/tlv.c
     ${WAKAAMA_SOURCES_DIR}/data.c
     ${WAKAAMA_SOURCES_DIR}/list.c
+    ${WAKAAMA_SOURCES_DIR}/hash.c
+    ${WAKAAMA_SOURCES_DIR}/arena.c
     ${WAKAAMA_SOURCES_DIR}/packet.c
     ${WAKAAMA_SOURCES_DIR}/transaction.c
+    ${WAKAAMA_SOURCES_DIR}/timer.c
     ${WAKAAMA_SOURCES_DIR}/registration.c
     ${WAKAAMA_SOURCES_DIR}/bootstrap.c
     ${WAKAAMA_SOURCES_DIR}/management.c
@@ -29,6 +32,7 @@ set(WAKAAMA_SOURCES
     ${WAKAAMA_SOURCES_DIR}/json.c
     ${WAKAAMA_SOURCES_DIR}/discover.c
     ${WAKAAMA_SOURCES_DIR}/block1.c
+    ${WAKAAMA_SOURCES_DIR}/block2.c
     ${WAKAAMA_SOURCES_DIR}/internals.h
 	${CORE_HEADERS}
     ${EXT_SOURCES})
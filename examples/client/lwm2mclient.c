@@ -793,6 +793,7 @@ void print_usage(void)
     fprintf(stdout, "  -t TIME\tSet the lifetime of the Client. Default: 300\r\n");
     fprintf(stdout, "  -b\t\tBootstrap requested.\r\n");
     fprintf(stdout, "  -c\t\tChange battery level over time.\r\n");
+    fprintf(stdout, "  -C\t\tSend confirmable notifications.\r\n");
 #ifdef WITH_TINYDTLS
     fprintf(stdout, "  -i STRING\tSet the device management or bootstrap server PSK identity. If not set use none secure mode\r\n");
     fprintf(stdout, "  -s HEXSTRING\tSet the device management or bootstrap server Pre-Shared-Key. If not set use none secure mode\r\n");
@@ -812,6 +813,7 @@ int main(int argc, char *argv[])
     char * name = "testlwm2mclient";
     int lifetime = 300;
     int batterylevelchanging = 0;
+    bool confirmableNotify = false;
     time_t reboot_time = 0;
     int opt;
     bool bootstrapRequested = false;
@@ -880,6 +882,9 @@ int main(int argc, char *argv[])
         case 'c':
             batterylevelchanging = 1;
             break;
+        case 'C':
+            confirmableNotify = true;
+            break;
         case 't':
             opt++;
             if (opt >= argc)
@@ -1031,7 +1036,7 @@ int main(int argc, char *argv[])
     }
     data.securityObjP = objArray[0];
 
-    objArray[1] = get_server_object(serverId, "U", lifetime, false);
+    objArray[1] = get_server_object(serverId, "U", lifetime, false, confirmableNotify);
     if (NULL == objArray[1])
     {
         fprintf(stderr, "Failed to create server object\r\n");
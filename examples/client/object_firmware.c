@@ -216,6 +216,43 @@ static uint8_t prv_firmware_write(uint16_t instanceId,
     return result;
 }
 
+// only the package is streamed, other resources go through prv_firmware_write()
+static bool prv_firmware_block_writable(uint16_t instanceId,
+                                        uint16_t resourceId,
+                                        lwm2m_object_t * objectP)
+{
+    return instanceId == 0 && resourceId == RES_M_PACKAGE;
+}
+
+static uint8_t prv_firmware_block_write(uint16_t instanceId,
+                                        uint16_t resourceId,
+                                        size_t offset,
+                                        uint8_t * buffer,
+                                        size_t length,
+                                        bool more,
+                                        lwm2m_object_t * objectP)
+{
+    firmware_data_t * data = (firmware_data_t*)(objectP->userData);
+
+    // this is a single instance object
+    if (instanceId != 0)
+    {
+        return COAP_404_NOT_FOUND;
+    }
+
+    if (resourceId != RES_M_PACKAGE) return COAP_405_METHOD_NOT_ALLOWED;
+
+    // write the chunk to flash here, the package is never held in RAM
+    fprintf(stdout, "\t FIRMWARE PACKAGE: %u bytes at offset %u\r\n", (unsigned int)length, (unsigned int)offset);
+    if (!more)
+    {
+        fprintf(stdout, "\n\t FIRMWARE PACKAGE RECEIVED: %u bytes\r\n\n", (unsigned int)(offset + length));
+        data->state = 1;
+    }
+
+    return COAP_204_CHANGED;
+}
+
 static uint8_t prv_firmware_execute(uint16_t instanceId,
                                     uint16_t resourceId,
                                     uint8_t * buffer,
@@ -308,6 +345,8 @@ lwm2m_object_t * get_object_firmware(void)
         firmwareObj->readFunc    = prv_firmware_read;
         firmwareObj->writeFunc   = prv_firmware_write;
         firmwareObj->executeFunc = prv_firmware_execute;
+        firmwareObj->blockWriteFunc = prv_firmware_block_write;
+        firmwareObj->blockWritableFunc = prv_firmware_block_writable;
         firmwareObj->userData    = lwm2m_malloc(sizeof(firmware_data_t));
 
         /*
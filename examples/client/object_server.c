@@ -51,6 +51,7 @@ typedef struct _server_instance_
     uint32_t    disableTimeout;
     bool        storing;
     char        binding[4];
+    uint32_t    notificationMode;
 } server_instance_t;
 
 static uint8_t prv_get_value(lwm2m_data_t * dataP,
@@ -92,6 +93,10 @@ static uint8_t prv_get_value(lwm2m_data_t * dataP,
     case LWM2M_SERVER_UPDATE_ID:
         return COAP_405_METHOD_NOT_ALLOWED;
 
+    case LWM2M_SERVER_NOTIF_MODE_ID:
+        lwm2m_data_encode_int(targetP->notificationMode, dataP);
+        return COAP_205_CONTENT;
+
     default:
         return COAP_404_NOT_FOUND;
     }
@@ -119,7 +124,8 @@ static uint8_t prv_server_read(uint16_t instanceId,
             LWM2M_SERVER_MAX_PERIOD_ID,
             LWM2M_SERVER_TIMEOUT_ID,
             LWM2M_SERVER_STORING_ID,
-            LWM2M_SERVER_BINDING_ID
+            LWM2M_SERVER_BINDING_ID,
+            LWM2M_SERVER_NOTIF_MODE_ID
         };
         int nbRes = sizeof(resList)/sizeof(uint16_t);
 
@@ -164,7 +170,8 @@ static uint8_t prv_server_discover(uint16_t instanceId,
             LWM2M_SERVER_TIMEOUT_ID,
             LWM2M_SERVER_STORING_ID,
             LWM2M_SERVER_BINDING_ID,
-            LWM2M_SERVER_UPDATE_ID
+            LWM2M_SERVER_UPDATE_ID,
+            LWM2M_SERVER_NOTIF_MODE_ID
         };
         int nbRes = sizeof(resList) / sizeof(uint16_t);
 
@@ -191,6 +198,7 @@ static uint8_t prv_server_discover(uint16_t instanceId,
             case LWM2M_SERVER_STORING_ID:
             case LWM2M_SERVER_BINDING_ID:
             case LWM2M_SERVER_UPDATE_ID:
+            case LWM2M_SERVER_NOTIF_MODE_ID:
                 break;
             default:
                 result = COAP_404_NOT_FOUND;
@@ -321,6 +329,24 @@ static uint8_t prv_server_write(uint16_t instanceId,
             result = COAP_405_METHOD_NOT_ALLOWED;
             break;
 
+        case LWM2M_SERVER_NOTIF_MODE_ID:
+            {
+                uint32_t value = targetP->notificationMode;
+                result = prv_set_int_value(dataArray + i, &value);
+                if (COAP_204_CHANGED == result)
+                {
+                    if (1 >= value)
+                    {
+                        targetP->notificationMode = value;
+                    }
+                    else
+                    {
+                        result = COAP_406_NOT_ACCEPTABLE;
+                    }
+                }
+            }
+            break;
+
         default:
             return COAP_404_NOT_FOUND;
         }
@@ -447,7 +473,8 @@ void display_server_object(lwm2m_object_t * object)
 lwm2m_object_t * get_server_object(int serverId,
                                    const char* binding,
                                    int lifetime,
-                                   bool storing)
+                                   bool storing,
+                                   bool confirmable)
 {
     lwm2m_object_t * serverObj;
 
@@ -474,6 +501,7 @@ lwm2m_object_t * get_server_object(int serverId,
         serverInstance->shortServerId = serverId;
         serverInstance->lifetime = lifetime;
         serverInstance->storing = storing;
+        serverInstance->notificationMode = confirmable ? 1 : 0;
         memcpy (serverInstance->binding, binding, strlen(binding)+1);
         serverObj->instanceList = LWM2M_LIST_ADD(serverObj->instanceList, serverInstance);
 
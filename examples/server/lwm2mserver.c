@@ -111,7 +111,7 @@ static void prv_dump_client(lwm2m_client_t * targetP)
 {
     lwm2m_client_object_t * objectP;
 
-    fprintf(stdout, "Client #%d:\r\n", targetP->internalID);
+    fprintf(stdout, "Client #%u:\r\n", targetP->internalID);
     fprintf(stdout, "\tname: \"%s\"\r\n", targetP->name);
     fprintf(stdout, "\tbinding: \"%s\"\r\n", prv_dump_binding(targetP->binding));
     if (targetP->msisdn) fprintf(stdout, "\tmsisdn: \"%s\"\r\n", targetP->msisdn);
@@ -158,21 +158,23 @@ static void prv_output_clients(char * buffer,
 }
 
 static int prv_read_id(char * buffer,
-                       uint16_t * idP)
+                       uint32_t * idP)
 {
     int nb;
-    int value;
+    unsigned long value;
 
-    nb = sscanf(buffer, "%d", &value);
+    if (buffer[0] == '-') return 0;
+
+    nb = sscanf(buffer, "%lu", &value);
     if (nb == 1)
     {
-        if (value < 0 || value > LWM2M_MAX_ID)
+        if (value > UINT32_MAX)
         {
             nb = 0;
         }
         else
         {
-            *idP = value;
+            *idP = (uint32_t)value;
         }
     }
 
@@ -180,7 +182,7 @@ static int prv_read_id(char * buffer,
 }
 
 
-static void prv_result_callback(uint16_t clientID,
+static void prv_result_callback(uint32_t clientID,
                                 lwm2m_uri_t * uriP,
                                 int status,
                                 lwm2m_media_type_t format,
@@ -188,7 +190,7 @@ static void prv_result_callback(uint16_t clientID,
                                 int dataLength,
                                 void * userData)
 {
-    fprintf(stdout, "\r\nClient #%d /%d", clientID, uriP->objectId);
+    fprintf(stdout, "\r\nClient #%u /%d", clientID, uriP->objectId);
     if (LWM2M_URI_IS_SET_INSTANCE(uriP))
         fprintf(stdout, "/%d", uriP->instanceId);
     else if (LWM2M_URI_IS_SET_RESOURCE(uriP))
@@ -205,7 +207,7 @@ static void prv_result_callback(uint16_t clientID,
     fflush(stdout);
 }
 
-static void prv_notify_callback(uint16_t clientID,
+static void prv_notify_callback(uint32_t clientID,
                                 lwm2m_uri_t * uriP,
                                 int count,
                                 lwm2m_media_type_t format,
@@ -213,7 +215,7 @@ static void prv_notify_callback(uint16_t clientID,
                                 int dataLength,
                                 void * userData)
 {
-    fprintf(stdout, "\r\nNotify from client #%d /%d", clientID, uriP->objectId);
+    fprintf(stdout, "\r\nNotify from client #%u /%d", clientID, uriP->objectId);
     if (LWM2M_URI_IS_SET_INSTANCE(uriP))
         fprintf(stdout, "/%d", uriP->instanceId);
     else if (LWM2M_URI_IS_SET_RESOURCE(uriP))
@@ -232,7 +234,7 @@ static void prv_read_client(char * buffer,
                             void * user_data)
 {
     lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
-    uint16_t clientId;
+    uint32_t clientId;
     lwm2m_uri_t uri;
     char* end = NULL;
     int result;
@@ -268,7 +270,7 @@ static void prv_discover_client(char * buffer,
                                 void * user_data)
 {
     lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
-    uint16_t clientId;
+    uint32_t clientId;
     lwm2m_uri_t uri;
     char* end = NULL;
     int result;
@@ -304,7 +306,7 @@ static void prv_write_client(char * buffer,
                              void * user_data)
 {
     lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
-    uint16_t clientId;
+    uint32_t clientId;
     lwm2m_uri_t uri;
     char * end = NULL;
     int result;
@@ -344,7 +346,7 @@ static void prv_time_client(char * buffer,
                             void * user_data)
 {
     lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
-    uint16_t clientId;
+    uint32_t clientId;
     lwm2m_uri_t uri;
     char * end = NULL;
     int result;
@@ -403,7 +405,7 @@ static void prv_attr_client(char * buffer,
                             void * user_data)
 {
     lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
-    uint16_t clientId;
+    uint32_t clientId;
     lwm2m_uri_t uri;
     char * end = NULL;
     int result;
@@ -470,7 +472,7 @@ static void prv_clear_client(char * buffer,
                              void * user_data)
 {
     lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
-    uint16_t clientId;
+    uint32_t clientId;
     lwm2m_uri_t uri;
     char * end = NULL;
     int result;
@@ -512,7 +514,7 @@ static void prv_exec_client(char * buffer,
                             void * user_data)
 {
     lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
-    uint16_t clientId;
+    uint32_t clientId;
     lwm2m_uri_t uri;
     char * end = NULL;
     int result;
@@ -558,7 +560,7 @@ static void prv_create_client(char * buffer,
                               void * user_data)
 {
     lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
-    uint16_t clientId;
+    uint32_t clientId;
     lwm2m_uri_t uri;
     char * end = NULL;
     int result;
@@ -633,7 +635,7 @@ static void prv_delete_client(char * buffer,
                               void * user_data)
 {
     lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
-    uint16_t clientId;
+    uint32_t clientId;
     lwm2m_uri_t uri;
     char* end = NULL;
     int result;
@@ -669,7 +671,7 @@ static void prv_observe_client(char * buffer,
                                void * user_data)
 {
     lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
-    uint16_t clientId;
+    uint32_t clientId;
     lwm2m_uri_t uri;
     char* end = NULL;
     int result;
@@ -705,7 +707,7 @@ static void prv_cancel_client(char * buffer,
                               void * user_data)
 {
     lwm2m_context_t * lwm2mH = (lwm2m_context_t *) user_data;
-    uint16_t clientId;
+    uint32_t clientId;
     lwm2m_uri_t uri;
     char* end = NULL;
     int result;
@@ -737,7 +739,7 @@ syntax_error:
     fprintf(stdout, "Syntax error !");
 }
 
-static void prv_monitor_callback(uint16_t clientID,
+static void prv_monitor_callback(uint32_t clientID,
                                  lwm2m_uri_t * uriP,
                                  int status,
                                  lwm2m_media_type_t format,
@@ -751,21 +753,21 @@ static void prv_monitor_callback(uint16_t clientID,
     switch (status)
     {
     case COAP_201_CREATED:
-        fprintf(stdout, "\r\nNew client #%d registered.\r\n", clientID);
+        fprintf(stdout, "\r\nNew client #%u registered.\r\n", clientID);
 
-        targetP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)lwm2mH->clientList, clientID);
+        targetP = lwm2m_get_client(lwm2mH, clientID);
 
         prv_dump_client(targetP);
         break;
 
     case COAP_202_DELETED:
-        fprintf(stdout, "\r\nClient #%d unregistered.\r\n", clientID);
+        fprintf(stdout, "\r\nClient #%u unregistered.\r\n", clientID);
         break;
 
     case COAP_204_CHANGED:
-        fprintf(stdout, "\r\nClient #%d updated.\r\n", clientID);
+        fprintf(stdout, "\r\nClient #%u updated.\r\n", clientID);
 
-        targetP = (lwm2m_client_t *)lwm2m_list_find((lwm2m_list_t *)lwm2mH->clientList, clientID);
+        targetP = lwm2m_get_client(lwm2mH, clientID);
 
         prv_dump_client(targetP);
         break;
@@ -807,6 +809,7 @@ int main(int argc, char *argv[])
     int sock;
     fd_set readfds;
     struct timeval tv;
+    int64_t timeoutMs;
     int result;
     lwm2m_context_t * lwm2mH = NULL;
     int i;
@@ -936,16 +939,18 @@ int main(int argc, char *argv[])
         FD_SET(sock, &readfds);
         FD_SET(STDIN_FILENO, &readfds);
 
-        tv.tv_sec = 60;
-        tv.tv_usec = 0;
+        timeoutMs = 60000;
 
-        result = lwm2m_step(lwm2mH, &(tv.tv_sec));
+        result = lwm2m_step_ms(lwm2mH, &timeoutMs);
         if (result != 0)
         {
-            fprintf(stderr, "lwm2m_step() failed: 0x%X\r\n", result);
+            fprintf(stderr, "lwm2m_step_ms() failed: 0x%X\r\n", result);
             return -1;
         }
 
+        tv.tv_sec = timeoutMs / 1000;
+        tv.tv_usec = (timeoutMs % 1000) * 1000;
+
         result = select(FD_SETSIZE, &readfds, 0, 0, &tv);
 
         if ( result < 0 )
@@ -0,0 +1,143 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2017 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ *******************************************************************************/
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+#include "internals.h"
+#include "memtest.h"
+
+static int prv_countBlocks(lwm2m_arena_t * arenaP)
+{
+    lwm2m_arena_block_t * blockP;
+    int count = 0;
+
+    for (blockP = arenaP->blockList ; blockP != NULL ; blockP = blockP->next)
+    {
+        count++;
+    }
+
+    return count;
+}
+
+static void test_arena_alloc(void)
+{
+    lwm2m_arena_t arena;
+    uint8_t * firstP;
+    uint8_t * secondP;
+    uint8_t * bigP;
+    uint8_t local;
+
+    MEMORY_TRACE_BEFORE;
+
+    memset(&arena, 0, sizeof(arena));
+    CU_ASSERT_PTR_NULL(arena_alloc(&arena, 0));
+
+    firstP = (uint8_t *)arena_alloc(&arena, 3);
+    secondP = (uint8_t *)arena_alloc(&arena, 8);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(firstP);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(secondP);
+    CU_ASSERT_EQUAL((size_t)secondP % sizeof(void *), 0);
+    CU_ASSERT(secondP >= firstP + 3);
+    CU_ASSERT_TRUE(arena_contains(&arena, firstP));
+    CU_ASSERT_FALSE(arena_contains(&arena, &local));
+    CU_ASSERT_FALSE(arena_contains(NULL, firstP));
+    CU_ASSERT_EQUAL(prv_countBlocks(&arena), 1);
+
+    // bigger than a block
+    bigP = (uint8_t *)arena_alloc(&arena, LWM2M_ARENA_BLOCK_SIZE * 2);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(bigP);
+    memset(bigP, 0, LWM2M_ARENA_BLOCK_SIZE * 2);
+    CU_ASSERT_TRUE(arena_contains(&arena, bigP + LWM2M_ARENA_BLOCK_SIZE));
+    CU_ASSERT_EQUAL(prv_countBlocks(&arena), 2);
+
+    // only the outermost leave rewinds the arena
+    arena_enter(&arena);
+    arena_enter(&arena);
+    arena_leave(&arena);
+    CU_ASSERT_EQUAL(prv_countBlocks(&arena), 2);
+    arena_leave(&arena);
+    CU_ASSERT_EQUAL(prv_countBlocks(&arena), 1);
+    CU_ASSERT_EQUAL(arena.blockList->used, 0);
+    CU_ASSERT_PTR_EQUAL(arena_alloc(&arena, 3), firstP);
+
+    arena_free(&arena);
+    CU_ASSERT_PTR_NULL(arena.blockList);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_arena_data_parse(void)
+{
+    lwm2m_arena_t arena;
+    lwm2m_data_t * dataP;
+    lwm2m_uri_t uri;
+    int size;
+    // Instance 0 holding a string resource 1 and a multiple resource 2
+    uint8_t buffer[] = { 0x08, 0x00, 0x0F,
+                         0xC5, 0x01, 'h', 'e', 'l', 'l', 'o',
+                         0x86, 0x02,
+                         0x41, 0x00, 0x01,
+                         0x41, 0x01, 0x02 };
+    uint8_t text[] = "42";
+
+    MEMORY_TRACE_BEFORE;
+
+    memset(&arena, 0, sizeof(arena));
+    arena_enter(&arena);
+
+    size = data_parse(&arena, NULL, buffer, sizeof(buffer), LWM2M_CONTENT_TLV, &dataP);
+    CU_ASSERT_EQUAL_FATAL(size, 1);
+    CU_ASSERT_EQUAL_FATAL(dataP->value.asChildren.count, 2);
+    CU_ASSERT_EQUAL(dataP->value.asChildren.array[0].value.asBuffer.length, 5);
+    CU_ASSERT_TRUE(arena_contains(&arena, dataP->value.asChildren.array[0].value.asBuffer.buffer));
+    CU_ASSERT_NSTRING_EQUAL(dataP->value.asChildren.array[0].value.asBuffer.buffer, "hello", 5);
+    data_free(&arena, size, dataP);
+
+    memset(&uri, 0, sizeof(uri));
+    uri.flag = LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID | LWM2M_URI_FLAG_RESOURCE_ID;
+    uri.resourceId = 3;
+    size = data_parse(&arena, &uri, text, 2, LWM2M_CONTENT_TEXT, &dataP);
+    CU_ASSERT_EQUAL_FATAL(size, 1);
+    CU_ASSERT_TRUE(arena_contains(&arena, dataP));
+    CU_ASSERT_EQUAL(dataP->id, 3);
+    CU_ASSERT_NSTRING_EQUAL(dataP->value.asBuffer.buffer, "42", 2);
+
+    // values set by objects are still owned by the heap
+    lwm2m_data_encode_string("heap", dataP);
+    CU_ASSERT_FALSE(arena_contains(&arena, dataP->value.asBuffer.buffer));
+    data_free(&arena, size, dataP);
+
+    arena_leave(&arena);
+    arena_free(&arena);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static struct TestTable table[] = {
+        { "test of arena_alloc() and arena_leave()", test_arena_alloc },
+        { "test of data_parse() with an arena", test_arena_data_parse },
+        { NULL, NULL },
+};
+
+CU_ErrorCode create_arena_suit()
+{
+   CU_pSuite pSuite = NULL;
+
+   pSuite = CU_add_suite("Suite_Arena", NULL, NULL);
+   if (NULL == pSuite) {
+      return CU_get_error();
+   }
+
+   return add_tests(pSuite, table);
+}
@@ -19,6 +19,7 @@
 #include "CUnit/Basic.h"
 #include "internals.h"
 #include "liblwm2m.h"
+#include "memtest.h"
 
 
 static void handle_12345(lwm2m_block1_data_t ** blk1,
@@ -27,7 +28,7 @@ static void handle_12345(lwm2m_block1_data_t ** blk1,
     size_t bsize;
     uint8_t *resultBuffer = NULL;
 
-    uint8_t st = coap_block1_handler(blk1, mid, buffer, 5, 5, 0, true, &resultBuffer, &bsize);
+    uint8_t st = coap_block1_handler(blk1, "/5/0/0", mid, buffer, 5, 5, 0, true, 0, LWM2M_BLOCK1_MAX_SIZE, &resultBuffer, &bsize);
     CU_ASSERT_EQUAL(st, COAP_231_CONTINUE);
     CU_ASSERT_PTR_NULL(resultBuffer);
 }
@@ -38,7 +39,7 @@ static void handle_67(lwm2m_block1_data_t ** blk1,
     size_t bsize;
     uint8_t *resultBuffer = NULL;
 
-    uint8_t st = coap_block1_handler(blk1, mid, buffer, 2, 5, 1, false, &resultBuffer, &bsize);
+    uint8_t st = coap_block1_handler(blk1, "/5/0/0", mid, buffer, 2, 5, 1, false, 0, LWM2M_BLOCK1_MAX_SIZE, &resultBuffer, &bsize);
     CU_ASSERT_EQUAL(st, NO_ERROR);
     CU_ASSERT_PTR_NOT_NULL(*resultBuffer);
     CU_ASSERT_EQUAL(bsize, 7);
@@ -69,9 +70,283 @@ static void test_block1_retransmit(void)
     free_block1_buffer(blk1);
 }
 
+static void test_block1_size1(void)
+{
+    lwm2m_block1_data_t * blk1 = NULL;
+    uint8_t block[16];
+    uint8_t * resultBuffer = NULL;
+    size_t bsize;
+    uint32_t i;
+
+    memset(block, 'x', sizeof(block));
+
+    // the buffer is allocated once from Size1
+    for (i = 0 ; i < 63 ; i++)
+    {
+        CU_ASSERT_EQUAL(coap_block1_handler(&blk1, "/5/0/0", (uint16_t)i, block, 16, 16, i, true, 1024, 1024, &resultBuffer, &bsize), COAP_231_CONTINUE);
+        CU_ASSERT_EQUAL_FATAL(blk1->block1bufferSize, 1024);
+    }
+    CU_ASSERT_EQUAL(coap_block1_handler(&blk1, "/5/0/0", 63, block, 16, 16, 63, false, 1024, 1024, &resultBuffer, &bsize), NO_ERROR);
+    CU_ASSERT_EQUAL(bsize, 1024);
+    CU_ASSERT_PTR_EQUAL(resultBuffer, blk1->block1buffer);
+
+    // announced or received size over the maximum
+    CU_ASSERT_EQUAL(coap_block1_handler(&blk1, "/5/0/0", 100, block, 16, 16, 0, true, 1025, 1024, &resultBuffer, &bsize), COAP_413_ENTITY_TOO_LARGE);
+    CU_ASSERT_PTR_NULL(blk1);
+    for (i = 0 ; i < 64 ; i++)
+    {
+        CU_ASSERT_EQUAL(coap_block1_handler(&blk1, "/5/0/0", (uint16_t)i, block, 16, 16, i, true, 0, 1024, &resultBuffer, &bsize), COAP_231_CONTINUE);
+    }
+    CU_ASSERT_EQUAL(coap_block1_handler(&blk1, "/5/0/0", 64, block, 16, 16, 64, true, 0, 1024, &resultBuffer, &bsize), COAP_413_ENTITY_TOO_LARGE);
+    CU_ASSERT_PTR_NULL(blk1);
+
+    free_block1_buffer(blk1);
+}
+
+static void test_block1_concurrent(void)
+{
+    lwm2m_block1_data_t * blk1 = NULL;
+    uint8_t * resultBuffer = NULL;
+    size_t bsize;
+
+    CU_ASSERT_EQUAL(coap_block1_handler(&blk1, "/1/0", 1, (uint8_t *)"ab", 2, 16, 0, true, 0, 1024, &resultBuffer, &bsize), COAP_231_CONTINUE);
+    CU_ASSERT_EQUAL(coap_block1_handler(&blk1, "/2/0", 2, (uint8_t *)"cd", 2, 16, 0, true, 0, 1024, &resultBuffer, &bsize), COAP_231_CONTINUE);
+
+    // blocks received out of order cancel their transfer only
+    CU_ASSERT_EQUAL(coap_block1_handler(&blk1, "/2/0", 3, (uint8_t *)"ef", 2, 16, 1, false, 0, 1024, &resultBuffer, &bsize), COAP_408_REQ_ENTITY_INCOMPLETE);
+    CU_ASSERT_EQUAL(coap_block1_handler(&blk1, "/2/0", 4, (uint8_t *)"ef", 2, 16, 1, false, 0, 1024, &resultBuffer, &bsize), COAP_408_REQ_ENTITY_INCOMPLETE);
+
+    CU_ASSERT_EQUAL(coap_block1_handler(&blk1, "/1/0", 5, (uint8_t *)"0123456789abcdef", 16, 16, 0, true, 0, 1024, &resultBuffer, &bsize), COAP_231_CONTINUE);
+    CU_ASSERT_EQUAL(coap_block1_handler(&blk1, "/2/0", 6, (uint8_t *)"0123456789ABCDEF", 16, 16, 0, true, 0, 1024, &resultBuffer, &bsize), COAP_231_CONTINUE);
+    CU_ASSERT_EQUAL(coap_block1_handler(&blk1, "/2/0", 7, (uint8_t *)"gh", 2, 16, 1, false, 0, 1024, &resultBuffer, &bsize), NO_ERROR);
+    CU_ASSERT_EQUAL(bsize, 18);
+    CU_ASSERT_NSTRING_EQUAL(resultBuffer, "0123456789ABCDEFgh", 18);
+    CU_ASSERT_EQUAL(coap_block1_handler(&blk1, "/1/0", 8, (uint8_t *)"ij", 2, 16, 1, false, 0, 1024, &resultBuffer, &bsize), NO_ERROR);
+    CU_ASSERT_EQUAL(bsize, 18);
+    CU_ASSERT_NSTRING_EQUAL(resultBuffer, "0123456789abcdefij", 18);
+
+    // a new transfer drops the completed ones
+    CU_ASSERT_EQUAL(coap_block1_handler(&blk1, "/3/0", 9, (uint8_t *)"kl", 2, 16, 0, true, 0, 1024, &resultBuffer, &bsize), COAP_231_CONTINUE);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(blk1);
+    CU_ASSERT_PTR_NULL(blk1->next);
+
+    free_block1_buffer(blk1);
+}
+
+static void test_block1_stream(void)
+{
+    lwm2m_block1_data_t * blk1 = NULL;
+    size_t offset = 0;
+
+    CU_ASSERT_EQUAL(coap_block1_stream(&blk1, "/5/0/0", 10, 16, 1, 16, true, &offset), COAP_408_REQ_ENTITY_INCOMPLETE);
+
+    CU_ASSERT_EQUAL(coap_block1_stream(&blk1, "/5/0/0", 11, 16, 0, 16, true, &offset), NO_ERROR);
+    CU_ASSERT_EQUAL(offset, 0);
+    CU_ASSERT_EQUAL(coap_block1_stream(&blk1, "/5/0/0", 11, 16, 0, 16, true, &offset), COAP_IGNORE);
+    CU_ASSERT_EQUAL(coap_block1_stream(&blk1, "/5/0/0", 12, 16, 1, 16, true, &offset), NO_ERROR);
+    CU_ASSERT_EQUAL(offset, 16);
+    CU_ASSERT_EQUAL(coap_block1_stream(&blk1, "/5/0/0", 13, 16, 2, 3, false, &offset), NO_ERROR);
+    CU_ASSERT_EQUAL(offset, 32);
+    CU_ASSERT_EQUAL(coap_block1_stream(&blk1, "/5/0/0", 13, 16, 2, 3, false, &offset), COAP_IGNORE);
+    CU_ASSERT_PTR_NULL(blk1->block1buffer);
+
+    // a block after the last one
+    CU_ASSERT_EQUAL(coap_block1_stream(&blk1, "/5/0/0", 14, 16, 3, 3, false, &offset), COAP_408_REQ_ENTITY_INCOMPLETE);
+    CU_ASSERT_PTR_NULL(blk1);
+
+    CU_ASSERT_EQUAL(coap_block1_stream(&blk1, "/5/0/0", 15, 16, 0, 16, true, &offset), NO_ERROR);
+    coap_block1_remove(&blk1, "/5/0/1");
+    CU_ASSERT_PTR_NOT_NULL(blk1);
+    coap_block1_remove(&blk1, "/5/0/0");
+    CU_ASSERT_PTR_NULL(blk1);
+
+    free_block1_buffer(blk1);
+}
+
+// streams resource 1, counting the questions in userData
+static bool prv_blockWritable(uint16_t instanceId,
+                              uint16_t resourceId,
+                              lwm2m_object_t * objectP)
+{
+    (void)instanceId;
+
+    (*(int *)objectP->userData)++;
+
+    return resourceId == 1;
+}
+
+// accepts the first 16 bytes only
+static uint8_t prv_blockWrite(uint16_t instanceId,
+                              uint16_t resourceId,
+                              size_t offset,
+                              uint8_t * buffer,
+                              size_t length,
+                              bool more,
+                              lwm2m_object_t * objectP)
+{
+    (void)instanceId;
+    (void)buffer;
+    (void)more;
+    (void)objectP;
+
+    if (resourceId != 1) return COAP_405_METHOD_NOT_ALLOWED;
+
+    return offset + length <= 16 ? COAP_204_CHANGED : COAP_500_INTERNAL_SERVER_ERROR;
+}
+
+static uint8_t prv_writeBlock(lwm2m_context_t * contextP,
+                              lwm2m_server_t * serverP,
+                              uint16_t mid,
+                              uint32_t blockNum,
+                              bool blockMore,
+                              size_t length)
+{
+    coap_packet_t message[1];
+    uint8_t result;
+
+    coap_init_message(message, COAP_TYPE_CON, COAP_PUT, mid);
+    coap_set_header_uri_path(message, "/5/0/1");
+    coap_set_header_content_type(message, LWM2M_CONTENT_OPAQUE);
+    coap_set_header_block1(message, blockNum, blockMore, 16);
+    coap_set_payload(message, "0123456789abcdef", length);
+
+    result = dm_handleBlockWrite(contextP, serverP, "/5/0/1", message);
+    coap_free_header(message);
+
+    return result;
+}
+
+static void test_block1_stream_failure(void)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_object_t object;
+    lwm2m_list_t instance;
+    lwm2m_server_t server;
+    int questions = 0;
+
+    MEMORY_TRACE_BEFORE;
+
+    memset(&object, 0, sizeof(object));
+    memset(&instance, 0, sizeof(instance));
+    object.objID = 5;
+    object.instanceList = &instance;
+    object.blockWriteFunc = prv_blockWrite;
+    object.blockWritableFunc = prv_blockWritable;
+    object.userData = &questions;
+    memset(&server, 0, sizeof(server));
+    server.status = STATE_REGISTERED;
+
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+    CU_ASSERT_EQUAL_FATAL(lwm2m_add_object(contextP, &object), COAP_NO_ERROR);
+
+    CU_ASSERT_EQUAL(prv_writeBlock(contextP, &server, 20, 0, true, 16), COAP_231_CONTINUE);
+    CU_ASSERT_PTR_NOT_NULL(server.block1Data);
+
+    // the object rejects the second block, the transfer is dropped
+    CU_ASSERT_EQUAL(prv_writeBlock(contextP, &server, 21, 1, true, 16), COAP_500_INTERNAL_SERVER_ERROR);
+    CU_ASSERT_PTR_NULL(server.block1Data);
+
+    // what the peer sends next is left to reassembly, which has no transfer to continue
+    CU_ASSERT_EQUAL(prv_writeBlock(contextP, &server, 22, 2, false, 16), NO_ERROR);
+    CU_ASSERT_PTR_NULL(server.block1Data);
+
+    // the object was only asked on the first block
+    CU_ASSERT_EQUAL(questions, 1);
+
+    free_block1_buffer(server.block1Data);
+    lwm2m_close(contextP);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_block1_stream_other_resource(void)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_object_t object;
+    lwm2m_list_t instance;
+    lwm2m_server_t server;
+    coap_packet_t message[1];
+    int questions = 0;
+
+    MEMORY_TRACE_BEFORE;
+
+    memset(&object, 0, sizeof(object));
+    memset(&instance, 0, sizeof(instance));
+    object.objID = 5;
+    object.instanceList = &instance;
+    object.blockWriteFunc = prv_blockWrite;
+    object.blockWritableFunc = prv_blockWritable;
+    object.userData = &questions;
+    memset(&server, 0, sizeof(server));
+    server.status = STATE_REGISTERED;
+
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+    CU_ASSERT_EQUAL_FATAL(lwm2m_add_object(contextP, &object), COAP_NO_ERROR);
+
+    // the object does not stream /5/0/2, the blocks are left to reassembly
+    coap_init_message(message, COAP_TYPE_CON, COAP_PUT, 30);
+    coap_set_header_uri_path(message, "/5/0/2");
+    coap_set_header_content_type(message, LWM2M_CONTENT_OPAQUE);
+    coap_set_header_block1(message, 0, true, 16);
+    coap_set_payload(message, "0123456789abcdef", 16);
+    CU_ASSERT_EQUAL(dm_handleBlockWrite(contextP, &server, "/5/0/2", message), NO_ERROR);
+    CU_ASSERT_PTR_NULL(server.block1Data);
+    coap_free_header(message);
+
+    lwm2m_close(contextP);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_block1_stream_empty_last(void)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_object_t object;
+    lwm2m_list_t instance;
+    lwm2m_server_t server;
+    int questions = 0;
+
+    MEMORY_TRACE_BEFORE;
+
+    memset(&object, 0, sizeof(object));
+    memset(&instance, 0, sizeof(instance));
+    object.objID = 5;
+    object.instanceList = &instance;
+    object.blockWriteFunc = prv_blockWrite;
+    object.blockWritableFunc = prv_blockWritable;
+    object.userData = &questions;
+    memset(&server, 0, sizeof(server));
+    server.status = STATE_REGISTERED;
+
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+    CU_ASSERT_EQUAL_FATAL(lwm2m_add_object(contextP, &object), COAP_NO_ERROR);
+
+    // a payload ending on a block boundary completes with an empty block
+    CU_ASSERT_EQUAL(prv_writeBlock(contextP, &server, 40, 0, true, 16), COAP_231_CONTINUE);
+    CU_ASSERT_EQUAL(prv_writeBlock(contextP, &server, 41, 1, false, 0), COAP_204_CHANGED);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(server.block1Data);
+    CU_ASSERT_TRUE(server.block1Data->complete);
+    CU_ASSERT_EQUAL(server.block1Data->block1bufferLength, 16);
+    CU_ASSERT_EQUAL(questions, 1);
+
+    free_block1_buffer(server.block1Data);
+    lwm2m_close(contextP);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
 static struct TestTable table[] = {
         { "test of test_block1_nominal()", test_block1_nominal },
         { "test of test_block1_retransmit()", test_block1_retransmit },
+        { "test of coap_block1_handler() with Size1 and a maximum size", test_block1_size1 },
+        { "test of coap_block1_handler() with concurrent transfers", test_block1_concurrent },
+        { "test of coap_block1_stream()", test_block1_stream },
+        { "test of dm_handleBlockWrite() with a failing object", test_block1_stream_failure },
+        { "test of dm_handleBlockWrite() on a resource not streamed", test_block1_stream_other_resource },
+        { "test of dm_handleBlockWrite() with an empty last block", test_block1_stream_empty_last },
         { NULL, NULL },
 };
 
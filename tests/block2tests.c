@@ -0,0 +1,312 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2017 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ *******************************************************************************/
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+#include "internals.h"
+#include "connection.h"
+#include "memtest.h"
+
+#define TEST_OBJECT_ID  1024
+
+static void prv_initRequest(coap_packet_t * message,
+                            const char * uri)
+{
+    coap_init_message(message, COAP_TYPE_CON, COAP_GET, 1);
+    coap_set_header_uri_path(message, uri);
+}
+
+static void prv_initResponse(coap_packet_t * response,
+                             size_t length)
+{
+    uint8_t * payload;
+
+    payload = (uint8_t *)lwm2m_malloc(length);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(payload);
+    memset(payload, 'x', length);
+    payload[length - 1] = 'y';
+    coap_init_message(response, COAP_TYPE_ACK, COAP_205_CONTENT, 1);
+    coap_set_header_content_type(response, LWM2M_CONTENT_TLV);
+    coap_set_payload(response, payload, length);
+}
+
+static void test_block2_small(void)
+{
+    lwm2m_context_t * contextP;
+    coap_packet_t message[1];
+    coap_packet_t response[1];
+    uint8_t * payload;
+
+    MEMORY_TRACE_BEFORE;
+
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+
+    prv_initRequest(message, "/3/0");
+    prv_initResponse(response, 16);
+    payload = response->payload;
+    CU_ASSERT_FALSE(block2_set(contextP, NULL, message, response, 0, 16));
+    CU_ASSERT_FALSE(IS_OPTION(response, COAP_OPTION_BLOCK2));
+    CU_ASSERT_PTR_NULL(contextP->block2List);
+
+    // a block size asked by the peer is echoed
+    coap_set_header_block2(message, 0, 0, 32);
+    CU_ASSERT_FALSE(block2_set(contextP, NULL, message, response, 0, 32));
+    CU_ASSERT_TRUE(IS_OPTION(response, COAP_OPTION_BLOCK2));
+    CU_ASSERT_EQUAL(response->block2_more, 0);
+
+    // no such block
+    CU_ASSERT_FALSE(block2_set(contextP, NULL, message, response, 1, 16));
+    CU_ASSERT_EQUAL(response->code, COAP_402_BAD_OPTION);
+
+    lwm2m_free(payload);
+    coap_free_header(message);
+    lwm2m_close(contextP);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_block2_cache(void)
+{
+    lwm2m_context_t * contextP;
+    coap_packet_t message[1];
+    coap_packet_t response[1];
+    uint8_t etag[4];
+
+    MEMORY_TRACE_BEFORE;
+
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+
+    // the representation is kept by the cache
+    prv_initRequest(message, "/3/0");
+    prv_initResponse(response, 40);
+    CU_ASSERT_TRUE_FATAL(block2_set(contextP, NULL, message, response, 0, 16));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP->block2List);
+    CU_ASSERT_EQUAL(response->block2_num, 0);
+    CU_ASSERT_EQUAL(response->block2_more, 1);
+    CU_ASSERT_EQUAL(response->payload_len, 16);
+    CU_ASSERT_EQUAL_FATAL(response->etag_len, 4);
+    memcpy(etag, response->etag, 4);
+    coap_free_header(message);
+
+    // the last block, with the same ETag
+    prv_initRequest(message, "/3/0");
+    coap_init_message(response, COAP_TYPE_ACK, COAP_205_CONTENT, 2);
+    CU_ASSERT_TRUE(block2_get(contextP, NULL, message, response, 2, 16));
+    CU_ASSERT_EQUAL(response->code, COAP_205_CONTENT);
+    CU_ASSERT_EQUAL(response->content_type, (coap_content_type_t)LWM2M_CONTENT_TLV);
+    CU_ASSERT_EQUAL(response->block2_more, 0);
+    CU_ASSERT_EQUAL_FATAL(response->payload_len, 8);
+    CU_ASSERT_EQUAL(response->payload[7], 'y');
+    CU_ASSERT_NSTRING_EQUAL(response->etag, etag, 4);
+    CU_ASSERT_TRUE(contextP->block2List->complete);
+
+    // past the end
+    coap_init_message(response, COAP_TYPE_ACK, COAP_205_CONTENT, 3);
+    CU_ASSERT_TRUE(block2_get(contextP, NULL, message, response, 3, 16));
+    CU_ASSERT_EQUAL(response->code, COAP_402_BAD_OPTION);
+    coap_free_header(message);
+
+    // another peer, path or format is not served from the cache
+    prv_initRequest(message, "/3/0");
+    CU_ASSERT_FALSE(block2_get(contextP, contextP, message, response, 1, 16));
+    coap_set_header_accept(message, LWM2M_CONTENT_JSON);
+    CU_ASSERT_FALSE(block2_get(contextP, NULL, message, response, 1, 16));
+    coap_free_header(message);
+    prv_initRequest(message, "/3/1");
+    CU_ASSERT_FALSE(block2_get(contextP, NULL, message, response, 1, 16));
+
+    // a completed representation gives room to a new one
+    prv_initResponse(response, 40);
+    CU_ASSERT_TRUE(block2_set(contextP, NULL, message, response, 0, 16));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP->block2List);
+    CU_ASSERT_PTR_NULL(contextP->block2List->next);
+    CU_ASSERT_NOT_EQUAL(memcmp(response->etag, etag, 4), 0);
+    coap_free_header(message);
+
+    lwm2m_close(contextP);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+// the instance holds a single integer resource, its value is in userData
+static uint8_t prv_read(uint16_t instanceId,
+                        int * numDataP,
+                        lwm2m_data_t ** dataArrayP,
+                        lwm2m_object_t * objectP)
+{
+    if (instanceId != 0) return COAP_404_NOT_FOUND;
+
+    if (*numDataP == 0)
+    {
+        *dataArrayP = lwm2m_data_new(1);
+        if (*dataArrayP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
+        *numDataP = 1;
+        (*dataArrayP)->id = 1;
+    }
+    else if (*numDataP != 1 || (*dataArrayP)->id != 1)
+    {
+        return COAP_404_NOT_FOUND;
+    }
+    lwm2m_data_encode_int(*(int64_t *)objectP->userData, *dataArrayP);
+
+    return COAP_205_CONTENT;
+}
+
+// the responses are sent to a socket read by prv_readPacket()
+static void prv_openSession(connection_t * connP,
+                            int * peerSockP)
+{
+    struct sockaddr_in6 addr;
+    socklen_t addrLen = sizeof(addr);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr = in6addr_loopback;
+    *peerSockP = socket(AF_INET6, SOCK_DGRAM, 0);
+    CU_ASSERT_FATAL(*peerSockP >= 0);
+    CU_ASSERT_EQUAL_FATAL(bind(*peerSockP, (struct sockaddr *)&addr, addrLen), 0);
+    CU_ASSERT_EQUAL_FATAL(getsockname(*peerSockP, (struct sockaddr *)&addr, &addrLen), 0);
+
+    memset(connP, 0, sizeof(connection_t));
+    connP->sock = socket(AF_INET6, SOCK_DGRAM, 0);
+    CU_ASSERT_FATAL(connP->sock >= 0);
+    connP->addr = addr;
+    connP->addrLen = addrLen;
+}
+
+// sends a GET through lwm2m_handle_packet() and parses the answer into response
+static void prv_readPacket(lwm2m_context_t * contextP,
+                           connection_t * connP,
+                           int peerSock,
+                           const char * uri,
+                           lwm2m_media_type_t format,
+                           coap_packet_t * response,
+                           uint8_t * buffer,
+                           size_t bufferLen)
+{
+    coap_packet_t message[1];
+    uint8_t request[64];
+    size_t length;
+    ssize_t received;
+
+    coap_init_message(message, COAP_TYPE_CON, COAP_GET, contextP->nextMID++);
+    coap_set_header_uri_path(message, uri);
+    coap_set_header_accept(message, (uint16_t)format);
+    length = coap_serialize_message_len(message, request, sizeof(request));
+    CU_ASSERT_FATAL(length != 0);
+
+    lwm2m_handle_packet(contextP, request, (int)length, connP);
+
+    received = recv(peerSock, buffer, bufferLen, MSG_DONTWAIT);
+    CU_ASSERT_FATAL(received > 0);
+    CU_ASSERT_EQUAL_FATAL(coap_parse_message(response, buffer, (uint16_t)received), NO_ERROR);
+}
+
+static void test_block2_read_single(void)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_object_t object;
+    lwm2m_list_t instance;
+    lwm2m_server_t server;
+    connection_t conn;
+    int peerSock;
+    coap_packet_t response[1];
+    uint8_t buffer[256];
+    lwm2m_uri_t uri;
+    lwm2m_data_t * dataP;
+    lwm2m_media_type_t format;
+    uint8_t * expected;
+    int64_t value;
+    int64_t decoded;
+    int length;
+    int size;
+
+    MEMORY_TRACE_BEFORE;
+
+    prv_openSession(&conn, &peerSock);
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+    memset(&object, 0, sizeof(lwm2m_object_t));
+    memset(&instance, 0, sizeof(lwm2m_list_t));
+    object.objID = TEST_OBJECT_ID;
+    object.instanceList = &instance;
+    object.readFunc = prv_read;
+    value = 42;
+    object.userData = &value;
+    CU_ASSERT_EQUAL_FATAL(lwm2m_add_object(contextP, &object), COAP_NO_ERROR);
+    memset(&server, 0, sizeof(lwm2m_server_t));
+    server.shortID = 1;
+    server.status = STATE_REGISTERED;
+    server.sessionH = &conn;
+    contextP->serverList = &server;
+    CU_ASSERT_FATAL(lwm2m_stringToUri("/1024/0/1", 9, &uri) != 0);
+
+    // a read fitting in a block is answered in one message, in both formats
+    prv_readPacket(contextP, &conn, peerSock, "/1024/0/1", LWM2M_CONTENT_TLV, response, buffer, sizeof(buffer));
+    CU_ASSERT_EQUAL(response->code, COAP_205_CONTENT);
+    CU_ASSERT_EQUAL(response->content_type, (coap_content_type_t)LWM2M_CONTENT_TLV);
+    CU_ASSERT_FALSE(IS_OPTION(response, COAP_OPTION_BLOCK2));
+    size = lwm2m_data_parse(&uri, response->payload, response->payload_len, LWM2M_CONTENT_TLV, &dataP);
+    CU_ASSERT_EQUAL_FATAL(size, 1);
+    CU_ASSERT_EQUAL(dataP->id, 1);
+    CU_ASSERT_TRUE(lwm2m_data_decode_int(dataP, &decoded));
+    CU_ASSERT_EQUAL(decoded, 42);
+    lwm2m_data_free(size, dataP);
+    coap_free_header(response);
+
+    prv_readPacket(contextP, &conn, peerSock, "/1024/0/1", LWM2M_CONTENT_JSON, response, buffer, sizeof(buffer));
+    CU_ASSERT_EQUAL(response->code, COAP_205_CONTENT);
+    CU_ASSERT_EQUAL(response->content_type, (coap_content_type_t)LWM2M_CONTENT_JSON);
+    CU_ASSERT_FALSE(IS_OPTION(response, COAP_OPTION_BLOCK2));
+    // the same representation as lwm2m_data_serialize()
+    dataP = lwm2m_data_new(1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(dataP);
+    dataP->id = 1;
+    lwm2m_data_encode_int(42, dataP);
+    format = LWM2M_CONTENT_JSON;
+    length = lwm2m_data_serialize(&uri, 1, dataP, &format, &expected);
+    CU_ASSERT_EQUAL_FATAL(length, (int)response->payload_len);
+    CU_ASSERT_NSTRING_EQUAL(response->payload, expected, length);
+    lwm2m_free(expected);
+    lwm2m_data_free(1, dataP);
+    coap_free_header(response);
+
+    contextP->serverList = NULL;
+    lwm2m_close(contextP);
+    close(conn.sock);
+    close(peerSock);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static struct TestTable table[] = {
+        { "test of block2_set() with a small response", test_block2_small },
+        { "test of block2_get() from a cached representation", test_block2_cache },
+        { "test of a read answered in a single block", test_block2_read_single },
+        { NULL, NULL },
+};
+
+CU_ErrorCode create_block2_suit()
+{
+   CU_pSuite pSuite = NULL;
+
+   pSuite = CU_add_suite("Suite_block2", NULL, NULL);
+   if (NULL == pSuite) {
+      return CU_get_error();
+   }
+
+   return add_tests(pSuite, table);
+}
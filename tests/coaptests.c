@@ -0,0 +1,189 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2017 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ *******************************************************************************/
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+#include "internals.h"
+#include "memtest.h"
+
+static size_t prv_serialize(coap_packet_t * packetP,
+                            uint8_t * buffer,
+                            size_t length)
+{
+    size_t size;
+
+    size = coap_serialize_get_size(packetP);
+    CU_ASSERT_FATAL(size != 0 && size <= length);
+
+    return coap_serialize_message(packetP, buffer);
+}
+
+static int prv_countOptions(multi_option_t * optP,
+                            bool inlineOnly)
+{
+    int count = 0;
+
+    for ( ; optP != NULL ; optP = optP->next)
+    {
+        if (!inlineOnly || optP->is_inline) count++;
+    }
+
+    return count;
+}
+
+static void test_parse_registration(void)
+{
+    coap_packet_t message[1];
+    coap_packet_t parsed[1];
+    uint8_t buffer[256];
+    size_t length;
+
+    MEMORY_TRACE_BEFORE;
+
+    coap_init_message(message, COAP_TYPE_CON, COAP_POST, 0x1234);
+    coap_set_header_uri_path(message, "/rd");
+    coap_set_header_uri_query(message, "?ep=test&lt=300&b=U&lwm2m=1.0");
+    length = prv_serialize(message, buffer, sizeof(buffer));
+
+    CU_ASSERT_EQUAL_FATAL(coap_parse_message(parsed, buffer, (uint16_t)length), NO_ERROR);
+    CU_ASSERT_EQUAL(parsed->mid, 0x1234);
+    CU_ASSERT_EQUAL(prv_countOptions(parsed->uri_path, true), 1);
+    CU_ASSERT_EQUAL(prv_countOptions(parsed->uri_query, true), 4);
+    CU_ASSERT_EQUAL(parsed->inline_options_num, 5);
+
+    // views point into the received buffer
+    CU_ASSERT_TRUE(parsed->uri_path->data > buffer && parsed->uri_path->data < buffer + length);
+    CU_ASSERT_NSTRING_EQUAL(parsed->uri_path->data, "rd", 2);
+    CU_ASSERT_EQUAL(parsed->uri_query->next->next->next->len, 9);
+    CU_ASSERT_NSTRING_EQUAL(parsed->uri_query->next->next->next->data, "lwm2m=1.0", 9);
+
+    coap_free_header(parsed);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_parse_long_path(void)
+{
+    coap_packet_t message[1];
+    coap_packet_t parsed[1];
+    uint8_t buffer[256];
+    size_t length;
+    char * path;
+
+    MEMORY_TRACE_BEFORE;
+
+    coap_init_message(message, COAP_TYPE_CON, COAP_GET, 1);
+    coap_set_header_uri_path(message, "/a/b/c/d/e/f/g/h/i/j");
+    coap_set_header_uri_query(message, "x=1");
+    length = prv_serialize(message, buffer, sizeof(buffer));
+
+    CU_ASSERT_EQUAL_FATAL(coap_parse_message(parsed, buffer, (uint16_t)length), NO_ERROR);
+    CU_ASSERT_EQUAL(parsed->inline_options_num, COAP_INLINE_OPTION_NUM);
+    CU_ASSERT_EQUAL(prv_countOptions(parsed->uri_path, false), 10);
+    CU_ASSERT_EQUAL(prv_countOptions(parsed->uri_query, false), 1);
+
+    path = coap_get_multi_option_as_string(parsed->uri_path);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(path);
+    CU_ASSERT_STRING_EQUAL(path, "/a/b/c/d/e/f/g/h/i/j");
+    lwm2m_free(path);
+
+    coap_free_header(parsed);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_serialize_len(void)
+{
+    coap_packet_t message[1];
+    coap_packet_t parsed[1];
+    uint8_t buffer[256];
+    uint8_t payload[40];
+    size_t length;
+
+    MEMORY_TRACE_BEFORE;
+
+    memset(payload, 'x', sizeof(payload));
+    coap_init_message(message, COAP_TYPE_ACK, COAP_205_CONTENT, 0x4321);
+    coap_set_header_location_path(message, "/rd/5a3f");
+    coap_set_header_content_type(message, LWM2M_CONTENT_TLV);
+    coap_set_payload(message, payload, sizeof(payload));
+
+    // too small: nothing is serialized and the options are kept
+    CU_ASSERT_EQUAL(coap_serialize_message_len(message, buffer, COAP_HEADER_LEN + 2), 0);
+    CU_ASSERT_EQUAL(coap_serialize_message_len(message, buffer, 30), 0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(message->location_path);
+
+    length = coap_serialize_message_len(message, buffer, sizeof(buffer));
+    CU_ASSERT(length > sizeof(payload));
+    CU_ASSERT_PTR_NULL(message->location_path);
+
+    CU_ASSERT_EQUAL_FATAL(coap_parse_message(parsed, buffer, (uint16_t)length), NO_ERROR);
+    CU_ASSERT_EQUAL(parsed->mid, 0x4321);
+    CU_ASSERT_EQUAL(parsed->content_type, (coap_content_type_t)LWM2M_CONTENT_TLV);
+    CU_ASSERT_EQUAL(prv_countOptions(parsed->location_path, false), 2);
+    CU_ASSERT_EQUAL(parsed->payload_len, sizeof(payload));
+    coap_free_header(parsed);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_size1(void)
+{
+    coap_packet_t message[1];
+    coap_packet_t parsed[1];
+    uint8_t buffer[256];
+    uint8_t payload[16];
+    size_t length;
+    uint32_t size = 0;
+
+    MEMORY_TRACE_BEFORE;
+
+    memset(payload, 'x', sizeof(payload));
+    coap_init_message(message, COAP_TYPE_CON, COAP_PUT, 7);
+    coap_set_header_uri_path(message, "/5/0/0");
+    coap_set_header_block1(message, 0, 1, 16);
+    coap_set_header_size1(message, 100000);
+    coap_set_payload(message, payload, sizeof(payload));
+    length = prv_serialize(message, buffer, sizeof(buffer));
+
+    CU_ASSERT_EQUAL_FATAL(coap_parse_message(parsed, buffer, (uint16_t)length), NO_ERROR);
+    CU_ASSERT_EQUAL(coap_get_header_size1(parsed, &size), 1);
+    CU_ASSERT_EQUAL(size, 100000);
+    CU_ASSERT_EQUAL(coap_get_header_size(parsed, &size), 0);
+    CU_ASSERT_EQUAL(parsed->block1_size, 16);
+    CU_ASSERT_EQUAL(parsed->payload_len, sizeof(payload));
+    coap_free_header(parsed);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static struct TestTable table[] = {
+        { "test of coap_parse_message() with a registration", test_parse_registration },
+        { "test of coap_parse_message() with more options than inline storage", test_parse_long_path },
+        { "test of coap_serialize_message_len()", test_serialize_len },
+        { "test of the Size1 option", test_size1 },
+        { NULL, NULL },
+};
+
+CU_ErrorCode create_coap_suit()
+{
+   CU_pSuite pSuite = NULL;
+
+   pSuite = CU_add_suite("Suite_CoAP", NULL, NULL);
+   if (NULL == pSuite) {
+      return CU_get_error();
+   }
+
+   return add_tests(pSuite, table);
+}
@@ -28,7 +28,7 @@
 
 const char * tests[]={"1", "-114" , "2", "0", "-2", "919293949596979899", "-98979969594939291", "999999999999999999999999999999", "1.2" , "0.134" , "432f.43" , "0.01", "1.00000000000002", NULL};
 int64_t tests_expected_int[]={1,-114,2,0,-2,919293949596979899,-98979969594939291,-1,-1,-1,-1,-1,-1};
-double tests_expected_float[]={1,-114,2,0,-2,9.1929394959698e+17,-9.897996959493928e+16,1e+30,1.2,0.134,-1,0.01,1.00000000000002};
+double tests_expected_float[]={1,-114,2,0,-2,919293949596979899.0,-98979969594939291.0,1e+30,1.2,0.134,-1,0.01,1.00000000000002};
 
 int64_t ints[]={12, -114 , 1 , 134 , 43243 , 0, -215025};
 const char* ints_expected[] = {"12","-114","1", "134", "43243","0","-215025"};
@@ -101,11 +101,135 @@ static void test_utils_floatToText(void)
     }
 }
 
+static void test_utils_floatToText_shortest(void)
+{
+    double values[] = { 0.1, 0.3, 0.1 + 0.2, 1e21, 1e20, 123456789012345680000.0, 1e-7, 0.000001, -4e+38,
+                        2.2250738585072014e-308, 5e-324, 1.7976931348623157e308, 1.0 / 3, 9007199254740993.0, -0.0 };
+    const char * expected[] = { "0.1", "0.3", "0.30000000000000004", "1e+21", "100000000000000000000", "123456789012345680000", "1e-7", "0.000001", "-4e+38",
+                                "2.2250738585072014e-308", "5e-324", "1.7976931348623157e+308", "0.3333333333333333", "9007199254740992", "0" };
+    unsigned int i;
+
+    for (i = 0 ; i < sizeof(values)/sizeof(values[0]); i++)
+    {
+        char res[32];
+        size_t len;
+
+        len = utils_floatToText(values[i], (uint8_t*)res, sizeof(res));
+
+        CU_ASSERT_EQUAL(len, strlen(expected[i]));
+        CU_ASSERT_NSTRING_EQUAL(res, expected[i], len);
+    }
+
+    // too small a buffer
+    CU_ASSERT_EQUAL(utils_floatToText(0.30000000000000004, (uint8_t*)values, 10), 0);
+}
+
+// 2^-1075, the midpoint between 0 and the smallest double
+static const char prv_midpoint[] =
+    "2.47032822920623272088284396434110686182529901307162382212792841250337753635104375932649918180817996"
+    "1898982823477228588654633283551779698981993873980053909390631503565951557022639229085839244910518443"
+    "5931802849936536152500319370457678249219365623669863658480757001585769269903706311928279558551332927"
+    "8343384093519780155312465972635795746227664652728272200563740064854999770965994704540208281662262378"
+    "5739345073633900796776193057750674017632467360096895134053553745851666113422376667860416215968046191"
+    "4467291840300530057530849048765391711386591646239524912623653881879636239373280423891018672348497668"
+    "2350898633885879256283027559956575244555072551893136908362547791869486679949683240497058210285131854"
+    "51396213837722826145437693412532098591327667236328125";
+
+static void test_utils_textToFloat_exact(void)
+{
+    const char * texts[] = { "0.1", "2.2250738585072011e-308", "4.9406564584124654e-324", "2.4703282292062328e-324", "2.4703282292062327e-324",
+                             "1.7976931348623157e308", "9007199254740993", "9007199254740995", "1e23", "8.98846567431158e307",
+                             "7.2057594037927933e+16", "2.5E-3", "1234567890123456789012345", "0.000000000000000000000000000000001",
+                             "18014398509481986.001", "9007199254740993.0000000001", "9007199254740993.0000000000",
+                             "1.00000000000000011102230246251565404236316680908203125", "1.00000000000000011102230246251565404236316680908203126",
+                             "1.00000000000000011102230246251565404236316680908203124", NULL };
+    double expected[] = { 0.1, 2.2250738585072011e-308, 4.9406564584124654e-324, 4.9406564584124654e-324, 0,
+                          1.7976931348623157e308, 9007199254740992.0, 9007199254740996.0, 1e23, 8.98846567431158e307,
+                          72057594037927936.0, 0.0025, 1.2345678901234568e24, 1e-33,
+                          18014398509481988.0, 9007199254740994.0, 9007199254740992.0,
+                          1.0, 1.0000000000000002, 1.0 };
+    const char * invalid[] = { "-", ".", "1.", "1e", "1e+", "e5", "1.7976931348623159e308", "1e400", "0x10", "1.5f", NULL };
+    int i;
+
+    for (i = 0 ; texts[i] != NULL ; i++)
+    {
+        double res;
+
+        CU_ASSERT_EQUAL(utils_textToFloat((uint8_t*)texts[i], strlen(texts[i]), &res), 1);
+        CU_ASSERT_DOUBLE_EQUAL(res, expected[i], 0);
+    }
+
+    for (i = 0 ; invalid[i] != NULL ; i++)
+    {
+        double res;
+
+        CU_ASSERT_EQUAL(utils_textToFloat((uint8_t*)invalid[i], strlen(invalid[i]), &res), 0);
+    }
+}
+
+static void test_utils_textToFloat_midpoint(void)
+{
+    const char * suffixes[] = { "e-324", "1e-324", "0000000000000000000000000000000000000001e-324", NULL };
+    double expected[] = { 0, 4.9406564584124654e-324, 4.9406564584124654e-324 };
+    char text[sizeof(prv_midpoint) + 64];
+    int i;
+
+    // the digits deciding the rounding are past the 750th
+    for (i = 0 ; suffixes[i] != NULL ; i++)
+    {
+        double res;
+
+        strcpy(text, prv_midpoint);
+        strcat(text, suffixes[i]);
+        CU_ASSERT_EQUAL(utils_textToFloat((uint8_t*)text, strlen(text), &res), 1);
+        CU_ASSERT_DOUBLE_EQUAL(res, expected[i], 0);
+    }
+}
+
+static void test_utils_float_roundtrip(void)
+{
+    uint64_t seed = 0x2545F4914F6CDD1DULL;
+    int i;
+
+    for (i = 0 ; i < 200000 ; i++)
+    {
+        uint64_t bits;
+        double value;
+        double res;
+        char text[32];
+        size_t len;
+
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        if ((i & 1) != 0)
+        {
+            // plain decimal values as well as random bit patterns
+            value = (double)((seed >> 11) % 100000000) / 1000;
+        }
+        else
+        {
+            // skip infinities, NaNs and negative zero
+            bits = seed;
+            if ((bits & 0x7FF0000000000000ULL) == 0x7FF0000000000000ULL) continue;
+            if (bits == 0x8000000000000000ULL) continue;
+            memcpy(&value, &bits, sizeof(value));
+        }
+
+        len = utils_floatToText(value, (uint8_t*)text, sizeof(text));
+        CU_ASSERT_FATAL(len > 0);
+        CU_ASSERT_EQUAL_FATAL(utils_textToFloat((uint8_t*)text, len, &res), 1);
+        CU_ASSERT_DOUBLE_EQUAL_FATAL(res, value, 0);
+    }
+}
+
 static struct TestTable table[] = {
         { "test of utils_textToInt()", test_utils_textToInt },
         { "test of utils_textToFloat()", test_utils_textToFloat },
         { "test of utils_intToText()", test_utils_intToText },
         { "test of utils_floatToText()", test_utils_floatToText },
+        { "test of utils_floatToText() shortest output", test_utils_floatToText_shortest },
+        { "test of utils_textToFloat() rounding", test_utils_textToFloat_exact },
+        { "test of utils_textToFloat() on a midpoint with 752 digits", test_utils_textToFloat_midpoint },
+        { "test of utils_floatToText() and utils_textToFloat() round trip", test_utils_float_roundtrip },
         { NULL, NULL },
 };
 
@@ -0,0 +1,125 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2017 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ *******************************************************************************/
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+#include "internals.h"
+#include "memtest.h"
+
+#define ITEM_COUNT 200
+
+static bool prv_matchValue(void * itemP,
+                           void * userData)
+{
+    return *(int *)itemP == *(int *)userData;
+}
+
+static void test_hash_add_find_remove(void)
+{
+    lwm2m_hash_t hash;
+    int items[ITEM_COUNT];
+    int i;
+
+    MEMORY_TRACE_BEFORE;
+
+    memset(&hash, 0, sizeof(hash));
+    CU_ASSERT_PTR_NULL(hash_find(&hash, 1, NULL, NULL));
+
+    for (i = 0 ; i < ITEM_COUNT ; i++)
+    {
+        items[i] = i;
+        CU_ASSERT_TRUE(hash_add(&hash, (uint32_t)i, items + i));
+    }
+    CU_ASSERT_EQUAL(hash.count, ITEM_COUNT);
+    CU_ASSERT(hash.bucketCount >= ITEM_COUNT);
+
+    for (i = 0 ; i < ITEM_COUNT ; i++)
+    {
+        CU_ASSERT_PTR_EQUAL(hash_find(&hash, (uint32_t)i, NULL, NULL), items + i);
+    }
+    CU_ASSERT_PTR_NULL(hash_find(&hash, ITEM_COUNT, NULL, NULL));
+
+    hash_remove(&hash, 10, items + 10);
+    CU_ASSERT_PTR_NULL(hash_find(&hash, 10, NULL, NULL));
+    CU_ASSERT_EQUAL(hash.count, ITEM_COUNT - 1);
+
+    // removing an unknown item is a no-op
+    hash_remove(&hash, 10, items + 10);
+    hash_remove(&hash, 11, items + 12);
+    CU_ASSERT_EQUAL(hash.count, ITEM_COUNT - 1);
+
+    hash_free(&hash);
+    CU_ASSERT_EQUAL(hash.count, 0);
+    CU_ASSERT_PTR_NULL(hash.buckets);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_hash_collisions(void)
+{
+    lwm2m_hash_t hash;
+    int items[3] = { 1, 2, 3 };
+    int value;
+
+    MEMORY_TRACE_BEFORE;
+
+    memset(&hash, 0, sizeof(hash));
+    CU_ASSERT_TRUE(hash_add(&hash, 42, items));
+    CU_ASSERT_TRUE(hash_add(&hash, 42, items + 1));
+    CU_ASSERT_TRUE(hash_add(&hash, 42, items + 2));
+
+    value = 2;
+    CU_ASSERT_PTR_EQUAL(hash_find(&hash, 42, prv_matchValue, &value), items + 1);
+    value = 4;
+    CU_ASSERT_PTR_NULL(hash_find(&hash, 42, prv_matchValue, &value));
+
+    hash_remove(&hash, 42, items + 1);
+    value = 2;
+    CU_ASSERT_PTR_NULL(hash_find(&hash, 42, prv_matchValue, &value));
+    value = 3;
+    CU_ASSERT_PTR_EQUAL(hash_find(&hash, 42, prv_matchValue, &value), items + 2);
+
+    hash_free(&hash);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_hash_buffer(void)
+{
+    uint8_t token1[4] = { 0x01, 0x02, 0x03, 0x04 };
+    uint8_t token2[4] = { 0x01, 0x02, 0x03, 0x05 };
+
+    CU_ASSERT_EQUAL(hash_buffer(token1, 4), hash_buffer(token1, 4));
+    CU_ASSERT_NOT_EQUAL(hash_buffer(token1, 4), hash_buffer(token2, 4));
+    CU_ASSERT_NOT_EQUAL(hash_buffer(token1, 3), hash_buffer(token1, 4));
+}
+
+static struct TestTable table[] = {
+        { "test of hash_add(), hash_find() and hash_remove()", test_hash_add_find_remove },
+        { "test of hash_find() with colliding keys", test_hash_collisions },
+        { "test of hash_buffer()", test_hash_buffer },
+        { NULL, NULL },
+};
+
+CU_ErrorCode create_hash_suit()
+{
+   CU_pSuite pSuite = NULL;
+
+   pSuite = CU_add_suite("Suite_Hash", NULL, NULL);
+   if (NULL == pSuite) {
+      return CU_get_error();
+   }
+
+   return add_tests(pSuite, table);
+}
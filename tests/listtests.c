@@ -0,0 +1,138 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2017 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ *******************************************************************************/
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+#include "internals.h"
+#include "memtest.h"
+
+#define NODE_COUNT 100
+
+static bool prv_isSorted(lwm2m_list_t * head,
+                         size_t count)
+{
+    size_t i = 0;
+
+    for ( ; head != NULL ; head = head->next)
+    {
+        if (head->next != NULL && head->next->id <= head->id) return false;
+        i++;
+    }
+
+    return i == count;
+}
+
+static void test_list_index(void)
+{
+    lwm2m_list_index_t index;
+    lwm2m_list_t nodes[NODE_COUNT];
+    lwm2m_list_t * head = NULL;
+    lwm2m_list_t * nodeP;
+    int i;
+
+    MEMORY_TRACE_BEFORE;
+
+    memset(&index, 0, sizeof(index));
+    memset(nodes, 0, sizeof(nodes));
+    CU_ASSERT_EQUAL(lwm2m_list_index_newId(&index, head), 0);
+
+    // even IDs first, in reverse order, then odd IDs
+    for (i = NODE_COUNT - 2 ; i >= 0 ; i -= 2)
+    {
+        nodes[i].id = (uint16_t)i;
+        head = lwm2m_list_index_add(&index, head, nodes + i);
+    }
+    CU_ASSERT_EQUAL(lwm2m_list_index_newId(&index, head), 1);
+    for (i = 1 ; i < NODE_COUNT ; i += 2)
+    {
+        nodes[i].id = (uint16_t)i;
+        head = lwm2m_list_index_add(&index, head, nodes + i);
+    }
+    CU_ASSERT_PTR_NOT_NULL_FATAL(index.nodes);
+    CU_ASSERT_PTR_EQUAL(head, nodes);
+    CU_ASSERT_TRUE(prv_isSorted(head, NODE_COUNT));
+    CU_ASSERT_EQUAL(lwm2m_list_index_newId(&index, head), NODE_COUNT);
+
+    for (i = 0 ; i < NODE_COUNT ; i++)
+    {
+        CU_ASSERT_PTR_EQUAL(lwm2m_list_index_find(&index, head, (uint16_t)i), nodes + i);
+    }
+    CU_ASSERT_PTR_NULL(lwm2m_list_index_find(&index, head, NODE_COUNT));
+
+    head = lwm2m_list_index_remove(&index, head, 0, &nodeP);
+    CU_ASSERT_PTR_EQUAL(nodeP, nodes);
+    CU_ASSERT_PTR_EQUAL(head, nodes + 1);
+    head = lwm2m_list_index_remove(&index, head, 42, &nodeP);
+    CU_ASSERT_PTR_EQUAL(nodeP, nodes + 42);
+    head = lwm2m_list_index_remove(&index, head, 42, &nodeP);
+    CU_ASSERT_PTR_NULL(nodeP);
+    CU_ASSERT_PTR_NULL(lwm2m_list_index_find(&index, head, 42));
+    CU_ASSERT_TRUE(prv_isSorted(head, NODE_COUNT - 2));
+    CU_ASSERT_EQUAL(lwm2m_list_index_newId(&index, head), 0);
+
+    lwm2m_list_index_free(&index);
+    CU_ASSERT_PTR_NULL(index.nodes);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_list_index_fallback(void)
+{
+    lwm2m_list_index_t index;
+    lwm2m_list_t nodes[3];
+    lwm2m_list_t * head = NULL;
+    lwm2m_list_t * nodeP;
+
+    MEMORY_TRACE_BEFORE;
+
+    memset(&index, 0, sizeof(index));
+    memset(nodes, 0, sizeof(nodes));
+    nodes[0].id = 0;
+    nodes[1].id = 2;
+    nodes[2].id = 1;
+
+    // a list built without the index is never indexed
+    head = lwm2m_list_add(head, nodes);
+    head = lwm2m_list_index_add(&index, head, nodes + 1);
+    CU_ASSERT_PTR_NULL(index.nodes);
+    CU_ASSERT_EQUAL(lwm2m_list_index_newId(&index, head), 1);
+    head = lwm2m_list_index_add(&index, head, nodes + 2);
+    CU_ASSERT_TRUE(prv_isSorted(head, 3));
+    CU_ASSERT_PTR_EQUAL(lwm2m_list_index_find(&index, head, 2), nodes + 1);
+
+    head = lwm2m_list_index_remove(&index, head, 1, &nodeP);
+    CU_ASSERT_PTR_EQUAL(nodeP, nodes + 2);
+    CU_ASSERT_TRUE(prv_isSorted(head, 2));
+    CU_ASSERT_PTR_NULL(index.nodes);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static struct TestTable table[] = {
+        { "test of lwm2m_list_index_*()", test_list_index },
+        { "test of lwm2m_list_index_*() on a list not indexed", test_list_index_fallback },
+        { NULL, NULL },
+};
+
+CU_ErrorCode create_list_suit()
+{
+   CU_pSuite pSuite = NULL;
+
+   pSuite = CU_add_suite("Suite_List", NULL, NULL);
+   if (NULL == pSuite) {
+      return CU_get_error();
+   }
+
+   return add_tests(pSuite, table);
+}
@@ -0,0 +1,141 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2017 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ *******************************************************************************/
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+#include "internals.h"
+#include "memtest.h"
+
+#define PAYLOAD_HEADER "</>;rt=\"oma.lwm2m\";ct=11543,"
+
+static void prv_addInstance(lwm2m_object_t * objectP,
+                            uint16_t id)
+{
+    lwm2m_list_t * instanceP;
+
+    instanceP = (lwm2m_list_t *)lwm2m_malloc(sizeof(lwm2m_list_t));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(instanceP);
+    memset(instanceP, 0, sizeof(lwm2m_list_t));
+    instanceP->id = id;
+    objectP->instanceList = LWM2M_LIST_ADD(objectP->instanceList, instanceP);
+}
+
+static void prv_checkPayload(lwm2m_context_t * contextP,
+                             const char * expected)
+{
+    uint8_t * payload;
+    size_t length;
+
+    payload = object_getRegisterPayload(contextP, &length);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(payload);
+    CU_ASSERT_EQUAL(length, strlen(expected));
+    CU_ASSERT_NSTRING_EQUAL(payload, expected, length);
+}
+
+static void test_register_payload(void)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_object_t objects[5];
+    lwm2m_object_t * objectArray[3];
+    lwm2m_server_t * serverP;
+    uint8_t * cacheP;
+    int i;
+
+    MEMORY_TRACE_BEFORE;
+
+    memset(objects, 0, sizeof(objects));
+    objects[0].objID = LWM2M_SECURITY_OBJECT_ID;
+    objects[1].objID = LWM2M_SERVER_OBJECT_ID;
+    objects[2].objID = LWM2M_DEVICE_OBJECT_ID;
+    objects[3].objID = 5;
+    objects[4].objID = 2;
+    for (i = 0 ; i < 3 ; i++)
+    {
+        prv_addInstance(objects + i, 0);
+        objectArray[i] = objects + i;
+    }
+
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+    CU_ASSERT_EQUAL_FATAL(lwm2m_configure(contextP, "test", NULL, NULL, 3, objectArray), COAP_NO_ERROR);
+
+    // the security object is not listed
+    prv_checkPayload(contextP, PAYLOAD_HEADER "</1/0>,</3/0>");
+
+    CU_ASSERT_EQUAL(lwm2m_add_object(contextP, objects + 3), COAP_NO_ERROR);
+    prv_checkPayload(contextP, PAYLOAD_HEADER "</1/0>,</3/0>,</5>");
+
+    prv_addInstance(objects + 2, 2);
+    prv_addInstance(objects + 2, 1);
+    object_updateRegisterPayload(contextP, LWM2M_DEVICE_OBJECT_ID);
+    prv_checkPayload(contextP, PAYLOAD_HEADER "</1/0>,</3/0>,</3/1>,</3/2>,</5>");
+
+    prv_addInstance(objects + 4, 7);
+    prv_addInstance(objects + 4, 0);
+    CU_ASSERT_EQUAL(lwm2m_add_object(contextP, objects + 4), COAP_NO_ERROR);
+    prv_checkPayload(contextP, PAYLOAD_HEADER "</1/0>,</2/0>,</2/7>,</3/0>,</3/1>,</3/2>,</5>");
+
+    CU_ASSERT_EQUAL(lwm2m_remove_object(contextP, LWM2M_DEVICE_OBJECT_ID), COAP_NO_ERROR);
+    prv_checkPayload(contextP, PAYLOAD_HEADER "</1/0>,</2/0>,</2/7>,</5>");
+    CU_ASSERT_EQUAL(lwm2m_remove_object(contextP, 5), COAP_NO_ERROR);
+    prv_checkPayload(contextP, PAYLOAD_HEADER "</1/0>,</2/0>,</2/7>");
+
+    // patching in place when the entries fit
+    cacheP = contextP->registerPayload;
+    object_updateRegisterPayload(contextP, 2);
+    CU_ASSERT_PTR_EQUAL(contextP->registerPayload, cacheP);
+
+    // the application changed instances on its own
+    serverP = (lwm2m_server_t *)lwm2m_malloc(sizeof(lwm2m_server_t));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(serverP);
+    memset(serverP, 0, sizeof(lwm2m_server_t));
+    serverP->status = STATE_DEREGISTERED;
+    contextP->serverList = serverP;
+    prv_addInstance(objects + 1, 3);
+    lwm2m_update_registration(contextP, 0, true);
+    CU_ASSERT_PTR_NULL(contextP->registerPayload);
+    prv_checkPayload(contextP, PAYLOAD_HEADER "</1/0>,</1/3>,</2/0>,</2/7>");
+
+    // a full registration does not trust the cache
+    serverP->status = STATE_REGISTERED;
+    prv_addInstance(objects + 1, 4);
+    CU_ASSERT_EQUAL(registration_start(contextP), COAP_NO_ERROR);
+    CU_ASSERT_PTR_NULL(contextP->registerPayload);
+    prv_checkPayload(contextP, PAYLOAD_HEADER "</1/0>,</1/3>,</1/4>,</2/0>,</2/7>");
+
+    lwm2m_close(contextP);
+    for (i = 0 ; i < 5 ; i++)
+    {
+        LWM2M_LIST_FREE(objects[i].instanceList);
+    }
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static struct TestTable table[] = {
+        { "test of object_getRegisterPayload() and object_updateRegisterPayload()", test_register_payload },
+        { NULL, NULL },
+};
+
+CU_ErrorCode create_objects_suit()
+{
+   CU_pSuite pSuite = NULL;
+
+   pSuite = CU_add_suite("Suite_Objects", NULL, NULL);
+   if (NULL == pSuite) {
+      return CU_get_error();
+   }
+
+   return add_tests(pSuite, table);
+}
@@ -0,0 +1,984 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2017 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ *******************************************************************************/
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+#include "internals.h"
+#include "connection.h"
+#include "memtest.h"
+
+#define TEST_OBJECT_ID  1024
+#define TEST_URI        "/1024/0/1"
+
+typedef struct
+{
+    lwm2m_context_t * contextP;
+    lwm2m_object_t    object;
+    lwm2m_list_t      instance;
+    lwm2m_server_t    server;
+    connection_t      conn;
+    int               peerSock;
+    int               reads;
+    int64_t           value;
+    uint8_t           buffer[1024];
+} observe_test_t;
+
+// the instance holds a single integer resource
+static uint8_t prv_read(uint16_t instanceId,
+                        int * numDataP,
+                        lwm2m_data_t ** dataArrayP,
+                        lwm2m_object_t * objectP)
+{
+    observe_test_t * testP = (observe_test_t *)objectP->userData;
+
+    if (instanceId != 0) return COAP_404_NOT_FOUND;
+
+    testP->reads++;
+    if (*numDataP == 0)
+    {
+        *dataArrayP = lwm2m_data_new(1);
+        if (*dataArrayP == NULL) return COAP_500_INTERNAL_SERVER_ERROR;
+        *numDataP = 1;
+        (*dataArrayP)->id = 1;
+    }
+    else if (*numDataP != 1 || (*dataArrayP)->id != 1)
+    {
+        return COAP_404_NOT_FOUND;
+    }
+    lwm2m_data_encode_int(testP->value, *dataArrayP);
+
+    return COAP_205_CONTENT;
+}
+
+// the notifications are sent to a socket read by prv_receive()
+static void prv_openSession(connection_t * connP,
+                            int * peerSockP)
+{
+    struct sockaddr_in6 addr;
+    socklen_t addrLen = sizeof(addr);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr = in6addr_loopback;
+    *peerSockP = socket(AF_INET6, SOCK_DGRAM, 0);
+    CU_ASSERT_FATAL(*peerSockP >= 0);
+    CU_ASSERT_EQUAL_FATAL(bind(*peerSockP, (struct sockaddr *)&addr, addrLen), 0);
+    CU_ASSERT_EQUAL_FATAL(getsockname(*peerSockP, (struct sockaddr *)&addr, &addrLen), 0);
+
+    memset(connP, 0, sizeof(connection_t));
+    connP->sock = socket(AF_INET6, SOCK_DGRAM, 0);
+    CU_ASSERT_FATAL(connP->sock >= 0);
+    connP->addr = addr;
+    connP->addrLen = addrLen;
+}
+
+static void prv_init(observe_test_t * testP)
+{
+    memset(testP, 0, sizeof(observe_test_t));
+    prv_openSession(&testP->conn, &testP->peerSock);
+
+    testP->contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(testP->contextP);
+    testP->object.objID = TEST_OBJECT_ID;
+    testP->object.instanceList = &testP->instance;
+    testP->object.readFunc = prv_read;
+    testP->object.userData = testP;
+    CU_ASSERT_EQUAL_FATAL(lwm2m_add_object(testP->contextP, &testP->object), COAP_NO_ERROR);
+
+    testP->server.shortID = 1;
+    testP->server.status = STATE_REGISTERED;
+    testP->server.sessionH = &testP->conn;
+}
+
+static void prv_close(observe_test_t * testP)
+{
+    lwm2m_close(testP->contextP);
+    close(testP->conn.sock);
+    close(testP->peerSock);
+}
+
+// gets the next notification sent, its payload points in testP->buffer
+static bool prv_receive(observe_test_t * testP,
+                        coap_packet_t * packet)
+{
+    ssize_t length;
+
+    length = recv(testP->peerSock, testP->buffer, sizeof(testP->buffer), MSG_DONTWAIT);
+    if (length <= 0) return false;
+    CU_ASSERT_EQUAL_FATAL(coap_parse_message(packet, testP->buffer, (uint16_t)length), NO_ERROR);
+
+    return true;
+}
+
+static int prv_countNotifications(observe_test_t * testP)
+{
+    coap_packet_t packet[1];
+    int count = 0;
+
+    while (prv_receive(testP, packet))
+    {
+        CU_ASSERT_EQUAL(packet->code, COAP_205_CONTENT);
+        CU_ASSERT_TRUE(IS_OPTION(packet, COAP_OPTION_OBSERVE));
+        coap_free_header(packet);
+        count++;
+    }
+
+    return count;
+}
+
+static lwm2m_watcher_t * prv_observe(observe_test_t * testP,
+                                     lwm2m_server_t * serverP,
+                                     const char * uriString,
+                                     lwm2m_media_type_t format)
+{
+    lwm2m_uri_t uri;
+    coap_packet_t message[1];
+    coap_packet_t response[1];
+    lwm2m_data_t * dataP;
+    lwm2m_observed_t * observedP;
+    lwm2m_watcher_t * watcherP;
+    uint8_t token;
+
+    CU_ASSERT_FATAL(lwm2m_stringToUri(uriString, strlen(uriString), &uri) != 0);
+
+    coap_init_message(message, COAP_TYPE_CON, COAP_GET, testP->contextP->nextMID++);
+    token = (uint8_t)serverP->shortID;
+    coap_set_header_token(message, &token, 1);
+    coap_set_header_observe(message, 0);
+    coap_set_header_accept(message, (uint16_t)format);
+    coap_init_message(response, COAP_TYPE_ACK, COAP_205_CONTENT, message->mid);
+    dataP = lwm2m_data_new(1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(dataP);
+    lwm2m_data_encode_int(testP->value, dataP);
+
+    CU_ASSERT_EQUAL(observe_handleRequest(testP->contextP, &uri, serverP, 1, dataP, message, response), COAP_205_CONTENT);
+
+    lwm2m_data_free(1, dataP);
+    coap_free_header(message);
+    coap_free_header(response);
+
+    observedP = observe_findByUri(testP->contextP, &uri);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(observedP);
+    for (watcherP = observedP->watcherList ; watcherP != NULL ; watcherP = watcherP->next)
+    {
+        if (watcherP->server == serverP) break;
+    }
+    CU_ASSERT_PTR_NOT_NULL_FATAL(watcherP);
+
+    return watcherP;
+}
+
+static void prv_setAttributes(observe_test_t * testP,
+                              lwm2m_attributes_t * attrP)
+{
+    lwm2m_uri_t uri;
+
+    CU_ASSERT_FATAL(lwm2m_stringToUri(TEST_URI, strlen(TEST_URI), &uri) != 0);
+    CU_ASSERT_EQUAL(observe_setParameters(testP->contextP, &uri, &testP->server, attrP), COAP_204_CHANGED);
+    testP->reads = 0;
+}
+
+static void prv_change(observe_test_t * testP,
+                       int64_t value)
+{
+    lwm2m_uri_t uri;
+
+    CU_ASSERT_FATAL(lwm2m_stringToUri(TEST_URI, strlen(TEST_URI), &uri) != 0);
+    testP->value = value;
+    lwm2m_resource_value_changed(testP->contextP, &uri);
+}
+
+static void prv_step(observe_test_t * testP,
+                     int64_t delayMs)
+{
+    int64_t timeout = 60000;
+
+    timer_step(testP->contextP, utils_getTimeMs() + delayMs, &timeout);
+}
+
+// pretends the last notification was sent seconds earlier, and steps the timers as far
+static void prv_elapse(observe_test_t * testP,
+                       lwm2m_watcher_t * watcherP,
+                       time_t seconds)
+{
+    watcherP->lastTime -= seconds;
+    prv_step(testP, (int64_t)seconds * 1000);
+}
+
+static void test_observe_idle(void)
+{
+    observe_test_t test;
+    lwm2m_watcher_t * watcherP;
+
+    MEMORY_TRACE_BEFORE;
+
+    prv_init(&test);
+    watcherP = prv_observe(&test, &test.server, TEST_URI, LWM2M_CONTENT_TEXT);
+
+    // without a change nor a maximum period, the resource is never read
+    CU_ASSERT_EQUAL(watcherP->timer.position, 0);
+    prv_elapse(&test, watcherP, 3600);
+    CU_ASSERT_EQUAL(test.reads, 0);
+    CU_ASSERT_EQUAL(prv_countNotifications(&test), 0);
+
+    prv_change(&test, 12);
+    prv_step(&test, 0);
+    CU_ASSERT_EQUAL(test.reads, 1);
+    CU_ASSERT_EQUAL(prv_countNotifications(&test), 1);
+    CU_ASSERT_EQUAL(watcherP->timer.position, 0);
+
+    prv_close(&test);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_observe_min_period(void)
+{
+    observe_test_t test;
+    lwm2m_watcher_t * watcherP;
+    lwm2m_attributes_t attr;
+
+    MEMORY_TRACE_BEFORE;
+
+    prv_init(&test);
+    watcherP = prv_observe(&test, &test.server, TEST_URI, LWM2M_CONTENT_TEXT);
+    memset(&attr, 0, sizeof(attr));
+    attr.toSet = LWM2M_ATTR_FLAG_MIN_PERIOD;
+    attr.minPeriod = 10;
+    prv_setAttributes(&test, &attr);
+
+    // the change waits for the minimum period
+    prv_change(&test, 12);
+    CU_ASSERT_NOT_EQUAL(watcherP->timer.position, 0);
+    prv_step(&test, 0);
+    CU_ASSERT_EQUAL(test.reads, 0);
+    CU_ASSERT_EQUAL(prv_countNotifications(&test), 0);
+    CU_ASSERT_TRUE(watcherP->update);
+
+    prv_elapse(&test, watcherP, 10);
+    CU_ASSERT_EQUAL(test.reads, 1);
+    CU_ASSERT_EQUAL(prv_countNotifications(&test), 1);
+    CU_ASSERT_FALSE(watcherP->update);
+
+    prv_close(&test);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_observe_max_period(void)
+{
+    observe_test_t test;
+    lwm2m_watcher_t * watcherP;
+    lwm2m_attributes_t attr;
+
+    MEMORY_TRACE_BEFORE;
+
+    prv_init(&test);
+    watcherP = prv_observe(&test, &test.server, TEST_URI, LWM2M_CONTENT_TEXT);
+    memset(&attr, 0, sizeof(attr));
+    attr.toSet = LWM2M_ATTR_FLAG_MAX_PERIOD;
+    attr.maxPeriod = 5;
+    prv_setAttributes(&test, &attr);
+
+    prv_step(&test, 0);
+    CU_ASSERT_EQUAL(test.reads, 0);
+    CU_ASSERT_EQUAL(prv_countNotifications(&test), 0);
+
+    // notified without any change, and scheduled for the next period
+    prv_elapse(&test, watcherP, 5);
+    CU_ASSERT_EQUAL(test.reads, 1);
+    CU_ASSERT_EQUAL(prv_countNotifications(&test), 1);
+    CU_ASSERT_NOT_EQUAL(watcherP->timer.position, 0);
+
+    prv_close(&test);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_observe_numeric(void)
+{
+    observe_test_t test;
+    lwm2m_attributes_t attr;
+
+    MEMORY_TRACE_BEFORE;
+
+    prv_init(&test);
+    test.value = 10;
+    (void)prv_observe(&test, &test.server, TEST_URI, LWM2M_CONTENT_TEXT);
+
+    memset(&attr, 0, sizeof(attr));
+    attr.toSet = LWM2M_ATTR_FLAG_GREATER_THAN;
+    attr.greaterThan = 50;
+    prv_setAttributes(&test, &attr);
+    prv_change(&test, 20);
+    prv_step(&test, 0);
+    CU_ASSERT_EQUAL(test.reads, 1);
+    CU_ASSERT_EQUAL(prv_countNotifications(&test), 0);
+    prv_change(&test, 60);
+    prv_step(&test, 0);
+    CU_ASSERT_EQUAL(test.reads, 2);
+    CU_ASSERT_EQUAL(prv_countNotifications(&test), 1);
+
+    memset(&attr, 0, sizeof(attr));
+    attr.toClear = LWM2M_ATTR_FLAG_GREATER_THAN;
+    attr.toSet = LWM2M_ATTR_FLAG_LESS_THAN;
+    attr.lessThan = 30;
+    prv_setAttributes(&test, &attr);
+    prv_change(&test, 40);
+    prv_step(&test, 0);
+    CU_ASSERT_EQUAL(prv_countNotifications(&test), 0);
+    prv_change(&test, 25);
+    prv_step(&test, 0);
+    CU_ASSERT_EQUAL(prv_countNotifications(&test), 1);
+
+    memset(&attr, 0, sizeof(attr));
+    attr.toClear = LWM2M_ATTR_FLAG_LESS_THAN;
+    attr.toSet = LWM2M_ATTR_FLAG_STEP;
+    attr.step = 5;
+    prv_setAttributes(&test, &attr);
+    prv_change(&test, 28);
+    prv_step(&test, 0);
+    CU_ASSERT_EQUAL(prv_countNotifications(&test), 0);
+    prv_change(&test, 31);
+    prv_step(&test, 0);
+    CU_ASSERT_EQUAL(prv_countNotifications(&test), 1);
+    CU_ASSERT_EQUAL(test.reads, 2);
+
+    prv_close(&test);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_observe_tagging(void)
+{
+    observe_test_t test;
+    const char * uris[] = { "/1024", "/1024/0", "/1024/0/1", "/1024/0/2", "/1024/1", "/1024/1/1" };
+    lwm2m_watcher_t * watchers[6];
+    lwm2m_uri_t uri;
+    int i;
+
+    MEMORY_TRACE_BEFORE;
+
+    prv_init(&test);
+    for (i = 0 ; i < 6 ; i++)
+    {
+        watchers[i] = prv_observe(&test, &test.server, uris[i], LWM2M_CONTENT_TLV);
+    }
+
+    // a resource change reaches the resource, its instance and its object only
+    prv_change(&test, 12);
+    CU_ASSERT_TRUE(watchers[0]->update);
+    CU_ASSERT_TRUE(watchers[1]->update);
+    CU_ASSERT_TRUE(watchers[2]->update);
+    CU_ASSERT_FALSE(watchers[3]->update);
+    CU_ASSERT_FALSE(watchers[4]->update);
+    CU_ASSERT_FALSE(watchers[5]->update);
+
+    // an instance change also reaches the resources below it
+    for (i = 0 ; i < 6 ; i++) watchers[i]->update = false;
+    CU_ASSERT_FATAL(lwm2m_stringToUri("/1024/1", 7, &uri) != 0);
+    lwm2m_resource_value_changed(test.contextP, &uri);
+    CU_ASSERT_TRUE(watchers[0]->update);
+    CU_ASSERT_FALSE(watchers[1]->update);
+    CU_ASSERT_FALSE(watchers[2]->update);
+    CU_ASSERT_FALSE(watchers[3]->update);
+    CU_ASSERT_TRUE(watchers[4]->update);
+    CU_ASSERT_TRUE(watchers[5]->update);
+
+    prv_close(&test);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_observe_formats(void)
+{
+    observe_test_t test;
+    lwm2m_server_t servers[2];
+    coap_packet_t packet[1];
+    int i;
+
+    MEMORY_TRACE_BEFORE;
+
+    prv_init(&test);
+    for (i = 0 ; i < 2 ; i++)
+    {
+        memcpy(servers + i, &test.server, sizeof(lwm2m_server_t));
+        servers[i].shortID = (uint16_t)(2 + i);
+    }
+    (void)prv_observe(&test, &test.server, "/1024/0", LWM2M_CONTENT_TLV);
+    (void)prv_observe(&test, servers, "/1024/0", LWM2M_CONTENT_JSON);
+    (void)prv_observe(&test, servers + 1, "/1024/0", LWM2M_CONTENT_TLV);
+
+    // the instance is read and serialized once per media type
+    prv_change(&test, 12);
+    prv_step(&test, 0);
+    CU_ASSERT_EQUAL(test.reads, 2);
+
+    for (i = 0 ; i < 3 ; i++)
+    {
+        CU_ASSERT_FATAL(prv_receive(&test, packet));
+        CU_ASSERT_EQUAL_FATAL(packet->token_len, 1);
+        CU_ASSERT_FATAL(packet->payload_len > 0);
+        if (packet->token[0] == 2)
+        {
+            CU_ASSERT_EQUAL(utils_convertMediaType(packet->content_type), LWM2M_CONTENT_JSON);
+            CU_ASSERT_EQUAL(packet->payload[0], '{');
+        }
+        else
+        {
+            CU_ASSERT_EQUAL(utils_convertMediaType(packet->content_type), LWM2M_CONTENT_TLV);
+            CU_ASSERT_NOT_EQUAL(packet->payload[0], '{');
+        }
+        coap_free_header(packet);
+    }
+    CU_ASSERT_EQUAL(prv_countNotifications(&test), 0);
+
+    prv_close(&test);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+// answers a confirmable notification
+static void prv_reply(observe_test_t * testP,
+                      coap_message_type_t type,
+                      uint16_t mid)
+{
+    coap_packet_t message[1];
+
+    coap_init_message(message, type, 0, mid);
+    CU_ASSERT_TRUE(transaction_handleResponse(testP->contextP, &testP->conn, message, NULL));
+    coap_free_header(message);
+}
+
+// gets a confirmable notification and checks its payload
+static uint16_t prv_receiveConfirmable(observe_test_t * testP,
+                                       const char * payload)
+{
+    coap_packet_t packet[1];
+    uint16_t mid;
+
+    CU_ASSERT_FATAL(prv_receive(testP, packet));
+    CU_ASSERT_EQUAL(packet->type, COAP_TYPE_CON);
+    CU_ASSERT_EQUAL(packet->payload_len, strlen(payload));
+    CU_ASSERT_NSTRING_EQUAL(packet->payload, payload, strlen(payload));
+    mid = packet->mid;
+    coap_free_header(packet);
+
+    return mid;
+}
+
+static void test_observe_confirmable(void)
+{
+    observe_test_t test;
+    lwm2m_watcher_t * watcherP;
+    uint16_t mid;
+    int64_t before;
+
+    MEMORY_TRACE_BEFORE;
+
+    prv_init(&test);
+    test.server.confirmableNotify = true;
+    watcherP = prv_observe(&test, &test.server, TEST_URI, LWM2M_CONTENT_TEXT);
+
+    prv_change(&test, 12);
+    prv_step(&test, 0);
+    mid = prv_receiveConfirmable(&test, "12");
+    CU_ASSERT_PTR_NOT_NULL(watcherP->transaction);
+
+    // a newer value replaces the notification waiting for its ACK
+    prv_change(&test, 13);
+    prv_step(&test, 0);
+    CU_ASSERT_NOT_EQUAL(prv_receiveConfirmable(&test, "13"), mid);
+    prv_change(&test, 14);
+    prv_step(&test, 0);
+    mid = prv_receiveConfirmable(&test, "14");
+    CU_ASSERT_EQUAL(test.reads, 3);
+    CU_ASSERT_FALSE(watcherP->update);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(watcherP->transaction);
+    CU_ASSERT_EQUAL(watcherP->transaction->mID, mid);
+
+    before = utils_getTimeMs();
+    prv_reply(&test, COAP_TYPE_ACK, mid);
+    CU_ASSERT_PTR_NULL(watcherP->transaction);
+    CU_ASSERT_PTR_NULL(test.contextP->transactionList);
+    CU_ASSERT_TRUE(watcherP->holdUntil >= before);
+
+    // the next notification is held back by the ACK latency
+    watcherP->holdUntil = utils_getTimeMs() + 1000;
+    prv_change(&test, 15);
+    prv_step(&test, 0);
+    CU_ASSERT_EQUAL(prv_countNotifications(&test), 0);
+    prv_step(&test, 1500);
+    mid = prv_receiveConfirmable(&test, "15");
+
+    // a reset removes the watcher
+    prv_reply(&test, COAP_TYPE_RST, mid);
+    CU_ASSERT_PTR_NULL(test.contextP->observedList);
+    prv_change(&test, 16);
+    prv_step(&test, 0);
+    CU_ASSERT_EQUAL(prv_countNotifications(&test), 0);
+
+    prv_close(&test);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_observe_confirmable_replace(void)
+{
+    observe_test_t test;
+    lwm2m_watcher_t * watcherP;
+    coap_packet_t packet[1];
+    uint16_t mid;
+    uint32_t observe;
+    int i;
+
+    MEMORY_TRACE_BEFORE;
+
+    prv_init(&test);
+    test.server.confirmableNotify = true;
+    watcherP = prv_observe(&test, &test.server, TEST_URI, LWM2M_CONTENT_TEXT);
+
+    prv_change(&test, 12);
+    prv_step(&test, 0);
+    CU_ASSERT_FATAL(prv_receive(&test, packet));
+    mid = packet->mid;
+    CU_ASSERT_EQUAL(coap_get_header_observe(packet, &observe), 1);
+    coap_free_header(packet);
+    prv_step(&test, watcherP->transaction->ack_timeout);
+    CU_ASSERT_EQUAL(prv_receiveConfirmable(&test, "12"), mid);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(watcherP->transaction);
+    CU_ASSERT_EQUAL(watcherP->transaction->retrans_counter, 3);
+
+    // the change goes out in the next packet, in place of the next retransmission
+    prv_change(&test, 13);
+    prv_step(&test, 0);
+    CU_ASSERT_FATAL(prv_receive(&test, packet));
+    CU_ASSERT_EQUAL(packet->type, COAP_TYPE_CON);
+    CU_ASSERT_NOT_EQUAL(packet->mid, mid);
+    CU_ASSERT_NSTRING_EQUAL(packet->payload, "13", packet->payload_len);
+    CU_ASSERT_TRUE(IS_OPTION(packet, COAP_OPTION_OBSERVE));
+    CU_ASSERT_TRUE(packet->observe > observe);
+    coap_free_header(packet);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(watcherP->transaction);
+    CU_ASSERT_EQUAL(watcherP->transaction->retrans_counter, 4);
+    CU_ASSERT_PTR_NULL(test.contextP->transactionList->next);
+
+    // the replacement only has the transmissions left by the first notification
+    for (i = 1 ; i <= COAP_MAX_RETRANSMIT + 2 - 4 ; i++)
+    {
+        prv_step(&test, i * 600000);
+        CU_ASSERT_EQUAL(prv_receiveConfirmable(&test, "13"), watcherP->transaction->mID);
+    }
+    prv_change(&test, 14);
+    prv_step(&test, 0);
+    CU_ASSERT_EQUAL(prv_countNotifications(&test), 0);
+    prv_step(&test, i * 600000);
+    CU_ASSERT_EQUAL(prv_countNotifications(&test), 0);
+    CU_ASSERT_PTR_NULL(test.contextP->observedList);
+    CU_ASSERT_PTR_NULL(test.contextP->transactionList);
+
+    prv_close(&test);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_observe_confirmable_timeout(void)
+{
+    observe_test_t test;
+    lwm2m_server_t server;
+    lwm2m_uri_t uri;
+    int i;
+
+    MEMORY_TRACE_BEFORE;
+
+    prv_init(&test);
+    memcpy(&server, &test.server, sizeof(lwm2m_server_t));
+    server.shortID = 2;
+    test.server.confirmableNotify = true;
+    (void)prv_observe(&test, &test.server, TEST_URI, LWM2M_CONTENT_TEXT);
+    (void)prv_observe(&test, &server, TEST_URI, LWM2M_CONTENT_TEXT);
+
+    prv_change(&test, 12);
+    prv_step(&test, 0);
+    CU_ASSERT_EQUAL(prv_countNotifications(&test), 2);
+
+    // the server never answers, only its watcher is removed
+    for (i = 1 ; i <= COAP_MAX_RETRANSMIT + 1 ; i++)
+    {
+        prv_step(&test, i * 600000);
+    }
+    CU_ASSERT(prv_countNotifications(&test) > 0);
+    CU_ASSERT_FATAL(lwm2m_stringToUri(TEST_URI, strlen(TEST_URI), &uri) != 0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(observe_findByUri(test.contextP, &uri));
+    CU_ASSERT_PTR_EQUAL(test.contextP->observedList->watcherList->server, &server);
+    CU_ASSERT_PTR_NULL(test.contextP->observedList->watcherList->next);
+    CU_ASSERT_PTR_NULL(test.contextP->transactionList);
+
+    prv_close(&test);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_observe_blocks(void)
+{
+    observe_test_t test;
+    coap_packet_t packet[1];
+    coap_packet_t request[1];
+    uint8_t buffer[64];
+    uint8_t etag[4];
+    const uint8_t * etagP;
+    size_t length;
+
+    MEMORY_TRACE_BEFORE;
+
+    prv_init(&test);
+    CU_ASSERT_EQUAL_FATAL(lwm2m_set_block_size(test.contextP, 16), 0);
+    (void)prv_observe(&test, &test.server, TEST_URI, LWM2M_CONTENT_TEXT);
+
+    // only the first block of a notification bigger than a block is sent
+    prv_change(&test, 1234567890123456789);
+    prv_step(&test, 0);
+    CU_ASSERT_FATAL(prv_receive(&test, packet));
+    CU_ASSERT_TRUE(IS_OPTION(packet, COAP_OPTION_OBSERVE));
+    CU_ASSERT_TRUE_FATAL(IS_OPTION(packet, COAP_OPTION_BLOCK2));
+    CU_ASSERT_EQUAL(packet->block2_num, 0);
+    CU_ASSERT_EQUAL(packet->block2_more, 1);
+    CU_ASSERT_EQUAL(packet->block2_size, 16);
+    CU_ASSERT_EQUAL(packet->payload_len, 16);
+    CU_ASSERT_NSTRING_EQUAL(packet->payload, "1234567890123456", 16);
+    CU_ASSERT_EQUAL_FATAL(coap_get_header_etag(packet, &etagP), 4);
+    memcpy(etag, etagP, 4);
+    coap_free_header(packet);
+
+    // the next one is sliced from the same representation
+    coap_init_message(request, COAP_TYPE_CON, COAP_GET, 0x4242);
+    coap_set_header_uri_path(request, TEST_URI);
+    coap_set_header_block2(request, 1, 0, 16);
+    length = coap_serialize_message_len(request, buffer, sizeof(buffer));
+    CU_ASSERT_FATAL(length != 0);
+    coap_free_header(request);
+    lwm2m_handle_packet(test.contextP, buffer, (int)length, &test.conn);
+    CU_ASSERT_FATAL(prv_receive(&test, packet));
+    CU_ASSERT_EQUAL(packet->code, COAP_205_CONTENT);
+    CU_ASSERT_FALSE(IS_OPTION(packet, COAP_OPTION_OBSERVE));
+    CU_ASSERT_EQUAL(packet->block2_num, 1);
+    CU_ASSERT_EQUAL(packet->block2_more, 0);
+    CU_ASSERT_EQUAL(packet->payload_len, 3);
+    CU_ASSERT_NSTRING_EQUAL(packet->payload, "789", 3);
+    CU_ASSERT_EQUAL(coap_get_header_etag(packet, &etagP), 4);
+    CU_ASSERT_EQUAL(memcmp(etag, etagP, 4), 0);
+    coap_free_header(packet);
+    CU_ASSERT_EQUAL(test.reads, 1);
+
+    prv_close(&test);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+// a server object instance with the short ID 1
+static uint8_t prv_serverRead(uint16_t instanceId,
+                              int * numDataP,
+                              lwm2m_data_t ** dataArrayP,
+                              lwm2m_object_t * objectP)
+{
+    int i;
+
+    if (instanceId != 0 || *numDataP == 0) return COAP_404_NOT_FOUND;
+
+    for (i = 0 ; i < *numDataP ; i++)
+    {
+        switch ((*dataArrayP)[i].id)
+        {
+        case LWM2M_SERVER_SHORT_ID_ID:
+            lwm2m_data_encode_int(1, *dataArrayP + i);
+            break;
+        case LWM2M_SERVER_NOTIF_MODE_ID:
+            lwm2m_data_encode_int(*(int64_t *)objectP->userData, *dataArrayP + i);
+            break;
+        default:
+            return COAP_404_NOT_FOUND;
+        }
+    }
+
+    return COAP_205_CONTENT;
+}
+
+static uint8_t prv_serverWrite(uint16_t instanceId,
+                               int numData,
+                               lwm2m_data_t * dataArray,
+                               lwm2m_object_t * objectP)
+{
+    if (instanceId != 0
+     || numData != 1
+     || dataArray->id != LWM2M_SERVER_NOTIF_MODE_ID
+     || 1 != lwm2m_data_decode_int(dataArray, (int64_t *)objectP->userData))
+    {
+        return COAP_400_BAD_REQUEST;
+    }
+
+    return COAP_204_CHANGED;
+}
+
+static void test_observe_notification_mode(void)
+{
+    observe_test_t test;
+    lwm2m_object_t object;
+    lwm2m_list_t instance;
+    int64_t mode = 0;
+    lwm2m_uri_t uri;
+
+    MEMORY_TRACE_BEFORE;
+
+    prv_init(&test);
+    memset(&object, 0, sizeof(object));
+    memset(&instance, 0, sizeof(instance));
+    object.objID = LWM2M_SERVER_OBJECT_ID;
+    object.instanceList = &instance;
+    object.readFunc = prv_serverRead;
+    object.writeFunc = prv_serverWrite;
+    object.userData = &mode;
+    CU_ASSERT_EQUAL_FATAL(lwm2m_add_object(test.contextP, &object), COAP_NO_ERROR);
+    test.contextP->serverList = &test.server;
+
+    // a write of the Default Notification Mode applies right away
+    CU_ASSERT_FATAL(lwm2m_stringToUri("/1/0/26", 7, &uri) != 0);
+    CU_ASSERT_EQUAL(object_write(test.contextP, &uri, LWM2M_CONTENT_TEXT, (uint8_t *)"1", 1), COAP_204_CHANGED);
+    CU_ASSERT_TRUE(test.server.confirmableNotify);
+    CU_ASSERT_EQUAL(object_write(test.contextP, &uri, LWM2M_CONTENT_TEXT, (uint8_t *)"0", 1), COAP_204_CHANGED);
+    CU_ASSERT_FALSE(test.server.confirmableNotify);
+
+    test.contextP->serverList = NULL;
+    prv_close(&test);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+typedef struct
+{
+    int                calls;
+    int                status;
+    lwm2m_media_type_t format;
+    int                length;
+} observe_result_t;
+
+static void prv_resultCallback(uint32_t clientID,
+                               lwm2m_uri_t * uriP,
+                               int status,
+                               lwm2m_media_type_t format,
+                               uint8_t * data,
+                               int dataLength,
+                               void * userData)
+{
+    observe_result_t * resultP = (observe_result_t *)userData;
+
+    (void)clientID;
+    (void)uriP;
+    (void)data;
+
+    resultP->calls++;
+    resultP->status = status;
+    resultP->format = format;
+    resultP->length = dataLength;
+}
+
+// observes the resource and answers with a text payload, returns the token used
+static void prv_serverObserve(lwm2m_context_t * contextP,
+                              connection_t * connP,
+                              observe_result_t * resultP,
+                              uint8_t * tokenP)
+{
+    lwm2m_uri_t uri;
+    lwm2m_transaction_t * transacP;
+    coap_packet_t * requestP;
+    coap_packet_t response[1];
+
+    CU_ASSERT_FATAL(lwm2m_stringToUri(TEST_URI, strlen(TEST_URI), &uri) != 0);
+    CU_ASSERT_EQUAL_FATAL(lwm2m_observe(contextP, 42, &uri, prv_resultCallback, resultP), 0);
+    transacP = contextP->transactionList;
+    CU_ASSERT_PTR_NOT_NULL_FATAL(transacP);
+    requestP = (coap_packet_t *)transacP->message;
+    CU_ASSERT_EQUAL_FATAL(requestP->token_len, 6);
+    memcpy(tokenP, requestP->token, 6);
+
+    coap_init_message(response, COAP_TYPE_ACK, COAP_205_CONTENT, transacP->mID);
+    coap_set_header_token(response, tokenP, 6);
+    coap_set_header_observe(response, 2);
+    coap_set_header_content_type(response, LWM2M_CONTENT_TEXT);
+    coap_set_payload(response, "12", 2);
+    CU_ASSERT_TRUE(transaction_handleResponse(contextP, connP, response, NULL));
+    coap_free_header(response);
+    CU_ASSERT_PTR_NULL(contextP->transactionList);
+}
+
+static bool prv_serverNotify(lwm2m_context_t * contextP,
+                             connection_t * connP,
+                             uint8_t * tokenP,
+                             uint32_t count,
+                             bool withFormat)
+{
+    coap_packet_t message[1];
+    coap_packet_t response[1];
+    bool result;
+
+    coap_init_message(message, COAP_TYPE_NON, COAP_205_CONTENT, (uint16_t)(1000 + count));
+    coap_set_header_token(message, tokenP, 6);
+    coap_set_header_observe(message, count);
+    if (withFormat) coap_set_header_content_type(message, LWM2M_CONTENT_TEXT);
+    coap_set_payload(message, "13", 2);
+
+    result = observe_handleNotify(contextP, connP, message, response);
+    coap_free_header(message);
+
+    return result;
+}
+
+// the first block of a notification sent in several blocks
+static bool prv_serverNotifyBlock(lwm2m_context_t * contextP,
+                                  connection_t * connP,
+                                  uint8_t * tokenP,
+                                  uint32_t count)
+{
+    coap_packet_t message[1];
+    coap_packet_t response[1];
+    bool result;
+
+    coap_init_message(message, COAP_TYPE_NON, COAP_205_CONTENT, (uint16_t)(1000 + count));
+    coap_set_header_token(message, tokenP, 6);
+    coap_set_header_observe(message, count);
+    coap_set_header_content_type(message, LWM2M_CONTENT_TEXT);
+    coap_set_header_etag(message, (const uint8_t *)"etag", 4);
+    coap_set_header_block2(message, 0, 1, 16);
+    coap_set_payload(message, "1234567890123456", 16);
+
+    result = observe_handleNotify(contextP, connP, message, response);
+    coap_free_header(message);
+
+    return result;
+}
+
+static void test_observe_server(void)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_client_t * clientP;
+    lwm2m_transaction_t * transacP;
+    coap_packet_t * requestP;
+    coap_packet_t response[1];
+    connection_t conn;
+    int peerSock;
+    observe_result_t result;
+    uint8_t oldToken[6];
+    uint8_t token[6];
+    int calls;
+
+    MEMORY_TRACE_BEFORE;
+
+    prv_openSession(&conn, &peerSock);
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+    clientP = (lwm2m_client_t *)lwm2m_malloc(sizeof(lwm2m_client_t));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(clientP);
+    memset(clientP, 0, sizeof(lwm2m_client_t));
+    clientP->internalID = 42;
+    clientP->sessionH = &conn;
+    contextP->clientList = clientP;
+    CU_ASSERT_TRUE_FATAL(hash_add(&contextP->clientIdIndex, clientP->internalID, clientP));
+    memset(&result, 0, sizeof(result));
+
+    prv_serverObserve(contextP, &conn, &result, oldToken);
+    CU_ASSERT_EQUAL(result.calls, 1);
+    CU_ASSERT_EQUAL(result.status, 0);
+    CU_ASSERT_EQUAL(contextP->observationIndex.count, 1);
+
+    // notifications are routed by their token, the media type is remembered
+    CU_ASSERT_TRUE(prv_serverNotify(contextP, &conn, oldToken, 3, true));
+    CU_ASSERT_EQUAL(result.calls, 2);
+    CU_ASSERT_EQUAL(result.status, 3);
+    CU_ASSERT_EQUAL(result.format, LWM2M_CONTENT_TEXT);
+    CU_ASSERT_TRUE(prv_serverNotify(contextP, &conn, oldToken, 4, false));
+    CU_ASSERT_EQUAL(result.calls, 3);
+    CU_ASSERT_EQUAL(result.status, 4);
+    CU_ASSERT_EQUAL(result.format, LWM2M_CONTENT_TEXT);
+
+    // a notification sent in several blocks is passed on once its next blocks are received
+    CU_ASSERT_TRUE(prv_serverNotifyBlock(contextP, &conn, oldToken, 5));
+    CU_ASSERT_EQUAL(result.calls, 3);
+    transacP = contextP->transactionList;
+    CU_ASSERT_PTR_NOT_NULL_FATAL(transacP);
+    requestP = (coap_packet_t *)transacP->message;
+    CU_ASSERT_EQUAL(requestP->code, COAP_GET);
+    CU_ASSERT_FALSE(IS_OPTION(requestP, COAP_OPTION_OBSERVE));
+    CU_ASSERT_EQUAL(requestP->block2_num, 1);
+    coap_init_message(response, COAP_TYPE_ACK, COAP_205_CONTENT, transacP->mID);
+    coap_set_header_token(response, requestP->token, requestP->token_len);
+    coap_set_header_content_type(response, LWM2M_CONTENT_TEXT);
+    coap_set_header_etag(response, (const uint8_t *)"etag", 4);
+    coap_set_header_block2(response, 1, 0, 16);
+    coap_set_payload(response, "789", 3);
+    CU_ASSERT_TRUE(transaction_handleResponse(contextP, &conn, response, NULL));
+    coap_free_header(response);
+    CU_ASSERT_PTR_NULL(contextP->transactionList);
+    CU_ASSERT_EQUAL(result.calls, 4);
+    CU_ASSERT_EQUAL(result.status, 5);
+    CU_ASSERT_EQUAL(result.length, 19);
+
+    // observing again gives the observation a new token, the old one is reset
+    prv_serverObserve(contextP, &conn, &result, token);
+    CU_ASSERT_NOT_EQUAL(memcmp(oldToken, token, 6), 0);
+    CU_ASSERT_EQUAL(contextP->observationIndex.count, 1);
+    calls = result.calls;
+    CU_ASSERT_TRUE(prv_serverNotify(contextP, &conn, oldToken, 5, true));
+    CU_ASSERT_EQUAL(result.calls, calls);
+    CU_ASSERT_TRUE(prv_serverNotify(contextP, &conn, token, 6, true));
+    CU_ASSERT_EQUAL(result.calls, calls + 1);
+    CU_ASSERT_EQUAL(result.status, 6);
+
+    // the observations of a client go away with it
+    contextP->clientList = NULL;
+    hash_remove(&contextP->clientIdIndex, clientP->internalID, clientP);
+    registration_freeClient(contextP, clientP);
+    CU_ASSERT_EQUAL(contextP->observationIndex.count, 0);
+    CU_ASSERT_FALSE(prv_serverNotify(contextP, &conn, token, 7, true));
+
+    lwm2m_close(contextP);
+    close(conn.sock);
+    close(peerSock);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static struct TestTable table[] = {
+        { "test of observe_expire() with an idle watcher", test_observe_idle },
+        { "test of observe_expire() with a minimum period", test_observe_min_period },
+        { "test of observe_expire() with a maximum period", test_observe_max_period },
+        { "test of observe_expire() with gt, lt and st", test_observe_numeric },
+        { "test of lwm2m_resource_value_changed()", test_observe_tagging },
+        { "test of observe_expire() with several media types", test_observe_formats },
+        { "test of confirmable notifications", test_observe_confirmable },
+        { "test of confirmable notifications replaced by a change", test_observe_confirmable_replace },
+        { "test of confirmable notifications timing out", test_observe_confirmable_timeout },
+        { "test of notifications bigger than a block", test_observe_blocks },
+        { "test of object_write() on the Default Notification Mode", test_observe_notification_mode },
+        { "test of observe_handleNotify()", test_observe_server },
+        { NULL, NULL },
+};
+
+CU_ErrorCode create_observe_suit() {
+    CU_pSuite pSuite = NULL;
+    pSuite = CU_add_suite("Suite_Observe", NULL, NULL);
+
+    if (NULL == pSuite) {
+        return CU_get_error();
+    }
+    return add_tests(pSuite, table);
+}
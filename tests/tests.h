@@ -32,5 +32,14 @@ CU_ErrorCode create_object_read_suit();
 CU_ErrorCode create_convert_numbers_suit();
 CU_ErrorCode create_tlv_json_suit();
 CU_ErrorCode create_block1_suit();
+CU_ErrorCode create_hash_suit();
+CU_ErrorCode create_timer_suit();
+CU_ErrorCode create_coap_suit();
+CU_ErrorCode create_arena_suit();
+CU_ErrorCode create_objects_suit();
+CU_ErrorCode create_list_suit();
+CU_ErrorCode create_block2_suit();
+CU_ErrorCode create_transaction_suit();
+CU_ErrorCode create_observe_suit();
 
 #endif /* TESTS_H_ */
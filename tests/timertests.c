@@ -0,0 +1,131 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2017 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ *******************************************************************************/
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+#include "internals.h"
+#include "memtest.h"
+
+#define TIMER_COUNT 100
+
+static bool prv_isHeap(lwm2m_timer_heap_t * heapP)
+{
+    size_t i;
+
+    for (i = 0 ; i < heapP->count ; i++)
+    {
+        if (heapP->entries[i]->position != i + 1) return false;
+        if (i > 0 && heapP->entries[(i - 1) / 2]->deadline > heapP->entries[i]->deadline) return false;
+    }
+
+    return true;
+}
+
+static void test_timer_order(void)
+{
+    lwm2m_context_t context;
+    lwm2m_timer_t timers[TIMER_COUNT];
+    int64_t previous;
+    int i;
+
+    MEMORY_TRACE_BEFORE;
+
+    memset(&context, 0, sizeof(context));
+    memset(timers, 0, sizeof(timers));
+
+    for (i = 0 ; i < TIMER_COUNT ; i++)
+    {
+        // spread the deadlines in a non monotonic order
+        CU_ASSERT_TRUE(timer_schedule(&context, timers + i, (i * 37) % TIMER_COUNT));
+    }
+    CU_ASSERT_EQUAL(context.timerHeap.count, TIMER_COUNT);
+    CU_ASSERT_TRUE(prv_isHeap(&context.timerHeap));
+
+    // move some timers around and remove a few
+    CU_ASSERT_TRUE(timer_schedule(&context, timers + 5, 1000));
+    CU_ASSERT_TRUE(timer_schedule(&context, timers + 50, -1));
+    timer_cancel(&context, timers + 7);
+    timer_cancel(&context, timers + 7);
+    CU_ASSERT_EQUAL(timers[7].position, 0);
+    CU_ASSERT_EQUAL(context.timerHeap.count, TIMER_COUNT - 1);
+    CU_ASSERT_TRUE(prv_isHeap(&context.timerHeap));
+    CU_ASSERT_PTR_EQUAL(context.timerHeap.entries[0], timers + 50);
+
+    previous = -2;
+    while (context.timerHeap.count > 0)
+    {
+        lwm2m_timer_t * timerP = context.timerHeap.entries[0];
+
+        CU_ASSERT(previous <= timerP->deadline);
+        previous = timerP->deadline;
+        timer_cancel(&context, timerP);
+        CU_ASSERT_TRUE(prv_isHeap(&context.timerHeap));
+    }
+    CU_ASSERT_EQUAL(previous, 1000);
+
+    timer_free(&context);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static void test_timer_step_timeout(void)
+{
+    lwm2m_context_t context;
+    lwm2m_timer_t timer;
+    int64_t timeout;
+
+    MEMORY_TRACE_BEFORE;
+
+    memset(&context, 0, sizeof(context));
+    memset(&timer, 0, sizeof(timer));
+    timer.type = (lwm2m_timer_type_t)-1;
+
+    timeout = 60;
+    timer_step(&context, 100, &timeout);
+    CU_ASSERT_EQUAL(timeout, 60);
+
+    CU_ASSERT_TRUE(timer_schedule(&context, &timer, 110));
+    timer_step(&context, 100, &timeout);
+    CU_ASSERT_EQUAL(timeout, 10);
+    CU_ASSERT_NOT_EQUAL(timer.position, 0);
+
+    // due timers of unknown type are dropped
+    timeout = 60;
+    timer_step(&context, 110, &timeout);
+    CU_ASSERT_EQUAL(timeout, 60);
+    CU_ASSERT_EQUAL(timer.position, 0);
+    CU_ASSERT_EQUAL(context.timerHeap.count, 0);
+
+    timer_free(&context);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static struct TestTable table[] = {
+        { "test of timer_schedule() and timer_cancel()", test_timer_order },
+        { "test of timer_step()", test_timer_step_timeout },
+        { NULL, NULL },
+};
+
+CU_ErrorCode create_timer_suit()
+{
+   CU_pSuite pSuite = NULL;
+
+   pSuite = CU_add_suite("Suite_Timer", NULL, NULL);
+   if (NULL == pSuite) {
+      return CU_get_error();
+   }
+
+   return add_tests(pSuite, table);
+}
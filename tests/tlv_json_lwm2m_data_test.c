@@ -415,6 +415,60 @@ static void test_13(void)
     test_raw(NULL, (uint8_t *)buffer, strlen(buffer), LWM2M_CONTENT_JSON, "13");
 }
 
+static void test_14(void)
+{
+    lwm2m_data_t * instancesP = lwm2m_data_new(20);
+    lwm2m_uri_t uri;
+    lwm2m_media_type_t format;
+    uint8_t * buffer;
+    uint8_t chunks[4096];
+    size_t offset;
+    int length;
+    int res;
+    int i;
+
+    CU_ASSERT_PTR_NOT_NULL_FATAL(instancesP);
+    for (i = 0; i < 20; i++)
+    {
+        lwm2m_data_t * resourcesP = lwm2m_data_new(3);
+
+        CU_ASSERT_PTR_NOT_NULL_FATAL(resourcesP);
+        resourcesP[0].id = 0;
+        lwm2m_data_encode_string("a resource value long enough to matter", resourcesP);
+        resourcesP[1].id = 1;
+        lwm2m_data_encode_int(i * 1000, resourcesP + 1);
+        resourcesP[2].id = 2;
+        lwm2m_data_encode_opaque((uint8_t *)"0123456789", 10, resourcesP + 2);
+        instancesP[i].id = i;
+        lwm2m_data_include(resourcesP, 3, instancesP + i);
+    }
+
+    // more than the former 1 KB limit
+    lwm2m_stringToUri("/12", 3, &uri);
+    format = LWM2M_CONTENT_JSON;
+    length = lwm2m_data_serialize(&uri, 20, instancesP, &format, &buffer);
+    CU_ASSERT_FATAL(length > 1024 && length <= (int)sizeof(chunks));
+    CU_ASSERT_EQUAL(buffer[length - 1], '}');
+
+    // small chunks rebuild the same output
+    offset = 0;
+    do
+    {
+        res = json_serializeChunk(&uri, 20, instancesP, &offset, chunks + offset, 100);
+        CU_ASSERT_FATAL(res >= 0);
+    } while (res == 100);
+    CU_ASSERT_EQUAL(offset, (size_t)length);
+    CU_ASSERT(0 == memcmp(buffer, chunks, length));
+
+    lwm2m_data_free(20, instancesP);
+
+    res = lwm2m_data_parse(&uri, buffer, length, LWM2M_CONTENT_JSON, &instancesP);
+    CU_ASSERT_EQUAL(res, 20);
+    CU_ASSERT_EQUAL(instancesP[19].value.asChildren.count, 3);
+    lwm2m_data_free(res, instancesP);
+    lwm2m_free(buffer);
+}
+
 static struct TestTable table[] = {
         { "test of test_1()", test_1 },
         { "test of test_2()", test_2 },
@@ -429,6 +483,7 @@ static struct TestTable table[] = {
         { "test of test_11()", test_11 },
         { "test of test_12()", test_12 },
         { "test of test_13()", test_13 },
+        { "test of test_14()", test_14 },
         { NULL, NULL },
 };
 
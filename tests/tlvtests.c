@@ -156,6 +156,58 @@ static void test_tlv_parse()
     MEMORY_TRACE_AFTER_EQ;
 }
 
+static void test_tlv_parse_arena()
+{
+    MEMORY_TRACE_BEFORE;
+    // Instance 1 {Resource 0 {0}, Resource 1 {1}, ... Resource 39 {39}}
+    uint8_t data[3 + 40 * 3];
+    lwm2m_arena_t arena;
+    lwm2m_data_t *dataP;
+    int result;
+    int i;
+
+    data[0] = 0x08;
+    data[1] = 1;
+    data[2] = 40 * 3;
+    for (i = 0 ; i < 40 ; i++)
+    {
+        data[3 + i * 3] = 0xC1;
+        data[3 + i * 3 + 1] = (uint8_t)i;
+        data[3 + i * 3 + 2] = (uint8_t)i;
+    }
+
+    memset(&arena, 0, sizeof(arena));
+    arena_enter(&arena);
+
+    result = tlv_parse(&arena, data, sizeof(data), &dataP);
+    CU_ASSERT_EQUAL(result, 1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(dataP);
+    CU_ASSERT_EQUAL_FATAL(dataP->value.asChildren.count, 40);
+    for (i = 0 ; i < 40 ; i++)
+    {
+        lwm2m_data_t * resP = dataP->value.asChildren.array + i;
+
+        CU_ASSERT_EQUAL(resP->type, LWM2M_TYPE_OPAQUE);
+        CU_ASSERT_EQUAL(resP->id, i);
+        CU_ASSERT_EQUAL(resP->value.asBuffer.length, 1);
+        // values are not copied
+        CU_ASSERT_PTR_EQUAL(resP->value.asBuffer.buffer, data + 3 + i * 3 + 2);
+    }
+    data_free(&arena, result, dataP);
+
+    // an empty instance nested in an instance makes the whole parse fail
+    data[2] = 2;
+    data[3] = 0x00;
+    data[4] = 5;
+    result = tlv_parse(&arena, data, 5, &dataP);
+    CU_ASSERT_EQUAL(result, 0);
+    CU_ASSERT_PTR_NULL(dataP);
+
+    arena_leave(&arena);
+    arena_free(&arena);
+    MEMORY_TRACE_AFTER_EQ;
+}
+
 static void test_tlv_serialize()
 {
     MEMORY_TRACE_BEFORE;
@@ -227,6 +279,69 @@ static void test_tlv_serialize()
     MEMORY_TRACE_AFTER_EQ;
 }
 
+static void test_tlv_serialize_chunk(void)
+{
+    MEMORY_TRACE_BEFORE;
+
+    lwm2m_data_t *dataP;
+    lwm2m_data_t *tlvSubP;
+    uint8_t data[300];
+    uint8_t* buffer;
+    uint8_t chunks[400];
+    size_t offset;
+    size_t chunkSize;
+    int length;
+    int result;
+    int i;
+
+    for (i = 0 ; i < (int)sizeof(data) ; i++) data[i] = (uint8_t)i;
+
+    tlvSubP = lwm2m_data_new(5);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(tlvSubP);
+    tlvSubP[0].id = 1;
+    lwm2m_data_encode_int(-70000, tlvSubP);
+    tlvSubP[1].id = 2;
+    lwm2m_data_encode_opaque(data, sizeof(data), tlvSubP + 1);
+    tlvSubP[2].id = 300;
+    lwm2m_data_encode_float(1.5, tlvSubP + 2);
+    tlvSubP[3].id = 4;
+    lwm2m_data_encode_bool(true, tlvSubP + 3);
+    tlvSubP[4].id = 5;
+    lwm2m_data_encode_string("chunk", tlvSubP + 4);
+
+    dataP = lwm2m_data_new(1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(dataP);
+    dataP->id = 3;
+    lwm2m_data_include(tlvSubP, 5, dataP);
+
+    length = tlv_serialize(false, 1, dataP, &buffer);
+    CU_ASSERT_FATAL(length > (int)sizeof(data) && length <= (int)sizeof(chunks));
+
+    // any chunk size rebuilds the same stream
+    for (chunkSize = 1 ; chunkSize <= 17 ; chunkSize++)
+    {
+        memset(chunks, 0, sizeof(chunks));
+        offset = 0;
+        do
+        {
+            result = tlv_serializeChunk(false, 1, dataP, &offset, chunks + offset, chunkSize);
+            CU_ASSERT_FATAL(result >= 0);
+        } while (result == (int)chunkSize);
+        CU_ASSERT_EQUAL(offset, (size_t)length);
+        CU_ASSERT(0 == memcmp(buffer, chunks, length));
+    }
+
+    // resuming past the end writes nothing
+    offset = length;
+    CU_ASSERT_EQUAL(tlv_serializeChunk(false, 1, dataP, &offset, chunks, sizeof(chunks)), 0);
+    CU_ASSERT_EQUAL(offset, (size_t)length);
+
+    lwm2m_data_free(1, dataP);
+    lwm2m_free(buffer);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
 static void test_tlv_int(void)
 {
    MEMORY_TRACE_BEFORE;
@@ -395,7 +510,9 @@ static struct TestTable table[] = {
         { "test of lwm2m_data_free()", test_tlv_free },
         { "test of lwm2m_decodeTLV()", test_decodeTLV },
         { "test of lwm2m_data_parse()", test_tlv_parse },
+        { "test of tlv_parse() with an arena", test_tlv_parse_arena },
         { "test of lwm2m_data_serialize()", test_tlv_serialize },
+        { "test of tlv_serializeChunk()", test_tlv_serialize_chunk },
         { "test of lwm2m_data_encode_int() and lwm2m_data_decode_int()", test_tlv_int },
         { "test of lwm2m_data_encode_bool()and lwm2m_data_decode_bool()", test_tlv_bool },
         { "test of lwm2m_data_encode_float() and lwm2m_data_decode_float()", test_tlv_float },
@@ -0,0 +1,300 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2017 Intel Corporation and others.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Eclipse Distribution License v1.0 which accompany this distribution.
+ *
+ * The Eclipse Public License is available at
+ *    http://www.eclipse.org/legal/epl-v10.html
+ * The Eclipse Distribution License is available at
+ *    http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ *******************************************************************************/
+
+#include "tests.h"
+#include "CUnit/Basic.h"
+#include "internals.h"
+#include "connection.h"
+#include "memtest.h"
+
+#define PAYLOAD "0123456789abcdefghijklmnopqrstuvwxyzABCD"
+#define PAYLOAD_LEN 40
+
+typedef struct
+{
+    int      calls;
+    uint8_t  code;
+    uint16_t blockSize;
+} result_t;
+
+static void prv_resultCallback(lwm2m_transaction_t * transacP,
+                               void * message)
+{
+    result_t * resultP = (result_t *)transacP->userData;
+
+    resultP->calls++;
+    resultP->code = message != NULL ? ((coap_packet_t *)message)->code : 0;
+    resultP->blockSize = transacP->block1Size;
+}
+
+// the transactions are sent to a socket nobody reads
+static void prv_openSession(connection_t * connP,
+                            int * peerSockP)
+{
+    struct sockaddr_in6 addr;
+    socklen_t addrLen = sizeof(addr);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr = in6addr_loopback;
+    *peerSockP = socket(AF_INET6, SOCK_DGRAM, 0);
+    CU_ASSERT_FATAL(*peerSockP >= 0);
+    CU_ASSERT_EQUAL_FATAL(bind(*peerSockP, (struct sockaddr *)&addr, addrLen), 0);
+    CU_ASSERT_EQUAL_FATAL(getsockname(*peerSockP, (struct sockaddr *)&addr, &addrLen), 0);
+
+    memset(connP, 0, sizeof(connection_t));
+    connP->sock = socket(AF_INET6, SOCK_DGRAM, 0);
+    CU_ASSERT_FATAL(connP->sock >= 0);
+    connP->addr = addr;
+    connP->addrLen = addrLen;
+}
+
+static lwm2m_transaction_t * prv_newTransaction(lwm2m_context_t * contextP,
+                                                connection_t * connP,
+                                                result_t * resultP,
+                                                uint16_t blockSize)
+{
+    lwm2m_transaction_t * transacP;
+    lwm2m_uri_t uri;
+
+    memset(&uri, 0, sizeof(uri));
+    uri.flag = LWM2M_URI_FLAG_OBJECT_ID | LWM2M_URI_FLAG_INSTANCE_ID | LWM2M_URI_FLAG_RESOURCE_ID;
+    uri.objectId = 5;
+    uri.resourceId = 0;
+
+    transacP = transaction_new(connP, COAP_PUT, NULL, &uri, contextP->nextMID++, 4, NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(transacP);
+    coap_set_header_content_type(transacP->message, LWM2M_CONTENT_OPAQUE);
+    CU_ASSERT_TRUE_FATAL(transaction_setPayload(transacP, (uint8_t *)PAYLOAD, PAYLOAD_LEN, blockSize));
+    transacP->callback = prv_resultCallback;
+    transacP->userData = resultP;
+    memset(resultP, 0, sizeof(result_t));
+
+    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transacP);
+    CU_ASSERT_EQUAL(transaction_send(contextP, transacP), 0);
+
+    return transacP;
+}
+
+// checks the Block1 option and the payload of the last request sent
+static void prv_checkBlock(lwm2m_transaction_t * transacP,
+                           uint32_t num,
+                           uint8_t more,
+                           uint16_t size,
+                           size_t offset,
+                           size_t length)
+{
+    coap_packet_t packet[1];
+    uint32_t blockNum;
+    uint8_t blockMore;
+    uint16_t blockSize;
+
+    CU_ASSERT_PTR_NOT_NULL_FATAL(transacP->buffer);
+    CU_ASSERT_EQUAL_FATAL(coap_parse_message(packet, transacP->buffer, transacP->buffer_len), NO_ERROR);
+    CU_ASSERT_EQUAL(packet->mid, transacP->mID);
+    CU_ASSERT_TRUE(coap_get_header_block1(packet, &blockNum, &blockMore, &blockSize, NULL));
+    CU_ASSERT_EQUAL(blockNum, num);
+    CU_ASSERT_EQUAL(blockMore, more);
+    CU_ASSERT_EQUAL(blockSize, size);
+    CU_ASSERT_EQUAL(packet->payload_len, length);
+    CU_ASSERT_NSTRING_EQUAL(packet->payload, PAYLOAD + offset, length);
+    coap_free_header(packet);
+}
+
+// answers the last request sent with a piggybacked response
+static bool prv_reply(lwm2m_context_t * contextP,
+                      lwm2m_transaction_t * transacP,
+                      uint8_t code,
+                      uint32_t num,
+                      uint16_t size)
+{
+    coap_packet_t * requestP = (coap_packet_t *)transacP->message;
+    coap_packet_t response[1];
+    bool result;
+
+    coap_init_message(response, COAP_TYPE_ACK, code, transacP->mID);
+    coap_set_header_token(response, requestP->token, requestP->token_len);
+    coap_set_header_block1(response, num, 0, size);
+
+    result = transaction_handleResponse(contextP, transacP->peerH, response, NULL);
+    coap_free_header(response);
+
+    return result;
+}
+
+static void test_transaction_block1(void)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_transaction_t * transacP;
+    connection_t conn;
+    int peerSock;
+    result_t result;
+    uint16_t mid;
+    lwm2m_client_t client;
+
+    MEMORY_TRACE_BEFORE;
+
+    prv_openSession(&conn, &peerSock);
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+    memset(&client, 0, sizeof(client));
+    client.internalID = 7;
+    client.sessionH = &conn;
+    contextP->clientList = &client;
+    CU_ASSERT_TRUE_FATAL(hash_add(&contextP->clientIdIndex, client.internalID, &client));
+
+    transacP = prv_newTransaction(contextP, &conn, &result, 32);
+    transacP->toClient = true;
+    transacP->clientID = client.internalID;
+    prv_checkBlock(transacP, 0, 1, 32, 0, 32);
+
+    // the peer asks for smaller blocks, the first one is sent again
+    mid = transacP->mID;
+    CU_ASSERT_TRUE(prv_reply(contextP, transacP, COAP_413_ENTITY_TOO_LARGE, 0, 16));
+    CU_ASSERT_PTR_EQUAL(contextP->transactionList, transacP);
+    CU_ASSERT_NOT_EQUAL(transacP->mID, mid);
+    prv_checkBlock(transacP, 0, 1, 16, 0, 16);
+    CU_ASSERT_EQUAL(client.blockSize, 16);
+
+    // a larger size offered afterwards is ignored
+    mid = transacP->mID;
+    CU_ASSERT_TRUE(prv_reply(contextP, transacP, COAP_231_CONTINUE, 0, 64));
+    CU_ASSERT_NOT_EQUAL(transacP->mID, mid);
+    prv_checkBlock(transacP, 1, 1, 16, 16, 16);
+
+    CU_ASSERT_TRUE(prv_reply(contextP, transacP, COAP_231_CONTINUE, 1, 16));
+    prv_checkBlock(transacP, 2, 0, 16, 32, 8);
+    CU_ASSERT_EQUAL(result.calls, 0);
+
+    // the final response completes the transaction with the size in use
+    CU_ASSERT_TRUE(prv_reply(contextP, transacP, COAP_204_CHANGED, 2, 16));
+    CU_ASSERT_EQUAL(result.calls, 1);
+    CU_ASSERT_EQUAL(result.code, COAP_204_CHANGED);
+    CU_ASSERT_EQUAL(result.blockSize, 16);
+    CU_ASSERT_PTR_NULL(contextP->transactionList);
+
+    // 4.13 is only honoured on the first block
+    transacP = prv_newTransaction(contextP, &conn, &result, 16);
+    CU_ASSERT_TRUE(prv_reply(contextP, transacP, COAP_231_CONTINUE, 0, 16));
+    prv_checkBlock(transacP, 1, 1, 16, 16, 16);
+    CU_ASSERT_TRUE(prv_reply(contextP, transacP, COAP_413_ENTITY_TOO_LARGE, 1, 8));
+    CU_ASSERT_EQUAL(result.calls, 1);
+    CU_ASSERT_EQUAL(result.code, COAP_413_ENTITY_TOO_LARGE);
+    CU_ASSERT_EQUAL(result.blockSize, 16);
+    CU_ASSERT_PTR_NULL(contextP->transactionList);
+    CU_ASSERT_EQUAL(client.blockSize, 16);
+
+    contextP->clientList = NULL;
+    hash_remove(&contextP->clientIdIndex, client.internalID, &client);
+    lwm2m_close(contextP);
+    close(conn.sock);
+    close(peerSock);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+// answers the last GET sent with a block of PAYLOAD
+static bool prv_replyBlock2(lwm2m_context_t * contextP,
+                            lwm2m_transaction_t * transacP,
+                            uint32_t num,
+                            uint8_t more,
+                            uint8_t etag)
+{
+    coap_packet_t * requestP = (coap_packet_t *)transacP->message;
+    coap_packet_t response[1];
+    bool result;
+
+    coap_init_message(response, COAP_TYPE_ACK, COAP_205_CONTENT, transacP->mID);
+    coap_set_header_token(response, requestP->token, requestP->token_len);
+    coap_set_header_etag(response, &etag, 1);
+    coap_set_header_block2(response, num, more, 16);
+    coap_set_payload(response, PAYLOAD + num * 16, 16);
+
+    result = transaction_handleResponse(contextP, transacP->peerH, response, NULL);
+    coap_free_header(response);
+
+    return result;
+}
+
+static lwm2m_transaction_t * prv_newGet(lwm2m_context_t * contextP,
+                                        connection_t * connP,
+                                        result_t * resultP)
+{
+    lwm2m_transaction_t * transacP;
+
+    transacP = transaction_new(connP, COAP_GET, NULL, NULL, contextP->nextMID++, 4, NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(transacP);
+    coap_set_header_uri_path(transacP->message, "/5/0/0");
+    transacP->callback = prv_resultCallback;
+    transacP->userData = resultP;
+    memset(resultP, 0, sizeof(result_t));
+
+    contextP->transactionList = (lwm2m_transaction_t *)LWM2M_LIST_ADD(contextP->transactionList, transacP);
+    CU_ASSERT_EQUAL(transaction_send(contextP, transacP), 0);
+
+    return transacP;
+}
+
+static void test_transaction_block2(void)
+{
+    lwm2m_context_t * contextP;
+    lwm2m_transaction_t * transacP;
+    connection_t conn;
+    int peerSock;
+    result_t result;
+
+    MEMORY_TRACE_BEFORE;
+
+    prv_openSession(&conn, &peerSock);
+    contextP = lwm2m_init(NULL);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(contextP);
+
+    transacP = prv_newGet(contextP, &conn, &result);
+    CU_ASSERT_TRUE(prv_replyBlock2(contextP, transacP, 0, 1, 1));
+    CU_ASSERT_TRUE(prv_replyBlock2(contextP, transacP, 1, 0, 1));
+    CU_ASSERT_EQUAL(result.calls, 1);
+    CU_ASSERT_EQUAL(result.code, COAP_205_CONTENT);
+    CU_ASSERT_PTR_NULL(contextP->transactionList);
+
+    // the representation changed between two blocks
+    transacP = prv_newGet(contextP, &conn, &result);
+    CU_ASSERT_TRUE(prv_replyBlock2(contextP, transacP, 0, 1, 1));
+    CU_ASSERT_EQUAL(result.calls, 0);
+    CU_ASSERT_TRUE(prv_replyBlock2(contextP, transacP, 1, 0, 2));
+    CU_ASSERT_EQUAL(result.calls, 1);
+    CU_ASSERT_EQUAL(result.code, COAP_408_REQ_ENTITY_INCOMPLETE);
+    CU_ASSERT_PTR_NULL(contextP->transactionList);
+
+    lwm2m_close(contextP);
+    close(conn.sock);
+    close(peerSock);
+
+    MEMORY_TRACE_AFTER_EQ;
+}
+
+static struct TestTable table[] = {
+        { "test of transaction_handleResponse() with Block1 replies", test_transaction_block1 },
+        { "test of transaction_handleResponse() with Block2 replies", test_transaction_block2 },
+        { NULL, NULL },
+};
+
+CU_ErrorCode create_transaction_suit() {
+    CU_pSuite pSuite = NULL;
+    pSuite = CU_add_suite("Suite_Transaction", NULL, NULL);
+
+    if (NULL == pSuite) {
+        return CU_get_error();
+    }
+    return add_tests(pSuite, table);
+}
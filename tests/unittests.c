@@ -58,6 +58,58 @@ int main()
        goto exit;
    }
 
+    if (CUE_SUCCESS != create_hash_suit()) {
+       goto exit;
+   }
+
+    if (CUE_SUCCESS != create_timer_suit()) {
+       goto exit;
+   }
+
+    if (CUE_SUCCESS != create_coap_suit()) {
+       goto exit;
+   }
+
+    if (CUE_SUCCESS != create_arena_suit()) {
+       goto exit;
+   }
+
+    if (CUE_SUCCESS != create_objects_suit()) {
+       goto exit;
+   }
+
+    if (CUE_SUCCESS != create_list_suit()) {
+       goto exit;
+   }
+
+    if (CUE_SUCCESS != create_block2_suit()) {
+       goto exit;
+   }
+
+    if (CUE_SUCCESS != create_uri_suit()) {
+       goto exit;
+   }
+
+    if (CUE_SUCCESS != create_tlv_suit()) {
+       goto exit;
+   }
+
+    if (CUE_SUCCESS != create_convert_numbers_suit()) {
+       goto exit;
+   }
+
+    if (CUE_SUCCESS != create_block1_suit()) {
+       goto exit;
+   }
+
+    if (CUE_SUCCESS != create_transaction_suit()) {
+       goto exit;
+   }
+
+    if (CUE_SUCCESS != create_observe_suit()) {
+       goto exit;
+   }
+
    CU_basic_set_mode(CU_BRM_VERBOSE);
    CU_basic_run_tests();
 exit:
@@ -24,12 +24,15 @@
 static void test_uri_decode(void)
 {
     lwm2m_uri_t* uri;
+    uint32_t clientId;
     multi_option_t extraID = { .next = NULL, .is_static = 1, .len = 3, .data = (uint8_t *) "555" };
     multi_option_t rID = { .next = NULL, .is_static = 1, .len = 1, .data = (uint8_t *) "0" };
     multi_option_t iID = { .next = &rID, .is_static = 1, .len = 2, .data = (uint8_t *) "11" };
     multi_option_t oID = { .next = &iID, .is_static = 1, .len = 4, .data = (uint8_t *) "9050" };
     multi_option_t location = { .next = NULL, .is_static = 1, .len = 4, .data = (uint8_t *) "5a3f" };
     multi_option_t locationDecimal = { .next = NULL, .is_static = 1, .len = 4, .data = (uint8_t *) "5312" };
+    multi_option_t locationLarge = { .next = NULL, .is_static = 1, .len = 10, .data = (uint8_t *) "4000000000" };
+    multi_option_t locationOverflow = { .next = NULL, .is_static = 1, .len = 10, .data = (uint8_t *) "4294967296" };
     multi_option_t reg = { .next = NULL, .is_static = 1, .len = 2, .data = (uint8_t *) "rd" };
     multi_option_t boot = { .next = NULL, .is_static = 1, .len = 2, .data = (uint8_t *) "bs" };
 
@@ -56,6 +59,27 @@ static void test_uri_decode(void)
     CU_ASSERT_EQUAL(uri->objectId, 5312);
     lwm2m_free(uri);
 
+    /* "/rd/4000000000" */
+    reg.next = &locationLarge;
+    uri = uri_decode(NULL, &reg);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(uri);
+    CU_ASSERT_EQUAL(uri->flag, LWM2M_URI_FLAG_REGISTRATION | LWM2M_URI_FLAG_OBJECT_ID);
+    CU_ASSERT_TRUE(uri_getClientId(&reg, &clientId));
+    CU_ASSERT_EQUAL(clientId, 4000000000u);
+    lwm2m_free(uri);
+
+    /* "/rd/4294967296" */
+    reg.next = &locationOverflow;
+    uri = uri_decode(NULL, &reg);
+    CU_ASSERT_PTR_NULL(uri);
+    CU_ASSERT_FALSE(uri_getClientId(&reg, &clientId));
+
+    /* "/rd/4000000000/555" */
+    reg.next = &locationLarge;
+    locationLarge.next = &extraID;
+    CU_ASSERT_FALSE(uri_getClientId(&reg, &clientId));
+    locationLarge.next = NULL;
+
     /* "/bs" */
     uri = uri_decode(NULL, &boot);
     CU_ASSERT_PTR_NOT_NULL_FATAL(uri);
@@ -68,6 +92,10 @@ static void test_uri_decode(void)
     CU_ASSERT_PTR_NULL(uri);
     lwm2m_free(uri);
 
+    /* "/bs/4000000000" is not a registration location */
+    boot.next = &locationLarge;
+    CU_ASSERT_FALSE(uri_getClientId(&boot, &clientId));
+
     /* "/9050/11/0" */
     uri = uri_decode(NULL, &oID);
     CU_ASSERT_PTR_NOT_NULL_FATAL(uri);